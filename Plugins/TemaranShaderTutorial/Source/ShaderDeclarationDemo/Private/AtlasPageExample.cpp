@@ -0,0 +1,252 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "AtlasPageExample.h"
+#include "ComputeShaderExample.h"
+#include "RenderTargetAtlas.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTrace.h"
+#include "CommonRenderResources.h"
+#include "GlobalShader.h"
+#include "PipelineStateCache.h"
+#include "RenderGraphUtils.h"
+#include "RenderTargetPool.h"
+#include "RenderUtils.h"
+#include "RHICommandList.h"
+#include "RHIStaticStates.h"
+#include "ShaderParameterStruct.h"
+#include "ShaderParameterUtils.h"
+#include "TextureResource.h"
+
+#define NUM_THREADS_PER_GROUP_DIMENSION 8
+
+// Must match SLOT_PARAMETERS_STRIDE in AtlasPage.usf
+#define SLOT_PARAMETERS_STRIDE 4
+
+static_assert(FRenderTargetAtlas::MinSlotSize % NUM_THREADS_PER_GROUP_DIMENSION == 0, "Atlas slots must be made of whole thread groups.");
+
+BEGIN_SHADER_PARAMETER_STRUCT(FAtlasPageParameters, )
+	SHADER_PARAMETER_SRV(Buffer<float4>, SlotParameters)
+	SHADER_PARAMETER(uint32, SlotSize)
+	SHADER_PARAMETER(uint32, SlotsPerRow)
+	SHADER_PARAMETER(uint32, ComputeSlotsPerRow)
+	SHADER_PARAMETER(FVector2D, PageSize)
+END_SHADER_PARAMETER_STRUCT()
+
+class FAtlasPageCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FAtlasPageCS);
+	SHADER_USE_PARAMETER_STRUCT(FAtlasPageCS, FGlobalShader);
+
+	class FHalfPrecisionDim : SHADER_PERMUTATION_BOOL("USE_HALF_PRECISION");
+	using FPermutationDomain = TShaderPermutationDomain<FHalfPrecisionDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FAtlasPageParameters, Page)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, OutputTexture)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::ES3_1);
+	}
+
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_X1"), NUM_THREADS_PER_GROUP_DIMENSION);
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_Y1"), NUM_THREADS_PER_GROUP_DIMENSION);
+	}
+};
+
+class FAtlasPageVS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FAtlasPageVS);
+	SHADER_USE_PARAMETER_STRUCT(FAtlasPageVS, FGlobalShader);
+
+	using FParameters = FAtlasPageParameters;
+
+public:
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::ES3_1);
+	}
+};
+
+class FAtlasPagePS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FAtlasPagePS);
+	SHADER_USE_PARAMETER_STRUCT(FAtlasPagePS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_INCLUDE(FAtlasPageParameters, Page)
+		SHADER_PARAMETER_TEXTURE(Texture2D<float4>, ComputeShaderOutput)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::ES3_1);
+	}
+};
+
+// This will tell the engine to create the shader and where the shader entry point is.
+//                      ShaderType                      ShaderPath                  Shader function name    Type
+IMPLEMENT_GLOBAL_SHADER(FAtlasPageCS, "/TutorialShaders/Private/AtlasPage.usf", "MainAtlasComputeShader", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FAtlasPageVS, "/TutorialShaders/Private/AtlasPage.usf", "MainAtlasVertexShader", SF_Vertex);
+IMPLEMENT_GLOBAL_SHADER(FAtlasPagePS, "/TutorialShaders/Private/AtlasPage.usf", "MainAtlasPixelShader", SF_Pixel);
+
+void FAtlasPageExample::DrawPage_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameterBatch& Batch, TArrayView<const int32> DrawIndices, TRefCountPtr<IPooledRenderTarget>& ComputeShaderOutput, FName MemoryTrackingName)
+{
+	check(IsInRenderingThread());
+	if (DrawIndices.Num() == 0)
+	{
+		return;
+	}
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_AtlasPage); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_AtlasPage); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+
+	UTextureRenderTarget2D* Page = Batch.RenderTargets[DrawIndices[0]];
+	FTextureRenderTargetResource* PageResource = Page->GetRenderTargetResource();
+	const FIntPoint PageSize = PageResource->GetSizeXY();
+	const int32 SlotSize = Batch.AtlasRects[DrawIndices[0]].Width();
+	const int32 SlotsPerRow = PageSize.X / SlotSize;
+	const FName PageName = Batch.RenderTargetNames[DrawIndices[0]];
+
+	// Everything that differs per slot goes into one buffer that both passes index with the slot's draw index.
+	const int64 SlotBufferBytes = sizeof(FVector4) * SLOT_PARAMETERS_STRIDE * (int64)DrawIndices.Num();
+	FReadBuffer SlotBuffer;
+	{
+		SHADERPLUGIN_TRACE_SCOPE(AtlasSlotParametersUpload);
+		SlotBuffer.Initialize(sizeof(FVector4), SLOT_PARAMETERS_STRIDE * DrawIndices.Num(), PF_A32B32G32R32F, BUF_Volatile);
+
+		FVector4* SlotData = static_cast<FVector4*>(RHILockVertexBuffer(SlotBuffer.Buffer, 0, SlotBufferBytes, RLM_WriteOnly));
+		for (int32 DrawIndex = 0; DrawIndex < DrawIndices.Num(); DrawIndex++)
+		{
+			const int32 Index = DrawIndices[DrawIndex];
+			const FIntRect& Rect = Batch.AtlasRects[Index];
+			check(Batch.RenderTargets[Index] == Page && Rect.Width() == SlotSize && Rect.Height() == SlotSize);
+
+			const FFractalFrameConstants FrameConstants(Batch.SimulationStates[Index]);
+			const FColor& StartColor = Batch.StartColors[Index];
+			const FColor& EndColor = Batch.EndColors[Index];
+			const int32 SlotIndex = Rect.Min.X / SlotSize + (Rect.Min.Y / SlotSize) * SlotsPerRow;
+
+			FVector4* Slot = SlotData + DrawIndex * SLOT_PARAMETERS_STRIDE;
+			Slot[0] = FVector4(StartColor.R, StartColor.G, StartColor.B, StartColor.A) / 255.0f;
+			Slot[1] = FVector4(EndColor.R, EndColor.G, EndColor.B, EndColor.A) / 255.0f;
+			Slot[2] = FVector4(FrameConstants.TimePhase, FrameConstants.TimeWarp, FrameConstants.ZOffset, FrameConstants.V1Phase);
+			Slot[3] = FVector4(FrameConstants.V2Phase, FrameConstants.RedScale, Batch.ComputeShaderBlends[Index], SlotIndex);
+		}
+		RHIUnlockVertexBuffer(SlotBuffer.Buffer);
+
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, SlotBufferBytes);
+	}
+	FShaderPluginScopedMemory SlotBufferMemory(EShaderPluginResource::AtlasSlotParameters, PageName, SlotBufferBytes);
+
+	// The drawn slots are packed into the compute output in draw order, rather than mirroring the whole page. A page with
+	// a few moving slots then costs a few slots of memory and bandwidth instead of a full page. The shaders address the
+	// output in texels, so it can be larger than the slots need.
+	const int32 ComputeSlotsPerRow = FMath::Min(DrawIndices.Num(), SlotsPerRow);
+	const FIntPoint ComputeOutputSize = FIntPoint(ComputeSlotsPerRow, FMath::DivideAndRoundUp(DrawIndices.Num(), ComputeSlotsPerRow)) * SlotSize;
+
+	const FIntPoint OldExtent = ComputeShaderOutput.IsValid() ? ComputeShaderOutput->GetDesc().Extent : FIntPoint::ZeroValue;
+	if (ComputeOutputSize.X > OldExtent.X || ComputeOutputSize.Y > OldExtent.Y)
+	{
+		// Growing to cover both the old and the new size means pages with a different slot layout don't take turns
+		// reallocating it. It only ever grows, so this stops happening once the largest page has been drawn.
+		const FIntPoint NewExtent = ComputeOutputSize.ComponentMax(OldExtent);
+		if (ComputeShaderOutput.IsValid())
+		{
+			FShaderPluginMemory::TrackFree(EShaderPluginResource::AtlasPageComputeOutput, MemoryTrackingName, CalculateImageBytes(OldExtent.X, OldExtent.Y, 0, PF_R8G8B8A8));
+			ComputeShaderOutput.SafeRelease();
+		}
+
+		FPooledRenderTargetDesc ComputeShaderOutputDesc(FPooledRenderTargetDesc::Create2DDesc(NewExtent, PF_R8G8B8A8, FClearValueBinding::None, TexCreate_None, TexCreate_RenderTargetable | TexCreate_UAV, false));
+		ComputeShaderOutputDesc.DebugName = TEXT("ShaderPlugin_AtlasPageComputeOutput");
+		GRenderTargetPool.FindFreeElement(RHICmdList, ComputeShaderOutputDesc, ComputeShaderOutput, TEXT("ShaderPlugin_AtlasPageComputeOutput"));
+		FShaderPluginMemory::TrackAllocation(EShaderPluginResource::AtlasPageComputeOutput, MemoryTrackingName, CalculateImageBytes(NewExtent.X, NewExtent.Y, 0, PF_R8G8B8A8));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	}
+
+	FAtlasPageParameters PageParameters;
+	PageParameters.SlotParameters = SlotBuffer.SRV;
+	PageParameters.SlotSize = SlotSize;
+	PageParameters.SlotsPerRow = SlotsPerRow;
+	PageParameters.ComputeSlotsPerRow = ComputeSlotsPerRow;
+	PageParameters.PageSize = FVector2D(PageSize.X, PageSize.Y);
+
+	auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+
+	{
+		SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Compute); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+		SHADERPLUGIN_TRACE_SCOPE(Dispatch);
+
+		FUnorderedAccessViewRHIRef OutputUAV = ComputeShaderOutput->GetRenderTargetItem().UAV;
+		UnbindRenderTargets(RHICmdList);
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, OutputUAV);
+
+		FAtlasPageCS::FParameters PassParameters;
+		PassParameters.Page = PageParameters;
+		PassParameters.OutputTexture = OutputUAV;
+
+		FAtlasPageCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FAtlasPageCS::FHalfPrecisionDim>(FComputeShaderExample::UseHalfPrecision_RenderThread());
+		TShaderMapRef<FAtlasPageCS> ComputeShader(ShaderMap, PermutationVector);
+
+		// Only the drawn slots are dispatched, the rest of the page is never touched.
+		const int32 NumGroupsPerSlot = SlotSize / NUM_THREADS_PER_GROUP_DIMENSION;
+		FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, FIntVector(NumGroupsPerSlot, NumGroupsPerSlot, DrawIndices.Num()));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, OutputUAV);
+	}
+
+	{
+		SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Pixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+		SHADERPLUGIN_TRACE_SCOPE(DrawAtlasPage);
+
+		FRHITexture* PageTexture = PageResource->GetRenderTargetTexture();
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, PageTexture);
+
+		// Load rather than clear, the slots we don't draw this frame keep what they had.
+		FRHIRenderPassInfo RenderPassInfo(PageTexture, ERenderTargetActions::Load_Store);
+		RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_OutputToAtlasPage"));
+
+		TShaderMapRef<FAtlasPageVS> VertexShader(ShaderMap);
+		TShaderMapRef<FAtlasPagePS> PixelShader(ShaderMap);
+
+		FGraphicsPipelineStateInitializer GraphicsPSOInit;
+		RHICmdList.ApplyCachedRenderTargets(GraphicsPSOInit);
+		GraphicsPSOInit.BlendState = TStaticBlendState<>::GetRHI();
+		GraphicsPSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
+		GraphicsPSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+		GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = GEmptyVertexDeclaration.VertexDeclarationRHI;
+		GraphicsPSOInit.BoundShaderState.VertexShaderRHI = GETSAFERHISHADER_VERTEX(*VertexShader);
+		GraphicsPSOInit.BoundShaderState.PixelShaderRHI = GETSAFERHISHADER_PIXEL(*PixelShader);
+		GraphicsPSOInit.PrimitiveType = PT_TriangleStrip;
+		SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit);
+
+		FAtlasPagePS::FParameters PixelParameters;
+		PixelParameters.Page = PageParameters;
+		PixelParameters.ComputeShaderOutput = ComputeShaderOutput->GetRenderTargetItem().ShaderResourceTexture;
+
+		SetShaderParameters(RHICmdList, *VertexShader, VertexShader->GetVertexShader(), PageParameters);
+		SetShaderParameters(RHICmdList, *PixelShader, PixelShader->GetPixelShader(), PixelParameters);
+
+		// One quad per slot, the vertex shader places each instance on its slot.
+		RHICmdList.DrawPrimitive(0, 2, DrawIndices.Num());
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Draws);
+
+		RHICmdList.EndRenderPass();
+	}
+}
@@ -0,0 +1,26 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "RendererInterface.h"
+
+/**************************************************************************************/
+/* Draws all the slots of one FRenderTargetAtlas page that are in a batch at once.    */
+/**************************************************************************************/
+class FAtlasPageExample
+{
+public:
+	// DrawIndices are the entries of Batch that go to this page. They must all have the same render target and an
+	// AtlasRect of the same size. The compute shader runs once for all of them, with one Z slice per slot, into
+	// ComputeShaderOutput, and the pixel shader draws one instanced quad per slot. Slots on the page that aren't in
+	// DrawIndices are left as they are.
+	// ComputeShaderOutput belongs to the caller and is kept between pages and frames. It is only reallocated when the
+	// slots don't fit, and then grows to fit both the old and the new slots, so it settles at the largest size drawn.
+	// MemoryTrackingName is who it is tracked under.
+	// Flipbooks, the vertex buffer sample and compute resolution scaling aren't supported for atlas slots.
+	static void DrawPage_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameterBatch& Batch, TArrayView<const int32> DrawIndices, TRefCountPtr<IPooledRenderTarget>& ComputeShaderOutput, FName MemoryTrackingName);
+};
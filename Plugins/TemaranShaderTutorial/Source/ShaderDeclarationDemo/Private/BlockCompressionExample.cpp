@@ -0,0 +1,165 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "BlockCompressionExample.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTrace.h"
+#include "GlobalShader.h"
+#include "RenderGraphUtils.h"
+#include "RenderUtils.h"
+#include "RHICommandList.h"
+#include "ShaderParameterStruct.h"
+#include "TextureResource.h"
+
+#define NUM_THREADS_PER_GROUP_DIMENSION 8
+
+class FBlockCompressionCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FBlockCompressionCS);
+	SHADER_USE_PARAMETER_STRUCT(FBlockCompressionCS, FGlobalShader);
+
+	class FBC3Dim : SHADER_PERMUTATION_BOOL("BC3");
+	using FPermutationDomain = TShaderPermutationDomain<FBC3Dim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_SRV(Texture2D<float4>, SrcTexture)
+		SHADER_PARAMETER_UAV(RWTexture2D<uint4>, OutBlocks) // uint2 for BC1
+		SHADER_PARAMETER(FIntPoint, NumBlocks)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	// Copying uint blocks into a compressed texture is something we only rely on with SM5.
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FBlockCompressionCS, "/TutorialShaders/Private/BlockCompression.usf", "MainCS", SF_Compute);
+
+FCompressedTarget::~FCompressedTarget()
+{
+	if (AllocatedBytes > 0)
+	{
+		FShaderPluginMemory::TrackFree(EShaderPluginResource::CompressedTargets, NAME_None, AllocatedBytes);
+	}
+}
+
+bool FBlockCompressionExample::IsSupported()
+{
+	return GMaxRHIFeatureLevel >= ERHIFeatureLevel::SM5 && GPixelFormats[PF_DXT1].Supported && GPixelFormats[PF_DXT5].Supported;
+}
+
+EPixelFormat FBlockCompressionExample::GetCompressedFormat(EShaderPluginCompression Compression)
+{
+	return Compression == EShaderPluginCompression::BC3 ? PF_DXT5 : PF_DXT1;
+}
+
+EPixelFormat FBlockCompressionExample::GetBlockFormat(EShaderPluginCompression Compression)
+{
+	return Compression == EShaderPluginCompression::BC3 ? PF_R32G32B32A32_UINT : PF_R32G32_UINT;
+}
+
+int32 FBlockCompressionExample::GetNumCompressibleMips(const FIntPoint& Size, int32 NumMips)
+{
+	int32 NumCompressibleMips = 0;
+	while (NumCompressibleMips < NumMips)
+	{
+		const FIntPoint MipSize(Size.X >> NumCompressibleMips, Size.Y >> NumCompressibleMips);
+		if (MipSize.X < 4 || MipSize.Y < 4 || MipSize.X % 4 != 0 || MipSize.Y % 4 != 0)
+		{
+			break;
+		}
+		NumCompressibleMips++;
+	}
+	return NumCompressibleMips;
+}
+
+void FBlockCompressionExample::CompressToBlocks_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Source, FRHIUnorderedAccessView* BlockUAV, const FIntPoint& NumBlocks, EShaderPluginCompression Compression, uint32 MipLevel /*= 0*/)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_BlockCompression); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_BlockCompression); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(BlockCompression); // Used to show our work next to the engine's in Unreal Insights
+
+	// The raw values, not linearized. The compressed texture is flagged sRGB when the source is, so they are read back right.
+	FRHITextureSRVCreateInfo SRVCreateInfo;
+	SRVCreateInfo.SRGBOverride = SRGBO_ForceDisable;
+	SRVCreateInfo.MipLevel = MipLevel;
+	SRVCreateInfo.NumMipLevels = 1;
+	FShaderResourceViewRHIRef SourceSRV = RHICreateShaderResourceView(Source, SRVCreateInfo);
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, BlockUAV);
+
+	FBlockCompressionCS::FParameters PassParameters;
+	PassParameters.SrcTexture = SourceSRV;
+	PassParameters.OutBlocks = BlockUAV;
+	PassParameters.NumBlocks = NumBlocks;
+
+	FBlockCompressionCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FBlockCompressionCS::FBC3Dim>(Compression == EShaderPluginCompression::BC3);
+
+	TShaderMapRef<FBlockCompressionCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, FComputeShaderUtils::GetGroupCount(NumBlocks, NUM_THREADS_PER_GROUP_DIMENSION));
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, BlockUAV);
+}
+
+void FBlockCompressionExample::UpdateCompressedTarget_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Source, FCompressedTarget& Target)
+{
+	check(IsInRenderingThread());
+
+	FRHITexture* CompressedTexture = Target.CompressedResource ? Target.CompressedResource->TextureRHI.GetReference() : nullptr;
+	if (!Source || !CompressedTexture || !IsSupported())
+	{
+		return;
+	}
+
+	// CreateCompressedTarget made the compressed texture the same size as the render target, but that may have been resized since.
+	const FIntPoint Size(Source->GetSizeX(), Source->GetSizeY());
+	if (Size != FIntPoint(CompressedTexture->GetSizeXYZ().X, CompressedTexture->GetSizeXYZ().Y))
+	{
+		return;
+	}
+
+	// CreateCompressedTarget only gave the compressed texture mips that can be compressed. The render target only has mips
+	// with auto generate mips ticked, and then we rebuild them before we get here.
+	const FIntPoint NumBlocks(Size.X / 4, Size.Y / 4);
+	const int32 NumMips = GetNumCompressibleMips(Size, FMath::Min<int32>(Source->GetNumMips(), CompressedTexture->GetNumMips()));
+	if (!Target.BlockTexture.IsValid())
+	{
+		LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+
+		const int32 NumBlockMips = GetNumCompressibleMips(Size, CompressedTexture->GetNumMips());
+		FRHIResourceCreateInfo CreateInfo;
+		Target.BlockTexture = RHICreateTexture2D(NumBlocks.X, NumBlocks.Y, GetBlockFormat(Target.Compression), NumBlockMips, 1, TexCreate_UAV | TexCreate_ShaderResource, CreateInfo);
+
+		// The compressed texture itself is counted here too, since it only exists because of us.
+		Target.AllocatedBytes = 0;
+		for (int32 MipIndex = 0; MipIndex < NumBlockMips; MipIndex++)
+		{
+			Target.BlockUAVs.Add(RHICreateUnorderedAccessView(Target.BlockTexture, MipIndex));
+			Target.AllocatedBytes += CalculateImageBytes(NumBlocks.X >> MipIndex, NumBlocks.Y >> MipIndex, 0, GetBlockFormat(Target.Compression)) * 2;
+		}
+		FShaderPluginMemory::TrackAllocation(EShaderPluginResource::CompressedTargets, NAME_None, Target.AllocatedBytes);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	}
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, CompressedTexture);
+	for (int32 MipIndex = 0; MipIndex < NumMips; MipIndex++)
+	{
+		const FIntPoint MipBlocks(NumBlocks.X >> MipIndex, NumBlocks.Y >> MipIndex);
+		CompressToBlocks_RenderThread(RHICmdList, Source, Target.BlockUAVs[MipIndex], MipBlocks, Target.Compression, MipIndex);
+
+		// A block of BC1 is the same 64 bits as a texel of the block texture, so the copy is just a reinterpretation. The
+		// size is in texels of the block texture.
+		FRHICopyTextureInfo CopyInfo;
+		CopyInfo.Size = FIntVector(MipBlocks.X, MipBlocks.Y, 1);
+		CopyInfo.SourceMipIndex = MipIndex;
+		CopyInfo.DestMipIndex = MipIndex;
+		RHICmdList.CopyTexture(Target.BlockTexture, CompressedTexture, CopyInfo);
+	}
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, CompressedTexture);
+}
@@ -0,0 +1,55 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "RHIResources.h"
+
+class FTextureResource;
+
+// The render thread side of a target made with FShaderDeclarationDemoModule::CreateCompressedTarget.
+struct FCompressedTarget
+{
+	EShaderPluginCompression Compression;
+	FTextureResource* CompressedResource; // Of the texture we handed out, which the module keeps rooted
+	FTexture2DRHIRef BlockTexture; // One texel per block. We compress into this and copy it over, see BlockCompression.usf
+	TArray<FUnorderedAccessViewRHIRef> BlockUAVs; // One per mip of BlockTexture
+	int64 AllocatedBytes;
+
+	FCompressedTarget(EShaderPluginCompression InCompression, FTextureResource* InCompressedResource)
+		: Compression(InCompression)
+		, CompressedResource(InCompressedResource)
+		, AllocatedBytes(0)
+	{
+	}
+
+	~FCompressedTarget();
+};
+
+/**************************************************************************************/
+/* Encodes what we drew to BC1 or BC3 on the GPU, so materials sample a quarter to an */
+/* eighth of the bytes. See FBlockCompressionReference for the CPU version.           */
+/**************************************************************************************/
+class FBlockCompressionExample
+{
+public:
+	static bool IsSupported();
+
+	static EPixelFormat GetCompressedFormat(EShaderPluginCompression Compression);
+
+	// The uint format with one texel per block the compute shader writes.
+	static EPixelFormat GetBlockFormat(EShaderPluginCompression Compression);
+
+	// Encodes MipLevel of Source into BlockUAV. That mip must be NumBlocks * 4 texels large.
+	static void CompressToBlocks_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Source, FRHIUnorderedAccessView* BlockUAV, const FIntPoint& NumBlocks, EShaderPluginCompression Compression, uint32 MipLevel = 0);
+
+	// How many mips of a texture of Size can be compressed, which is every mip down to the first that isn't a multiple of 4.
+	static int32 GetNumCompressibleMips(const FIntPoint& Size, int32 NumMips);
+
+	// Encodes every mip that Source and Target's compressed texture both have, and copies the blocks into the compressed
+	// texture. Allocates the block texture on first use.
+	static void UpdateCompressedTarget_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Source, FCompressedTarget& Target);
+};
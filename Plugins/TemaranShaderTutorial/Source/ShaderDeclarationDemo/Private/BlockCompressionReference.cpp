@@ -0,0 +1,259 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "BlockCompressionReference.h"
+
+#include "Async/ParallelFor.h"
+
+// Keep these in sync with BlockCompression.usf. The names follow the HLSL so the two are easy to compare.
+static uint32 Quantize(uint32 Value, uint32 MaxValue)
+{
+	return (Value * MaxValue + 127) / 255;
+}
+
+static uint32 Expand5(uint32 Value)
+{
+	return (Value << 3) | (Value >> 2);
+}
+
+static uint32 Expand6(uint32 Value)
+{
+	return (Value << 2) | (Value >> 4);
+}
+
+static void EncodeColorBlock(const FColor* Texels, uint32* OutWords)
+{
+	FIntVector MinColor(Texels[0].R, Texels[0].G, Texels[0].B);
+	FIntVector MaxColor = MinColor;
+	for (int32 i = 1; i < 16; i++)
+	{
+		MinColor = FIntVector(FMath::Min<int32>(MinColor.X, Texels[i].R), FMath::Min<int32>(MinColor.Y, Texels[i].G), FMath::Min<int32>(MinColor.Z, Texels[i].B));
+		MaxColor = FIntVector(FMath::Max<int32>(MaxColor.X, Texels[i].R), FMath::Max<int32>(MaxColor.Y, Texels[i].G), FMath::Max<int32>(MaxColor.Z, Texels[i].B));
+	}
+
+	const FIntVector Inset((MaxColor.X - MinColor.X) >> 4, (MaxColor.Y - MinColor.Y) >> 4, (MaxColor.Z - MinColor.Z) >> 4);
+	MinColor += Inset;
+	MaxColor -= Inset;
+
+	const FIntVector q0(Quantize(MaxColor.X, 31), Quantize(MaxColor.Y, 63), Quantize(MaxColor.Z, 31));
+	const FIntVector q1(Quantize(MinColor.X, 31), Quantize(MinColor.Y, 63), Quantize(MinColor.Z, 31));
+	const uint32 c0 = (q0.X << 11) | (q0.Y << 5) | q0.Z;
+	const uint32 c1 = (q1.X << 11) | (q1.Y << 5) | q1.Z;
+
+	FIntVector Palette[4];
+	Palette[0] = FIntVector(Expand5(q0.X), Expand6(q0.Y), Expand5(q0.Z));
+	Palette[1] = FIntVector(Expand5(q1.X), Expand6(q1.Y), Expand5(q1.Z));
+	Palette[2] = (Palette[0] * 2 + Palette[1]) / 3;
+	Palette[3] = (Palette[0] + Palette[1] * 2) / 3;
+
+	uint32 Indices = 0;
+	if (c0 != c1)
+	{
+		for (int32 i = 0; i < 16; i++)
+		{
+			uint32 BestIndex = 0;
+			int32 BestDistance = MAX_int32;
+			for (int32 j = 0; j < 4; j++)
+			{
+				const FIntVector Delta = FIntVector(Texels[i].R, Texels[i].G, Texels[i].B) - Palette[j];
+				const int32 Distance = Delta.X * Delta.X + Delta.Y * Delta.Y + Delta.Z * Delta.Z;
+				if (Distance < BestDistance)
+				{
+					BestDistance = Distance;
+					BestIndex = j;
+				}
+			}
+			Indices |= BestIndex << (2 * i);
+		}
+	}
+
+	OutWords[0] = c0 | (c1 << 16);
+	OutWords[1] = Indices;
+}
+
+static void EncodeAlphaBlock(const FColor* Texels, uint32* OutWords)
+{
+	int32 a0 = Texels[0].A;
+	int32 a1 = Texels[0].A;
+	for (int32 i = 1; i < 16; i++)
+	{
+		a0 = FMath::Max<int32>(a0, Texels[i].A);
+		a1 = FMath::Min<int32>(a1, Texels[i].A);
+	}
+
+	int32 Palette[8];
+	Palette[0] = a0;
+	Palette[1] = a1;
+	for (int32 j = 2; j < 8; j++)
+	{
+		Palette[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+	}
+
+	OutWords[0] = a0 | (a1 << 8);
+	OutWords[1] = 0;
+	if (a0 != a1)
+	{
+		for (int32 i = 0; i < 16; i++)
+		{
+			uint32 BestIndex = 0;
+			int32 BestDistance = MAX_int32;
+			for (int32 j = 0; j < 8; j++)
+			{
+				const int32 Distance = FMath::Abs(Texels[i].A - Palette[j]);
+				if (Distance < BestDistance)
+				{
+					BestDistance = Distance;
+					BestIndex = j;
+				}
+			}
+
+			const uint32 BitOffset = 16 + 3 * i;
+			if (BitOffset < 32)
+			{
+				OutWords[0] |= BestIndex << BitOffset;
+				if (BitOffset > 29)
+				{
+					OutWords[1] |= BestIndex >> (32 - BitOffset);
+				}
+			}
+			else
+			{
+				OutWords[1] |= BestIndex << (BitOffset - 32);
+			}
+		}
+	}
+}
+
+static void DecodeColorBlock(const uint32* Words, bool bAllowThreeColorMode, FColor* OutTexels)
+{
+	const uint32 c0 = Words[0] & 0xffff;
+	const uint32 c1 = Words[0] >> 16;
+
+	FIntVector Palette[4];
+	Palette[0] = FIntVector(Expand5(c0 >> 11), Expand6((c0 >> 5) & 63), Expand5(c0 & 31));
+	Palette[1] = FIntVector(Expand5(c1 >> 11), Expand6((c1 >> 5) & 63), Expand5(c1 & 31));
+
+	// BC1 switches to three colors and transparent black when c0 <= c1. BC3 always uses four colors.
+	const bool bThreeColorMode = bAllowThreeColorMode && c0 <= c1;
+	if (bThreeColorMode)
+	{
+		Palette[2] = (Palette[0] + Palette[1]) / 2;
+		Palette[3] = FIntVector::ZeroValue;
+	}
+	else
+	{
+		Palette[2] = (Palette[0] * 2 + Palette[1]) / 3;
+		Palette[3] = (Palette[0] + Palette[1] * 2) / 3;
+	}
+
+	for (int32 i = 0; i < 16; i++)
+	{
+		const uint32 Index = (Words[1] >> (2 * i)) & 3;
+		OutTexels[i] = FColor(Palette[Index].X, Palette[Index].Y, Palette[Index].Z, bThreeColorMode && Index == 3 ? 0 : 255);
+	}
+}
+
+static void DecodeAlphaBlock(const uint32* Words, FColor* OutTexels)
+{
+	const int32 a0 = Words[0] & 0xff;
+	const int32 a1 = (Words[0] >> 8) & 0xff;
+
+	int32 Palette[8];
+	Palette[0] = a0;
+	Palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int32 j = 2; j < 8; j++)
+		{
+			Palette[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+		}
+	}
+	else
+	{
+		for (int32 j = 2; j < 6; j++)
+		{
+			Palette[j] = ((6 - j) * a0 + (j - 1) * a1) / 5;
+		}
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+
+	const uint64 Indices = ((uint64)Words[0] >> 16) | ((uint64)Words[1] << 16);
+	for (int32 i = 0; i < 16; i++)
+	{
+		OutTexels[i].A = Palette[(Indices >> (3 * i)) & 7];
+	}
+}
+
+int32 FBlockCompressionReference::GetWordsPerBlock(EShaderPluginCompression Compression)
+{
+	return Compression == EShaderPluginCompression::BC3 ? 4 : 2;
+}
+
+void FBlockCompressionReference::Compress(const FColor* Pixels, const FIntPoint& Size, EShaderPluginCompression Compression, TArray<uint32>& OutBlocks)
+{
+	check(Size.X % 4 == 0 && Size.Y % 4 == 0);
+
+	const FIntPoint NumBlocks(Size.X / 4, Size.Y / 4);
+	const int32 WordsPerBlock = GetWordsPerBlock(Compression);
+	OutBlocks.SetNumUninitialized(NumBlocks.X * NumBlocks.Y * WordsPerBlock);
+
+	// One row of blocks per task.
+	ParallelFor(NumBlocks.Y, [&](int32 BlockY)
+	{
+		for (int32 BlockX = 0; BlockX < NumBlocks.X; BlockX++)
+		{
+			FColor Texels[16];
+			for (int32 i = 0; i < 16; i++)
+			{
+				Texels[i] = Pixels[(BlockY * 4 + i / 4) * Size.X + BlockX * 4 + i % 4];
+			}
+
+			uint32* Words = &OutBlocks[(BlockY * NumBlocks.X + BlockX) * WordsPerBlock];
+			if (Compression == EShaderPluginCompression::BC3)
+			{
+				EncodeAlphaBlock(Texels, Words);
+				EncodeColorBlock(Texels, Words + 2);
+			}
+			else
+			{
+				EncodeColorBlock(Texels, Words);
+			}
+		}
+	});
+}
+
+void FBlockCompressionReference::Decompress(const TArray<uint32>& Blocks, const FIntPoint& Size, EShaderPluginCompression Compression, TArray<FColor>& OutPixels)
+{
+	check(Size.X % 4 == 0 && Size.Y % 4 == 0);
+
+	const FIntPoint NumBlocks(Size.X / 4, Size.Y / 4);
+	const int32 WordsPerBlock = GetWordsPerBlock(Compression);
+	check(Blocks.Num() == NumBlocks.X * NumBlocks.Y * WordsPerBlock);
+	OutPixels.SetNumUninitialized(Size.X * Size.Y);
+
+	ParallelFor(NumBlocks.Y, [&](int32 BlockY)
+	{
+		for (int32 BlockX = 0; BlockX < NumBlocks.X; BlockX++)
+		{
+			const uint32* Words = &Blocks[(BlockY * NumBlocks.X + BlockX) * WordsPerBlock];
+
+			FColor Texels[16];
+			if (Compression == EShaderPluginCompression::BC3)
+			{
+				DecodeColorBlock(Words + 2, false, Texels);
+				DecodeAlphaBlock(Words, Texels);
+			}
+			else
+			{
+				DecodeColorBlock(Words, true, Texels);
+			}
+
+			for (int32 i = 0; i < 16; i++)
+			{
+				OutPixels[(BlockY * 4 + i / 4) * Size.X + BlockX * 4 + i % 4] = Texels[i];
+			}
+		}
+	});
+}
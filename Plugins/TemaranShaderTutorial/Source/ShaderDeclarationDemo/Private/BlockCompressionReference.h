@@ -0,0 +1,24 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+
+/**************************************************************************************/
+/* A CPU port of BlockCompression.usf, plus a decoder to check the results with. The  */
+/* encoder produces the same bits as the GPU, so either can be used to validate the   */
+/* other, and the quality can be measured without a GPU at all.                       */
+/**************************************************************************************/
+class FBlockCompressionReference
+{
+public:
+	// Blocks are stored row by row, GetWordsPerBlock words each, the same way the GPU writes them.
+	// Size must be a multiple of 4.
+	static void Compress(const FColor* Pixels, const FIntPoint& Size, EShaderPluginCompression Compression, TArray<uint32>& OutBlocks);
+	static void Decompress(const TArray<uint32>& Blocks, const FIntPoint& Size, EShaderPluginCompression Compression, TArray<FColor>& OutPixels);
+
+	static int32 GetWordsPerBlock(EShaderPluginCompression Compression);
+};
@@ -0,0 +1,144 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ComputeMeshGenerator.h"
+#include "ShaderPluginTrace.h"
+#include "GlobalShader.h"
+#include "RenderGraphUtils.h"
+#include "RHICommandList.h"
+#include "RHIStaticStates.h"
+#include "ShaderParameterStruct.h"
+#include "TextureResource.h"
+
+BEGIN_SHADER_PARAMETER_STRUCT(FComputeMeshGeneratorParameters, )
+	SHADER_PARAMETER_UAV(RWBuffer<float>, VertexPosition)
+	SHADER_PARAMETER_UAV(RWBuffer<float4>, VertexTangents)
+	SHADER_PARAMETER_UAV(RWBuffer<float2>, VertexTexCoords)
+	SHADER_PARAMETER_UAV(RWBuffer<uint>, Indices)
+	SHADER_PARAMETER(FIntPoint, Segments)
+	SHADER_PARAMETER(float, Radius)
+	SHADER_PARAMETER(float, MinorRadius)
+	SHADER_PARAMETER(FVector2D, Extent)
+	SHADER_PARAMETER(float, Height)
+	SHADER_PARAMETER_TEXTURE(Texture2D, HeightTexture)
+	SHADER_PARAMETER_SAMPLER(SamplerState, HeightSampler)
+END_SHADER_PARAMETER_STRUCT()
+
+class FComputeMeshGeneratorShader : public FGlobalShader
+{
+public:
+	enum { ThreadGroupSize = 64 };
+	static_assert(FComputeMeshShapeSettings::MaxElementsPerDispatch / ThreadGroupSize <= 65535, "FComputeMeshShapeSettings::IsValid lets through shapes that need more thread groups than a dispatch can have.");
+
+	FComputeMeshGeneratorShader() { }
+	FComputeMeshGeneratorShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) { }
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_X"), ThreadGroupSize);
+	}
+};
+
+class FComputeMeshVerticesCS : public FComputeMeshGeneratorShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FComputeMeshVerticesCS);
+	using FParameters = FComputeMeshGeneratorParameters;
+	SHADER_USE_PARAMETER_STRUCT(FComputeMeshVerticesCS, FComputeMeshGeneratorShader);
+
+	class FShapeDim : SHADER_PERMUTATION_INT("MESH_SHAPE", (int32)EComputeMeshShape::Num);
+	using FPermutationDomain = TShaderPermutationDomain<FShapeDim>;
+};
+
+class FComputeMeshIndicesCS : public FComputeMeshGeneratorShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FComputeMeshIndicesCS);
+	using FParameters = FComputeMeshGeneratorParameters;
+	SHADER_USE_PARAMETER_STRUCT(FComputeMeshIndicesCS, FComputeMeshGeneratorShader);
+};
+
+IMPLEMENT_GLOBAL_SHADER(FComputeMeshVerticesCS, "/TutorialShaders/Private/ComputeVertices.usf", "MainVerticesCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FComputeMeshIndicesCS, "/TutorialShaders/Private/ComputeVertices.usf", "MainIndicesCS", SF_Compute);
+
+bool FComputeMeshGenerator::IsSupported(ERHIFeatureLevel::Type FeatureLevel)
+{
+	return FeatureLevel >= ERHIFeatureLevel::SM5;
+}
+
+void FComputeMeshGenerator::GenerateVertices_RenderThread(FRHICommandListImmediate& RHICmdList, const FComputeMeshShapeSettings& Shape, float RadiusScale, FRHITexture* HeightTexture, const FComputeMeshGeneratorUAVs& UAVs)
+{
+	check(IsInRenderingThread());
+	check(Shape.IsValid());
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_GenerateMeshVertices); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_GenerateMeshVertices); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(GenerateMeshVertices); // Used to show our work next to the engine's in Unreal Insights
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, UAVs.VertexPositionUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, UAVs.VertexTangentsUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, UAVs.VertexTexCoordsUAV);
+
+	FComputeMeshGeneratorParameters PassParameters;
+	PassParameters.VertexPosition = UAVs.VertexPositionUAV;
+	PassParameters.VertexTangents = UAVs.VertexTangentsUAV;
+	PassParameters.VertexTexCoords = UAVs.VertexTexCoordsUAV;
+	PassParameters.Indices = UAVs.IndexUAV;
+	PassParameters.Segments = Shape.Segments;
+	PassParameters.Radius = Shape.Radius * RadiusScale;
+	PassParameters.MinorRadius = Shape.MinorRadius * RadiusScale;
+	PassParameters.Extent = Shape.Extent;
+	PassParameters.Height = Shape.Height;
+	PassParameters.HeightTexture = HeightTexture ? HeightTexture : GBlackTexture->TextureRHI.GetReference();
+	PassParameters.HeightSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
+
+	FComputeMeshVerticesCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FComputeMeshVerticesCS::FShapeDim>((int32)Shape.Shape);
+
+	TShaderMapRef<FComputeMeshVerticesCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, FIntVector(FMath::DivideAndRoundUp(Shape.GetNumVertices(), (int32)FComputeMeshGeneratorShader::ThreadGroupSize), 1, 1));
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::VerticesGenerated, Shape.GetNumVertices());
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, UAVs.VertexPositionUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, UAVs.VertexTangentsUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, UAVs.VertexTexCoordsUAV);
+}
+
+void FComputeMeshGenerator::GenerateIndices_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Segments, const FComputeMeshGeneratorUAVs& UAVs)
+{
+	check(IsInRenderingThread());
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_GenerateMeshIndices); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_GenerateMeshIndices); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(GenerateMeshIndices); // Used to show our work next to the engine's in Unreal Insights
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, UAVs.IndexUAV);
+
+	FComputeMeshGeneratorParameters PassParameters;
+	PassParameters.VertexPosition = UAVs.VertexPositionUAV;
+	PassParameters.VertexTangents = UAVs.VertexTangentsUAV;
+	PassParameters.VertexTexCoords = UAVs.VertexTexCoordsUAV;
+	PassParameters.Indices = UAVs.IndexUAV;
+	PassParameters.Segments = Segments;
+	PassParameters.Radius = 0.0f;
+	PassParameters.MinorRadius = 0.0f;
+	PassParameters.Extent = FVector2D::ZeroVector;
+	PassParameters.Height = 0.0f;
+	PassParameters.HeightTexture = GBlackTexture->TextureRHI;
+	PassParameters.HeightSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
+
+	TShaderMapRef<FComputeMeshIndicesCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, FIntVector(FMath::DivideAndRoundUp(Segments.X * Segments.Y, (int32)FComputeMeshGeneratorShader::ThreadGroupSize), 1, 1));
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, UAVs.IndexUAV);
+}
@@ -0,0 +1,35 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "RHIResources.h"
+
+// Where FComputeMeshGenerator writes to. The vertex streams use the same layout as FComputeShaderSceneMeshUAVs.
+struct FComputeMeshGeneratorUAVs
+{
+	FRHIUnorderedAccessView* VertexPositionUAV = nullptr;
+	FRHIUnorderedAccessView* VertexTangentsUAV = nullptr;
+	FRHIUnorderedAccessView* VertexTexCoordsUAV = nullptr;
+	FRHIUnorderedAccessView* IndexUAV = nullptr; // 32 bit indices
+};
+
+/**************************************************************************************/
+/* Builds the meshes described by FComputeMeshShapeSettings on the GPU, one thread per */
+/* vertex and one per quad. See ComputeVertices.usf.                                  */
+/**************************************************************************************/
+class FComputeMeshGenerator
+{
+public:
+	// Writing indices from a compute shader needs UAVs on index buffers, which we only rely on having with SM5.
+	static bool IsSupported(ERHIFeatureLevel::Type FeatureLevel);
+
+	// Writes Shape.GetNumVertices() vertices. RadiusScale is applied to Radius and MinorRadius. HeightTexture may be null.
+	static void GenerateVertices_RenderThread(FRHICommandListImmediate& RHICmdList, const FComputeMeshShapeSettings& Shape, float RadiusScale, FRHITexture* HeightTexture, const FComputeMeshGeneratorUAVs& UAVs);
+
+	// Writes Shape.GetNumIndices() indices. These only depend on the segments, not on the shape.
+	static void GenerateIndices_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Segments, const FComputeMeshGeneratorUAVs& UAVs);
+};
@@ -0,0 +1,362 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ComputeMeshSceneProxy.h"
+
+#include "ComputeMeshGenerator.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTargetParameters.h"
+#include "ShaderPluginTrace.h"
+#include "VertexFromCSExample.h"
+
+#include "Components.h"
+#include "Components/MeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/Texture.h"
+#include "Materials/Material.h"
+#include "MaterialShared.h"
+#include "PrimitiveViewRelevance.h"
+#include "RenderingThread.h"
+#include "SceneManagement.h"
+#include "TextureResource.h"
+
+void FComputeMeshVertexBuffer::InitRHI()
+{
+	// BUF_Static since only the GPU ever writes to it. The vertex factory binds the SRV when it uses manual vertex fetch.
+	RWBuffer.Initialize(BytesPerElement, NumElements, Format, BUF_Static);
+	VertexBufferRHI = RWBuffer.Buffer;
+}
+
+void FComputeMeshVertexBuffer::ReleaseRHI()
+{
+	RWBuffer.Release();
+	FVertexBuffer::ReleaseRHI();
+}
+
+void FComputeMeshIndexBuffer::InitRHI()
+{
+	FRHIResourceCreateInfo CreateInfo;
+	IndexBufferRHI = RHICreateIndexBuffer(sizeof(uint32), GetNumBytes(), BUF_Static | BUF_UnorderedAccess, CreateInfo);
+	UAV = RHICreateUnorderedAccessView(IndexBufferRHI, PF_R32_UINT);
+}
+
+void FComputeMeshIndexBuffer::ReleaseRHI()
+{
+	UAV.SafeRelease();
+	FIndexBuffer::ReleaseRHI();
+}
+
+FComputeMeshSceneProxy::FComputeMeshSceneProxy(UMeshComponent* Component, int32 InNumTriangles, float InMeshScale, float InMeshHeight)
+	: FPrimitiveSceneProxy(Component)
+	, PositionBuffer(sizeof(float), PF_R32_FLOAT)
+	, TangentBuffer(sizeof(uint32), PF_R8G8B8A8_SNORM)
+	, TexCoordBuffer(sizeof(FVector2D), PF_G32R32F)
+	, VertexFactory(GetScene().GetFeatureLevel(), "FComputeMeshSceneProxy")
+	, MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+	, NumTriangles(FMath::Clamp(InNumTriangles, 1, (int32)FVertexFromCSExample::MaxSceneMeshTriangles))
+	, MeshScale(InMeshScale)
+	, MeshHeight(InMeshHeight)
+	, bHasGeometry(false)
+	, bUseShape(false)
+	, RadiusScale(1.0f)
+	, bHasIndices(false)
+	, bShapeChanged(false)
+	, GeneratedRadiusScale(0.0f)
+	, GeneratedHeightTexture(nullptr)
+{
+	Material = Component->GetMaterial(0);
+	if (!Material)
+	{
+		Material = UMaterial::GetDefaultMaterial(MD_Surface);
+	}
+
+	SetBufferSizes(NumTriangles * 3, 0);
+
+	FComputeMeshSceneProxy* ThisPtr = this;
+	ENQUEUE_RENDER_COMMAND(InitComputeMeshSceneProxy)(
+		[ThisPtr](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->InitResources_RenderThread();
+	}
+	);
+}
+
+FComputeMeshSceneProxy::FComputeMeshSceneProxy(UMeshComponent* Component, const FComputeMeshShapeSettings& InShape)
+	: FPrimitiveSceneProxy(Component)
+	, PositionBuffer(sizeof(float), PF_R32_FLOAT)
+	, TangentBuffer(sizeof(uint32), PF_R8G8B8A8_SNORM)
+	, TexCoordBuffer(sizeof(FVector2D), PF_G32R32F)
+	, VertexFactory(GetScene().GetFeatureLevel(), "FComputeMeshSceneProxy")
+	, MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+	, NumTriangles(0)
+	, MeshScale(1.0f)
+	, MeshHeight(0.0f)
+	, bHasGeometry(false)
+	, bUseShape(true)
+	, Shape(InShape)
+	, RadiusScale(1.0f)
+	, bHasIndices(false)
+	, bShapeChanged(true)
+	, GeneratedRadiusScale(0.0f)
+	, GeneratedHeightTexture(nullptr)
+{
+	check(Shape.IsValid());
+
+	Material = Component->GetMaterial(0);
+	if (!Material)
+	{
+		Material = UMaterial::GetDefaultMaterial(MD_Surface);
+	}
+
+	SetBufferSizes(Shape.GetNumVertices(), Shape.GetNumIndices());
+
+	// The reference is made on the render thread, so it is only read in the command. The texture can't have released it
+	// before then, that is queued behind us.
+	FComputeMeshSceneProxy* ThisPtr = this;
+	const FTextureReference* HeightTextureReference = InShape.HeightTexture ? &InShape.HeightTexture->TextureReference : nullptr;
+	ENQUEUE_RENDER_COMMAND(InitComputeMeshSceneProxy)(
+		[ThisPtr, HeightTextureReference](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->HeightTexture = HeightTextureReference ? HeightTextureReference->TextureReferenceRHI : nullptr;
+		ThisPtr->InitResources_RenderThread();
+	}
+	);
+}
+
+FComputeMeshSceneProxy::~FComputeMeshSceneProxy()
+{
+	check(IsInRenderingThread());
+
+	ReleaseResources_RenderThread();
+}
+
+void FComputeMeshSceneProxy::SetBufferSizes(uint32 NumVertices, uint32 NumIndices)
+{
+	PositionBuffer.SetNumElements(NumVertices * 3);
+	TangentBuffer.SetNumElements(NumVertices * 2);
+	TexCoordBuffer.SetNumElements(NumVertices);
+	IndexBuffer.SetNumIndices(NumIndices);
+}
+
+int64 FComputeMeshSceneProxy::GetAllocatedBytes() const
+{
+	return PositionBuffer.GetNumBytes() + TangentBuffer.GetNumBytes() + TexCoordBuffer.GetNumBytes() + IndexBuffer.GetNumBytes();
+}
+
+void FComputeMeshSceneProxy::ReleaseResources_RenderThread()
+{
+	check(IsInRenderingThread());
+
+	VertexFactory.ReleaseResource();
+	PositionBuffer.ReleaseResource();
+	TangentBuffer.ReleaseResource();
+	TexCoordBuffer.ReleaseResource();
+	IndexBuffer.ReleaseResource();
+	TargetUniformBuffers.Reset();
+
+	FShaderPluginMemory::TrackFree(EShaderPluginResource::SceneMeshBuffers, GetOwnerName(), GetAllocatedBytes());
+}
+
+void FComputeMeshSceneProxy::InitResources_RenderThread()
+{
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+
+	PositionBuffer.InitResource();
+	TangentBuffer.InitResource();
+	TexCoordBuffer.InitResource();
+	if (IndexBuffer.GetNumIndices() > 0)
+	{
+		IndexBuffer.InitResource();
+	}
+	FShaderPluginMemory::TrackAllocation(EShaderPluginResource::SceneMeshBuffers, GetOwnerName(), GetAllocatedBytes());
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated, IndexBuffer.GetNumIndices() > 0 ? 4 : 3);
+
+	// Same streams as a static mesh with one UV channel and no vertex colors.
+	FLocalVertexFactory::FDataType Data;
+	Data.PositionComponent = FVertexStreamComponent(&PositionBuffer, 0, sizeof(float) * 3, VET_Float3);
+	Data.PositionComponentSRV = PositionBuffer.RWBuffer.SRV;
+	Data.TangentBasisComponents[0] = FVertexStreamComponent(&TangentBuffer, 0, TangentBuffer.GetBytesPerElement() * 2, VET_PackedNormal);
+	Data.TangentBasisComponents[1] = FVertexStreamComponent(&TangentBuffer, TangentBuffer.GetBytesPerElement(), TangentBuffer.GetBytesPerElement() * 2, VET_PackedNormal);
+	Data.TangentsSRV = TangentBuffer.RWBuffer.SRV;
+	Data.TextureCoordinates.Add(FVertexStreamComponent(&TexCoordBuffer, 0, TexCoordBuffer.GetBytesPerElement(), VET_Float2));
+	Data.TextureCoordinatesSRV = TexCoordBuffer.RWBuffer.SRV;
+	Data.NumTexCoords = 1;
+	Data.LightMapCoordinateIndex = 0;
+	Data.ColorComponentsSRV = GNullColorVertexBuffer.VertexBufferSRV;
+	Data.ColorIndexMask = 0;
+
+	VertexFactory.SetData(Data);
+	VertexFactory.InitResource();
+}
+
+void FComputeMeshSceneProxy::Update_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters)
+{
+	check(IsInRenderingThread());
+
+	if (!FVertexFromCSExample::SupportsSceneMesh(GetScene().GetFeatureLevel()))
+	{
+		return;
+	}
+
+	if (bUseShape)
+	{
+		// The shapes don't move by themselves, so they only have to be generated again when something they depend on
+		// changes. The height texture is checked too, since streaming or reimporting it swaps the texture it points at.
+		RadiusScale = DrawParameters.ComputeRadius;
+		if (!bHasGeometry || bShapeChanged || RadiusScale != GeneratedRadiusScale || GetHeightTexture_RenderThread() != GeneratedHeightTexture)
+		{
+			GenerateShape_RenderThread(RHICmdList);
+		}
+		return;
+	}
+
+	FComputeShaderSceneMeshUAVs SceneMeshUAVs;
+	SceneMeshUAVs.VertexPositionUAV = PositionBuffer.RWBuffer.UAV;
+	SceneMeshUAVs.VertexTangentsUAV = TangentBuffer.RWBuffer.UAV;
+	SceneMeshUAVs.VertexTexCoordsUAV = TexCoordBuffer.RWBuffer.UAV;
+
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = TargetUniformBuffers.Get(DrawParameters);
+	FVertexFromCSExample::RunSceneMeshComputeShader_RenderThread(RHICmdList, TargetUniformBuffer, SceneMeshUAVs, NumTriangles, MeshScale, MeshHeight);
+
+	bHasGeometry = true;
+}
+
+void FComputeMeshSceneProxy::SetShape_RenderThread(FRHICommandListImmediate& RHICmdList, const FComputeMeshShapeSettings& NewShape, FRHITextureReference* NewHeightTexture)
+{
+	check(IsInRenderingThread());
+
+	if (!bUseShape || !NewShape.IsValid())
+	{
+		return;
+	}
+
+	if (NewShape.Segments != Shape.Segments)
+	{
+		bHasIndices = false;
+	}
+
+	Shape = NewShape;
+	HeightTexture = NewHeightTexture;
+	bShapeChanged = true;
+
+	// Smaller meshes keep the buffers they have, so scrubbing the resolution doesn't reallocate on every change.
+	if ((uint32)Shape.GetNumVertices() > TexCoordBuffer.GetNumElements() || (uint32)Shape.GetNumIndices() > IndexBuffer.GetNumIndices())
+	{
+		ReleaseResources_RenderThread();
+		SetBufferSizes(FMath::Max<uint32>(Shape.GetNumVertices(), TexCoordBuffer.GetNumElements()), FMath::Max<uint32>(Shape.GetNumIndices(), IndexBuffer.GetNumIndices()));
+		InitResources_RenderThread();
+		bHasIndices = false;
+	}
+
+	// Otherwise the old mesh would be drawn with the new counts until the next update.
+	if (bHasGeometry)
+	{
+		GenerateShape_RenderThread(RHICmdList);
+	}
+}
+
+void FComputeMeshSceneProxy::GenerateShape_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	FComputeMeshGeneratorUAVs UAVs;
+	UAVs.VertexPositionUAV = PositionBuffer.RWBuffer.UAV;
+	UAVs.VertexTangentsUAV = TangentBuffer.RWBuffer.UAV;
+	UAVs.VertexTexCoordsUAV = TexCoordBuffer.RWBuffer.UAV;
+	UAVs.IndexUAV = IndexBuffer.UAV;
+
+	if (!bHasIndices)
+	{
+		FComputeMeshGenerator::GenerateIndices_RenderThread(RHICmdList, Shape.Segments, UAVs);
+		bHasIndices = true;
+	}
+
+	FRHITexture* CurrentHeightTexture = GetHeightTexture_RenderThread();
+	FComputeMeshGenerator::GenerateVertices_RenderThread(RHICmdList, Shape, RadiusScale, CurrentHeightTexture, UAVs);
+
+	bHasGeometry = true;
+	bShapeChanged = false;
+	GeneratedRadiusScale = RadiusScale;
+	GeneratedHeightTexture = CurrentHeightTexture;
+}
+
+FRHITexture* FComputeMeshSceneProxy::GetHeightTexture_RenderThread() const
+{
+	return HeightTexture.IsValid() ? HeightTexture->GetReferencedTexture() : nullptr;
+}
+
+SIZE_T FComputeMeshSceneProxy::GetTypeHash() const
+{
+	static size_t UniquePointer;
+	return reinterpret_cast<size_t>(&UniquePointer);
+}
+
+void FComputeMeshSceneProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_SceneMeshElements); // Used to gather CPU profiling data for the UE4 session frontend
+
+	if (!bHasGeometry)
+	{
+		return;
+	}
+
+	const bool bWireframe = AllowDebugViewmodes() && ViewFamily.EngineShowFlags.Wireframe;
+
+	FMaterialRenderProxy* MaterialProxy = Material->GetRenderProxy();
+	if (bWireframe)
+	{
+		FColoredMaterialRenderProxy* WireframeMaterialProxy = new FColoredMaterialRenderProxy(GEngine->WireframeMaterial ? GEngine->WireframeMaterial->GetRenderProxy() : nullptr, FLinearColor(0.0f, 0.5f, 1.0f));
+		Collector.RegisterOneFrameMaterialProxy(WireframeMaterialProxy);
+		MaterialProxy = WireframeMaterialProxy;
+	}
+
+	for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+	{
+		if (!(VisibilityMap & (1 << ViewIndex)))
+		{
+			continue;
+		}
+
+		FMeshBatch& Mesh = Collector.AllocateMesh();
+		Mesh.bWireframe = bWireframe;
+		Mesh.VertexFactory = &VertexFactory;
+		Mesh.MaterialRenderProxy = MaterialProxy;
+		Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+		Mesh.Type = PT_TriangleList;
+		Mesh.DepthPriorityGroup = SDPG_World;
+		Mesh.bCanApplyViewModeOverrides = false;
+
+		// The fan has no index buffer, so its draw falls back to DrawPrimitive over the vertices in order.
+		FMeshBatchElement& BatchElement = Mesh.Elements[0];
+		BatchElement.IndexBuffer = bUseShape ? &IndexBuffer : nullptr;
+		BatchElement.PrimitiveUniformBuffer = GetUniformBuffer();
+		BatchElement.FirstIndex = 0;
+		BatchElement.NumPrimitives = bUseShape ? Shape.GetNumIndices() / 3 : NumTriangles;
+		BatchElement.MinVertexIndex = 0;
+		BatchElement.MaxVertexIndex = bUseShape ? Shape.GetNumVertices() - 1 : NumTriangles * 3 - 1;
+
+		Collector.AddMesh(ViewIndex, Mesh);
+	}
+}
+
+FPrimitiveViewRelevance FComputeMeshSceneProxy::GetViewRelevance(const FSceneView* View) const
+{
+	FPrimitiveViewRelevance Result;
+	Result.bDrawRelevance = IsShown(View);
+	Result.bShadowRelevance = IsShadowCast(View);
+	Result.bDynamicRelevance = true;
+	Result.bRenderInMainPass = ShouldRenderInMainPass();
+	Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+	Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+	MaterialRelevance.SetPrimitiveViewRelevance(Result);
+	return Result;
+}
+
+bool FComputeMeshSceneProxy::CanBeOccluded() const
+{
+	return !MaterialRelevance.bDisableDepthTest;
+}
+
+uint32 FComputeMeshSceneProxy::GetMemoryFootprint() const
+{
+	return sizeof(*this) + GetAllocatedSize();
+}
@@ -0,0 +1,140 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+
+#include "LocalVertexFactory.h"
+#include "MaterialShared.h"
+#include "PrimitiveSceneProxy.h"
+#include "RenderResource.h"
+#include "ShaderPluginTargetParameters.h"
+
+class UMaterialInterface;
+class UMeshComponent;
+
+// A vertex buffer the compute shader writes to and the vertex factory reads from, as a stream or through its SRV.
+class FComputeMeshVertexBuffer : public FVertexBuffer
+{
+public:
+	FComputeMeshVertexBuffer(uint32 InBytesPerElement, EPixelFormat InFormat)
+		: BytesPerElement(InBytesPerElement)
+		, Format(InFormat)
+		, NumElements(0)
+	{
+	}
+
+	void SetNumElements(uint32 InNumElements) { NumElements = InNumElements; }
+	uint32 GetNumElements() const { return NumElements; }
+	uint32 GetBytesPerElement() const { return BytesPerElement; }
+	int64 GetNumBytes() const { return (int64)BytesPerElement * NumElements; }
+
+	virtual void InitRHI() override;
+	virtual void ReleaseRHI() override;
+
+	FRWBuffer RWBuffer;
+
+private:
+	uint32 BytesPerElement;
+	EPixelFormat Format;
+	uint32 NumElements;
+};
+
+// A 32 bit index buffer FComputeMeshGenerator writes to through its UAV.
+class FComputeMeshIndexBuffer : public FIndexBuffer
+{
+public:
+	FComputeMeshIndexBuffer()
+		: NumIndices(0)
+	{
+	}
+
+	void SetNumIndices(uint32 InNumIndices) { NumIndices = InNumIndices; }
+	uint32 GetNumIndices() const { return NumIndices; }
+	int64 GetNumBytes() const { return (int64)sizeof(uint32) * NumIndices; }
+
+	virtual void InitRHI() override;
+	virtual void ReleaseRHI() override;
+
+	FUnorderedAccessViewRHIRef UAV;
+
+private:
+	uint32 NumIndices;
+};
+
+/*
+ * Draws the vertex compute shader's output as a regular mesh in the scene, so it gets depth, lighting, shadows and
+ * any material you like. The compute shader writes straight into the buffers FLocalVertexFactory reads from, the same
+ * layout a static mesh uses, so there is no readback and nothing is ever copied through the CPU. The triangles are
+ * unindexed, which saves us from having to build an index buffer at all.
+ *
+ * Proxies made with an FComputeMeshShapeSettings draw one of FComputeMeshGenerator's shapes instead of the fan. Those
+ * are indexed, with the indices written by the GPU as well.
+ *
+ * The geometry changes every frame, so the proxy is drawn as a dynamic primitive. Until the first Update_RenderThread
+ * the buffers are undefined and nothing is drawn.
+ */
+class FComputeMeshSceneProxy : public FPrimitiveSceneProxy
+{
+public:
+	FComputeMeshSceneProxy(UMeshComponent* Component, int32 InNumTriangles, float InMeshScale, float InMeshHeight);
+	FComputeMeshSceneProxy(UMeshComponent* Component, const FComputeMeshShapeSettings& InShape);
+	virtual ~FComputeMeshSceneProxy();
+
+	// Runs the compute shader for this frame. Must be called before the scene renders for the new geometry to show up.
+	void Update_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters);
+
+	// Switches a proxy made with a shape to another one. The buffers are only reallocated when the new shape doesn't fit,
+	// and the mesh is regenerated right away if it had been generated before. HeightTexture may be null, it is the
+	// TextureReference of Shape.HeightTexture, which keeps pointing at the texture's current RHI texture.
+	void SetShape_RenderThread(FRHICommandListImmediate& RHICmdList, const FComputeMeshShapeSettings& NewShape, FRHITextureReference* NewHeightTexture);
+
+	// FPrimitiveSceneProxy
+	virtual SIZE_T GetTypeHash() const override;
+	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override;
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override;
+	virtual bool CanBeOccluded() const override;
+	virtual uint32 GetMemoryFootprint() const override;
+
+private:
+	void SetBufferSizes(uint32 NumVertices, uint32 NumIndices);
+	void InitResources_RenderThread();
+	void ReleaseResources_RenderThread();
+	int64 GetAllocatedBytes() const;
+
+	// Runs FComputeMeshGenerator, the indices only when they are out of date.
+	void GenerateShape_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// The texture HeightTexture points at right now, or nullptr.
+	FRHITexture* GetHeightTexture_RenderThread() const;
+
+	FComputeMeshVertexBuffer PositionBuffer;
+	FComputeMeshVertexBuffer TangentBuffer;
+	FComputeMeshVertexBuffer TexCoordBuffer;
+	FComputeMeshIndexBuffer IndexBuffer; // Only used with a shape
+	FLocalVertexFactory VertexFactory;
+
+	UMaterialInterface* Material;
+	FMaterialRelevance MaterialRelevance;
+
+	FShaderPluginTargetUniformBufferCache TargetUniformBuffers; // Render thread only
+
+	uint32 NumTriangles;
+	float MeshScale;
+	float MeshHeight;
+	bool bHasGeometry; // Render thread only
+
+	bool bUseShape;
+	FComputeMeshShapeSettings Shape; // Render thread only after construction
+	FTextureReferenceRHIRef HeightTexture; // Render thread only, holds on to the reference even if the texture goes away
+	float RadiusScale; // Render thread only, the ComputeRadius of the last update
+	bool bHasIndices; // Render thread only
+
+	// What the vertices were last generated with, the shape only has to be generated again when one of these changes.
+	bool bShapeChanged; // Render thread only
+	float GeneratedRadiusScale; // Render thread only
+	FRHITexture* GeneratedHeightTexture; // Render thread only, compared against but never used
+};
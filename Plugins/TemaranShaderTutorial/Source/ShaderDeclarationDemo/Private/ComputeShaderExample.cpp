@@ -3,6 +3,7 @@
 ///////////////////////////////////////////////////////////////////////////////////////
 
 #include "ComputeShaderExample.h"
+#include "ShaderPluginTrace.h"
 #include "ShaderParameterUtils.h"
 #include "RHIStaticStates.h"
 #include "Shader.h"
@@ -12,9 +13,38 @@
 #include "ShaderParameterStruct.h"
 #include "UniformBuffer.h"
 #include "RHICommandList.h"
+#include "HAL/IConsoleManager.h"
 
 #define NUM_THREADS_PER_GROUP_DIMENSION 8
 
+static TAutoConsoleVariable<int32> CVarBufferLayout(
+	TEXT("r.ShaderPlugin.BufferLayout"),
+	0,
+	TEXT("Memory layout of the buffer the compute shader passes to the pixel shader.\n")
+	TEXT(" 0: Linear, row-major (default)\n")
+	TEXT(" 1: 8x8 tiles\n")
+	TEXT(" 2: 8x8 tiles with Z-order inside each tile\n")
+	TEXT("ShaderPlugin.BenchmarkBufferLayouts compares them on the current GPU."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarHalfPrecisionFractal(
+	TEXT("r.ShaderPlugin.HalfPrecisionFractal"),
+	0,
+	TEXT("When enabled, the fractal fold runs in half precision. This is a lot faster on most mobile and console GPUs.\n")
+	TEXT("Use ShaderPlugin.ReportHalfPrecisionError to see how much it changes the output before turning it on."),
+	ECVF_RenderThreadSafe);
+
+FFractalFrameConstants::FFractalFrameConstants(float SimulationState)
+{
+	// See the matching comments in ComputeShader.usf. These end up in the ShaderPluginTarget uniform buffer.
+	TimePhase = FMath::Fmod(SimulationState * 0.1f, 2.0f * PI);
+	TimeWarp = 0.25f + 0.05f * FMath::Sin(SimulationState * 0.1f);
+	ZOffset = -1.5f - FMath::Sin(SimulationState * 0.13f) * 0.1f;
+	V1Phase = FMath::Fmod(0.5f - SimulationState * 0.2f, 2.0f * PI);
+	V2Phase = FMath::Fmod(1.2f - SimulationState * 0.3f, 2.0f * PI);
+	RedScale = 1.5f + FMath::Sin(SimulationState * 0.2f) * 0.4f;
+}
+
 /**********************************************************************************************/
 /* This class carries our parameter declarations and acts as the bridge between cpp and HLSL. */
 /**********************************************************************************************/
@@ -24,12 +54,18 @@ public:
 	DECLARE_GLOBAL_SHADER(FComputeShaderExampleCS);
 	SHADER_USE_PARAMETER_STRUCT(FComputeShaderExampleCS, FGlobalShader);
 
+	class FBufferLayoutDim : SHADER_PERMUTATION_INT("BUFFER_LAYOUT", (int32)EComputeBufferLayout::Num);
+	class FHalfPrecisionDim : SHADER_PERMUTATION_BOOL("USE_HALF_PRECISION");
+	using FPermutationDomain = TShaderPermutationDomain<FBufferLayoutDim, FHalfPrecisionDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER_TEXTURE(Texture2D, SrcTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, SrcSampler)
 		SHADER_PARAMETER_UAV(RWTexture2D<float4>, OutputTexture)
 		SHADER_PARAMETER_UAV(RWBuffer<float4>, DstBuffer)
-		SHADER_PARAMETER(FVector2D, TextureSize) // Metal doesn't support GetDimensions(), so we send in this data via our parameters.
-		SHADER_PARAMETER(float, SimulationState)
+		SHADER_PARAMETER(FIntPoint, DispatchOffset)
+		SHADER_PARAMETER(FIntPoint, DispatchEnd)
+		SHADER_PARAMETER_STRUCT_REF(FShaderPluginTargetParameters, ShaderPluginTarget)
 	END_SHADER_PARAMETER_STRUCT()
 
 public:
@@ -45,6 +81,7 @@ public:
 		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_X1"), NUM_THREADS_PER_GROUP_DIMENSION);
 		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_Y1"), NUM_THREADS_PER_GROUP_DIMENSION);
 		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_Z1"), 1);
+		OutEnvironment.SetDefine(TEXT("BUFFER_LAYOUT_TILE_SIZE"), BUFFER_LAYOUT_TILE_SIZE);
 	}
 };
 
@@ -52,28 +89,75 @@ public:
 //                            ShaderType                            ShaderPath                     Shader function name    Type
 IMPLEMENT_GLOBAL_SHADER(FComputeShaderExampleCS, "/TutorialShaders/Private/ComputeShader.usf", "MainComputeShader", SF_Compute);
 
-void FComputeShaderExample::RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FUnorderedAccessViewRHIRef ComputeShaderOutputUAV, FUnorderedAccessViewRHIRef DstBufferUAV)
+void FComputeShaderExample::RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FIntPoint& ComputeSize, EComputeBufferLayout BufferLayout, FUnorderedAccessViewRHIRef ComputeShaderOutputUAV, FUnorderedAccessViewRHIRef DstBufferUAV, bool bHalfPrecision /*= false*/, const TArray<FIntRect>& ComputeRects /*= TArray<FIntRect>()*/, FRHITexture* SrcTexture /*= nullptr*/)
 {
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_ComputeShader); // Used to gather CPU profiling data for the UE4 session frontend
 	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Compute); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(Dispatch); // Used to show our work next to the engine's in Unreal Insights
 
 	UnbindRenderTargets(RHICmdList);
 	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, ComputeShaderOutputUAV);
 	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, DstBufferUAV);
 	
 	FComputeShaderExampleCS::FParameters PassParameters;
-	PassParameters.SrcTexture = GBlackTexture->TextureRHI;
+	PassParameters.SrcTexture = SrcTexture ? SrcTexture : GBlackTexture->TextureRHI.GetReference();
+	PassParameters.SrcSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
 	PassParameters.OutputTexture = ComputeShaderOutputUAV;
 	PassParameters.DstBuffer = DstBufferUAV;
-	PassParameters.TextureSize = FVector2D(DrawParameters.GetRenderTargetSize().X, DrawParameters.GetRenderTargetSize().Y);
-	PassParameters.SimulationState = DrawParameters.SimulationState;
+	PassParameters.ShaderPluginTarget = TargetUniformBuffer;
+
+	FComputeShaderExampleCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FComputeShaderExampleCS::FBufferLayoutDim>((int32)BufferLayout);
+	PermutationVector.Set<FComputeShaderExampleCS::FHalfPrecisionDim>(bHalfPrecision);
 
-	TShaderMapRef<FComputeShaderExampleCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	TShaderMapRef<FComputeShaderExampleCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 
-	FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, 
-								FIntVector(FMath::DivideAndRoundUp(DrawParameters.GetRenderTargetSize().X, NUM_THREADS_PER_GROUP_DIMENSION),
-										   FMath::DivideAndRoundUp(DrawParameters.GetRenderTargetSize().Y, NUM_THREADS_PER_GROUP_DIMENSION), 1));
+	// The rectangles only overlap where they write the same values, so the dispatches don't need barriers in between.
+	const FIntRect FullRect(FIntPoint::ZeroValue, ComputeSize);
+	const int32 NumDispatches = FMath::Max(ComputeRects.Num(), 1);
+	for (int32 DispatchIndex = 0; DispatchIndex < NumDispatches; DispatchIndex++)
+	{
+		const FIntRect& Rect = ComputeRects.Num() > 0 ? ComputeRects[DispatchIndex] : FullRect;
+		PassParameters.DispatchOffset = Rect.Min;
+		PassParameters.DispatchEnd = Rect.Max;
+
+		FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, 
+									FIntVector(FMath::DivideAndRoundUp(Rect.Width(), NUM_THREADS_PER_GROUP_DIMENSION),
+											   FMath::DivideAndRoundUp(Rect.Height(), NUM_THREADS_PER_GROUP_DIMENSION), 1));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	}
 
 	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, ComputeShaderOutputUAV);
 	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, DstBufferUAV);
 }
+
+uint32 FComputeShaderExample::GetBufferNumElements(const FIntPoint& Size, EComputeBufferLayout BufferLayout)
+{
+	if (BufferLayout == EComputeBufferLayout::Linear)
+	{
+		return Size.X * Size.Y;
+	}
+
+	return FMath::DivideAndRoundUp(Size.X, BUFFER_LAYOUT_TILE_SIZE) * FMath::DivideAndRoundUp(Size.Y, BUFFER_LAYOUT_TILE_SIZE) * BUFFER_LAYOUT_TILE_SIZE * BUFFER_LAYOUT_TILE_SIZE;
+}
+
+EComputeBufferLayout FComputeShaderExample::GetBufferLayout_RenderThread()
+{
+	return (EComputeBufferLayout)FMath::Clamp(CVarBufferLayout.GetValueOnRenderThread(), 0, (int32)EComputeBufferLayout::Num - 1);
+}
+
+const TCHAR* FComputeShaderExample::GetBufferLayoutName(EComputeBufferLayout BufferLayout)
+{
+	switch (BufferLayout)
+	{
+	case EComputeBufferLayout::Linear:		return TEXT("Linear");
+	case EComputeBufferLayout::Tiled:		return TEXT("Tiled");
+	case EComputeBufferLayout::TiledMorton:	return TEXT("TiledMorton");
+	default:								return TEXT("Unknown");
+	}
+}
+
+bool FComputeShaderExample::UseHalfPrecision_RenderThread()
+{
+	return CVarHalfPrecisionFractal.GetValueOnRenderThread() != 0;
+}
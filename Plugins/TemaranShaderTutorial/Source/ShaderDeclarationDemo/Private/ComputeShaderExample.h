@@ -6,6 +6,35 @@
 
 #include "CoreMinimal.h"
 #include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginTargetParameters.h"
+
+// How the compute shader lays out DstBuffer. The pixel shader reads it back with the same layout, see BufferLayout.ush.
+enum class EComputeBufferLayout : int32
+{
+	Linear,			// Row-major
+	Tiled,			// 8x8 tiles matching the thread groups, row-major inside each tile
+	TiledMorton,	// 8x8 tiles, Z-order inside each tile so every 2x2 quad is contiguous
+	Num
+};
+
+// Edge length of the tiles in the tiled layouts. Every shader that includes BufferLayout.ush gets it as a define, so the
+// buffer sizes worked out here always match the addressing in there. TiledMorton interleaves 3 bits per axis inside a
+// tile, so changing this also means changing MortonSpread3.
+#define BUFFER_LAYOUT_TILE_SIZE 8
+
+// Every term of the fractal that only depends on time. We work these out once per frame on the CPU instead of per pixel,
+// and wrap the phases to [0, 2PI) so the half precision permutation doesn't have to deal with large arguments.
+struct FFractalFrameConstants
+{
+	float TimePhase;
+	float TimeWarp;
+	float ZOffset;
+	float V1Phase;
+	float V2Phase;
+	float RedScale;
+
+	FFractalFrameConstants(float SimulationState);
+};
 
 /**************************************************************************************/
 /* This is just an interface we use to keep all the compute shading code in one file. */
@@ -13,5 +42,23 @@
 class FComputeShaderExample
 {
 public:
-	static void RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FUnorderedAccessViewRHIRef ComputeShaderOutputUAV, FUnorderedAccessViewRHIRef DstBufferUAV);
+	// ComputeSize is the resolution the fractal is evaluated at. It can be smaller than the render target, in which case
+	// only the top left ComputeSize texels of the outputs are written and the pixel shader upscales them.
+	// bHalfPrecision selects the permutation that runs the fractal fold in 16 bit floats where the platform supports it.
+	// ComputeSize must match the ComputeSize in TargetUniformBuffer.
+	// When ComputeRects is set, only the texels inside them are written, with one dispatch per rectangle. They have to be
+	// within ComputeSize.
+	// SrcTexture is stretched over the target and added to the fractal. nullptr adds nothing.
+	static void RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FIntPoint& ComputeSize, EComputeBufferLayout BufferLayout, FUnorderedAccessViewRHIRef ComputeShaderOutputUAV, FUnorderedAccessViewRHIRef DstBufferUAV, bool bHalfPrecision = false, const TArray<FIntRect>& ComputeRects = TArray<FIntRect>(), FRHITexture* SrcTexture = nullptr);
+
+	// Whether r.ShaderPlugin.HalfPrecisionFractal is set.
+	static bool UseHalfPrecision_RenderThread();
+
+	// The tiled layouts pad the buffer out to whole tiles.
+	static uint32 GetBufferNumElements(const FIntPoint& Size, EComputeBufferLayout BufferLayout);
+
+	// The layout selected with r.ShaderPlugin.BufferLayout.
+	static EComputeBufferLayout GetBufferLayout_RenderThread();
+
+	static const TCHAR* GetBufferLayoutName(EComputeBufferLayout BufferLayout);
 };
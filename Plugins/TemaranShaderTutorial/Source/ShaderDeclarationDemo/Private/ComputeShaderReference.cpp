@@ -0,0 +1,76 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ComputeShaderReference.h"
+
+#include "Async/ParallelFor.h"
+
+FLinearColor FComputeShaderReference::EvaluatePixel(const FVector2D& UV, float SimulationState)
+{
+	// Keep this in sync with MainComputeShader. The variable names follow the HLSL so the two are easy to compare.
+	const float iGlobalTime = SimulationState;
+	const float Len = UV.Size();
+
+	const float t = iGlobalTime * 0.1f + ((0.25f + 0.05f * FMath::Sin(iGlobalTime * 0.1f)) / (Len + 0.07f)) * 2.2f;
+	const float si = FMath::Sin(t);
+	const float co = FMath::Cos(t);
+
+	// These don't change inside the loop, so there is no need to recompute them 90 times.
+	const float zOffset = -1.5f - FMath::Sin(iGlobalTime * 0.13f) * 0.1f;
+	const float v1Scale = 0.0015f * (1.8f + FMath::Sin((UV * 13.0f).Size() + 0.5f - iGlobalTime * 0.2f));
+	const float v2Scale = 0.0013f * (1.5f + FMath::Sin((UV * 14.5f).Size() + 1.2f - iGlobalTime * 0.3f));
+
+	float v1 = 0.0f;
+	float v2 = 0.0f;
+	float v3 = 0.0f;
+
+	float s = 0.0f;
+	for (int32 i = 0; i < 90; i++)
+	{
+		// mul(p.xy, ma) with ma = { co, si, -si, co }
+		FVector p(s * UV.X * co - s * UV.Y * si, s * UV.X * si + s * UV.Y * co, 0.0f);
+		p += FVector(0.22f, 0.3f, s + zOffset);
+
+		for (int32 j = 0; j < 8; j++)
+		{
+			p = p.GetAbs() / FVector::DotProduct(p, p) - 0.659f;
+		}
+
+		const float pp = FVector::DotProduct(p, p);
+		v1 += pp * v1Scale;
+		v2 += pp * v2Scale;
+		v3 += FVector2D(p.X, p.Y).Size() * 10.0f * 0.0003f;
+		s += 0.035f;
+	}
+
+	v1 *= FMath::Lerp(0.7f, 0.0f, Len);
+	v2 *= FMath::Lerp(0.5f, 0.0f, Len);
+	v3 *= FMath::Lerp(0.9f, 0.0f, Len);
+
+	const FVector Col = FVector(v3 * (1.5f + FMath::Sin(iGlobalTime * 0.2f) * 0.4f), (v1 + v3) * 0.3f, v2)
+		+ FMath::Lerp(0.2f, 0.0f, Len) * 0.85f
+		+ FMath::Lerp(0.0f, 0.6f, v3) * 0.3f;
+
+	return FLinearColor(
+		FMath::Min(FMath::Pow(FMath::Abs(Col.X), 1.2f), 1.0f),
+		FMath::Min(FMath::Pow(FMath::Abs(Col.Y), 1.2f), 1.0f),
+		FMath::Min(FMath::Pow(FMath::Abs(Col.Z), 1.2f), 1.0f),
+		1.0f);
+}
+
+void FComputeShaderReference::RenderFrame(const FIntPoint& FrameSize, float SimulationState, FColor* OutPixels, int32 OutRowPitch)
+{
+	check(OutPixels);
+
+	ParallelFor(FrameSize.Y, [&](int32 Y)
+	{
+		FColor* Row = OutPixels + Y * OutRowPitch;
+		for (int32 X = 0; X < FrameSize.X; X++)
+		{
+			// Same mapping as the compute shader: ThreadId.xy / iResolution.xy - 0.5
+			const FVector2D UV(X / (float)FrameSize.X - 0.5f, Y / (float)FrameSize.Y - 0.5f);
+			Row[X] = EvaluatePixel(UV, SimulationState).ToFColor(false);
+		}
+	});
+}
@@ -0,0 +1,21 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**************************************************************************************/
+/* A CPU port of MainComputeShader in ComputeShader.usf. It is much slower than the   */
+/* GPU version, but lets us produce the same output when there is no GPU to run on.   */
+/**************************************************************************************/
+class FComputeShaderReference
+{
+public:
+	// Evaluates the fractal for a single pixel. UV is in the same [-0.5, 0.5) range the compute shader uses.
+	static FLinearColor EvaluatePixel(const FVector2D& UV, float SimulationState);
+
+	// Renders a whole frame into OutPixels, which must point at FrameSize.Y rows of OutRowPitch pixels each.
+	static void RenderFrame(const FIntPoint& FrameSize, float SimulationState, FColor* OutPixels, int32 OutRowPitch);
+};
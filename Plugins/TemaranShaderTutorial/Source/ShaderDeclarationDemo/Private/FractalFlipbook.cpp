@@ -0,0 +1,183 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "FractalFlipbook.h"
+
+#include "ComputeShaderExample.h"
+#include "ComputeShaderReference.h"
+#include "ShaderPluginTrace.h"
+
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "RenderTargetPool.h"
+
+#if WITH_EDITOR
+#include "Engine/Texture2D.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#endif
+
+bool FFractalFlipbook::CanBakeOnGPU()
+{
+	return !GUsingNullRHI && RHISupportsComputeShaders(GMaxRHIShaderPlatform);
+}
+
+FTextureRHIRef FFractalFlipbook::BakeGPU_RenderThread(FRHICommandListImmediate& RHICmdList, const FFractalFlipbookSettings& Settings, TArray<FColor>* OutPixels)
+{
+	check(IsInRenderingThread());
+	check(Settings.IsValid());
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_BakeFlipbook); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_BakeFlipbook); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(BakeFlipbook); // Used to show our work next to the engine's in Unreal Insights
+
+	const FIntPoint AtlasSize = Settings.GetAtlasSize();
+
+	FRHIResourceCreateInfo CreateInfo;
+	FTexture2DRHIRef Atlas = RHICreateTexture2D(AtlasSize.X, AtlasSize.Y, PF_R8G8B8A8, 1, 1, TexCreate_ShaderResource, CreateInfo);
+
+	// We render each frame with the regular compute shader and then copy it into its slot in the atlas.
+	TRefCountPtr<IPooledRenderTarget> FrameOutput;
+	FPooledRenderTargetDesc FrameOutputDesc(FPooledRenderTargetDesc::Create2DDesc(Settings.FrameSize, PF_R8G8B8A8, FClearValueBinding::None, TexCreate_None, TexCreate_RenderTargetable | TexCreate_UAV, false));
+	FrameOutputDesc.DebugName = TEXT("ShaderPlugin_FlipbookFrame");
+	GRenderTargetPool.FindFreeElement(RHICmdList, FrameOutputDesc, FrameOutput, TEXT("ShaderPlugin_FlipbookFrame"));
+
+	FRWBuffer FrameBuffer;
+	FrameBuffer.Initialize(sizeof(float) * 4, Settings.FrameSize.X * Settings.FrameSize.Y, PF_A32B32G32R32F);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated, 3);
+
+	const FSceneRenderTargetItem& FrameTarget = FrameOutput->GetRenderTargetItem();
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, Atlas);
+
+	for (int32 FrameIndex = 0; FrameIndex < Settings.NumFrames; FrameIndex++)
+	{
+		FShaderUsageExampleParameters FrameParameters(Settings.FrameSize);
+		FrameParameters.SimulationState = Settings.GetFrameTime(FrameIndex);
+
+		// The previous frame's copy read the frame texture, so it has to be done before the dispatch writes it again.
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, FrameTarget.UAV);
+		FComputeShaderExample::RunComputeShader_RenderThread(RHICmdList, CreateShaderPluginTargetUniformBuffer(FrameParameters), Settings.FrameSize, EComputeBufferLayout::Linear, FrameTarget.UAV, FrameBuffer.UAV);
+
+		// And the dispatch has to be done writing before the copy reads it.
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, FrameTarget.TargetableTexture);
+
+		const FIntPoint FrameOrigin = Settings.GetFrameOrigin(FrameIndex);
+		FRHICopyTextureInfo CopyInfo;
+		CopyInfo.Size = FIntVector(Settings.FrameSize.X, Settings.FrameSize.Y, 1);
+		CopyInfo.DestPosition = FIntVector(FrameOrigin.X, FrameOrigin.Y, 0);
+		RHICmdList.CopyTexture(FrameTarget.TargetableTexture, Atlas, CopyInfo);
+	}
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, Atlas);
+
+	if (OutPixels)
+	{
+		RHICmdList.ReadSurfaceData(Atlas, FIntRect(FIntPoint::ZeroValue, AtlasSize), *OutPixels, FReadSurfaceDataFlags());
+	}
+
+	return Atlas;
+}
+
+void FFractalFlipbook::BakeCPU(const FFractalFlipbookSettings& Settings, TArray<FColor>& OutPixels)
+{
+	check(Settings.IsValid());
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_BakeFlipbookCPU);
+	SHADERPLUGIN_TRACE_SCOPE(BakeFlipbookCPU);
+
+	const FIntPoint AtlasSize = Settings.GetAtlasSize();
+	OutPixels.SetNumZeroed(AtlasSize.X * AtlasSize.Y);
+
+	for (int32 FrameIndex = 0; FrameIndex < Settings.NumFrames; FrameIndex++)
+	{
+		const FIntPoint FrameOrigin = Settings.GetFrameOrigin(FrameIndex);
+		FColor* FramePixels = OutPixels.GetData() + FrameOrigin.Y * AtlasSize.X + FrameOrigin.X;
+		FComputeShaderReference::RenderFrame(Settings.FrameSize, Settings.GetFrameTime(FrameIndex), FramePixels, AtlasSize.X);
+	}
+}
+
+FTextureRHIRef FFractalFlipbook::CreateAtlasTexture_RenderThread(const FFractalFlipbookSettings& Settings, const TArray<FColor>& Pixels)
+{
+	check(IsInRenderingThread());
+
+	const FIntPoint AtlasSize = Settings.GetAtlasSize();
+	check(Pixels.Num() == AtlasSize.X * AtlasSize.Y);
+
+	// FColor is stored as BGRA in memory.
+	FRHIResourceCreateInfo CreateInfo;
+	FTexture2DRHIRef Atlas = RHICreateTexture2D(AtlasSize.X, AtlasSize.Y, PF_B8G8R8A8, 1, 1, TexCreate_ShaderResource, CreateInfo);
+
+	const FUpdateTextureRegion2D Region(0, 0, 0, 0, AtlasSize.X, AtlasSize.Y);
+	{
+		SHADERPLUGIN_TRACE_SCOPE(UploadFlipbook);
+		RHIUpdateTexture2D(Atlas, 0, Region, AtlasSize.X * sizeof(FColor), reinterpret_cast<const uint8*>(Pixels.GetData()));
+	}
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, Pixels.Num() * sizeof(FColor));
+
+	return Atlas;
+}
+
+void FFractalFlipbook::GetPlaybackFrames(const FFractalFlipbookSettings& Settings, float SimulationState, int32& OutFrameA, int32& OutFrameB, float& OutCrossfade)
+{
+	float Phase = FMath::Fmod(SimulationState - Settings.LoopStart, Settings.LoopDuration) / Settings.LoopDuration;
+	if (Phase < 0.0f)
+	{
+		Phase += 1.0f;
+	}
+
+	const float FramePosition = Phase * Settings.NumFrames;
+	OutFrameA = FMath::Clamp(FMath::FloorToInt(FramePosition), 0, Settings.NumFrames - 1);
+	OutFrameB = (OutFrameA + 1) % Settings.NumFrames;
+	OutCrossfade = FMath::Clamp(FramePosition - OutFrameA, 0.0f, 1.0f);
+}
+
+FVector4 FFractalFlipbook::GetFrameScaleBias(const FFractalFlipbookSettings& Settings, int32 FrameIndex)
+{
+	const FIntPoint AtlasSize = Settings.GetAtlasSize();
+	const FIntPoint FrameOrigin = Settings.GetFrameOrigin(FrameIndex);
+
+	// Map UV 0 and 1 onto the centers of the frame's edge texels, so bilinear filtering never picks up the neighbouring frame.
+	return FVector4(
+		(Settings.FrameSize.X - 1) / (float)AtlasSize.X,
+		(Settings.FrameSize.Y - 1) / (float)AtlasSize.Y,
+		(FrameOrigin.X + 0.5f) / AtlasSize.X,
+		(FrameOrigin.Y + 0.5f) / AtlasSize.Y);
+}
+
+#if WITH_EDITOR
+UTexture2D* FFractalFlipbook::SaveAsTextureAsset(const FFractalFlipbookSettings& Settings, const TArray<FColor>& Pixels, const FString& PackageName)
+{
+	const FIntPoint AtlasSize = Settings.GetAtlasSize();
+	if (Pixels.Num() != AtlasSize.X * AtlasSize.Y)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Flipbook bake for %s returned %d pixels, expected %d."), *PackageName, Pixels.Num(), AtlasSize.X * AtlasSize.Y);
+		return nullptr;
+	}
+
+	UPackage* Package = CreatePackage(nullptr, *PackageName);
+	Package->FullyLoad();
+
+	UTexture2D* Texture = NewObject<UTexture2D>(Package, *FPackageName::GetShortName(PackageName), RF_Public | RF_Standalone);
+	Texture->Source.Init(AtlasSize.X, AtlasSize.Y, 1, 1, TSF_BGRA8, reinterpret_cast<const uint8*>(Pixels.GetData()));
+
+	// Keep the frames exact. Compression and mips would both bleed neighbouring frames into each other.
+	Texture->SRGB = false;
+	Texture->CompressionSettings = TC_VectorDisplacementmap;
+	Texture->MipGenSettings = TMGS_NoMipmaps;
+	Texture->AddressX = TA_Clamp;
+	Texture->AddressY = TA_Clamp;
+	Texture->PostEditChange();
+	Package->MarkPackageDirty();
+
+	const FString Filename = FPackageName::LongPackageNameToFilename(PackageName, FPackageName::GetAssetPackageExtension());
+	if (!UPackage::SavePackage(Package, Texture, RF_Public | RF_Standalone, *Filename))
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to save flipbook asset %s."), *Filename);
+		return nullptr;
+	}
+
+	return Texture;
+}
+#endif
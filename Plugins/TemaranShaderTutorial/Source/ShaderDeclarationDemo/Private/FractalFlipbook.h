@@ -0,0 +1,38 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+
+/**************************************************************************************/
+/* This is just an interface we use to keep all the flipbook baking code in one file. */
+/**************************************************************************************/
+class FFractalFlipbook
+{
+public:
+	// False when there is no GPU we can run the compute shader on, in which case we bake on the CPU instead.
+	static bool CanBakeOnGPU();
+
+	// Runs the compute shader once per frame and copies the frames into a new atlas texture.
+	// If OutPixels is set, the atlas is also read back so it can be saved.
+	static FTextureRHIRef BakeGPU_RenderThread(FRHICommandListImmediate& RHICmdList, const FFractalFlipbookSettings& Settings, TArray<FColor>* OutPixels = nullptr);
+
+	// Renders every frame with the CPU reference implementation. OutPixels is laid out like the atlas.
+	static void BakeCPU(const FFractalFlipbookSettings& Settings, TArray<FColor>& OutPixels);
+
+	// Uploads a CPU baked atlas.
+	static FTextureRHIRef CreateAtlasTexture_RenderThread(const FFractalFlipbookSettings& Settings, const TArray<FColor>& Pixels);
+
+	// Finds the two frames to crossfade between at the given simulation time. The last frame crossfades into the first.
+	static void GetPlaybackFrames(const FFractalFlipbookSettings& Settings, float SimulationState, int32& OutFrameA, int32& OutFrameB, float& OutCrossfade);
+
+	// Returns the UV scale (xy) and bias (zw) that maps a full frame UV into the frame's rect in the atlas.
+	static FVector4 GetFrameScaleBias(const FFractalFlipbookSettings& Settings, int32 FrameIndex);
+
+#if WITH_EDITOR
+	static UTexture2D* SaveAsTextureAsset(const FFractalFlipbookSettings& Settings, const TArray<FColor>& Pixels, const FString& PackageName);
+#endif
+};
@@ -0,0 +1,112 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "GenerateMipsExample.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginTrace.h"
+#include "GlobalShader.h"
+#include "RenderGraphUtils.h"
+#include "RHICommandList.h"
+#include "ShaderParameterStruct.h"
+
+// Must match TILE_SIZE in GenerateMips.usf, times two since the tile is in texels of the first mip we write.
+#define GENERATE_MIPS_TILE_SIZE 64
+
+// The D3D11 RHI gives a compute shader 8 UAVs, so six levels per dispatch is as far as one set of bindings goes.
+#define GENERATE_MIPS_PER_DISPATCH 6
+
+class FGenerateMipsCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FGenerateMipsCS);
+	SHADER_USE_PARAMETER_STRUCT(FGenerateMipsCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_SRV(Texture2D<float4>, SrcMip)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, DstMip1)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, DstMip2)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, DstMip3)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, DstMip4)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, DstMip5)
+		SHADER_PARAMETER_UAV(RWTexture2D<float4>, DstMip6)
+		SHADER_PARAMETER(FIntPoint, SrcSize)
+		SHADER_PARAMETER(uint32, NumMips)
+	END_SHADER_PARAMETER_STRUCT()
+
+public:
+	// Typed UAV stores to the render target formats are only something we rely on with SM5.
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FGenerateMipsCS, "/TutorialShaders/Private/GenerateMips.usf", "MainCS", SF_Compute);
+
+bool FGenerateMipsExample::CanGenerateMips(FRHITexture2D* Texture)
+{
+	return Texture && Texture->GetNumMips() > 1 && (Texture->GetFlags() & TexCreate_UAV) != 0 && GMaxRHIFeatureLevel >= ERHIFeatureLevel::SM5;
+}
+
+void FGenerateMipsExample::GenerateMips_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Texture)
+{
+	check(IsInRenderingThread());
+
+	if (!CanGenerateMips(Texture))
+	{
+		return;
+	}
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_GenerateMips); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_GenerateMips); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(GenerateMips); // Used to show our work next to the engine's in Unreal Insights
+
+	const int32 NumMips = Texture->GetNumMips();
+	TArray<FUnorderedAccessViewRHIRef, TInlineAllocator<16>> MipUAVs;
+	MipUAVs.Add(nullptr); // Mip 0 is what we drew, it is only ever read
+	for (int32 MipLevel = 1; MipLevel < NumMips; MipLevel++)
+	{
+		MipUAVs.Add(RHICreateUnorderedAccessView(Texture, MipLevel));
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, MipUAVs[MipLevel]);
+	}
+
+	TShaderMapRef<FGenerateMipsCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+
+	for (int32 SrcMipLevel = 0; SrcMipLevel < NumMips - 1; SrcMipLevel += GENERATE_MIPS_PER_DISPATCH)
+	{
+		const int32 NumDispatchMips = FMath::Min(NumMips - 1 - SrcMipLevel, GENERATE_MIPS_PER_DISPATCH);
+		const FIntPoint SrcSize(FMath::Max(Texture->GetSizeX() >> SrcMipLevel, 1u), FMath::Max(Texture->GetSizeY() >> SrcMipLevel, 1u));
+
+		FShaderResourceViewRHIRef SrcMipSRV = RHICreateShaderResourceView(Texture, SrcMipLevel);
+
+		FGenerateMipsCS::FParameters PassParameters;
+		PassParameters.SrcMip = SrcMipSRV;
+		PassParameters.SrcSize = SrcSize;
+		PassParameters.NumMips = NumDispatchMips;
+
+		// Levels past the end of the chain still need something bound. The shader never writes to them.
+		FRHIUnorderedAccessView** DstMips[GENERATE_MIPS_PER_DISPATCH] = { &PassParameters.DstMip1, &PassParameters.DstMip2, &PassParameters.DstMip3, &PassParameters.DstMip4, &PassParameters.DstMip5, &PassParameters.DstMip6 };
+		for (int32 Index = 0; Index < GENERATE_MIPS_PER_DISPATCH; Index++)
+		{
+			*DstMips[Index] = MipUAVs[SrcMipLevel + 1 + FMath::Min(Index, NumDispatchMips - 1)];
+		}
+
+		FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters, FIntVector(
+			FMath::DivideAndRoundUp(SrcSize.X, GENERATE_MIPS_TILE_SIZE),
+			FMath::DivideAndRoundUp(SrcSize.Y, GENERATE_MIPS_TILE_SIZE), 1));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+
+		// The last level we wrote is the source of the next dispatch.
+		const int32 LastMipLevel = SrcMipLevel + NumDispatchMips;
+		if (LastMipLevel < NumMips - 1)
+		{
+			RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, MipUAVs[LastMipLevel]);
+		}
+	}
+
+	for (int32 MipLevel = 1; MipLevel < NumMips; MipLevel++)
+	{
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, MipUAVs[MipLevel]);
+	}
+}
@@ -0,0 +1,22 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+
+/**************************************************************************************/
+/* Rebuilds the mip chain of a render target after we have drawn to it. Materials     */
+/* that sample the target from far away then read small mips instead of aliasing.     */
+/**************************************************************************************/
+class FGenerateMipsExample
+{
+public:
+	// The target needs "Auto Generate Mips" ticked, which gives it the mip chain and, on SM5, the UAV access we write it
+	// with. Each dispatch writes six levels, so anything up to 64x64 is done in one and up to 4096x4096 in two.
+	static void GenerateMips_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Texture);
+
+	static bool CanGenerateMips(FRHITexture2D* Texture);
+};
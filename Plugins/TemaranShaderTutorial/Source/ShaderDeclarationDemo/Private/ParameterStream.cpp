@@ -0,0 +1,237 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ParameterStream.h"
+
+#include "HAL/FileManager.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+// Bump the version whenever the event layout changes, old recordings are rejected rather than misread.
+static const uint32 ParameterStreamMagic = 0x53505053; // "SPPS"
+static const uint32 ParameterStreamVersion = 2;
+
+FParameterStreamEvent::FParameterStreamEvent()
+	: Type(EType::UpdateParameters)
+	, Time(0.0)
+	, RenderTargetSize(FIntPoint::ZeroValue)
+	, StartColor(FColor::White)
+	, EndColor(FColor::White)
+	, SimulationState(1.0f)
+	, ComputeShaderBlend(0.0f)
+	, ComputeRadius(1.0f)
+	, VertexOffset(FVector2D::ZeroVector)
+	, VertexTint(FLinearColor::White)
+	, ComputeResolutionScale(1.0f)
+	, bUseFlipbook(false)
+	, SampleType(EShaderTestSampleType::ComputeAndPixel)
+{
+}
+
+FParameterStreamEvent FParameterStreamEvent::MakeUpdate(double Time, const FShaderUsageExampleParameters& DrawParameters)
+{
+	FParameterStreamEvent Event;
+	Event.Type = EType::UpdateParameters;
+	Event.Time = Time;
+	Event.RenderTargetSize = DrawParameters.GetRenderTargetSize();
+	Event.StartColor = DrawParameters.StartColor;
+	Event.EndColor = DrawParameters.EndColor;
+	Event.SimulationState = DrawParameters.SimulationState;
+	Event.ComputeShaderBlend = DrawParameters.ComputeShaderBlend;
+	Event.ComputeRadius = DrawParameters.ComputeRadius;
+	Event.VertexOffset = DrawParameters.VertexOffset;
+	Event.VertexTint = DrawParameters.VertexTint;
+	Event.ComputeResolutionScale = DrawParameters.ComputeResolutionScale;
+	Event.bUseFlipbook = DrawParameters.bUseFlipbook;
+	return Event;
+}
+
+FParameterStreamEvent FParameterStreamEvent::MakeDraw(double Time, EShaderTestSampleType SampleType)
+{
+	FParameterStreamEvent Event;
+	Event.Type = EType::DrawTarget;
+	Event.Time = Time;
+	Event.SampleType = SampleType;
+	return Event;
+}
+
+FShaderUsageExampleParameters FParameterStreamEvent::ToDrawParameters(UTextureRenderTarget2D* RenderTarget) const
+{
+	FShaderUsageExampleParameters DrawParameters(RenderTarget);
+	CopyTo(DrawParameters);
+	return DrawParameters;
+}
+
+FShaderUsageExampleParameters FParameterStreamEvent::ToDrawParameters() const
+{
+	FShaderUsageExampleParameters DrawParameters(RenderTargetSize);
+	CopyTo(DrawParameters);
+	return DrawParameters;
+}
+
+void FParameterStreamEvent::CopyTo(FShaderUsageExampleParameters& DrawParameters) const
+{
+	DrawParameters.StartColor = StartColor;
+	DrawParameters.EndColor = EndColor;
+	DrawParameters.SimulationState = SimulationState;
+	DrawParameters.ComputeShaderBlend = ComputeShaderBlend;
+	DrawParameters.ComputeRadius = ComputeRadius;
+	DrawParameters.VertexOffset = VertexOffset;
+	DrawParameters.VertexTint = VertexTint;
+	DrawParameters.ComputeResolutionScale = ComputeResolutionScale;
+	DrawParameters.bUseFlipbook = bUseFlipbook;
+}
+
+FArchive& operator<<(FArchive& Ar, FParameterStreamEvent& Event)
+{
+	uint8 Type = (uint8)Event.Type;
+	Ar << Type;
+	Event.Type = (FParameterStreamEvent::EType)Type;
+	Ar << Event.Time;
+
+	if (Event.Type == FParameterStreamEvent::EType::UpdateParameters)
+	{
+		uint8 bUseFlipbook = Event.bUseFlipbook ? 1 : 0;
+		Ar << Event.RenderTargetSize;
+		Ar << Event.StartColor;
+		Ar << Event.EndColor;
+		Ar << Event.SimulationState;
+		Ar << Event.ComputeShaderBlend;
+		Ar << Event.ComputeRadius;
+		Ar << Event.VertexOffset;
+		Ar << Event.VertexTint;
+		Ar << Event.ComputeResolutionScale;
+		Ar << bUseFlipbook;
+		Event.bUseFlipbook = bUseFlipbook != 0;
+	}
+	else
+	{
+		uint8 SampleType = (uint8)Event.SampleType;
+		Ar << SampleType;
+		Event.SampleType = (EShaderTestSampleType)SampleType;
+	}
+
+	return Ar;
+}
+
+FParameterStreamWriter::~FParameterStreamWriter()
+{
+	Close();
+}
+
+bool FParameterStreamWriter::Open(const FString& InFilename)
+{
+	Close();
+
+	Archive.Reset(IFileManager::Get().CreateFileWriter(*InFilename));
+	if (!Archive.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to open %s for recording."), *InFilename);
+		return false;
+	}
+
+	uint32 Magic = ParameterStreamMagic;
+	uint32 Version = ParameterStreamVersion;
+	*Archive << Magic;
+	*Archive << Version;
+
+	Filename = InFilename;
+	StartTime = FPlatformTime::Seconds();
+	NumEvents = 0;
+	return true;
+}
+
+void FParameterStreamWriter::Close()
+{
+	if (!Archive.IsValid())
+	{
+		return;
+	}
+
+	Archive->Close();
+	Archive.Reset();
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Recorded %d parameter stream events to %s."), NumEvents, *Filename);
+}
+
+void FParameterStreamWriter::AppendUpdate(const FShaderUsageExampleParameters& DrawParameters)
+{
+	check(IsOpen());
+
+	FParameterStreamEvent Event = FParameterStreamEvent::MakeUpdate(FPlatformTime::Seconds() - StartTime, DrawParameters);
+	*Archive << Event;
+	NumEvents++;
+}
+
+void FParameterStreamWriter::AppendDraw(EShaderTestSampleType SampleType)
+{
+	check(IsOpen());
+
+	FParameterStreamEvent Event = FParameterStreamEvent::MakeDraw(FPlatformTime::Seconds() - StartTime, SampleType);
+	*Archive << Event;
+	NumEvents++;
+}
+
+bool FParameterStreamReader::Load(const FString& Filename, TArray<FParameterStreamEvent>& OutEvents)
+{
+	OutEvents.Reset();
+
+	TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileReader(*Filename));
+	if (!Archive.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to open parameter stream %s."), *Filename);
+		return false;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	*Archive << Magic;
+	*Archive << Version;
+	if (Magic != ParameterStreamMagic || Version != ParameterStreamVersion)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("%s is not a version %u parameter stream."), *Filename, ParameterStreamVersion);
+		return false;
+	}
+
+	while (!Archive->AtEnd() && !Archive->IsError())
+	{
+		FParameterStreamEvent Event;
+		*Archive << Event;
+		if (!Archive->IsError())
+		{
+			OutEvents.Add(Event);
+		}
+	}
+
+	// A recording that was cut short (for example by a crash) is still useful up to the last complete event.
+	if (Archive->IsError())
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("Parameter stream %s is truncated, replaying the first %d events."), *Filename, OutEvents.Num());
+	}
+
+	return OutEvents.Num() > 0;
+}
+
+UTextureRenderTarget2D* FParameterStreamReplay::FindOrCreateRenderTarget(const FIntPoint& Size)
+{
+	if (UTextureRenderTarget2D** Existing = RenderTargets.Find(Size))
+	{
+		return *Existing;
+	}
+
+	UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>();
+	RenderTarget->AddToRoot();
+	RenderTarget->InitCustomFormat(Size.X, Size.Y, PF_R8G8B8A8, true);
+	RenderTarget->UpdateResourceImmediate(true);
+	RenderTargets.Add(Size, RenderTarget);
+	return RenderTarget;
+}
+
+void FParameterStreamReplay::ReleaseRenderTargets()
+{
+	for (const TPair<FIntPoint, UTextureRenderTarget2D*>& Pair : RenderTargets)
+	{
+		Pair.Value->RemoveFromRoot();
+	}
+	RenderTargets.Reset();
+}
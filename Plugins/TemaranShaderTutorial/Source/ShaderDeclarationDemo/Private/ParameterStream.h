@@ -0,0 +1,125 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "ParticleSimulation.h"
+
+class UTextureRenderTarget2D;
+class FParticleSimulationReference;
+class FShaderPluginContext;
+
+// One UpdateParameters or DrawTarget call, as it was made during play.
+struct FParameterStreamEvent
+{
+	enum class EType : uint8
+	{
+		UpdateParameters,
+		DrawTarget,
+	};
+
+	EType Type;
+	double Time; // Seconds since the recording started
+
+	// Only used by UpdateParameters events. The render target itself can't be recorded, so we keep its size instead.
+	FIntPoint RenderTargetSize;
+	FColor StartColor;
+	FColor EndColor;
+	float SimulationState;
+	float ComputeShaderBlend;
+	float ComputeRadius;
+	FVector2D VertexOffset;
+	FLinearColor VertexTint;
+	float ComputeResolutionScale;
+	bool bUseFlipbook;
+
+	// Only used by DrawTarget events.
+	EShaderTestSampleType SampleType;
+
+	FParameterStreamEvent();
+
+	static FParameterStreamEvent MakeUpdate(double Time, const FShaderUsageExampleParameters& DrawParameters);
+	static FParameterStreamEvent MakeDraw(double Time, EShaderTestSampleType SampleType);
+
+	// Rebuilds the parameters for this event, drawing to RenderTarget instead of the one that was used during recording.
+	FShaderUsageExampleParameters ToDrawParameters(UTextureRenderTarget2D* RenderTarget) const;
+
+	// Same as above, but without a render target. The parameters keep the size of the one that was recorded.
+	FShaderUsageExampleParameters ToDrawParameters() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FParameterStreamEvent& Event);
+
+private:
+	void CopyTo(FShaderUsageExampleParameters& DrawParameters) const;
+};
+
+/*
+ * Appends events to a parameter stream file. The file is a small header followed by the events back to back, so
+ * recording is just a buffered write per call and there is nothing to fix up when we stop.
+ */
+class FParameterStreamWriter
+{
+public:
+	FParameterStreamWriter() : StartTime(0.0), NumEvents(0) { }
+	~FParameterStreamWriter();
+
+	bool Open(const FString& Filename);
+	void Close();
+	bool IsOpen() const { return Archive.IsValid(); }
+
+	void AppendUpdate(const FShaderUsageExampleParameters& DrawParameters);
+	void AppendDraw(EShaderTestSampleType SampleType);
+
+	int32 GetNumEvents() const { return NumEvents; }
+
+private:
+	TUniquePtr<FArchive> Archive;
+	FString Filename;
+	double StartTime;
+	int32 NumEvents;
+};
+
+class FParameterStreamReader
+{
+public:
+	// Reads a whole parameter stream file. Returns false if the file is missing, truncated or from another version.
+	static bool Load(const FString& Filename, TArray<FParameterStreamEvent>& OutEvents);
+};
+
+// Everything the module needs to keep around while a recording is being played back.
+struct FParameterStreamReplay
+{
+	TArray<FParameterStreamEvent> Events;
+	int32 NextEvent = 0;
+	bool bRealTime = false;
+	bool bUseCPU = false; // Draws go through FComputeShaderReference or FParticleSimulationReference instead of the GPU
+	bool bExitWhenDone = false;
+
+	double ReplayTime = 0.0; // Only advanced in real time mode
+	double StartWallTime = 0.0;
+	int32 NumDraws = 0;
+	int32 NumSkippedDraws = 0;
+	uint32 LoggedSkippedSampleTypes = 0; // One bit per EShaderTestSampleType, so each one is only warned about once
+
+	FParameterStreamEvent CurrentParameters;
+	bool bHasParameters = false;
+
+	// Stand-ins for the render targets used while recording, one per size. Rooted until the replay ends.
+	TMap<FIntPoint, UTextureRenderTarget2D*> RenderTargets;
+
+	// GPU draws go through a context of their own, so they don't share resources with the worlds that are running.
+	TSharedPtr<FShaderPluginContext> Context;
+
+	// Scratch output for the CPU back-end.
+	TArray<FColor> CPUPixels;
+
+	// The particles are stepped on the CPU like FParticleSimulation steps them on the GPU.
+	TSharedPtr<FParticleSimulationReference> CPUParticles;
+	FParticleSimulationClock CPUParticleClock;
+
+	UTextureRenderTarget2D* FindOrCreateRenderTarget(const FIntPoint& Size);
+	void ReleaseRenderTargets();
+};
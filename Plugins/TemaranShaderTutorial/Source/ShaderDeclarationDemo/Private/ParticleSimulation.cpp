@@ -0,0 +1,325 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ParticleSimulation.h"
+
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTrace.h"
+#include "VertexFromCSExample.h"
+
+#include "GlobalShader.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderGraphUtils.h"
+#include "RHICommandList.h"
+#include "ShaderParameterStruct.h"
+
+static TAutoConsoleVariable<int32> CVarParticlesMax(
+	TEXT("r.ShaderPlugin.Particles.Max"),
+	1 << 20,
+	TEXT("Number of particle slots. The simulation always runs over all of them, so this sets the cost per frame.\n")
+	TEXT("Changing it restarts the simulation. Clamped to 4194240, the most one dispatch can cover."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarParticlesSpawnRate(
+	TEXT("r.ShaderPlugin.Particles.SpawnRate"),
+	1 << 18,
+	TEXT("Particles spawned per second. Spawns are dropped while every slot is in use."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarParticlesLifetime(
+	TEXT("r.ShaderPlugin.Particles.Lifetime"),
+	3.0f,
+	TEXT("Longest lifetime of a particle in seconds. Each particle lives between half of this and all of it."),
+	ECVF_RenderThreadSafe);
+
+// See FParticleSimulationClock
+#define MAX_PARTICLE_DELTA_TIME 0.1f
+
+BEGIN_SHADER_PARAMETER_STRUCT(FParticleSimulationParameters, )
+	SHADER_PARAMETER_SRV(StructuredBuffer<FParticle>, StateIn)
+	SHADER_PARAMETER_UAV(RWStructuredBuffer<FParticle>, StateOut)
+	SHADER_PARAMETER_UAV(RWBuffer<uint>, FreeList)
+	SHADER_PARAMETER_UAV(RWBuffer<int>, FreeListCount)
+	SHADER_PARAMETER_UAV(RWBuffer<float>, VertexPosition)
+	SHADER_PARAMETER_UAV(RWBuffer<float>, VertexColor)
+	SHADER_PARAMETER(uint32, MaxParticles)
+	SHADER_PARAMETER(uint32, NumToSpawn)
+	SHADER_PARAMETER(uint32, SpawnSeed)
+	SHADER_PARAMETER(float, DeltaTime)
+	SHADER_PARAMETER(FVector, EmitterPosition)
+	SHADER_PARAMETER(float, SpawnSpeed)
+	SHADER_PARAMETER(FVector, Gravity)
+	SHADER_PARAMETER(float, SpawnConeAngle)
+	SHADER_PARAMETER(float, ParticleLifetime)
+	SHADER_PARAMETER(float, FloorHeight)
+	SHADER_PARAMETER(float, Restitution)
+	SHADER_PARAMETER_STRUCT_REF(FShaderPluginTargetParameters, ShaderPluginTarget) // StartColor, EndColor
+END_SHADER_PARAMETER_STRUCT()
+
+class FParticleSimulationCS : public FGlobalShader
+{
+public:
+	enum { ThreadGroupSize = 64 };
+
+	FParticleSimulationCS() { }
+	FParticleSimulationCS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) { }
+
+	// The free list relies on atomics on typed buffers, which we only rely on having with SM5.
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_X"), ThreadGroupSize);
+	}
+};
+
+class FParticleResetCS : public FParticleSimulationCS
+{
+public:
+	DECLARE_GLOBAL_SHADER(FParticleResetCS);
+	using FParameters = FParticleSimulationParameters;
+	SHADER_USE_PARAMETER_STRUCT(FParticleResetCS, FParticleSimulationCS);
+};
+
+class FParticleUpdateCS : public FParticleSimulationCS
+{
+public:
+	DECLARE_GLOBAL_SHADER(FParticleUpdateCS);
+	using FParameters = FParticleSimulationParameters;
+	SHADER_USE_PARAMETER_STRUCT(FParticleUpdateCS, FParticleSimulationCS);
+};
+
+class FParticleSpawnCS : public FParticleSimulationCS
+{
+public:
+	DECLARE_GLOBAL_SHADER(FParticleSpawnCS);
+	using FParameters = FParticleSimulationParameters;
+	SHADER_USE_PARAMETER_STRUCT(FParticleSpawnCS, FParticleSimulationCS);
+};
+
+IMPLEMENT_GLOBAL_SHADER(FParticleResetCS, "/TutorialShaders/Private/ParticleSimulation.usf", "MainResetCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FParticleUpdateCS, "/TutorialShaders/Private/ParticleSimulation.usf", "MainUpdateCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FParticleSpawnCS, "/TutorialShaders/Private/ParticleSimulation.usf", "MainSpawnCS", SF_Compute);
+
+FParticleSimulationSettings FParticleSimulationSettings::FromConsoleVariables()
+{
+	FParticleSimulationSettings Settings;
+	Settings.MaxParticles = FMath::Clamp(CVarParticlesMax.GetValueOnAnyThread(), 1, (int32)MaxDispatchableParticles);
+	Settings.SpawnRate = FMath::Max(CVarParticlesSpawnRate.GetValueOnAnyThread(), 0.0f);
+	Settings.ParticleLifetime = FMath::Max(CVarParticlesLifetime.GetValueOnAnyThread(), 0.01f);
+	return Settings;
+}
+
+uint32 FParticleSpawner::Advance(const FParticleSimulationSettings& Settings, float DeltaTime, uint32& OutSpawnSeed)
+{
+	const float NumToSpawn = Settings.SpawnRate * DeltaTime + SpawnRemainder;
+	const uint32 WholeNumToSpawn = (uint32)FMath::Min(FMath::FloorToFloat(NumToSpawn), (float)Settings.MaxParticles);
+	SpawnRemainder = FMath::Frac(NumToSpawn);
+
+	OutSpawnSeed = SpawnSeed++;
+	return WholeNumToSpawn;
+}
+
+float FParticleSimulationClock::Advance(float SimulationState)
+{
+	const float DeltaTime = bHasSimulationState ? FMath::Clamp(SimulationState - LastSimulationState, 0.0f, MAX_PARTICLE_DELTA_TIME) : 0.0f;
+	LastSimulationState = SimulationState;
+	bHasSimulationState = true;
+	return DeltaTime;
+}
+
+static FParticleSimulationParameters MakeParticleSimulationParameters(const FParticleSimulationSettings& Settings, float DeltaTime, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer)
+{
+	FParticleSimulationParameters Parameters;
+	Parameters.MaxParticles = Settings.MaxParticles;
+	Parameters.NumToSpawn = 0;
+	Parameters.SpawnSeed = 0;
+	Parameters.DeltaTime = DeltaTime;
+	Parameters.EmitterPosition = Settings.EmitterPosition;
+	Parameters.SpawnSpeed = Settings.SpawnSpeed;
+	Parameters.Gravity = Settings.Gravity;
+	Parameters.SpawnConeAngle = Settings.SpawnConeAngle;
+	Parameters.ParticleLifetime = Settings.ParticleLifetime;
+	Parameters.FloorHeight = Settings.FloorHeight;
+	Parameters.Restitution = Settings.Restitution;
+	Parameters.ShaderPluginTarget = TargetUniformBuffer;
+	return Parameters;
+}
+
+FParticleSimulation::FParticleSimulation()
+	: CurrentState(0)
+	, MaxParticles(0)
+{
+}
+
+FParticleSimulation::~FParticleSimulation()
+{
+	Release_RenderThread();
+}
+
+void FParticleSimulation::Allocate_RenderThread(FRHICommandListImmediate& RHICmdList, int32 InMaxParticles, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer)
+{
+	SHADERPLUGIN_TRACE_SCOPE(ParticleAllocate);
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+
+	Release_RenderThread();
+
+	MaxParticles = InMaxParticles;
+	StateBuffers[0].Initialize(sizeof(FParticleState), MaxParticles);
+	StateBuffers[1].Initialize(sizeof(FParticleState), MaxParticles);
+	FreeList.Initialize(sizeof(uint32), MaxParticles, PF_R32_UINT);
+	FreeListCount.Initialize(sizeof(int32), 1, PF_R32_SINT);
+	VertexPositionBuffer.Initialize(sizeof(float), MaxParticles * 4, PF_R32_FLOAT);
+	VertexColorBuffer.Initialize(sizeof(float), MaxParticles * 4, PF_R32_FLOAT);
+	CurrentState = 0;
+	Spawner = FParticleSpawner();
+
+	FShaderPluginMemory::TrackAllocation(EShaderPluginResource::ParticleBuffers, NAME_None, GetAllocatedBytes());
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated, 6);
+
+	// Everything starts out dead, on the GPU, so a million particles don't cost us a million particle upload.
+	TShaderMapRef<FParticleResetCS> ResetShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	static_assert(FParticleSimulationSettings::MaxDispatchableParticles / FParticleSimulationCS::ThreadGroupSize <= 65535, "MaxDispatchableParticles doesn't fit in one dispatch.");
+	const FIntVector GroupCount(FMath::DivideAndRoundUp(MaxParticles, (int32)FParticleSimulationCS::ThreadGroupSize), 1, 1);
+
+	for (int32 StateIndex = 0; StateIndex < 2; StateIndex++)
+	{
+		FParticleSimulationParameters Parameters = MakeParticleSimulationParameters(FParticleSimulationSettings(), 0.0f, TargetUniformBuffer);
+		Parameters.MaxParticles = MaxParticles;
+		Parameters.StateOut = StateBuffers[StateIndex].UAV;
+		Parameters.FreeList = FreeList.UAV;
+		Parameters.FreeListCount = FreeListCount.UAV;
+		Parameters.VertexPosition = VertexPositionBuffer.UAV;
+		Parameters.VertexColor = VertexColorBuffer.UAV;
+
+		FComputeShaderUtils::Dispatch(RHICmdList, *ResetShader, Parameters, GroupCount);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	}
+}
+
+void FParticleSimulation::Release_RenderThread()
+{
+	if (MaxParticles == 0)
+	{
+		return;
+	}
+
+	FShaderPluginMemory::TrackFree(EShaderPluginResource::ParticleBuffers, NAME_None, GetAllocatedBytes());
+
+	StateBuffers[0].Release();
+	StateBuffers[1].Release();
+	FreeList.Release();
+	FreeListCount.Release();
+	VertexPositionBuffer.Release();
+	VertexColorBuffer.Release();
+	MaxParticles = 0;
+}
+
+int64 FParticleSimulation::GetAllocatedBytes() const
+{
+	return (int64)MaxParticles * (sizeof(FParticleState) * 2 + sizeof(uint32) + sizeof(float) * 8) + sizeof(int32);
+}
+
+void FParticleSimulation::Simulate_RenderThread(FRHICommandListImmediate& RHICmdList, const FParticleSimulationSettings& Settings, float DeltaTime, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer)
+{
+	check(IsInRenderingThread());
+	check(Settings.MaxParticles > 0 && Settings.MaxParticles <= FParticleSimulationSettings::MaxDispatchableParticles);
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_ParticleSimulate); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_ParticleSimulate); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(ParticleSimulate); // Used to show our work next to the engine's in Unreal Insights
+
+	if (MaxParticles != Settings.MaxParticles)
+	{
+		Allocate_RenderThread(RHICmdList, Settings.MaxParticles, TargetUniformBuffer);
+	}
+
+	uint32 SpawnSeed = 0;
+	const uint32 NumToSpawn = Spawner.Advance(Settings, DeltaTime, SpawnSeed);
+
+	const int32 PreviousState = CurrentState;
+	CurrentState ^= 1;
+
+	FParticleSimulationParameters Parameters = MakeParticleSimulationParameters(Settings, DeltaTime, TargetUniformBuffer);
+	Parameters.StateIn = StateBuffers[PreviousState].SRV;
+	Parameters.StateOut = StateBuffers[CurrentState].UAV;
+	Parameters.FreeList = FreeList.UAV;
+	Parameters.FreeListCount = FreeListCount.UAV;
+	Parameters.VertexPosition = VertexPositionBuffer.UAV;
+	Parameters.VertexColor = VertexColorBuffer.UAV;
+	Parameters.NumToSpawn = NumToSpawn;
+	Parameters.SpawnSeed = SpawnSeed;
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, StateBuffers[PreviousState].UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, StateBuffers[CurrentState].UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, FreeList.UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, FreeListCount.UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, VertexPositionBuffer.UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, VertexColorBuffer.UAV);
+
+	auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+	{
+		// Every slot, alive or not, so the cost doesn't depend on how many particles there are.
+		TShaderMapRef<FParticleUpdateCS> UpdateShader(ShaderMap);
+		FComputeShaderUtils::Dispatch(RHICmdList, *UpdateShader, Parameters, FIntVector(FMath::DivideAndRoundUp(MaxParticles, (int32)FParticleSimulationCS::ThreadGroupSize), 1, 1));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	}
+
+	if (NumToSpawn > 0)
+	{
+		// The spawn pass takes slots off the free list the update pass just pushed dead particles onto.
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, StateBuffers[CurrentState].UAV);
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, FreeList.UAV);
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, FreeListCount.UAV);
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, VertexPositionBuffer.UAV);
+		RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, VertexColorBuffer.UAV);
+
+		TShaderMapRef<FParticleSpawnCS> SpawnShader(ShaderMap);
+		FComputeShaderUtils::Dispatch(RHICmdList, *SpawnShader, Parameters, FIntVector(FMath::DivideAndRoundUp(NumToSpawn, (uint32)FParticleSimulationCS::ThreadGroupSize), 1, 1));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	}
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, VertexPositionBuffer.UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, VertexColorBuffer.UAV);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::VerticesGenerated, MaxParticles);
+}
+
+void FParticleSimulation::Draw_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer)
+{
+	if (MaxParticles == 0)
+	{
+		return;
+	}
+
+	FComputeShaderVertexOutputStruct VertexOutput;
+	VertexOutput.PositionVB = VertexPositionBuffer.Buffer;
+	VertexOutput.ColorVB = VertexColorBuffer.Buffer;
+	FVertexFromCSExample::DrawPointsToRenderTarget_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer, VertexOutput, MaxParticles);
+}
+
+void FParticleSimulation::ReadState_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FParticleState>& OutParticles)
+{
+	check(IsInRenderingThread());
+	SHADERPLUGIN_TRACE_SCOPE(ParticleReadback);
+
+	OutParticles.Reset();
+	if (MaxParticles == 0)
+	{
+		return;
+	}
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, StateBuffers[CurrentState].UAV);
+	RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+
+	const uint32 NumBytes = MaxParticles * sizeof(FParticleState);
+	OutParticles.SetNumUninitialized(MaxParticles);
+	const void* Data = RHILockStructuredBuffer(StateBuffers[CurrentState].Buffer, 0, NumBytes, RLM_ReadOnly);
+	FMemory::Memcpy(OutParticles.GetData(), Data, NumBytes);
+	RHIUnlockStructuredBuffer(StateBuffers[CurrentState].Buffer);
+}
@@ -0,0 +1,120 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "RHIResources.h"
+#include "RenderResource.h"
+#include "ShaderPluginTargetParameters.h"
+
+// Everything that decides how the particles move. Positions are in clip space, so the emitter sits in the lower half
+// of the render target and the particles fall back down onto the floor at the bottom.
+struct FParticleSimulationSettings
+{
+	// Every pass runs one thread per slot in a 1D dispatch of 64 thread groups, and a dispatch can have at most 65535 groups
+	// along each dimension.
+	enum { MaxDispatchableParticles = 65535 * 64 };
+
+	int32 MaxParticles; // At most MaxDispatchableParticles
+	float SpawnRate; // Particles per second
+	float ParticleLifetime; // Seconds. Each particle lives between half of this and all of it.
+	FVector EmitterPosition;
+	FVector Gravity;
+	float SpawnSpeed;
+	float SpawnConeAngle; // Radians, centered on straight up
+	float FloorHeight;
+	float Restitution;
+
+	FParticleSimulationSettings()
+		: MaxParticles(1 << 20)
+		, SpawnRate(1 << 18)
+		, ParticleLifetime(3.0f)
+		, EmitterPosition(0.0f, -0.5f, 0.0f)
+		, Gravity(0.0f, -1.5f, 0.0f)
+		, SpawnSpeed(1.5f)
+		, SpawnConeAngle(0.8f)
+		, FloorHeight(-0.9f)
+		, Restitution(0.5f)
+	{
+	}
+
+	// Reads r.ShaderPlugin.Particles.*
+	static FParticleSimulationSettings FromConsoleVariables();
+};
+
+// Hands out the number of particles to spawn each step, carrying fractions over to the next one. The GPU simulation and
+// the CPU reference both use it, so given the same steps they spawn the same particles.
+struct FParticleSpawner
+{
+	float SpawnRemainder = 0.0f;
+	uint32 SpawnSeed = 0;
+
+	// Returns how many particles to spawn this step, and the seed to spawn them with.
+	uint32 Advance(const FParticleSimulationSettings& Settings, float DeltaTime, uint32& OutSpawnSeed);
+};
+
+// Turns the SimulationState of consecutive draws into simulation steps. Large jumps are clamped, so a hitch doesn't throw
+// every particle through the floor.
+struct FParticleSimulationClock
+{
+	float LastSimulationState = 0.0f;
+	bool bHasSimulationState = false;
+
+	float Advance(float SimulationState);
+};
+
+// One particle, exactly as it is laid out in the state buffers. Must match FParticle in ParticleSimulation.usf.
+struct FParticleState
+{
+	FVector Position;
+	float Age;
+	FVector Velocity;
+	float Lifetime; // 0 for dead slots
+};
+
+static_assert(sizeof(FParticleState) == 32, "FParticleState must match FParticle in ParticleSimulation.usf");
+
+/**************************************************************************************/
+/* A GPU particle simulation with a fixed number of slots. The state is ping-ponged   */
+/* between two structured buffers and integrated by a compute shader every step. The  */
+/* particles are drawn as points with the vertex sample's shaders. Render thread only.*/
+/**************************************************************************************/
+class FParticleSimulation
+{
+public:
+	FParticleSimulation();
+	~FParticleSimulation();
+
+	// Allocates the buffers on the first call, and again whenever MaxParticles changes, which also kills every particle.
+	void Simulate_RenderThread(FRHICommandListImmediate& RHICmdList, const FParticleSimulationSettings& Settings, float DeltaTime, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer);
+
+	// Draws every slot as a point. Dead slots are clipped by the vertex shader.
+	void Draw_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer);
+
+	// Copies the current state back to the CPU. This stalls until the GPU is done, it is meant for validation only.
+	void ReadState_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FParticleState>& OutParticles);
+
+	void Release_RenderThread();
+
+	int32 GetMaxParticles() const { return MaxParticles; }
+
+	// Follows the SimulationState of the draws when the simulation is stepped once per draw.
+	FParticleSimulationClock Clock;
+
+private:
+	void Allocate_RenderThread(FRHICommandListImmediate& RHICmdList, int32 InMaxParticles, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer);
+	int64 GetAllocatedBytes() const;
+
+	FRWBufferStructured StateBuffers[2];
+	int32 CurrentState; // Index of the buffer holding the latest state
+	FRWBuffer FreeList;
+	FRWBuffer FreeListCount;
+	FRWBuffer VertexPositionBuffer;
+	FRWBuffer VertexColorBuffer;
+	int32 MaxParticles;
+
+	FParticleSpawner Spawner;
+};
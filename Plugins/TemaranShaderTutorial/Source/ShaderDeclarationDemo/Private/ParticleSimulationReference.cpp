@@ -0,0 +1,122 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ParticleSimulationReference.h"
+
+#include "Async/ParallelFor.h"
+
+// Keep these in sync with ParticleHash and ParticleRandom.
+static uint32 ParticleHash(uint32 x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static float ParticleRandom(uint32 x)
+{
+	return (float)(ParticleHash(x) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Slots are integrated in chunks, one ParallelFor task each.
+#define PARTICLE_REFERENCE_CHUNK_SIZE 16384
+
+FParticleSimulationReference::FParticleSimulationReference(const FParticleSimulationSettings& InSettings)
+	: Settings(InSettings)
+{
+	Particles.SetNumZeroed(Settings.MaxParticles);
+	DiedThisStep.SetNumZeroed(Settings.MaxParticles);
+
+	// Same order as MainResetCS, the top of the stack is slot 0.
+	FreeList.SetNumUninitialized(Settings.MaxParticles);
+	for (int32 Index = 0; Index < Settings.MaxParticles; Index++)
+	{
+		FreeList[Index] = Settings.MaxParticles - 1 - Index;
+	}
+}
+
+void FParticleSimulationReference::Step(float DeltaTime)
+{
+	// MainUpdateCS
+	const int32 NumChunks = FMath::DivideAndRoundUp(Particles.Num(), PARTICLE_REFERENCE_CHUNK_SIZE);
+	ParallelFor(NumChunks, [this, DeltaTime](int32 ChunkIndex)
+	{
+		const int32 Start = ChunkIndex * PARTICLE_REFERENCE_CHUNK_SIZE;
+		const int32 End = FMath::Min(Start + PARTICLE_REFERENCE_CHUNK_SIZE, Particles.Num());
+		for (int32 Slot = Start; Slot < End; Slot++)
+		{
+			FParticleState& Particle = Particles[Slot];
+			DiedThisStep[Slot] = 0;
+			if (Particle.Lifetime <= 0.0f)
+			{
+				continue;
+			}
+
+			Particle.Age += DeltaTime;
+			if (Particle.Age >= Particle.Lifetime)
+			{
+				FMemory::Memzero(Particle);
+				DiedThisStep[Slot] = 1;
+				continue;
+			}
+
+			Particle.Velocity += Settings.Gravity * DeltaTime;
+			Particle.Position += Particle.Velocity * DeltaTime;
+
+			if (Particle.Position.Y < Settings.FloorHeight)
+			{
+				Particle.Position.Y = Settings.FloorHeight + (Settings.FloorHeight - Particle.Position.Y) * Settings.Restitution;
+				Particle.Velocity.Y = -Particle.Velocity.Y * Settings.Restitution;
+			}
+		}
+	});
+
+	// The GPU pushes dead slots in whatever order its threads get there, we just go in slot order.
+	for (int32 Slot = 0; Slot < DiedThisStep.Num(); Slot++)
+	{
+		if (DiedThisStep[Slot])
+		{
+			FreeList.Push(Slot);
+		}
+	}
+
+	// MainSpawnCS
+	uint32 SpawnSeed = 0;
+	const uint32 NumToSpawn = Spawner.Advance(Settings, DeltaTime, SpawnSeed);
+	const uint32 SeedHash = ParticleHash(SpawnSeed);
+
+	for (uint32 SpawnIndex = 0; SpawnIndex < NumToSpawn && FreeList.Num() > 0; SpawnIndex++)
+	{
+		const uint32 Key = ParticleHash(SpawnIndex ^ SeedHash);
+		const float Angle = (ParticleRandom(Key) - 0.5f) * Settings.SpawnConeAngle;
+		const float Speed = Settings.SpawnSpeed * (0.75f + 0.25f * ParticleRandom(Key + 1));
+
+		FParticleState& Particle = Particles[FreeList.Pop(false)];
+		Particle.Position = Settings.EmitterPosition;
+		Particle.Age = 0.0f;
+		Particle.Velocity = FVector(FMath::Sin(Angle) * Speed, FMath::Cos(Angle) * Speed, 0.0f);
+		Particle.Lifetime = Settings.ParticleLifetime * (0.5f + 0.5f * ParticleRandom(Key + 2));
+	}
+}
+
+void FParticleSimulationReference::GetSortedLiveParticles(const TArray<FParticleState>& InParticles, TArray<FParticleState>& OutLiveParticles)
+{
+	OutLiveParticles.Reset();
+	for (const FParticleState& Particle : InParticles)
+	{
+		if (Particle.Lifetime > 0.0f)
+		{
+			OutLiveParticles.Add(Particle);
+		}
+	}
+
+	// Lifetimes come from 24 random bits, so ties are rare. Age breaks most of the ones that do happen.
+	OutLiveParticles.Sort([](const FParticleState& A, const FParticleState& B)
+	{
+		return A.Lifetime != B.Lifetime ? A.Lifetime < B.Lifetime : A.Age < B.Age;
+	});
+}
@@ -0,0 +1,35 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ParticleSimulation.h"
+
+/**************************************************************************************/
+/* A CPU port of ParticleSimulation.usf. Given the same settings and steps it spawns  */
+/* and moves the same particles as FParticleSimulation, so it can be used to validate */
+/* the GPU version, and to run the simulation where there is no GPU at all.           */
+/**************************************************************************************/
+class FParticleSimulationReference
+{
+public:
+	explicit FParticleSimulationReference(const FParticleSimulationSettings& InSettings);
+
+	void Step(float DeltaTime);
+
+	const TArray<FParticleState>& GetParticles() const { return Particles; }
+	int32 GetNumAlive() const { return Particles.Num() - FreeList.Num(); }
+
+	// The spawned particles only depend on the spawn index and seed, but which slot they end up in doesn't. Sorting the
+	// live particles by their lifetime makes the GPU and CPU results comparable one to one.
+	static void GetSortedLiveParticles(const TArray<FParticleState>& InParticles, TArray<FParticleState>& OutLiveParticles);
+
+private:
+	FParticleSimulationSettings Settings;
+	FParticleSpawner Spawner;
+	TArray<FParticleState> Particles;
+	TArray<int32> FreeList;
+	TArray<uint8> DiedThisStep;
+};
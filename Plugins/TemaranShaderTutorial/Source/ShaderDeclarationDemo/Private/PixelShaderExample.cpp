@@ -3,6 +3,8 @@
 ///////////////////////////////////////////////////////////////////////////////////////
 
 #include "PixelShaderExample.h"
+#include "FractalFlipbook.h"
+#include "ShaderPluginTrace.h"
 #include "ShaderParameterUtils.h"
 #include "RHIStaticStates.h"
 #include "Shader.h"
@@ -61,6 +63,14 @@ public:
 		return true;
 	}
 
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		// PixelShader.usf includes BufferLayout.ush for the pixel shader, but the whole file is compiled for us too.
+		OutEnvironment.SetDefine(TEXT("BUFFER_LAYOUT_TILE_SIZE"), BUFFER_LAYOUT_TILE_SIZE);
+	}
+
 	FSimplePassThroughVS() { }
 	FSimplePassThroughVS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)	{ }
 };
@@ -74,20 +84,54 @@ public:
 	DECLARE_GLOBAL_SHADER(FPixelShaderExamplePS);
 	SHADER_USE_PARAMETER_STRUCT(FPixelShaderExamplePS, FGlobalShader);
 
+	// When set, the compute shader component is sampled from a baked flipbook atlas instead of the compute shader output buffer.
+	class FUseFlipbookDim : SHADER_PERMUTATION_BOOL("USE_FLIPBOOK");
+	// When set, the compute shader ran at a lower resolution and its output texture is sampled with bilinear filtering.
+	class FUpscaleDim : SHADER_PERMUTATION_BOOL("USE_UPSCALE");
+	// Layout of ComputeShaderOutputBuffer, see EComputeBufferLayout.
+	class FBufferLayoutDim : SHADER_PERMUTATION_INT("BUFFER_LAYOUT", (int32)EComputeBufferLayout::Num);
+	using FPermutationDomain = TShaderPermutationDomain<FUseFlipbookDim, FUpscaleDim, FBufferLayoutDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER_TEXTURE(Texture2D<float4>, ComputeShaderOutput)
 		SHADER_PARAMETER_SRV(Buffer<float4>, ComputeShaderOutputBuffer)
-		SHADER_PARAMETER(FVector4, StartColor)
-		SHADER_PARAMETER(FVector4, EndColor)
-		SHADER_PARAMETER(FVector2D, TextureSize) // Metal doesn't support GetDimensions(), so we send in this data via our parameters.
-		SHADER_PARAMETER(float, BlendFactor)
+		SHADER_PARAMETER_SAMPLER(SamplerState, ComputeShaderOutputSampler)
+		SHADER_PARAMETER(FVector4, ComputeShaderOutputUVScaleClamp) // xy = UV scale, zw = max UV we can sample without leaving the computed texels
+		SHADER_PARAMETER(FVector2D, ComputeShaderOutputUVBias) // Added after the scale, see DrawToTexture_RenderThread
+		SHADER_PARAMETER_TEXTURE(Texture2D<float4>, FlipbookTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, FlipbookSampler)
+		SHADER_PARAMETER(FVector4, FlipbookFrameA) // xy = UV scale, zw = UV bias
+		SHADER_PARAMETER(FVector4, FlipbookFrameB)
+		SHADER_PARAMETER(float, FlipbookCrossfade)
+		SHADER_PARAMETER_STRUCT_REF(FShaderPluginTargetParameters, ShaderPluginTarget) // Colors, sizes and blend factor
 	END_SHADER_PARAMETER_STRUCT()
 
 public:
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
+		// A flipbook is always sampled at full resolution, so there is no point compiling the combination.
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		if (PermutationVector.Get<FUseFlipbookDim>() && PermutationVector.Get<FUpscaleDim>())
+		{
+			return false;
+		}
+
+		// Only the buffer path cares about the buffer layout.
+		const bool bReadsBuffer = !PermutationVector.Get<FUseFlipbookDim>() && !PermutationVector.Get<FUpscaleDim>();
+		if (!bReadsBuffer && PermutationVector.Get<FBufferLayoutDim>() != (int32)EComputeBufferLayout::Linear)
+		{
+			return false;
+		}
+
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::ES3_1);
 	}
+
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		OutEnvironment.SetDefine(TEXT("BUFFER_LAYOUT_TILE_SIZE"), BUFFER_LAYOUT_TILE_SIZE);
+	}
 };
 
 // This will tell the engine to create the shader and where the shader entry point is.
@@ -95,19 +139,21 @@ public:
 IMPLEMENT_GLOBAL_SHADER(FSimplePassThroughVS, "/TutorialShaders/Private/PixelShader.usf", "MainVertexShader", SF_Vertex);
 IMPLEMENT_GLOBAL_SHADER(FPixelShaderExamplePS, "/TutorialShaders/Private/PixelShader.usf", "MainPixelShader", SF_Pixel);
 
-void FPixelShaderExample::DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FTextureRHIRef ComputeShaderOutput, FShaderResourceViewRHIRef ComputeShaderOutputBuffer)
+// With DirtyRects set, the quad is drawn once per rectangle with a scissor around it, and the rest of the target is loaded
+// instead of cleared so it keeps what was drawn before.
+static void DrawFullscreenPass_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* RenderTargetTexture, const FPixelShaderExamplePS::FPermutationDomain& PermutationVector, const FPixelShaderExamplePS::FParameters& PassParameters, const TArray<FIntRect>& DirtyRects)
 {
-	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_PixelShader); // Used to gather CPU profiling data for the UE4 session frontend
-	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Pixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(DrawFullscreenPass);
 
-	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture());
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, RenderTargetTexture);
 
-	FRHIRenderPassInfo RenderPassInfo(DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture(), ERenderTargetActions::Clear_Store);
+	const bool bPartialUpdate = DirtyRects.Num() > 0;
+	FRHIRenderPassInfo RenderPassInfo(RenderTargetTexture, bPartialUpdate ? ERenderTargetActions::Load_Store : ERenderTargetActions::Clear_Store);
 	RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_OutputToRenderTarget"));
 
 	auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
 	TShaderMapRef<FSimplePassThroughVS> VertexShader(ShaderMap);
-	TShaderMapRef<FPixelShaderExamplePS> PixelShader(ShaderMap);
+	TShaderMapRef<FPixelShaderExamplePS> PixelShader(ShaderMap, PermutationVector);
 		
 	// Set the graphic pipeline state.
 	FGraphicsPipelineStateInitializer GraphicsPSOInit;
@@ -122,21 +168,96 @@ void FPixelShaderExample::DrawToRenderTarget_RenderThread(FRHICommandListImmedia
 	SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit);
 	
 	// Setup the pixel shader
-	FPixelShaderExamplePS::FParameters PassParameters; 
-	PassParameters.ComputeShaderOutput = ComputeShaderOutput;
-	PassParameters.ComputeShaderOutputBuffer = ComputeShaderOutputBuffer;
-	PassParameters.StartColor = FVector4(DrawParameters.StartColor.R, DrawParameters.StartColor.G, DrawParameters.StartColor.B, DrawParameters.StartColor.A) / 255.0f;
-	PassParameters.EndColor = FVector4(DrawParameters.EndColor.R, DrawParameters.EndColor.G, DrawParameters.EndColor.B, DrawParameters.EndColor.A) / 255.0f;
-	PassParameters.TextureSize = FVector2D(DrawParameters.GetRenderTargetSize().X, DrawParameters.GetRenderTargetSize().Y);
-	PassParameters.BlendFactor = DrawParameters.ComputeShaderBlend;	
 	SetShaderParameters(RHICmdList, *PixelShader, PixelShader->GetPixelShader(), PassParameters);
 	
 	// Draw
 	RHICmdList.SetStreamSource(0, GSimpleScreenVertexBuffer.VertexBufferRHI, 0);
-	RHICmdList.DrawPrimitive(0, 2, 1);
+	if (bPartialUpdate)
+	{
+		for (const FIntRect& Rect : DirtyRects)
+		{
+			RHICmdList.SetScissorRect(true, Rect.Min.X, Rect.Min.Y, Rect.Max.X, Rect.Max.Y);
+			RHICmdList.DrawPrimitive(0, 2, 1);
+			FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Draws);
+		}
+		RHICmdList.SetScissorRect(false, 0, 0, 0, 0);
+	}
+	else
+	{
+		RHICmdList.DrawPrimitive(0, 2, 1);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Draws);
+	}
 
 	RHICmdList.EndRenderPass();
 
 	// Resolve render target
-	//RHICmdList.CopyToResolveTarget(DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture(), DrawParameters.RenderTarget->GetRenderTargetResource()->TextureRHI, FResolveParams());
+	//RHICmdList.CopyToResolveTarget(RenderTargetTexture, RenderTargetTexture, FResolveParams());
+}
+
+void FPixelShaderExample::DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FIntPoint& ComputeSize, EComputeBufferLayout BufferLayout, FTextureRHIRef ComputeShaderOutput, FShaderResourceViewRHIRef ComputeShaderOutputBuffer, const TArray<FIntRect>& DirtyRects /*= TArray<FIntRect>()*/)
+{
+	DrawToTexture_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer, DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture(), ComputeSize, BufferLayout, ComputeShaderOutput, ComputeShaderOutputBuffer, DirtyRects);
+}
+
+void FPixelShaderExample::DrawToTexture_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FRHITexture* RenderTargetTexture, const FIntPoint& ComputeSize, EComputeBufferLayout BufferLayout, FTextureRHIRef ComputeShaderOutput, FShaderResourceViewRHIRef ComputeShaderOutputBuffer, const TArray<FIntRect>& DirtyRects /*= TArray<FIntRect>()*/)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_PixelShader); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Pixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+
+	const bool bUpscale = ComputeSize != DrawParameters.GetRenderTargetSize();
+
+	FPixelShaderExamplePS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FPixelShaderExamplePS::FUseFlipbookDim>(false);
+	PermutationVector.Set<FPixelShaderExamplePS::FUpscaleDim>(bUpscale);
+	PermutationVector.Set<FPixelShaderExamplePS::FBufferLayoutDim>(bUpscale ? (int32)EComputeBufferLayout::Linear : (int32)BufferLayout);
+
+	FPixelShaderExamplePS::FParameters PassParameters; 
+	PassParameters.ComputeShaderOutput = ComputeShaderOutput;
+	PassParameters.ComputeShaderOutputBuffer = ComputeShaderOutputBuffer;
+	PassParameters.ShaderPluginTarget = TargetUniformBuffer;
+
+	if (bUpscale)
+	{
+		// The output texture can be larger than what we computed this frame, so we only sample the part that was written.
+		const FIntVector OutputExtent = ComputeShaderOutput->GetSizeXYZ();
+		PassParameters.ComputeShaderOutputSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
+		PassParameters.ComputeShaderOutputUVScaleClamp = FVector4(
+			ComputeSize.X / (float)OutputExtent.X,
+			ComputeSize.Y / (float)OutputExtent.Y,
+			(ComputeSize.X - 0.5f) / OutputExtent.X,
+			(ComputeSize.Y - 0.5f) / OutputExtent.Y);
+
+		// Texel N of the compute output holds the fractal at N / ComputeSize, its corner, while the sampler treats it as the
+		// value at its center. Our pixel centers want the fractal at their own corner too, so we move back half a target
+		// pixel and forward half a compute texel, which lines the two grids up the way the full resolution path has them.
+		const FIntPoint TargetSize = DrawParameters.GetRenderTargetSize();
+		PassParameters.ComputeShaderOutputUVBias = FVector2D(
+			0.5f * (1.0f - ComputeSize.X / (float)TargetSize.X) / OutputExtent.X,
+			0.5f * (1.0f - ComputeSize.Y / (float)TargetSize.Y) / OutputExtent.Y);
+	}
+
+	DrawFullscreenPass_RenderThread(RHICmdList, RenderTargetTexture, PermutationVector, PassParameters, DirtyRects);
+}
+
+void FPixelShaderExample::DrawFlipbookToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FTextureRHIRef FlipbookTexture, const FFractalFlipbookSettings& FlipbookSettings, const TArray<FIntRect>& DirtyRects /*= TArray<FIntRect>()*/)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_PixelShaderFlipbook); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Pixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+
+	int32 FrameA, FrameB;
+	float Crossfade;
+	FFractalFlipbook::GetPlaybackFrames(FlipbookSettings, DrawParameters.SimulationState, FrameA, FrameB, Crossfade);
+
+	FPixelShaderExamplePS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FPixelShaderExamplePS::FUseFlipbookDim>(true);
+
+	FPixelShaderExamplePS::FParameters PassParameters;
+	PassParameters.FlipbookTexture = FlipbookTexture;
+	PassParameters.FlipbookSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
+	PassParameters.FlipbookFrameA = FFractalFlipbook::GetFrameScaleBias(FlipbookSettings, FrameA);
+	PassParameters.FlipbookFrameB = FFractalFlipbook::GetFrameScaleBias(FlipbookSettings, FrameB);
+	PassParameters.FlipbookCrossfade = Crossfade;
+	PassParameters.ShaderPluginTarget = TargetUniformBuffer;
+
+	DrawFullscreenPass_RenderThread(RHICmdList, DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture(), PermutationVector, PassParameters, DirtyRects);
 }
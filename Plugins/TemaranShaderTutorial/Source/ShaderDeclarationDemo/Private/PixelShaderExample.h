@@ -6,6 +6,8 @@
 
 #include "CoreMinimal.h"
 #include "ShaderDeclarationDemoModule.h"
+#include "ComputeShaderExample.h"
+#include "ShaderPluginTargetParameters.h"
 
 /**************************************************************************************/
 /* This is just an interface we use to keep all the pixel shading code in one file.   */
@@ -13,5 +15,16 @@
 class FPixelShaderExample
 {
 public:
-	static void DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FTextureRHIRef ComputeShaderOutput, FShaderResourceViewRHIRef ComputeShaderOutputBuffer);
+	// When ComputeSize is smaller than the render target, the compute shader output is upscaled with bilinear filtering
+	// from the ComputeShaderOutput texture. Otherwise it is read directly from ComputeShaderOutputBuffer.
+	// BufferLayout must be the layout the compute shader wrote ComputeShaderOutputBuffer with.
+	// TargetUniformBuffer is the same per frame uniform buffer the compute shader was dispatched with.
+	// When DirtyRects is set, only the pixels inside them are drawn and the rest of the target is kept as it was.
+	static void DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FIntPoint& ComputeSize, EComputeBufferLayout BufferLayout, FTextureRHIRef ComputeShaderOutput, FShaderResourceViewRHIRef ComputeShaderOutputBuffer, const TArray<FIntRect>& DirtyRects = TArray<FIntRect>());
+
+	// Same as DrawToRenderTarget_RenderThread, but draws to any render targetable texture instead of DrawParameters.RenderTarget.
+	static void DrawToTexture_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FRHITexture* RenderTargetTexture, const FIntPoint& ComputeSize, EComputeBufferLayout BufferLayout, FTextureRHIRef ComputeShaderOutput, FShaderResourceViewRHIRef ComputeShaderOutputBuffer, const TArray<FIntRect>& DirtyRects = TArray<FIntRect>());
+
+	// Same as above, but the compute shader component is crossfaded from a baked flipbook instead.
+	static void DrawFlipbookToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FTextureRHIRef FlipbookTexture, const FFractalFlipbookSettings& FlipbookSettings, const TArray<FIntRect>& DirtyRects = TArray<FIntRect>());
 };
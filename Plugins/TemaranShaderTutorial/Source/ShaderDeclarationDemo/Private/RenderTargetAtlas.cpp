@@ -0,0 +1,195 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "RenderTargetAtlas.h"
+
+#include "ShaderDeclarationDemoModule.h"
+
+#include "ClearQuad.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RHICommandList.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+
+// Slots are drawn with load rather than clear, so a slot that is handed out again still has what its last owner drew
+// until its new owner draws. Clearing it right away means materials sampling it before that see nothing instead.
+static void ClearSlot(UTextureRenderTarget2D* PageTexture, const FIntRect& SlotRect)
+{
+	FTextureRenderTargetResource* PageResource = PageTexture->GameThread_GetRenderTargetResource();
+	ENQUEUE_RENDER_COMMAND(ClearRenderTargetAtlasSlotCommand)(
+		[PageResource, SlotRect](FRHICommandListImmediate& RHICmdList)
+	{
+		FRHITexture* Texture = PageResource->GetRenderTargetTexture();
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, Texture);
+
+		FRHIRenderPassInfo RenderPassInfo(Texture, ERenderTargetActions::Load_Store);
+		RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_ClearAtlasSlot"));
+		RHICmdList.SetViewport(SlotRect.Min.X, SlotRect.Min.Y, 0.0f, SlotRect.Max.X, SlotRect.Max.Y, 1.0f);
+		DrawClearQuad(RHICmdList, FLinearColor::Transparent);
+		RHICmdList.EndRenderPass();
+	}
+	);
+}
+
+FRenderTargetAtlas::~FRenderTargetAtlas()
+{
+	Reset();
+}
+
+FRenderTargetAtlasSlot FRenderTargetAtlas::Allocate(int32 Size)
+{
+	check(IsInGameThread());
+
+	FRenderTargetAtlasSlot Slot;
+	if (Size > PageSize)
+	{
+		return Slot;
+	}
+
+	const int32 SlotSize = FMath::Max((int32)FMath::RoundUpToPowerOfTwo(FMath::Max(Size, 1)), MinSlotSize);
+	int32 FreePageIndex = INDEX_NONE;
+
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); PageIndex++)
+	{
+		FPage& Page = Pages[PageIndex];
+		if (!Page.Texture)
+		{
+			FreePageIndex = FreePageIndex == INDEX_NONE ? PageIndex : FreePageIndex;
+			continue;
+		}
+
+		if (Page.SlotSize == SlotSize && Page.NumUsedSlots < Page.UsedSlots.Num())
+		{
+			Slot.PageIndex = PageIndex;
+			Slot.SlotIndex = Page.UsedSlots.FindAndSetFirstZeroBit();
+			Page.NumUsedSlots++;
+			ClearSlot(Page.Texture, GetSlotRect(Slot));
+			return Slot;
+		}
+	}
+
+	// Every page with this slot size is full, so we need a new one.
+	if (FreePageIndex == INDEX_NONE)
+	{
+		FreePageIndex = Pages.AddDefaulted();
+	}
+
+	// New pages are cleared when their resource is created. The default clear color is green, which would show up in
+	// every slot that hasn't been drawn yet.
+	UTextureRenderTarget2D* Texture = NewObject<UTextureRenderTarget2D>();
+	Texture->AddToRoot();
+	Texture->ClearColor = FLinearColor::Transparent;
+	Texture->InitCustomFormat(PageSize, PageSize, PF_R8G8B8A8, true);
+	Texture->UpdateResourceImmediate(true);
+
+	FPage& Page = Pages[FreePageIndex];
+	Page.Texture = Texture;
+	Page.SlotSize = SlotSize;
+	Page.SlotsPerRow = PageSize / SlotSize;
+	Page.UsedSlots.Init(false, Page.SlotsPerRow * Page.SlotsPerRow);
+	Page.UsedSlots[0] = true;
+	Page.NumUsedSlots = 1;
+
+	UE_LOG(LogShaderPlugin, Verbose, TEXT("Added render target atlas page %d with %d %dx%d slots."), FreePageIndex, Page.UsedSlots.Num(), SlotSize, SlotSize);
+
+	Slot.PageIndex = FreePageIndex;
+	Slot.SlotIndex = 0;
+	return Slot;
+}
+
+void FRenderTargetAtlas::Free(FRenderTargetAtlasSlot& Slot)
+{
+	check(IsInGameThread());
+
+	if (!Slot.IsValid() || !Pages.IsValidIndex(Slot.PageIndex) || !Pages[Slot.PageIndex].Texture)
+	{
+		Slot = FRenderTargetAtlasSlot();
+		return;
+	}
+
+	FPage& Page = Pages[Slot.PageIndex];
+	check(Page.UsedSlots[Slot.SlotIndex]);
+	Page.UsedSlots[Slot.SlotIndex] = false;
+	Page.NumUsedSlots--;
+
+	// Empty pages go straight back, a page is a lot of memory to keep around for a slot that may never be asked for again.
+	if (Page.NumUsedSlots == 0)
+	{
+		Page.Texture->RemoveFromRoot();
+		Page.Texture = nullptr;
+		Page.UsedSlots.Empty();
+	}
+
+	Slot = FRenderTargetAtlasSlot();
+}
+
+void FRenderTargetAtlas::Reset()
+{
+	for (FPage& Page : Pages)
+	{
+		if (Page.Texture)
+		{
+			Page.Texture->RemoveFromRoot();
+		}
+	}
+	Pages.Empty();
+}
+
+UTextureRenderTarget2D* FRenderTargetAtlas::GetPageTexture(const FRenderTargetAtlasSlot& Slot) const
+{
+	return Slot.IsValid() ? GetPage(Slot).Texture : nullptr;
+}
+
+FIntRect FRenderTargetAtlas::GetSlotRect(const FRenderTargetAtlasSlot& Slot) const
+{
+	if (!Slot.IsValid())
+	{
+		return FIntRect();
+	}
+
+	const FPage& Page = GetPage(Slot);
+	const FIntPoint Min((Slot.SlotIndex % Page.SlotsPerRow) * Page.SlotSize, (Slot.SlotIndex / Page.SlotsPerRow) * Page.SlotSize);
+	return FIntRect(Min, Min + FIntPoint(Page.SlotSize));
+}
+
+FVector4 FRenderTargetAtlas::GetSlotScaleBias(const FRenderTargetAtlasSlot& Slot) const
+{
+	if (!Slot.IsValid())
+	{
+		return FVector4(1.0f, 1.0f, 0.0f, 0.0f);
+	}
+
+	const FIntRect Rect = GetSlotRect(Slot);
+	return FVector4(
+		Rect.Width() / (float)PageSize,
+		Rect.Height() / (float)PageSize,
+		Rect.Min.X / (float)PageSize,
+		Rect.Min.Y / (float)PageSize);
+}
+
+int32 FRenderTargetAtlas::GetNumPages() const
+{
+	int32 NumPages = 0;
+	for (const FPage& Page : Pages)
+	{
+		NumPages += Page.Texture ? 1 : 0;
+	}
+	return NumPages;
+}
+
+int32 FRenderTargetAtlas::GetNumSlots() const
+{
+	int32 NumSlots = 0;
+	for (const FPage& Page : Pages)
+	{
+		NumSlots += Page.Texture ? Page.NumUsedSlots : 0;
+	}
+	return NumSlots;
+}
+
+const FRenderTargetAtlas::FPage& FRenderTargetAtlas::GetPage(const FRenderTargetAtlasSlot& Slot) const
+{
+	check(Pages.IsValidIndex(Slot.PageIndex) && Pages[Slot.PageIndex].Texture);
+	return Pages[Slot.PageIndex];
+}
@@ -3,9 +3,11 @@
 ///////////////////////////////////////////////////////////////////////////////////////
 
 #include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginContext.h"
 
-#include "ComputeShaderExample.h"
-#include "PixelShaderExample.h"
+#include "BlockCompressionExample.h"
+#include "ComputeMeshGenerator.h"
+#include "ComputeMeshSceneProxy.h"
 
 #include "Misc/Paths.h"
 #include "Misc/FileHelper.h"
@@ -13,13 +15,36 @@
 #include "GlobalShader.h"
 #include "RHICommandList.h"
 #include "RenderGraphBuilder.h"
-#include "RenderTargetPool.h"
 #include "Runtime/Core/Public/Modules/ModuleManager.h"
+#include "Components/MeshComponent.h"
 #include "Engine/Engine.h"
+#include "Engine/Texture2D.h"
+#include "Engine/World.h"
+#include "SceneInterface.h"
+#include "HAL/IConsoleManager.h"
 #include "VertexFromCSExample.h"
+#include "FractalFlipbook.h"
+#include "ComputeShaderReference.h"
+#include "ParticleSimulation.h"
+#include "ParticleSimulationReference.h"
+#include "ParameterStream.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTrace.h"
+#include "RenderUtils.h"
+#include "TextureResource.h"
+#include "Containers/Ticker.h"
 
 IMPLEMENT_MODULE(FShaderDeclarationDemoModule, ShaderDeclarationDemo)
 
+DEFINE_LOG_CATEGORY(LogShaderPlugin);
+
+static TAutoConsoleVariable<float> CVarReplayTickBudget(
+	TEXT("r.ShaderPlugin.ReplayTickBudget"),
+	8.0f,
+	TEXT("Milliseconds of game thread time a replay that isn't in real time spends replaying draws each tick. At least one draw\n")
+	TEXT("is replayed per tick, so 0 goes back to one draw per tick."),
+	ECVF_Default);
+
 // Declare some GPU stats so we can track them later
 DECLARE_GPU_STAT_NAMED(ShaderPlugin_Render, TEXT("ShaderPlugin: Root Render"));
 DECLARE_GPU_STAT_NAMED(ShaderPlugin_Compute, TEXT("ShaderPlugin: Render Compute Shader"));
@@ -27,11 +52,90 @@ DECLARE_GPU_STAT_NAMED(ShaderPlugin_Pixel, TEXT("ShaderPlugin: Render Pixel Shad
 
 DECLARE_GPU_STAT_NAMED(ShaderPlugin_VertexCompute, TEXT("ShaderPlugin: Render Compute Shader for Vertex"))
 DECLARE_GPU_STAT_NAMED(ShaderPlugin_VertexFromCSVertexPixel, TEXT("ShaderPlugin: Render VertexFromC Vertex and Pixel Shader"))
+DECLARE_GPU_STAT_NAMED(ShaderPlugin_BakeFlipbook, TEXT("ShaderPlugin: Bake Flipbook"));
+
+static FAutoConsoleCommand CBakeFlipbookCommand(
+	TEXT("ShaderPlugin.BakeFlipbook"),
+	TEXT("Bakes one loop of the fractal into a flipbook that draws with bUseFlipbook set will play back.\n")
+	TEXT("Usage: ShaderPlugin.BakeFlipbook [NumFrames] [FrameSize] [LoopDuration] [cpu]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FFractalFlipbookSettings Settings;
+		if (Args.Num() > 0) { Settings.NumFrames = FCString::Atoi(*Args[0]); }
+		if (Args.Num() > 1) { Settings.FrameSize = FIntPoint(FCString::Atoi(*Args[1])); }
+		if (Args.Num() > 2) { Settings.LoopDuration = FCString::Atof(*Args[2]); }
+		Settings.FramesPerRow = FMath::CeilToInt(FMath::Sqrt((float)Settings.NumFrames));
+
+		const bool bForceCPU = Args.Num() > 3 && Args[3] == TEXT("cpu");
+		FShaderDeclarationDemoModule::Get().BakeFlipbook(Settings, bForceCPU);
+	}));
+
+static FAutoConsoleCommand CClearFlipbookCommand(
+	TEXT("ShaderPlugin.ClearFlipbook"),
+	TEXT("Drops the baked flipbook so draws go back to running the compute shader."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FShaderDeclarationDemoModule::Get().ClearFlipbook();
+	}));
+
+// Relative names end up in Saved/Profiling, next to the other captures.
+static FString GetParameterStreamFilename(const TArray<FString>& Args)
+{
+	const FString Filename = Args.Num() > 0 ? Args[0] : TEXT("ShaderPlugin.params");
+	return FPaths::IsRelative(Filename) ? FPaths::Combine(FPaths::ProfilingDir(), Filename) : Filename;
+}
+
+static FAutoConsoleCommand CRecordCommand(
+	TEXT("ShaderPlugin.Record"),
+	TEXT("Records every UpdateParameters and DrawTarget call to a file until ShaderPlugin.StopRecording.\n")
+	TEXT("Usage: ShaderPlugin.Record [Filename=ShaderPlugin.params]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FShaderDeclarationDemoModule::Get().StartRecording(GetParameterStreamFilename(Args));
+	}));
+
+static FAutoConsoleCommand CStopRecordingCommand(
+	TEXT("ShaderPlugin.StopRecording"),
+	TEXT("Stops the recording started by ShaderPlugin.Record."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FShaderDeclarationDemoModule::Get().StopRecording();
+	}));
+
+static FAutoConsoleCommand CReplayCommand(
+	TEXT("ShaderPlugin.Replay"),
+	TEXT("Replays a recording made with ShaderPlugin.Record and logs how long it took.\n")
+	TEXT("realtime keeps the recorded pacing instead of replaying as fast as r.ShaderPlugin.ReplayTickBudget allows, cpu uses\n")
+	TEXT("the CPU reference back-end and exit quits when the replay is done. For headless A/B runs, start the game with\n")
+	TEXT("-nullrhi -ExecCmds=\"ShaderPlugin.Replay MyCapture.params exit\".\n")
+	TEXT("Usage: ShaderPlugin.Replay [Filename=ShaderPlugin.params] [realtime] [cpu] [exit]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const bool bRealTime = Args.Contains(TEXT("realtime"));
+		const bool bForceCPU = Args.Contains(TEXT("cpu"));
+		const bool bExitWhenDone = Args.Contains(TEXT("exit"));
+
+		TArray<FString> FilenameArgs = Args.FilterByPredicate([](const FString& Arg) { return Arg != TEXT("realtime") && Arg != TEXT("cpu") && Arg != TEXT("exit"); });
+		FShaderDeclarationDemoModule::Get().StartReplay(GetParameterStreamFilename(FilenameArgs), bRealTime, bForceCPU, bExitWhenDone);
+	}));
+
+static FAutoConsoleCommand CStopReplayCommand(
+	TEXT("ShaderPlugin.StopReplay"),
+	TEXT("Stops the replay started by ShaderPlugin.Replay."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FShaderDeclarationDemoModule::Get().StopReplay();
+	}));
 
 void FShaderDeclarationDemoModule::StartupModule()
 {
-	OnPostResolvedSceneColorHandle.Reset();
-	bCachedParametersValid = false;
+	FlipbookTextureBytes = 0;
+	LastRecordedContext = nullptr;
+
+	FShaderPluginMemory::RegisterLLMTags();
+	FShaderPluginTrace::Startup();
+
+	WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddRaw(this, &FShaderDeclarationDemoModule::OnWorldCleanup);
 
 	// Maps virtual shader source directory to the plugin's actual shaders directory.
 	FString PluginShaderDir = FPaths::Combine(FPaths::ProjectPluginsDir(), TEXT("TemaranShaderTutorial/Shaders"));
@@ -40,141 +144,593 @@ void FShaderDeclarationDemoModule::StartupModule()
 
 void FShaderDeclarationDemoModule::ShutdownModule()
 {
-	EndRendering();
+	StopReplay();
+	StopRecording();
+
+	FWorldDelegates::OnWorldCleanup.Remove(WorldCleanupHandle);
+	FShaderPluginTrace::Shutdown();
+	FlipbookTextureAsset.Reset();
+
+	TArray<UTextureRenderTarget2D*> CompressedRenderTargets;
+	CompressedTargets.GetKeys(CompressedRenderTargets);
+	for (UTextureRenderTarget2D* RenderTarget : CompressedRenderTargets)
+	{
+		ReleaseCompressedTarget(RenderTarget);
+	}
+
+	TArray<TSharedPtr<FShaderPluginContext>> ContextsToDestroy;
+	Contexts.GenerateValueArray(ContextsToDestroy);
+	Contexts.Reset();
+	DestroyContexts(MoveTemp(ContextsToDestroy));
 }
 
-void FShaderDeclarationDemoModule::BeginRendering()
+FShaderPluginContext& FShaderDeclarationDemoModule::GetContext(const UObject* Owner)
 {
-	if (OnPostResolvedSceneColorHandle.IsValid())
+	check(IsInGameThread());
+
+	TSharedPtr<FShaderPluginContext>& Context = Contexts.FindOrAdd(FObjectKey(Owner));
+	if (!Context.IsValid())
+	{
+		Context = MakeShared<FShaderPluginContext>(this, Owner ? Owner->GetPathName() : TEXT("Default"), Owner ? Owner->GetWorld() : nullptr);
+		UE_LOG(LogShaderPlugin, Verbose, TEXT("Created context for %s, %d contexts in total."), *Context->GetName(), Contexts.Num());
+	}
+	return *Context;
+}
+
+FShaderPluginContext* FShaderDeclarationDemoModule::FindContext(const UObject* Owner) const
+{
+	check(IsInGameThread());
+
+	const TSharedPtr<FShaderPluginContext>* Context = Contexts.Find(FObjectKey(Owner));
+	return Context ? Context->Get() : nullptr;
+}
+
+void FShaderDeclarationDemoModule::ReleaseContext(const UObject* Owner)
+{
+	check(IsInGameThread());
+
+	TSharedPtr<FShaderPluginContext> Context;
+	if (Contexts.RemoveAndCopyValue(FObjectKey(Owner), Context))
+	{
+		DestroyContexts({ Context });
+	}
+}
+
+void FShaderDeclarationDemoModule::DestroyContexts(TArray<TSharedPtr<FShaderPluginContext>>&& ContextsToDestroy)
+{
+	if (ContextsToDestroy.Num() == 0)
 	{
 		return;
 	}
 
-	bCachedParametersValid = false;
+	for (const TSharedPtr<FShaderPluginContext>& Context : ContextsToDestroy)
+	{
+		if (LastRecordedContext == Context.Get())
+		{
+			LastRecordedContext = nullptr;
+		}
+		Context->Release();
+	}
+
+	// The render commands we have enqueued point at the contexts, and the atlas pages may still be in use by their draws.
+	FlushRenderingCommands();
+	ContextsToDestroy.Reset();
+}
+
+void FShaderDeclarationDemoModule::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	// Worlds that are only cleaned up to be reused keep their resources, and their context.
+	if (bCleanupResources)
+	{
+		ReleaseContext(World);
+	}
+}
+
+void FShaderDeclarationDemoModule::RecordParameters(const FShaderPluginContext& Context, const FShaderUsageExampleParameters& DrawParameters, bool bForce)
+{
+	check(ParameterStreamWriter.IsValid());
+
+	if (bForce || LastRecordedContext != &Context)
+	{
+		ParameterStreamWriter->AppendUpdate(DrawParameters);
+		LastRecordedContext = &Context;
+	}
+}
+
+FPrimitiveSceneProxy* FShaderDeclarationDemoModule::CreateComputeMeshSceneProxy(UMeshComponent* Component, int32 NumTriangles, float MeshScale, float MeshHeight)
+{
+	check(Component);
 
-	//HandlePreRenderHandle = GEngine->GetPreRenderDelegate().AddRaw(this, &FShaderDeclarationDemoModule::HandlePreRender);
+	UWorld* World = Component->GetWorld();
+	if (!World || !World->Scene || !FVertexFromCSExample::SupportsSceneMesh(World->Scene->GetFeatureLevel()))
+	{
+		return nullptr;
+	}
 
-	const FName RendererModuleName("Renderer");
-	IRendererModule* RendererModule = FModuleManager::GetModulePtr<IRendererModule>(RendererModuleName);
-	if (RendererModule)
+	return new FComputeMeshSceneProxy(Component, NumTriangles, MeshScale, MeshHeight);
+}
+
+FPrimitiveSceneProxy* FShaderDeclarationDemoModule::CreateComputeMeshSceneProxy(UMeshComponent* Component, const FComputeMeshShapeSettings& Shape)
+{
+	check(Component);
+
+	UWorld* World = Component->GetWorld();
+	if (!World || !World->Scene || !FComputeMeshGenerator::IsSupported(World->Scene->GetFeatureLevel()) || !Shape.IsValid())
 	{
-		//OnPostResolvedSceneColorHandle = RendererModule->GetResolvedSceneColorCallbacks().AddRaw(this, &FShaderDeclarationDemoModule::PostResolveSceneColor_RenderThread);
+		return nullptr;
 	}
+
+	return new FComputeMeshSceneProxy(Component, Shape);
 }
 
-void FShaderDeclarationDemoModule::EndRendering()
+void FShaderDeclarationDemoModule::SetComputeMeshShape(FPrimitiveSceneProxy* SceneProxy, const FComputeMeshShapeSettings& Shape)
 {
-	if (!OnPostResolvedSceneColorHandle.IsValid())
+	if (!SceneProxy || !Shape.IsValid())
 	{
 		return;
 	}
 
-	GEngine->GetPreRenderDelegate().Remove(HandlePreRenderHandle);
-	HandlePreRenderHandle.Reset();
+	// The proxy holds on to the texture's reference rather than its resource, which is recreated whenever the texture
+	// is streamed or reimported. The reference itself is only read on the render thread.
+	FComputeMeshSceneProxy* ComputeMeshProxy = static_cast<FComputeMeshSceneProxy*>(SceneProxy);
+	const FTextureReference* HeightTextureReference = Shape.HeightTexture ? &Shape.HeightTexture->TextureReference : nullptr;
 
-	const FName RendererModuleName("Renderer");
-	IRendererModule* RendererModule = FModuleManager::GetModulePtr<IRendererModule>(RendererModuleName);
-	if (RendererModule)
+	ENQUEUE_RENDER_COMMAND(SetComputeMeshShapeCommand)(
+		[ComputeMeshProxy, Shape, HeightTextureReference](FRHICommandListImmediate& RHICmdList)
 	{
-		//RendererModule->GetResolvedSceneColorCallbacks().Remove(OnPostResolvedSceneColorHandle);
+		ComputeMeshProxy->SetShape_RenderThread(RHICmdList, Shape, HeightTextureReference ? HeightTextureReference->TextureReferenceRHI.GetReference() : nullptr);
+	}
+	);
+}
+
+void FShaderDeclarationDemoModule::UpdateComputeMesh(FPrimitiveSceneProxy* SceneProxy, const FShaderUsageExampleParameters& DrawParameters)
+{
+	if (!SceneProxy)
+	{
+		return;
 	}
 
-	OnPostResolvedSceneColorHandle.Reset();
+	FComputeMeshSceneProxy* ComputeMeshProxy = static_cast<FComputeMeshSceneProxy*>(SceneProxy);
+
+	ENQUEUE_RENDER_COMMAND(UpdateComputeMeshCommand)(
+		[ComputeMeshProxy, DrawParameters](FRHICommandListImmediate& RHICmdList)
+	{
+		ComputeMeshProxy->Update_RenderThread(RHICmdList, DrawParameters);
+	}
+	);
 }
 
-void FShaderDeclarationDemoModule::UpdateParameters(FShaderUsageExampleParameters& DrawParameters)
+void FShaderDeclarationDemoModule::BakeFlipbook(const FFractalFlipbookSettings& Settings, bool bForceCPU /*= false*/)
 {
-	//RenderEveryFrameLock.Lock();
-	CachedShaderUsageExampleParameters = DrawParameters;
-	bCachedParametersValid = true;
-	//RenderEveryFrameLock.Unlock();
+	if (!Settings.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("Ignoring flipbook bake with invalid settings."));
+		return;
+	}
+
+	FlipbookTextureAsset.Reset();
+	auto* ThisPtr = this;
+
+	if (bForceCPU || !FFractalFlipbook::CanBakeOnGPU())
+	{
+		// This blocks the game thread for a while, but it only happens once.
+		TArray<FColor> Pixels;
+		FFractalFlipbook::BakeCPU(Settings, Pixels);
+
+		ENQUEUE_RENDER_COMMAND(UploadFlipbookCommand)(
+			[ThisPtr, Settings, Pixels = MoveTemp(Pixels)](FRHICommandListImmediate& RHICmdList)
+		{
+			LLM_SCOPE_SHADERPLUGIN();
+			ThisPtr->SetFlipbookTexture_RenderThread(FFractalFlipbook::CreateAtlasTexture_RenderThread(Settings, Pixels), Settings, true);
+		}
+		);
+	}
+	else
+	{
+		ENQUEUE_RENDER_COMMAND(BakeFlipbookCommand)(
+			[ThisPtr, Settings](FRHICommandListImmediate& RHICmdList)
+		{
+			LLM_SCOPE_SHADERPLUGIN();
+			SCOPED_GPU_STAT(RHICmdList, ShaderPlugin_BakeFlipbook);
+			ThisPtr->SetFlipbookTexture_RenderThread(FFractalFlipbook::BakeGPU_RenderThread(RHICmdList, Settings), Settings, true);
+		}
+		);
+	}
 }
 
-void FShaderDeclarationDemoModule::DrawTarget(EShaderTestSampleType TestType /*= EShaderTestSampleType::ComputeAndPixel*/)
+void FShaderDeclarationDemoModule::SetFlipbook(UTexture2D* FlipbookAsset, const FFractalFlipbookSettings& Settings)
 {
-	if (!bCachedParametersValid)
+	if (!FlipbookAsset || !FlipbookAsset->Resource || !Settings.IsValid())
+	{
+		ClearFlipbook();
 		return;
+	}
+
+	// Holding on to the asset keeps the garbage collector from releasing the resource before the command below has run.
+	// Its RHI texture may not have been created yet, so we only look at it on the render thread.
+	FlipbookTextureAsset.Reset(FlipbookAsset);
+	FTextureResource* FlipbookResource = FlipbookAsset->Resource;
+	auto* ThisPtr = this;
 
-	FShaderUsageExampleParameters Copy = CachedShaderUsageExampleParameters;
+	ENQUEUE_RENDER_COMMAND(SetFlipbookCommand)(
+		[ThisPtr, FlipbookResource, Settings](FRHICommandListImmediate& RHICmdList)
+	{
+		if (!FlipbookResource->TextureRHI.IsValid())
+		{
+			UE_LOG(LogShaderPlugin, Warning, TEXT("Flipbook texture has no RHI resource, clearing the flipbook."));
+			ThisPtr->SetFlipbookTexture_RenderThread(nullptr, FFractalFlipbookSettings(), false);
+			return;
+		}
+		ThisPtr->SetFlipbookTexture_RenderThread(FlipbookResource->TextureRHI, Settings, false);
+	}
+	);
+}
+
+void FShaderDeclarationDemoModule::ClearFlipbook()
+{
+	// The render thread holds its own reference to the RHI texture, so the asset can go right away.
+	FlipbookTextureAsset.Reset();
 	auto* ThisPtr = this;
 
-	ENQUEUE_RENDER_COMMAND(DrawTargetCommand)(
-		[ThisPtr, Copy, TestType](FRHICommandListImmediate& RHICmdList)
+	ENQUEUE_RENDER_COMMAND(ClearFlipbookCommand)(
+		[ThisPtr](FRHICommandListImmediate& RHICmdList)
 	{
-		ThisPtr->Draw_RenderThread(RHICmdList, Copy, TestType);
+		ThisPtr->SetFlipbookTexture_RenderThread(nullptr, FFractalFlipbookSettings(), false);
 	}
 	);
 }
 
-void FShaderDeclarationDemoModule::PostResolveSceneColor_RenderThread(FRHICommandListImmediate& RHICmdList, class FSceneRenderTargets& SceneContext)
+UTexture2D* FShaderDeclarationDemoModule::CreateCompressedTarget(UTextureRenderTarget2D* RenderTarget, EShaderPluginCompression Compression)
 {
-	if (!bCachedParametersValid)
+	check(IsInGameThread());
+
+	if (!RenderTarget || !FBlockCompressionExample::IsSupported())
+	{
+		return nullptr;
+	}
+
+	if (RenderTarget->SizeX <= 0 || RenderTarget->SizeY <= 0 || RenderTarget->SizeX % 4 != 0 || RenderTarget->SizeY % 4 != 0)
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("Can't compress %s, its size %dx%d isn't a multiple of 4."), *RenderTarget->GetName(), RenderTarget->SizeX, RenderTarget->SizeY);
+		return nullptr;
+	}
+
+	ReleaseCompressedTarget(RenderTarget);
+
+	const EPixelFormat CompressedFormat = FBlockCompressionExample::GetCompressedFormat(Compression);
+	UTexture2D* CompressedTexture = UTexture2D::CreateTransient(RenderTarget->SizeX, RenderTarget->SizeY, CompressedFormat);
+	if (!CompressedTexture)
+	{
+		return nullptr;
+	}
+
+	// CreateTransient only makes mip 0. The render target's mips are compressed as well, down to the first one that isn't
+	// a whole number of blocks, so the compressed texture gets as many.
+	const FIntPoint Size(RenderTarget->SizeX, RenderTarget->SizeY);
+	const int32 NumRenderTargetMips = RenderTarget->bAutoGenerateMips ? FMath::FloorLog2(FMath::Max(Size.X, Size.Y)) + 1 : 1;
+	const int32 NumMips = FBlockCompressionExample::GetNumCompressibleMips(Size, NumRenderTargetMips);
+	for (int32 MipIndex = 1; MipIndex < NumMips; MipIndex++)
+	{
+		FTexture2DMipMap* Mip = new(CompressedTexture->PlatformData->Mips) FTexture2DMipMap();
+		Mip->SizeX = Size.X >> MipIndex;
+		Mip->SizeY = Size.Y >> MipIndex;
+
+		const int64 MipBytes = CalculateImageBytes(Mip->SizeX, Mip->SizeY, 0, CompressedFormat);
+		Mip->BulkData.Lock(LOCK_READ_WRITE);
+		FMemory::Memzero(Mip->BulkData.Realloc(MipBytes), MipBytes);
+		Mip->BulkData.Unlock();
+	}
+
+	// We encode the raw values of the render target, so they have to be read back the same way.
+	CompressedTexture->SRGB = RenderTarget->SRGB;
+	CompressedTexture->NeverStream = true;
+	CompressedTexture->UpdateResource();
+	CompressedTexture->AddToRoot();
+	CompressedTargets.Add(RenderTarget, CompressedTexture);
+
+	auto* ThisPtr = this;
+	FTextureResource* CompressedResource = CompressedTexture->Resource;
+	ENQUEUE_RENDER_COMMAND(CreateCompressedTargetCommand)(
+		[ThisPtr, RenderTarget, Compression, CompressedResource](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->CompressedTargetResources.Add(RenderTarget, MakeShared<FCompressedTarget>(Compression, CompressedResource));
+	}
+	);
+
+	return CompressedTexture;
+}
+
+void FShaderDeclarationDemoModule::ReleaseCompressedTarget(UTextureRenderTarget2D* RenderTarget)
+{
+	check(IsInGameThread());
+
+	UTexture2D* CompressedTexture = nullptr;
+	if (!CompressedTargets.RemoveAndCopyValue(RenderTarget, CompressedTexture))
 	{
 		return;
 	}
 
-	// Depending on your data, you might not have to lock here, just added this code to show how you can do it if you have to.
-	RenderEveryFrameLock.Lock();
-	FShaderUsageExampleParameters Copy = CachedShaderUsageExampleParameters;
-	RenderEveryFrameLock.Unlock();
+	// The texture's resource is released after the garbage collector gets to it, which is after this command has run.
+	auto* ThisPtr = this;
+	ENQUEUE_RENDER_COMMAND(ReleaseCompressedTargetCommand)(
+		[ThisPtr, RenderTarget](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->CompressedTargetResources.Remove(RenderTarget);
+	}
+	);
 
-	Draw_RenderThread(RHICmdList, Copy);
+	CompressedTexture->RemoveFromRoot();
 }
 
-void FShaderDeclarationDemoModule::Draw_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType Type /*= EShaderTestSampleType::ComputeAndPixel*/)
+void FShaderDeclarationDemoModule::SetFlipbookTexture_RenderThread(FTextureRHIRef Texture, const FFractalFlipbookSettings& Settings, bool bOwnedByPlugin)
 {
 	check(IsInRenderingThread());
 
-	switch (Type)
+	if (FlipbookTextureBytes > 0)
 	{
-	case EShaderTestSampleType::ComputeAndPixel:
-		RunComputeAndPixelSample_RenderThread(RHICmdList, DrawParameters);
-		break;
+		FShaderPluginMemory::TrackFree(EShaderPluginResource::FlipbookAtlas, NAME_None, FlipbookTextureBytes);
+		FlipbookTextureBytes = 0;
+	}
+
+	FlipbookTexture = Texture;
+	FlipbookSettings = Settings;
 
-	case EShaderTestSampleType::ComputeToVertexBuffer:
-		FVertexFromCSExample::RunVertexFromCS_RenderThread(RHICmdList, DrawParameters);
-		break;
+	if (FlipbookTexture.IsValid() && bOwnedByPlugin)
+	{
+		const FIntPoint AtlasSize = Settings.GetAtlasSize();
+		FlipbookTextureBytes = CalculateImageBytes(AtlasSize.X, AtlasSize.Y, 0, PF_R8G8B8A8);
+		FShaderPluginMemory::TrackAllocation(EShaderPluginResource::FlipbookAtlas, NAME_None, FlipbookTextureBytes);
 	}
 }
 
-void FShaderDeclarationDemoModule::RunComputeAndPixelSample_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters)
+#if WITH_EDITOR
+UTexture2D* FShaderDeclarationDemoModule::BakeFlipbookToAsset(const FFractalFlipbookSettings& Settings, const FString& PackageName, bool bForceCPU /*= false*/)
 {
-	if (!DrawParameters.RenderTarget)
+	if (!Settings.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("Ignoring flipbook bake with invalid settings."));
+		return nullptr;
+	}
+
+	TArray<FColor> Pixels;
+	if (bForceCPU || !FFractalFlipbook::CanBakeOnGPU())
+	{
+		FFractalFlipbook::BakeCPU(Settings, Pixels);
+	}
+	else
+	{
+		TArray<FColor>* PixelsPtr = &Pixels;
+		ENQUEUE_RENDER_COMMAND(BakeFlipbookToAssetCommand)(
+			[Settings, PixelsPtr](FRHICommandListImmediate& RHICmdList)
+		{
+			SCOPED_GPU_STAT(RHICmdList, ShaderPlugin_BakeFlipbook);
+			FFractalFlipbook::BakeGPU_RenderThread(RHICmdList, Settings, PixelsPtr);
+		}
+		);
+
+		// We need the pixels back on the game thread before we can build the asset.
+		FlushRenderingCommands();
+	}
+
+	return FFractalFlipbook::SaveAsTextureAsset(Settings, Pixels, PackageName);
+}
+#endif
+
+bool FShaderDeclarationDemoModule::StartRecording(const FString& Filename)
+{
+	StopRecording();
+
+	TSharedPtr<FParameterStreamWriter> Writer = MakeShared<FParameterStreamWriter>();
+	if (!Writer->Open(Filename))
+	{
+		return false;
+	}
+
+	ParameterStreamWriter = Writer;
+
+	// The first draw of every context records its parameters, so the replay doesn't depend on parameters that were set
+	// before we started recording.
+	LastRecordedContext = nullptr;
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Recording parameter stream to %s."), *Filename);
+	return true;
+}
+
+void FShaderDeclarationDemoModule::StopRecording()
+{
+	// Closing flushes the file and logs how many events were written.
+	ParameterStreamWriter.Reset();
+}
+
+bool FShaderDeclarationDemoModule::IsRecording() const
+{
+	return ParameterStreamWriter.IsValid();
+}
+
+bool FShaderDeclarationDemoModule::StartReplay(const FString& Filename, bool bRealTime /*= false*/, bool bForceCPU /*= false*/, bool bExitWhenDone /*= false*/)
+{
+	StopReplay();
+
+	TSharedPtr<FParameterStreamReplay> Replay = MakeShared<FParameterStreamReplay>();
+	if (!FParameterStreamReader::Load(Filename, Replay->Events))
+	{
+		if (bExitWhenDone)
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+		return false;
+	}
+
+	Replay->bRealTime = bRealTime;
+	Replay->bUseCPU = bForceCPU || GUsingNullRHI;
+	Replay->bExitWhenDone = bExitWhenDone;
+	Replay->StartWallTime = FPlatformTime::Seconds();
+	Replay->Context = MakeShared<FShaderPluginContext>(this, TEXT("Replay"));
+	ParameterStreamReplay = Replay;
+
+	ReplayTickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FShaderDeclarationDemoModule::ReplayTick));
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Replaying %d parameter stream events from %s on the %s back-end%s."),
+		Replay->Events.Num(), *Filename, Replay->bUseCPU ? TEXT("CPU") : TEXT("GPU"), bRealTime ? TEXT(" in real time") : TEXT(""));
+	return true;
+}
+
+void FShaderDeclarationDemoModule::StopReplay()
+{
+	if (!ParameterStreamReplay.IsValid())
 	{
 		return;
 	}
 
-	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_Render); // Used to gather CPU profiling data for the UE4 session frontend
-	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Render); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	if (ReplayTickHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(ReplayTickHandle);
+		ReplayTickHandle.Reset();
+	}
+
+	// Wait for the draws we enqueued, both so they count towards the time and because they use our render targets.
+	FlushRenderingCommands();
+
+	FParameterStreamReplay& Replay = *ParameterStreamReplay;
+	const double WallTime = FPlatformTime::Seconds() - Replay.StartWallTime;
+	const double RecordedTime = Replay.Events.Num() > 0 ? Replay.Events.Last().Time : 0.0;
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Replayed %d of %d events in %.3f s (recorded %.3f s): %d draws, %d skipped, %.1f draws/s."),
+		Replay.NextEvent, Replay.Events.Num(), WallTime, RecordedTime, Replay.NumDraws, Replay.NumSkippedDraws, WallTime > 0.0 ? Replay.NumDraws / WallTime : 0.0);
+	if (Replay.CPUParticles.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Display, TEXT("The CPU particle simulation ended with %d of %d particles alive."), Replay.CPUParticles->GetNumAlive(), Replay.CPUParticles->GetParticles().Num());
+	}
+
+	Replay.ReleaseRenderTargets();
+
+	const bool bExitWhenDone = Replay.bExitWhenDone;
+	TSharedPtr<FShaderPluginContext> ReplayContext = MoveTemp(Replay.Context);
+	ParameterStreamReplay.Reset();
+	DestroyContexts({ ReplayContext });
 
-	if (!ComputeShaderOutput.IsValid())
+	if (bExitWhenDone)
 	{
-		FPooledRenderTargetDesc ComputeShaderOutputDesc(FPooledRenderTargetDesc::Create2DDesc(DrawParameters.GetRenderTargetSize(), PF_R8G8B8A8, FClearValueBinding::None, TexCreate_None, TexCreate_RenderTargetable | TexCreate_UAV, false));
-		ComputeShaderOutputDesc.DebugName = TEXT("ShaderPlugin_ComputeShaderOutput");
-		GRenderTargetPool.FindFreeElement(RHICmdList, ComputeShaderOutputDesc, ComputeShaderOutput, TEXT("ShaderPlugin_ComputeShaderOutput"));
+		FPlatformMisc::RequestExit(false);
 	}
+}
+
+bool FShaderDeclarationDemoModule::IsReplaying() const
+{
+	return ParameterStreamReplay.IsValid();
+}
 
-	FRWBuffer TestRWBuffer;
-	TestRWBuffer.Initialize(sizeof(float) * 4, DrawParameters.GetRenderTargetSize().X * DrawParameters.GetRenderTargetSize().Y, PF_A32B32G32R32F);
+bool FShaderDeclarationDemoModule::ReplayTick(float DeltaTime)
+{
+	check(ParameterStreamReplay.IsValid());
+	FParameterStreamReplay& Replay = *ParameterStreamReplay;
+
+	if (Replay.bRealTime)
+	{
+		Replay.ReplayTime += DeltaTime;
+		while (Replay.NextEvent < Replay.Events.Num() && Replay.Events[Replay.NextEvent].Time <= Replay.ReplayTime)
+		{
+			ReplayEvent(Replay.Events[Replay.NextEvent++]);
+		}
+	}
+	else
+	{
+		// As many draws as fit in the budget, so a replay runs at full speed without starving the engine's own frame. The
+		// engine still ends a frame every tick, just not between every pair of draws.
+		const double EndTime = FPlatformTime::Seconds() + CVarReplayTickBudget.GetValueOnGameThread() / 1000.0;
+		while (Replay.NextEvent < Replay.Events.Num())
+		{
+			const FParameterStreamEvent& Event = Replay.Events[Replay.NextEvent++];
+			ReplayEvent(Event);
+
+			if (Event.Type == FParameterStreamEvent::EType::DrawTarget && FPlatformTime::Seconds() >= EndTime)
+			{
+				break;
+			}
+		}
+	}
 
-	FComputeShaderExample::RunComputeShader_RenderThread(RHICmdList, DrawParameters, ComputeShaderOutput->GetRenderTargetItem().UAV, TestRWBuffer.UAV);
+	if (Replay.NextEvent >= Replay.Events.Num())
+	{
+		// Returning false removes the ticker for us.
+		ReplayTickHandle.Reset();
+		StopReplay();
+		return false;
+	}
 
-	FPixelShaderExample::DrawToRenderTarget_RenderThread(RHICmdList, DrawParameters, ComputeShaderOutput->GetRenderTargetItem().TargetableTexture, TestRWBuffer.SRV);
+	return true;
 }
 
-void FShaderDeclarationDemoModule::HandlePreRender()
+void FShaderDeclarationDemoModule::ReplayEvent(const FParameterStreamEvent& Event)
 {
-	if (!bCachedParametersValid)
+	FParameterStreamReplay& Replay = *ParameterStreamReplay;
+
+	if (Event.Type == FParameterStreamEvent::EType::UpdateParameters)
+	{
+		Replay.CurrentParameters = Event;
+		Replay.bHasParameters = true;
+		return;
+	}
+
+	// DrawTarget doesn't do anything before the first UpdateParameters either.
+	if (!Replay.bHasParameters)
+	{
+		return;
+	}
+
+	const FParameterStreamEvent& Parameters = Replay.CurrentParameters;
+	if (Parameters.RenderTargetSize.X <= 0 || Parameters.RenderTargetSize.Y <= 0)
+	{
+		Replay.NumSkippedDraws++;
+		return;
+	}
+
+	if (Replay.bUseCPU)
 	{
+		// The fractal and the particles have CPU back-ends, the vertex sample can't be replayed without a GPU.
+		if (Event.SampleType == EShaderTestSampleType::Particles)
+		{
+			if (!Replay.CPUParticles.IsValid())
+			{
+				Replay.CPUParticles = MakeShared<FParticleSimulationReference>(FParticleSimulationSettings::FromConsoleVariables());
+			}
+
+			Replay.CPUParticles->Step(Replay.CPUParticleClock.Advance(Parameters.SimulationState));
+			Replay.NumDraws++;
+			return;
+		}
+
+		if (Event.SampleType != EShaderTestSampleType::ComputeAndPixel)
+		{
+			const uint32 SampleTypeBit = 1u << (uint32)Event.SampleType;
+			if (!(Replay.LoggedSkippedSampleTypes & SampleTypeBit))
+			{
+				Replay.LoggedSkippedSampleTypes |= SampleTypeBit;
+				UE_LOG(LogShaderPlugin, Warning, TEXT("Skipping draws of sample type %d, it has no CPU back-end. They are counted as skipped."), (int32)Event.SampleType);
+			}
+			Replay.NumSkippedDraws++;
+			return;
+		}
+
+		// The same size the GPU draw would use. The dynamic scale follows the GPU frame time, which there is none of here.
+		const FIntPoint ComputeSize = FShaderPluginContext::CalculateComputeSize(Parameters.RenderTargetSize, Parameters.ComputeResolutionScale, FShaderPluginContext::GetComputeScale(), 1.0f);
+
+		Replay.CPUPixels.SetNumUninitialized(ComputeSize.X * ComputeSize.Y, false);
+		FComputeShaderReference::RenderFrame(ComputeSize, Parameters.SimulationState, Replay.CPUPixels.GetData(), ComputeSize.X);
+		Replay.NumDraws++;
 		return;
 	}
 
-	// Depending on your data, you might not have to lock here, just added this code to show how you can do it if you have to.
-	RenderEveryFrameLock.Lock();
-	FShaderUsageExampleParameters Copy = CachedShaderUsageExampleParameters;
-	RenderEveryFrameLock.Unlock();
+	const FShaderUsageExampleParameters DrawParameters = Parameters.ToDrawParameters(Replay.FindOrCreateRenderTarget(Parameters.RenderTargetSize));
+	const EShaderTestSampleType SampleType = Event.SampleType;
+	FShaderPluginContext* Context = Replay.Context.Get();
 
-	FRHICommandListImmediate& RHICmdList = GRHICommandList.GetImmediateCommandList();
+	ENQUEUE_RENDER_COMMAND(ReplayDrawTargetCommand)(
+		[Context, DrawParameters, SampleType](FRHICommandListImmediate& RHICmdList)
+	{
+		Context->Draw_RenderThread(RHICmdList, DrawParameters, SampleType);
+	}
+	);
 
-	Draw_RenderThread(RHICmdList, Copy);
+	Replay.NumDraws++;
 }
@@ -0,0 +1,235 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginBatchBake.h"
+#include "ShaderPluginContext.h"
+#include "ShaderPluginImageArray.h"
+
+#include "ComputeShaderReference.h"
+#include "ParameterStream.h"
+#include "ShaderPluginTrace.h"
+
+#include "Async/ParallelFor.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "HAL/PlatformTime.h"
+#include "RHI.h"
+#include "TextureResource.h"
+
+// How often a shard logs its progress, in seconds.
+static const double BakeProgressInterval = 5.0;
+
+bool FShaderPluginBatchBake::LoadJobs(const FString& Filename, TArray<FShaderPluginBakeJob>& OutJobs)
+{
+	OutJobs.Reset();
+
+	TArray<FParameterStreamEvent> Events;
+	if (!FParameterStreamReader::Load(Filename, Events))
+	{
+		return false;
+	}
+
+	const FParameterStreamEvent* CurrentParameters = nullptr;
+	int32 NumSkipped = 0;
+	for (const FParameterStreamEvent& Event : Events)
+	{
+		if (Event.Type == FParameterStreamEvent::EType::UpdateParameters)
+		{
+			CurrentParameters = &Event;
+		}
+		else if (!CurrentParameters || CurrentParameters->RenderTargetSize.X <= 0 || CurrentParameters->RenderTargetSize.Y <= 0)
+		{
+			// Same as DrawTarget, which doesn't draw anything without parameters or a render target either.
+			NumSkipped++;
+		}
+		else
+		{
+			FShaderPluginBakeJob& Job = OutJobs.AddDefaulted_GetRef();
+			Job.Parameters = CurrentParameters->ToDrawParameters();
+			Job.SampleType = Event.SampleType;
+		}
+	}
+
+	if (NumSkipped > 0)
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("Skipped %d draws in %s that had no parameters or an empty render target."), NumSkipped, *Filename);
+	}
+
+	return OutJobs.Num() > 0;
+}
+
+bool FShaderPluginBatchBake::SaveJobs(const FString& Filename, const TArray<FShaderPluginBakeJob>& Jobs)
+{
+	FParameterStreamWriter Writer;
+	if (!Writer.Open(Filename))
+	{
+		return false;
+	}
+
+	for (const FShaderPluginBakeJob& Job : Jobs)
+	{
+		Writer.AppendUpdate(Job.Parameters);
+		Writer.AppendDraw(Job.SampleType);
+	}
+	return true;
+}
+
+bool FShaderPluginBatchBake::CreateOutput(const FString& Filename, const TArray<FShaderPluginBakeJob>& Jobs)
+{
+	TArray<FIntPoint> Sizes;
+	Sizes.Reserve(Jobs.Num());
+	for (const FShaderPluginBakeJob& Job : Jobs)
+	{
+		Sizes.Add(Job.Parameters.GetRenderTargetSize());
+	}
+
+	return FImageArrayWriter::Create(Filename, Sizes);
+}
+
+bool FShaderPluginBatchBake::BakeShard(const TArray<FShaderPluginBakeJob>& Jobs, const FString& OutputFilename, int32 ShardIndex, int32 NumShards, bool bForceCPU, FShaderPluginBakeStats& OutStats)
+{
+	check(IsInGameThread());
+	check(NumShards > 0 && ShardIndex >= 0 && ShardIndex < NumShards);
+	SHADERPLUGIN_TRACE_SCOPE(BakeShard);
+
+	OutStats = FShaderPluginBakeStats();
+
+	FImageArrayWriter Writer;
+	if (!Writer.Open(OutputFilename))
+	{
+		return false;
+	}
+
+	if (Writer.Num() != Jobs.Num())
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("%s has %d images, but there are %d jobs. It was made for another job list."), *OutputFilename, Writer.Num(), Jobs.Num());
+		return false;
+	}
+
+	// Quietly baking on the CPU instead would skip most jobs and make every image a different one than the GPU draws.
+	if (!bForceCPU && GUsingNullRHI)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Can't bake %s on the GPU without an RHI. Run with -AllowCommandletRendering, or pass -cpu."), *OutputFilename);
+		return false;
+	}
+	const bool bUseCPU = bForceCPU;
+
+	// The draws go through the context tools get, and into stand-ins for the render targets, one per size.
+	FShaderPluginContext* Context = bUseCPU ? nullptr : &FShaderDeclarationDemoModule::Get().GetContext(nullptr);
+	TMap<FIntPoint, UTextureRenderTarget2D*> RenderTargets;
+
+	const double StartTime = FPlatformTime::Seconds();
+	double NextProgressTime = StartTime + BakeProgressInterval;
+	const int32 NumShardJobs = FMath::DivideAndRoundUp(Jobs.Num() - ShardIndex, NumShards);
+
+	TArray<FColor> Pixels;
+	for (int32 Index = ShardIndex; Index < Jobs.Num(); Index += NumShards)
+	{
+		const FShaderPluginBakeJob& Job = Jobs[Index];
+
+		if (bUseCPU)
+		{
+			if (Job.SampleType != EShaderTestSampleType::ComputeAndPixel)
+			{
+				OutStats.NumSkipped++;
+				continue;
+			}
+
+			RenderCPU(Job.Parameters, Pixels);
+		}
+		else
+		{
+			const FIntPoint Size = Job.Parameters.GetRenderTargetSize();
+			UTextureRenderTarget2D*& RenderTarget = RenderTargets.FindOrAdd(Size);
+			if (!RenderTarget)
+			{
+				RenderTarget = NewObject<UTextureRenderTarget2D>();
+				RenderTarget->AddToRoot();
+				RenderTarget->InitCustomFormat(Size.X, Size.Y, PF_R8G8B8A8, true);
+				RenderTarget->UpdateResourceImmediate(true);
+			}
+
+			// Same size, so the cached size in the parameters still holds.
+			FShaderUsageExampleParameters DrawParameters = Job.Parameters;
+			DrawParameters.RenderTarget = RenderTarget;
+			Context->UpdateParameters(DrawParameters);
+			Context->DrawTarget(Job.SampleType);
+
+			// This waits for the draw. The shards run in processes of their own, so the GPU is kept busy by the others.
+			FTextureRenderTargetResource* RenderTargetResource = RenderTarget->GameThread_GetRenderTargetResource();
+			if (!RenderTargetResource || !RenderTargetResource->ReadPixels(Pixels))
+			{
+				OutStats.NumFailed++;
+				continue;
+			}
+		}
+
+		if (Writer.Write(Index, Pixels))
+		{
+			OutStats.NumBaked++;
+			OutStats.BytesWritten += Pixels.Num() * sizeof(FColor);
+		}
+		else
+		{
+			OutStats.NumFailed++;
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		if (Now >= NextProgressTime)
+		{
+			NextProgressTime = Now + BakeProgressInterval;
+			UE_LOG(LogShaderPlugin, Display, TEXT("Shard %d/%d: %d of %d jobs done."), ShardIndex + 1, NumShards, OutStats.NumBaked + OutStats.NumSkipped + OutStats.NumFailed, NumShardJobs);
+		}
+	}
+
+	Writer.Close();
+	OutStats.Seconds = FPlatformTime::Seconds() - StartTime;
+
+	for (const TPair<FIntPoint, UTextureRenderTarget2D*>& Pair : RenderTargets)
+	{
+		Pair.Value->RemoveFromRoot();
+	}
+
+	if (Context)
+	{
+		FShaderDeclarationDemoModule::Get().ReleaseContext(nullptr);
+	}
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Shard %d/%d baked %d images on the %s in %.2f s (%.1f images/s, %.1f MB/s), %d skipped, %d failed."),
+		ShardIndex + 1, NumShards, OutStats.NumBaked, bUseCPU ? TEXT("CPU") : TEXT("GPU"), OutStats.Seconds,
+		OutStats.Seconds > 0.0 ? OutStats.NumBaked / OutStats.Seconds : 0.0,
+		OutStats.Seconds > 0.0 ? OutStats.BytesWritten / (1024.0 * 1024.0) / OutStats.Seconds : 0.0,
+		OutStats.NumSkipped, OutStats.NumFailed);
+
+	return OutStats.NumFailed == 0;
+}
+
+void FShaderPluginBatchBake::RenderCPU(const FShaderUsageExampleParameters& Parameters, TArray<FColor>& OutPixels)
+{
+	const FIntPoint Size = Parameters.GetRenderTargetSize();
+	OutPixels.SetNumUninitialized(Size.X * Size.Y, false);
+
+	// The shaders get the colors divided by 255, without any gamma conversion.
+	const FLinearColor StartColor = Parameters.StartColor.ReinterpretAsLinear();
+	const FLinearColor EndColor = Parameters.EndColor.ReinterpretAsLinear();
+	const float BlendFactor = Parameters.ComputeShaderBlend;
+
+	// Rows are independent. Workers started with -nothreading run this on their own thread, the pool is then the processes.
+	ParallelFor(Size.Y, [&](int32 Y)
+	{
+		FColor* Row = OutPixels.GetData() + Y * Size.X;
+		for (int32 X = 0; X < Size.X; X++)
+		{
+			// MainPixelShader in PixelShader.usf, with the compute shader output at full resolution.
+			const FVector2D PixelUV((X + 0.5f) / Size.X, (Y + 0.5f) / Size.Y);
+			const float Alpha = PixelUV.Size() / FMath::Sqrt(2.0f);
+			const FLinearColor SolidColor = FMath::Lerp(StartColor, EndColor, Alpha) * (1.0f - BlendFactor);
+
+			// Same mapping as FComputeShaderReference::RenderFrame.
+			const FVector2D ComputeUV(X / (float)Size.X - 0.5f, Y / (float)Size.Y - 0.5f);
+			const FLinearColor ComputeColor = FComputeShaderReference::EvaluatePixel(ComputeUV, Parameters.SimulationState) * BlendFactor;
+
+			Row[X] = (SolidColor + ComputeColor).ToFColor(false);
+		}
+	});
+}
@@ -0,0 +1,681 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginBenchmarks.h"
+
+#include "BlockCompressionExample.h"
+#include "BlockCompressionReference.h"
+#include "ComputeShaderExample.h"
+#include "ComputeShaderReference.h"
+#include "ParticleSimulation.h"
+#include "ParticleSimulationReference.h"
+#include "PixelShaderExample.h"
+#include "TextureUploadRing.h"
+#include "VertexFromCSExample.h"
+
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "RenderTargetPool.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Containers/Ticker.h"
+#include "Math/RandomStream.h"
+
+static FAutoConsoleCommand CBenchmarkBufferLayoutsCommand(
+	TEXT("ShaderPlugin.BenchmarkBufferLayouts"),
+	TEXT("Times the compute and pixel passes with every r.ShaderPlugin.BufferLayout and prints the results to the log.\n")
+	TEXT("Usage: ShaderPlugin.BenchmarkBufferLayouts [Size=1024] [Iterations=20]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Size = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 8) : 1024;
+		const int32 NumIterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 20;
+
+		ENQUEUE_RENDER_COMMAND(BenchmarkBufferLayoutsCommand)(
+			[Size, NumIterations](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginBenchmarks::BenchmarkBufferLayouts_RenderThread(RHICmdList, FIntPoint(Size, Size), NumIterations);
+		}
+		);
+	}));
+
+static FAutoConsoleCommand CReportHalfPrecisionErrorCommand(
+	TEXT("ShaderPlugin.ReportHalfPrecisionError"),
+	TEXT("Compares the half precision fractal against the full precision one and prints the error to the log.\n")
+	TEXT("Usage: ShaderPlugin.ReportHalfPrecisionError [Size=512] [SimulationState=10]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Size = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 8) : 512;
+		const float SimulationState = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+
+		ENQUEUE_RENDER_COMMAND(ReportHalfPrecisionErrorCommand)(
+			[Size, SimulationState](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginBenchmarks::ReportHalfPrecisionError_RenderThread(RHICmdList, FIntPoint(Size, Size), SimulationState);
+		}
+		);
+	}));
+
+static FAutoConsoleCommand CValidateParticlesCommand(
+	TEXT("ShaderPlugin.ValidateParticles"),
+	TEXT("Runs the GPU particle simulation next to the CPU reference and prints how far apart they end up to the log.\n")
+	TEXT("Usage: ShaderPlugin.ValidateParticles [Steps=120] [MaxParticles=262144]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumSteps = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 120;
+		const int32 MaxParticles = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 1, (int32)FParticleSimulationSettings::MaxDispatchableParticles) : 262144;
+
+		ENQUEUE_RENDER_COMMAND(ValidateParticlesCommand)(
+			[NumSteps, MaxParticles](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginBenchmarks::ValidateParticles_RenderThread(RHICmdList, NumSteps, MaxParticles);
+		}
+		);
+	}));
+
+static FAutoConsoleCommand CBenchmarkParticlesCommand(
+	TEXT("ShaderPlugin.BenchmarkParticles"),
+	TEXT("Times a particle simulation step and prints the results to the log. cpu times the CPU reference instead of the GPU.\n")
+	TEXT("Usage: ShaderPlugin.BenchmarkParticles [MaxParticles=1048576] [Steps=60] [cpu]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const bool bCPU = Args.Contains(TEXT("cpu"));
+		TArray<FString> NumberArgs = Args.FilterByPredicate([](const FString& Arg) { return Arg != TEXT("cpu"); });
+		const int32 MaxParticles = NumberArgs.Num() > 0 ? FMath::Clamp(FCString::Atoi(*NumberArgs[0]), 1, (int32)FParticleSimulationSettings::MaxDispatchableParticles) : 1 << 20;
+		const int32 NumSteps = NumberArgs.Num() > 1 ? FMath::Max(FCString::Atoi(*NumberArgs[1]), 1) : 60;
+
+		if (bCPU)
+		{
+			FShaderPluginBenchmarks::BenchmarkParticlesCPU(MaxParticles, NumSteps);
+			return;
+		}
+
+		ENQUEUE_RENDER_COMMAND(BenchmarkParticlesCommand)(
+			[MaxParticles, NumSteps](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginBenchmarks::BenchmarkParticles_RenderThread(RHICmdList, MaxParticles, NumSteps);
+		}
+		);
+	}));
+
+static FAutoConsoleCommand CValidateCompressionCommand(
+	TEXT("ShaderPlugin.ValidateCompression"),
+	TEXT("Block compresses a frame of the fractal and prints the quality, and how well the GPU encoder matches the CPU one, to the log.\n")
+	TEXT("Usage: ShaderPlugin.ValidateCompression [Size=512] [bc1|bc3] [SimulationState=10]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const EShaderPluginCompression Compression = Args.Contains(TEXT("bc3")) ? EShaderPluginCompression::BC3 : EShaderPluginCompression::BC1;
+		TArray<FString> NumberArgs = Args.FilterByPredicate([](const FString& Arg) { return Arg != TEXT("bc1") && Arg != TEXT("bc3"); });
+		const int32 Size = NumberArgs.Num() > 0 ? FMath::Max(FCString::Atoi(*NumberArgs[0]), 4) / 4 * 4 : 512;
+		const float SimulationState = NumberArgs.Num() > 1 ? FCString::Atof(*NumberArgs[1]) : 10.0f;
+
+		ENQUEUE_RENDER_COMMAND(ValidateCompressionCommand)(
+			[Size, Compression, SimulationState](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginBenchmarks::ValidateCompression_RenderThread(RHICmdList, FIntPoint(Size, Size), Compression, SimulationState);
+		}
+		);
+	}));
+
+static FAutoConsoleCommand CBenchmarkRingTopologyCommand(
+	TEXT("ShaderPlugin.BenchmarkRingTopology"),
+	TEXT("Times drawing the vertex sample's ring as a fan and with the max area triangulation, and prints the results to the log.\n")
+	TEXT("Usage: ShaderPlugin.BenchmarkRingTopology [Size=1024] [Radius=0.9] [Iterations=20]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Size = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 8) : 1024;
+		const float Radius = Args.Num() > 1 ? FMath::Max(FCString::Atof(*Args[1]), 0.0f) : 0.9f;
+		const int32 NumIterations = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 20;
+
+		ENQUEUE_RENDER_COMMAND(BenchmarkRingTopologyCommand)(
+			[Size, Radius, NumIterations](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginBenchmarks::BenchmarkRingTopology_RenderThread(RHICmdList, FIntPoint(Size, Size), Radius, NumIterations);
+		}
+		);
+	}));
+
+static FAutoConsoleCommand CBenchmarkSourceUploadCommand(
+	TEXT("ShaderPlugin.BenchmarkSourceUpload"),
+	TEXT("Streams generated images through an upload ring over the next frames and prints the throughput to the log.\n")
+	TEXT("Usage: ShaderPlugin.BenchmarkSourceUpload [Size=1024] [Frames=120] [ImagesPerFrame=1] [Slots=3]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 Size = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1024;
+		const int32 NumFrames = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 120;
+		const int32 ImagesPerFrame = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 1;
+		const int32 NumSlots = Args.Num() > 3 ? FMath::Max(FCString::Atoi(*Args[3]), 2) : 3;
+
+		FShaderPluginBenchmarks::BenchmarkSourceUpload(FIntPoint(Size, Size), NumFrames, ImagesPerFrame, NumSlots);
+	}));
+
+// Both benchmarks and the validation step at a fixed rate, so the results don't depend on the frame rate.
+#define PARTICLE_BENCHMARK_DELTA_TIME (1.0f / 60.0f)
+
+FShaderPluginBenchmarks::FImageDifference FShaderPluginBenchmarks::CompareImages(const TArray<FColor>& Reference, const TArray<FColor>& Test, int32 Threshold /*= 2*/)
+{
+	check(Reference.Num() == Test.Num());
+
+	double SumAbsoluteError = 0.0;
+	double SumSquaredError = 0.0;
+	int32 MaxAbsoluteError = 0;
+	int32 NumPixelsOverThreshold = 0;
+
+	for (int32 i = 0; i < Reference.Num(); i++)
+	{
+		const int32 Errors[3] =
+		{
+			FMath::Abs((int32)Reference[i].R - (int32)Test[i].R),
+			FMath::Abs((int32)Reference[i].G - (int32)Test[i].G),
+			FMath::Abs((int32)Reference[i].B - (int32)Test[i].B),
+		};
+
+		int32 PixelMaxError = 0;
+		for (int32 Error : Errors)
+		{
+			SumAbsoluteError += Error;
+			SumSquaredError += Error * Error;
+			PixelMaxError = FMath::Max(PixelMaxError, Error);
+		}
+
+		MaxAbsoluteError = FMath::Max(MaxAbsoluteError, PixelMaxError);
+		NumPixelsOverThreshold += PixelMaxError > Threshold ? 1 : 0;
+	}
+
+	const double NumSamples = FMath::Max(Reference.Num() * 3, 1);
+	const double MeanSquaredError = SumSquaredError / NumSamples;
+
+	FImageDifference Difference;
+	Difference.MeanAbsoluteError = SumAbsoluteError / NumSamples;
+	Difference.MaxAbsoluteError = MaxAbsoluteError;
+	Difference.PSNR = MeanSquaredError > 0.0 ? 10.0 * FMath::LogX(10.0f, (float)(255.0 * 255.0 / MeanSquaredError)) : TNumericLimits<float>::Max();
+	Difference.PercentPixelsOverThreshold = 100.0 * NumPixelsOverThreshold / FMath::Max(Reference.Num(), 1);
+	Difference.Threshold = Threshold;
+	return Difference;
+}
+
+static void LogImageDifference(const TCHAR* Name, const FShaderPluginBenchmarks::FImageDifference& Difference)
+{
+	UE_LOG(LogShaderPlugin, Display, TEXT("%s: PSNR %.2f dB, mean error %.3f, max error %d, %.2f%% of pixels off by more than %d/255"),
+		Name, Difference.PSNR, Difference.MeanAbsoluteError, Difference.MaxAbsoluteError, Difference.PercentPixelsOverThreshold, Difference.Threshold);
+}
+
+double FShaderPluginBenchmarks::MeasureGPUTime_RenderThread(FRHICommandListImmediate& RHICmdList, TFunctionRef<void()> Work)
+{
+	check(IsInRenderingThread());
+
+	if (!GSupportsTimestampRenderQueries)
+	{
+		Work();
+		return -1.0;
+	}
+
+	FRenderQueryRHIRef StartQuery = RHICreateRenderQuery(RQT_AbsoluteTime);
+	FRenderQueryRHIRef EndQuery = RHICreateRenderQuery(RQT_AbsoluteTime);
+
+	RHICmdList.EndRenderQuery(StartQuery);
+	Work();
+	RHICmdList.EndRenderQuery(EndQuery);
+
+	RHICmdList.SubmitCommandsHint();
+	RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+
+	// Timestamp results are in microseconds.
+	uint64 StartTime = 0;
+	uint64 EndTime = 0;
+	if (!RHIGetRenderQueryResult(StartQuery, StartTime, true) || !RHIGetRenderQueryResult(EndQuery, EndTime, true))
+	{
+		return -1.0;
+	}
+
+	return (EndTime - StartTime) / 1000.0;
+}
+
+void FShaderPluginBenchmarks::BenchmarkBufferLayouts_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, int32 NumIterations)
+{
+	check(IsInRenderingThread());
+
+	FShaderUsageExampleParameters DrawParameters(Size);
+	DrawParameters.ComputeShaderBlend = 1.0f;
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = CreateShaderPluginTargetUniformBuffer(DrawParameters);
+
+	TRefCountPtr<IPooledRenderTarget> ComputeShaderOutput;
+	FPooledRenderTargetDesc ComputeShaderOutputDesc(FPooledRenderTargetDesc::Create2DDesc(Size, PF_R8G8B8A8, FClearValueBinding::None, TexCreate_None, TexCreate_RenderTargetable | TexCreate_UAV, false));
+	ComputeShaderOutputDesc.DebugName = TEXT("ShaderPlugin_BenchmarkComputeShaderOutput");
+	GRenderTargetPool.FindFreeElement(RHICmdList, ComputeShaderOutputDesc, ComputeShaderOutput, TEXT("ShaderPlugin_BenchmarkComputeShaderOutput"));
+
+	TRefCountPtr<IPooledRenderTarget> RenderTarget;
+	FPooledRenderTargetDesc RenderTargetDesc(FPooledRenderTargetDesc::Create2DDesc(Size, PF_R8G8B8A8, FClearValueBinding::Black, TexCreate_None, TexCreate_RenderTargetable, false));
+	RenderTargetDesc.DebugName = TEXT("ShaderPlugin_BenchmarkRenderTarget");
+	GRenderTargetPool.FindFreeElement(RHICmdList, RenderTargetDesc, RenderTarget, TEXT("ShaderPlugin_BenchmarkRenderTarget"));
+
+	for (int32 LayoutIndex = 0; LayoutIndex < (int32)EComputeBufferLayout::Num; LayoutIndex++)
+	{
+		const EComputeBufferLayout BufferLayout = (EComputeBufferLayout)LayoutIndex;
+
+		FRWBuffer Buffer;
+		Buffer.Initialize(sizeof(float) * 4, FComputeShaderExample::GetBufferNumElements(Size, BufferLayout), PF_A32B32G32R32F);
+
+		auto RunCompute = [&]()
+		{
+			FComputeShaderExample::RunComputeShader_RenderThread(RHICmdList, TargetUniformBuffer, Size, BufferLayout, ComputeShaderOutput->GetRenderTargetItem().UAV, Buffer.UAV);
+		};
+
+		auto RunPixel = [&]()
+		{
+			FPixelShaderExample::DrawToTexture_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer, RenderTarget->GetRenderTargetItem().TargetableTexture, Size, BufferLayout, ComputeShaderOutput->GetRenderTargetItem().TargetableTexture, Buffer.SRV);
+		};
+
+		// Warm up first, so PSO creation and first touch of the buffer stay out of the timings.
+		RunCompute();
+		RunPixel();
+
+		// The compute pass is dominated by the fractal math, so the pixel pass shows the read side of the layout much more clearly.
+		const double ComputeMs = MeasureGPUTime_RenderThread(RHICmdList, [&]() { for (int32 i = 0; i < NumIterations; i++) { RunCompute(); } });
+		const double PixelMs = MeasureGPUTime_RenderThread(RHICmdList, [&]() { for (int32 i = 0; i < NumIterations; i++) { RunPixel(); } });
+
+		if (ComputeMs < 0.0 || PixelMs < 0.0)
+		{
+			UE_LOG(LogShaderPlugin, Warning, TEXT("ShaderPlugin.BenchmarkBufferLayouts needs GPU timestamp queries, which this RHI doesn't support."));
+			return;
+		}
+
+		UE_LOG(LogShaderPlugin, Display, TEXT("BufferLayout %-12s %dx%d: compute %.3f ms, pixel %.3f ms (average of %d)"),
+			FComputeShaderExample::GetBufferLayoutName(BufferLayout), Size.X, Size.Y, ComputeMs / NumIterations, PixelMs / NumIterations, NumIterations);
+	}
+}
+
+void FShaderPluginBenchmarks::ReportHalfPrecisionError_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, float SimulationState)
+{
+	check(IsInRenderingThread());
+
+	FShaderUsageExampleParameters DrawParameters(Size);
+	DrawParameters.SimulationState = SimulationState;
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = CreateShaderPluginTargetUniformBuffer(DrawParameters);
+
+	FRWBuffer Buffer;
+	Buffer.Initialize(sizeof(float) * 4, Size.X * Size.Y, PF_A32B32G32R32F);
+
+	TArray<FColor> Outputs[2];
+	for (int32 Precision = 0; Precision < 2; Precision++)
+	{
+		const bool bHalfPrecision = Precision == 1;
+
+		TRefCountPtr<IPooledRenderTarget> ComputeShaderOutput;
+		FPooledRenderTargetDesc ComputeShaderOutputDesc(FPooledRenderTargetDesc::Create2DDesc(Size, PF_R8G8B8A8, FClearValueBinding::None, TexCreate_None, TexCreate_RenderTargetable | TexCreate_UAV, false));
+		ComputeShaderOutputDesc.DebugName = TEXT("ShaderPlugin_PrecisionComputeShaderOutput");
+		GRenderTargetPool.FindFreeElement(RHICmdList, ComputeShaderOutputDesc, ComputeShaderOutput, TEXT("ShaderPlugin_PrecisionComputeShaderOutput"));
+
+		FComputeShaderExample::RunComputeShader_RenderThread(RHICmdList, TargetUniformBuffer, Size, EComputeBufferLayout::Linear, ComputeShaderOutput->GetRenderTargetItem().UAV, Buffer.UAV, bHalfPrecision);
+		RHICmdList.ReadSurfaceData(ComputeShaderOutput->GetRenderTargetItem().TargetableTexture, FIntRect(FIntPoint::ZeroValue, Size), Outputs[Precision], FReadSurfaceDataFlags());
+	}
+
+	TArray<FColor> Reference;
+	Reference.SetNumUninitialized(Size.X * Size.Y);
+	FComputeShaderReference::RenderFrame(Size, SimulationState, Reference.GetData(), Size.X);
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Fractal precision report for %dx%d at SimulationState %.2f:"), Size.X, Size.Y, SimulationState);
+	LogImageDifference(TEXT("  GPU full precision vs CPU reference"), CompareImages(Reference, Outputs[0]));
+	LogImageDifference(TEXT("  GPU half precision vs GPU full precision"), CompareImages(Outputs[0], Outputs[1]));
+}
+
+void FShaderPluginBenchmarks::ValidateParticles_RenderThread(FRHICommandListImmediate& RHICmdList, int32 NumSteps, int32 MaxParticles)
+{
+	check(IsInRenderingThread());
+
+	if (GMaxRHIFeatureLevel < ERHIFeatureLevel::SM5)
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("ShaderPlugin.ValidateParticles needs SM5."));
+		return;
+	}
+
+	// At this rate there can never be more live particles than slots, so every spawn succeeds on both sides.
+	FParticleSimulationSettings Settings;
+	Settings.MaxParticles = MaxParticles;
+	Settings.SpawnRate = MaxParticles / Settings.ParticleLifetime;
+
+	FShaderUsageExampleParameters DrawParameters(FIntPoint(1, 1));
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = CreateShaderPluginTargetUniformBuffer(DrawParameters);
+
+	FParticleSimulation Simulation;
+	FParticleSimulationReference Reference(Settings);
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		Simulation.Simulate_RenderThread(RHICmdList, Settings, PARTICLE_BENCHMARK_DELTA_TIME, TargetUniformBuffer);
+		Reference.Step(PARTICLE_BENCHMARK_DELTA_TIME);
+	}
+
+	TArray<FParticleState> GPUParticles;
+	Simulation.ReadState_RenderThread(RHICmdList, GPUParticles);
+	Simulation.Release_RenderThread();
+
+	TArray<FParticleState> GPULive;
+	TArray<FParticleState> CPULive;
+	FParticleSimulationReference::GetSortedLiveParticles(GPUParticles, GPULive);
+	FParticleSimulationReference::GetSortedLiveParticles(Reference.GetParticles(), CPULive);
+
+	// The GPU's sin and cos aren't bit exact, and the difference grows a little with every step and bounce.
+	const float Tolerance = 1e-3f;
+	const int32 NumCompared = FMath::Min(GPULive.Num(), CPULive.Num());
+	double TotalError = 0.0;
+	float MaxError = 0.0f;
+	int32 NumOverTolerance = 0;
+	for (int32 Index = 0; Index < NumCompared; Index++)
+	{
+		const float Error = FVector::Dist(GPULive[Index].Position, CPULive[Index].Position);
+		TotalError += Error;
+		MaxError = FMath::Max(MaxError, Error);
+		NumOverTolerance += Error > Tolerance ? 1 : 0;
+	}
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Particle validation, %d slots after %d steps: %d alive on the GPU, %d on the CPU."),
+		MaxParticles, NumSteps, GPULive.Num(), CPULive.Num());
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Position error: mean %.6f, max %.6f, %.2f%% of particles off by more than %g"),
+		NumCompared > 0 ? TotalError / NumCompared : 0.0, MaxError, NumCompared > 0 ? 100.0 * NumOverTolerance / NumCompared : 0.0, Tolerance);
+
+	if (GPULive.Num() != CPULive.Num())
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("  The GPU and CPU disagree on how many particles are alive."));
+	}
+}
+
+void FShaderPluginBenchmarks::BenchmarkParticles_RenderThread(FRHICommandListImmediate& RHICmdList, int32 MaxParticles, int32 NumSteps)
+{
+	check(IsInRenderingThread());
+
+	if (GMaxRHIFeatureLevel < ERHIFeatureLevel::SM5)
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("ShaderPlugin.BenchmarkParticles needs SM5, try ShaderPlugin.BenchmarkParticles %d %d cpu."), MaxParticles, NumSteps);
+		return;
+	}
+
+	FParticleSimulationSettings Settings;
+	Settings.MaxParticles = MaxParticles;
+
+	FShaderUsageExampleParameters DrawParameters(FIntPoint(1, 1));
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = CreateShaderPluginTargetUniformBuffer(DrawParameters);
+
+	// Warm up first, so allocation and PSO creation stay out of the timings and there are particles to move.
+	FParticleSimulation Simulation;
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		Simulation.Simulate_RenderThread(RHICmdList, Settings, PARTICLE_BENCHMARK_DELTA_TIME, TargetUniformBuffer);
+	}
+
+	const double GPUMs = MeasureGPUTime_RenderThread(RHICmdList, [&]()
+	{
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			Simulation.Simulate_RenderThread(RHICmdList, Settings, PARTICLE_BENCHMARK_DELTA_TIME, TargetUniformBuffer);
+		}
+	});
+	Simulation.Release_RenderThread();
+
+	if (GPUMs < 0.0)
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("ShaderPlugin.BenchmarkParticles needs GPU timestamp queries, which this RHI doesn't support."));
+		return;
+	}
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Particles on the GPU, %d slots: %.3f ms per step, %.1f Mparticles/s (average of %d)"),
+		MaxParticles, GPUMs / NumSteps, GPUMs > 0.0 ? (double)MaxParticles * NumSteps / (GPUMs * 1000.0) : 0.0, NumSteps);
+}
+
+void FShaderPluginBenchmarks::BenchmarkParticlesCPU(int32 MaxParticles, int32 NumSteps)
+{
+	FParticleSimulationSettings Settings;
+	Settings.MaxParticles = MaxParticles;
+
+	FParticleSimulationReference Reference(Settings);
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		Reference.Step(PARTICLE_BENCHMARK_DELTA_TIME);
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		Reference.Step(PARTICLE_BENCHMARK_DELTA_TIME);
+	}
+	const double CPUMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Particles on the CPU, %d slots: %.3f ms per step, %.1f Mparticles/s (average of %d, %d alive)"),
+		MaxParticles, CPUMs / NumSteps, CPUMs > 0.0 ? (double)MaxParticles * NumSteps / (CPUMs * 1000.0) : 0.0, NumSteps, Reference.GetNumAlive());
+}
+
+void FShaderPluginBenchmarks::ValidateCompression_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, EShaderPluginCompression Compression, float SimulationState)
+{
+	check(IsInRenderingThread());
+
+	const TCHAR* CompressionName = Compression == EShaderPluginCompression::BC3 ? TEXT("BC3") : TEXT("BC1");
+	const int32 WordsPerBlock = FBlockCompressionReference::GetWordsPerBlock(Compression);
+	const FIntPoint NumBlocks(Size.X / 4, Size.Y / 4);
+
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(Size.X * Size.Y);
+	FComputeShaderReference::RenderFrame(Size, SimulationState, Pixels.GetData(), Size.X);
+
+	TArray<uint32> ReferenceBlocks;
+	TArray<FColor> ReferenceDecoded;
+	FBlockCompressionReference::Compress(Pixels.GetData(), Size, Compression, ReferenceBlocks);
+	FBlockCompressionReference::Decompress(ReferenceBlocks, Size, Compression, ReferenceDecoded);
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("%s compression of %dx%d at SimulationState %.2f: %d KB down to %d KB (%d:1)"), CompressionName, Size.X, Size.Y, SimulationState,
+		Pixels.Num() * Pixels.GetTypeSize() / 1024, ReferenceBlocks.Num() * ReferenceBlocks.GetTypeSize() / 1024, Pixels.GetTypeSize() * 16 / (WordsPerBlock * 4));
+	LogImageDifference(TEXT("  CPU encoder vs source"), CompareImages(Pixels, ReferenceDecoded));
+
+	if (GUsingNullRHI || !FBlockCompressionExample::IsSupported())
+	{
+		UE_LOG(LogShaderPlugin, Display, TEXT("  Skipping the GPU encoder, it needs SM5."));
+		return;
+	}
+
+	// FColor is BGRA in memory.
+	FRHIResourceCreateInfo CreateInfo;
+	FTexture2DRHIRef SourceTexture = RHICreateTexture2D(Size.X, Size.Y, PF_B8G8R8A8, 1, 1, TexCreate_ShaderResource, CreateInfo);
+	RHIUpdateTexture2D(SourceTexture, 0, FUpdateTextureRegion2D(0, 0, 0, 0, Size.X, Size.Y), Size.X * Pixels.GetTypeSize(), (const uint8*)Pixels.GetData());
+
+	FTexture2DRHIRef BlockTexture = RHICreateTexture2D(NumBlocks.X, NumBlocks.Y, FBlockCompressionExample::GetBlockFormat(Compression), 1, 1, TexCreate_UAV | TexCreate_ShaderResource, CreateInfo);
+	FUnorderedAccessViewRHIRef BlockUAV = RHICreateUnorderedAccessView(BlockTexture);
+	FBlockCompressionExample::CompressToBlocks_RenderThread(RHICmdList, SourceTexture, BlockUAV, NumBlocks, Compression);
+
+	TArray<uint32> GPUBlocks;
+	GPUBlocks.SetNumUninitialized(ReferenceBlocks.Num());
+	uint32 Stride = 0;
+	const uint8* BlockData = (const uint8*)RHILockTexture2D(BlockTexture, 0, RLM_ReadOnly, Stride, false);
+	for (int32 BlockY = 0; BlockY < NumBlocks.Y; BlockY++)
+	{
+		FMemory::Memcpy(&GPUBlocks[BlockY * NumBlocks.X * WordsPerBlock], BlockData + BlockY * Stride, NumBlocks.X * WordsPerBlock * sizeof(uint32));
+	}
+	RHIUnlockTexture2D(BlockTexture, 0, false);
+
+	int32 NumMatchingBlocks = 0;
+	for (int32 BlockIndex = 0; BlockIndex < NumBlocks.X * NumBlocks.Y; BlockIndex++)
+	{
+		const int32 Offset = BlockIndex * WordsPerBlock;
+		NumMatchingBlocks += FMemory::Memcmp(&GPUBlocks[Offset], &ReferenceBlocks[Offset], WordsPerBlock * sizeof(uint32)) == 0 ? 1 : 0;
+	}
+
+	TArray<FColor> GPUDecoded;
+	FBlockCompressionReference::Decompress(GPUBlocks, Size, Compression, GPUDecoded);
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("  %.2f%% of the GPU blocks are identical to the CPU ones"), 100.0 * NumMatchingBlocks / FMath::Max(NumBlocks.X * NumBlocks.Y, 1));
+	LogImageDifference(TEXT("  GPU encoder vs source"), CompareImages(Pixels, GPUDecoded));
+}
+
+void FShaderPluginBenchmarks::BenchmarkRingTopology_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, float Radius, int32 NumIterations)
+{
+	check(IsInRenderingThread());
+
+	FShaderUsageExampleParameters DrawParameters(Size);
+	DrawParameters.ComputeRadius = Radius;
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = CreateShaderPluginTargetUniformBuffer(DrawParameters);
+
+	TRefCountPtr<IPooledRenderTarget> RenderTarget;
+	FPooledRenderTargetDesc RenderTargetDesc(FPooledRenderTargetDesc::Create2DDesc(Size, PF_R8G8B8A8, FClearValueBinding::Black, TexCreate_None, TexCreate_RenderTargetable, false));
+	RenderTargetDesc.DebugName = TEXT("ShaderPlugin_BenchmarkRenderTarget");
+	GRenderTargetPool.FindFreeElement(RHICmdList, RenderTargetDesc, RenderTarget, TEXT("ShaderPlugin_BenchmarkRenderTarget"));
+
+	FVertexFromCSDrawTransform Transform;
+	Transform.Scale = Radius;
+	const float RadiusInPixels = FVertexFromCSExample::GetRingRadiusInPixels(Size, Transform);
+
+	// Culling is left out on purpose, it only hides how much the triangles themselves cost to fill.
+	FVertexFromCSRing Ring;
+	double FanMs = -1.0;
+	for (int32 Run = 0; Run < 3; Run++)
+	{
+		const EVertexRingTopology Topology = Run == 0 ? EVertexRingTopology::Fan : EVertexRingTopology::MaxArea;
+		const float MinTriangleSize = Run == 2 ? FVertexFromCSExample::GetMinTriangleSize_RenderThread() : 0.0f;
+
+		Ring.SetTopology_RenderThread(Topology);
+		Ring.Update_RenderThread(RHICmdList, GBlackTexture->TextureRHI);
+		const uint32 NumTriangles = Ring.GetNumTriangles(RadiusInPixels, MinTriangleSize);
+
+		auto Draw = [&]()
+		{
+			FVertexFromCSExample::DrawToTexture_RenderThread(RHICmdList, TargetUniformBuffer, RenderTarget->GetRenderTargetItem().TargetableTexture, Ring.GetVertexOutput(), Ring.GetIndexBuffer(), NumTriangles, Transform);
+		};
+
+		// Warm up first, so PSO creation and the upload of the index buffer stay out of the timings.
+		Draw();
+
+		const double DrawMs = MeasureGPUTime_RenderThread(RHICmdList, [&]() { for (int32 i = 0; i < NumIterations; i++) { Draw(); } }) / NumIterations;
+		if (DrawMs < 0.0)
+		{
+			UE_LOG(LogShaderPlugin, Warning, TEXT("ShaderPlugin.BenchmarkRingTopology needs GPU timestamp queries, which this RHI doesn't support."));
+			return;
+		}
+
+		FanMs = Run == 0 ? DrawMs : FanMs;
+		UE_LOG(LogShaderPlugin, Display, TEXT("Ring %-8s %dx%d, %.0f px radius, min triangle size %.2f px: %7d triangles, %.3f ms, %.2fx as fast as the fan (average of %d)"),
+			FVertexFromCSExample::GetRingTopologyName(Topology), Size.X, Size.Y, RadiusInPixels, MinTriangleSize, NumTriangles, DrawMs, FanMs / FMath::Max(DrawMs, 0.001), NumIterations);
+	}
+
+	Ring.Release_RenderThread();
+}
+
+// Shared by the ticker that drives BenchmarkSourceUpload and the render commands it enqueues.
+struct FSourceUploadBenchmark
+{
+	FIntPoint Size;
+	int32 NumFrames;
+	int32 ImagesPerFrame;
+	TArray<TArray<FColor>> Images; // Game thread only
+	int32 FramesSubmitted = 0; // Game thread only
+	int32 FramesWaited = 0; // Game thread only
+	TSharedPtr<FTextureUploadRing> Ring; // Render thread only
+	double StartTime = 0.0; // Render thread only
+	FThreadSafeBool bFinished;
+};
+
+// Gives up on uploads the GPU still hasn't finished this many frames after the last one was submitted.
+#define SOURCE_UPLOAD_BENCHMARK_MAX_WAIT_FRAMES 300
+
+static void FinishSourceUploadBenchmark_RenderThread(FRHICommandListImmediate& RHICmdList, FSourceUploadBenchmark& Benchmark, bool bGiveUp)
+{
+	if (Benchmark.bFinished)
+	{
+		return;
+	}
+
+	Benchmark.Ring->GetLatest_RenderThread(RHICmdList);
+	if (Benchmark.Ring->HasPendingUploads() && !bGiveUp)
+	{
+		return;
+	}
+
+	// Completion is only noticed when we poll, once a frame, so the end to end number is on the low side.
+	const double TotalSeconds = FMath::Max(FPlatformTime::Seconds() - Benchmark.StartTime, SMALL_NUMBER);
+	const FTextureUploadRingStats& Stats = Benchmark.Ring->GetStats();
+	const double MegaBytes = 1024.0 * 1024.0;
+	const int64 NumSubmitted = Stats.NumUploaded + Stats.NumDropped;
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Source upload of %dx%d images (%d KB), %d per frame over %d frames:"),
+		Benchmark.Size.X, Benchmark.Size.Y, Benchmark.Size.X * Benchmark.Size.Y * (int32)sizeof(FColor) / 1024, Benchmark.ImagesPerFrame, Benchmark.NumFrames);
+	UE_LOG(LogShaderPlugin, Display, TEXT("  %lld uploaded, %lld dropped (%.1f%%), %lld seen finished by the GPU"),
+		Stats.NumUploaded, Stats.NumDropped, 100.0 * Stats.NumDropped / FMath::Max<int64>(NumSubmitted, 1), Stats.NumCompleted);
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Render thread: %.3f ms per upload, %.1f MB/s handed to the RHI"),
+		1000.0 * Stats.UploadSeconds / FMath::Max<int64>(Stats.NumUploaded, 1), Stats.BytesUploaded / MegaBytes / FMath::Max(Stats.UploadSeconds, SMALL_NUMBER));
+	UE_LOG(LogShaderPlugin, Display, TEXT("  End to end: %.1f MB/s over %.3f s"), Stats.BytesCompleted / MegaBytes / TotalSeconds, TotalSeconds);
+
+	if (bGiveUp && Benchmark.Ring->HasPendingUploads())
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("  Gave up waiting for the GPU after %d frames."), SOURCE_UPLOAD_BENCHMARK_MAX_WAIT_FRAMES);
+	}
+
+	Benchmark.Ring.Reset();
+	Benchmark.bFinished = true;
+}
+
+void FShaderPluginBenchmarks::BenchmarkSourceUpload(const FIntPoint& Size, int32 NumFrames, int32 ImagesPerFrame, int32 NumSlots)
+{
+	check(IsInGameThread());
+
+	TSharedRef<FSourceUploadBenchmark, ESPMode::ThreadSafe> Benchmark = MakeShared<FSourceUploadBenchmark, ESPMode::ThreadSafe>();
+	Benchmark->Size = Size;
+	Benchmark->NumFrames = NumFrames;
+	Benchmark->ImagesPerFrame = ImagesPerFrame;
+
+	// A few different images, made up front so generating them isn't part of what we measure.
+	FRandomStream Random(1234);
+	Benchmark->Images.SetNum(3);
+	for (TArray<FColor>& Image : Benchmark->Images)
+	{
+		Image.SetNumUninitialized(Size.X * Size.Y);
+		for (FColor& Pixel : Image)
+		{
+			Pixel = FColor(Random.RandRange(0, 255), Random.RandRange(0, 255), Random.RandRange(0, 255), 255);
+		}
+	}
+
+	ENQUEUE_RENDER_COMMAND(StartSourceUploadBenchmarkCommand)(
+		[Benchmark, NumSlots](FRHICommandListImmediate& RHICmdList)
+	{
+		Benchmark->Ring = MakeShared<FTextureUploadRing>(NumSlots);
+		Benchmark->StartTime = FPlatformTime::Seconds();
+	}
+	);
+
+	// The images are handed over the same way SubmitSourceImage does it, and read once a frame like a draw would.
+	FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Benchmark](float DeltaTime)
+	{
+		if (Benchmark->bFinished)
+		{
+			return false;
+		}
+
+		if (Benchmark->FramesSubmitted < Benchmark->NumFrames)
+		{
+			for (int32 ImageIndex = 0; ImageIndex < Benchmark->ImagesPerFrame; ImageIndex++)
+			{
+				TArray<FColor> Pixels = Benchmark->Images[(Benchmark->FramesSubmitted * Benchmark->ImagesPerFrame + ImageIndex) % Benchmark->Images.Num()];
+				ENQUEUE_RENDER_COMMAND(SourceUploadBenchmarkUploadCommand)(
+					[Benchmark, Pixels = MoveTemp(Pixels)](FRHICommandListImmediate& RHICmdList) mutable
+				{
+					Benchmark->Ring->Upload_RenderThread(RHICmdList, Benchmark->Size, MoveTemp(Pixels));
+				}
+				);
+			}
+
+			ENQUEUE_RENDER_COMMAND(SourceUploadBenchmarkReadCommand)(
+				[Benchmark](FRHICommandListImmediate& RHICmdList)
+			{
+				Benchmark->Ring->GetLatest_RenderThread(RHICmdList);
+			}
+			);
+
+			Benchmark->FramesSubmitted++;
+			return true;
+		}
+
+		const bool bGiveUp = ++Benchmark->FramesWaited >= SOURCE_UPLOAD_BENCHMARK_MAX_WAIT_FRAMES;
+		ENQUEUE_RENDER_COMMAND(FinishSourceUploadBenchmarkCommand)(
+			[Benchmark, bGiveUp](FRHICommandListImmediate& RHICmdList)
+		{
+			FinishSourceUploadBenchmark_RenderThread(RHICmdList, *Benchmark, bGiveUp);
+		}
+		);
+		return !bGiveUp;
+	}));
+}
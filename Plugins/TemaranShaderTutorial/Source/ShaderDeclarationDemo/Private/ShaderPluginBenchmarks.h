@@ -0,0 +1,61 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+
+/**************************************************************************************/
+/* Microbenchmarks for the plugin passes. They are all run from console commands and  */
+/* print their results to the log, so they work the same in the editor and on device. */
+/**************************************************************************************/
+class FShaderPluginBenchmarks
+{
+public:
+	// How far apart two images of the same size are, compared over the RGB channels.
+	struct FImageDifference
+	{
+		double MeanAbsoluteError;
+		int32 MaxAbsoluteError;
+		double PSNR; // In dB, infinite if the images are identical
+		double PercentPixelsOverThreshold;
+		int32 Threshold; // What PercentPixelsOverThreshold was counted against
+	};
+
+	// Pixels where any channel differs by more than Threshold count towards PercentPixelsOverThreshold.
+	static FImageDifference CompareImages(const TArray<FColor>& Reference, const TArray<FColor>& Test, int32 Threshold = 2);
+
+	// Runs Work between two GPU timestamps and waits for the result. Returns the GPU time in milliseconds,
+	// or a negative value if the RHI doesn't support timestamp queries.
+	static double MeasureGPUTime_RenderThread(FRHICommandListImmediate& RHICmdList, TFunctionRef<void()> Work);
+
+	// Times the compute and pixel passes separately for every EComputeBufferLayout.
+	static void BenchmarkBufferLayouts_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, int32 NumIterations);
+
+	// Renders one frame with the full and half precision compute shaders and logs how much they differ.
+	// The full precision output is also checked against the CPU reference, so we know the baseline itself is right.
+	static void ReportHalfPrecisionError_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, float SimulationState);
+
+	// Steps the GPU particle simulation and the CPU reference side by side at a fixed rate, and logs how far apart
+	// the live particles end up. The spawn rate is capped so no spawns are dropped, since which ones are is up to the GPU.
+	static void ValidateParticles_RenderThread(FRHICommandListImmediate& RHICmdList, int32 NumSteps, int32 MaxParticles);
+
+	// Times a simulation step for MaxParticles slots, on the GPU or with the CPU reference. The CPU version runs on the
+	// calling thread and doesn't need an RHI at all, so it also works with -nullrhi.
+	static void BenchmarkParticles_RenderThread(FRHICommandListImmediate& RHICmdList, int32 MaxParticles, int32 NumSteps);
+	static void BenchmarkParticlesCPU(int32 MaxParticles, int32 NumSteps);
+
+	// Compresses a frame of the fractal with the CPU reference and logs the quality. When the RHI can, the frame is also
+	// compressed on the GPU and the blocks are compared bit for bit with the reference.
+	static void ValidateCompression_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, EShaderPluginCompression Compression, float SimulationState);
+
+	// Times drawing the vertex sample's ring with each EVertexRingTopology at a radius of Radius, in clip space. The max
+	// area ring is timed with every level and with the ones r.ShaderPlugin.VertexRing.MinTriangleSize leaves out skipped.
+	static void BenchmarkRingTopology_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, float Radius, int32 NumIterations);
+
+	// Streams generated images through a FTextureUploadRing, ImagesPerFrame of them on each of the next NumFrames frames,
+	// and logs how many made it and the throughput in MB/s. Runs from the game thread over several frames, like real use.
+	static void BenchmarkSourceUpload(const FIntPoint& Size, int32 NumFrames, int32 ImagesPerFrame, int32 NumSlots);
+};
@@ -0,0 +1,631 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginContext.h"
+
+#include "AtlasPageExample.h"
+#include "BlockCompressionExample.h"
+#include "ComputeShaderExample.h"
+#include "GenerateMipsExample.h"
+#include "ParameterStream.h"
+#include "ParticleSimulation.h"
+#include "PixelShaderExample.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTargetParameters.h"
+#include "ShaderPluginTrace.h"
+#include "ShaderPluginViewExtension.h"
+#include "TextureUploadRing.h"
+#include "VertexFromCSExample.h"
+
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "RenderTargetPool.h"
+#include "RenderUtils.h"
+#include "TextureResource.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_GPU_STAT_NAMED(ShaderPlugin_Particles, TEXT("ShaderPlugin: Simulate and Draw Particles"));
+DECLARE_GPU_STAT_NAMED(ShaderPlugin_GenerateMips, TEXT("ShaderPlugin: Generate Mips"));
+DECLARE_GPU_STAT_NAMED(ShaderPlugin_BlockCompression, TEXT("ShaderPlugin: Block Compression"));
+
+static TAutoConsoleVariable<float> CVarComputeScale(
+	TEXT("r.ShaderPlugin.ComputeScale"),
+	1.0f,
+	TEXT("Fraction of the render target resolution the fractal compute shader runs at. The pixel shader upscales the result."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarDynamicComputeScale(
+	TEXT("r.ShaderPlugin.DynamicComputeScale"),
+	0,
+	TEXT("When enabled, the compute shader resolution is lowered while the GPU frame time is above the target and raised again when it is below."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarDynamicComputeScaleTargetTime(
+	TEXT("r.ShaderPlugin.DynamicComputeScale.TargetGPUTime"),
+	16.6f,
+	TEXT("GPU frame time in milliseconds the dynamic compute scale tries to stay under."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarDynamicComputeScaleMin(
+	TEXT("r.ShaderPlugin.DynamicComputeScale.Min"),
+	0.25f,
+	TEXT("Lowest scale the dynamic compute scale is allowed to go to."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarGenerateMips(
+	TEXT("r.ShaderPlugin.GenerateMips"),
+	1,
+	TEXT("When enabled, render targets that have \"Auto Generate Mips\" ticked get their mip chain rebuilt after every draw.\n")
+	TEXT("Needs SM5. Atlas pages never get mips, since their slots would bleed into each other."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarDirtyRectsMaxCoverage(
+	TEXT("r.ShaderPlugin.DirtyRects.MaxCoverage"),
+	0.5f,
+	TEXT("When the dirty rectangles of a draw cover more than this fraction of its render target, the whole target is redrawn\n")
+	TEXT("in one pass instead of one pass per rectangle. 0 ignores dirty rectangles and always redraws everything."),
+	ECVF_RenderThreadSafe);
+
+// Clips the dirty rectangles of a draw to its render target. Returns false if none of them are on the target, in which
+// case there is nothing to draw. OutRects is left empty when the whole target should be redrawn instead.
+static bool GetDirtyRects_RenderThread(const FShaderUsageExampleParameters& DrawParameters, TArray<FIntRect>& OutRects)
+{
+	OutRects.Reset();
+	if (DrawParameters.DirtyRects.Num() == 0)
+	{
+		return true;
+	}
+
+	const FIntRect TargetRect(FIntPoint::ZeroValue, DrawParameters.GetRenderTargetSize());
+	int64 DirtyArea = 0;
+	for (FIntRect Rect : DrawParameters.DirtyRects)
+	{
+		Rect.Clip(TargetRect);
+		if (Rect.Area() > 0)
+		{
+			OutRects.Add(Rect);
+			DirtyArea += Rect.Area();
+		}
+	}
+
+	if (OutRects.Num() == 0)
+	{
+		return false;
+	}
+
+	// Overlaps are counted twice, which only makes us fall back to a full redraw a little early.
+	if (DirtyArea > (int64)TargetRect.Area() * CVarDirtyRectsMaxCoverage.GetValueOnRenderThread())
+	{
+		OutRects.Reset();
+	}
+
+	return true;
+}
+
+// Where the compute shader has to run for the pixel shader to redraw TargetRect. When the fractal is upscaled, the rectangle
+// grows by a texel on each side since the bilinear filter along its edges also reads the texels just outside.
+static FIntRect GetComputeRect(const FIntRect& TargetRect, const FIntPoint& TargetSize, const FIntPoint& ComputeSize)
+{
+	if (ComputeSize == TargetSize)
+	{
+		return TargetRect;
+	}
+
+	const float ScaleX = ComputeSize.X / (float)TargetSize.X;
+	const float ScaleY = ComputeSize.Y / (float)TargetSize.Y;
+	FIntRect ComputeRect(
+		FMath::FloorToInt(TargetRect.Min.X * ScaleX) - 1,
+		FMath::FloorToInt(TargetRect.Min.Y * ScaleY) - 1,
+		FMath::CeilToInt(TargetRect.Max.X * ScaleX) + 1,
+		FMath::CeilToInt(TargetRect.Max.Y * ScaleY) + 1);
+	ComputeRect.Clip(FIntRect(FIntPoint::ZeroValue, ComputeSize));
+	return ComputeRect;
+}
+
+FShaderPluginContext::FShaderPluginContext(FShaderDeclarationDemoModule* InModule, const FString& InName, const UWorld* InWorld /*= nullptr*/)
+	: Module(InModule)
+	, Name(InName)
+	, MemoryTrackingName(*InName)
+	, World(InWorld)
+	, DynamicComputeScale(1.0f)
+	, DynamicComputeScaleFrameNumber(0)
+	, TargetUniformBuffers(MakeShared<FShaderPluginTargetUniformBufferCache>())
+	, bCachedParametersValid(false)
+	, NumRenderingClients(0)
+{
+}
+
+FShaderPluginContext::~FShaderPluginContext()
+{
+	check(!ViewExtension.IsValid());
+}
+
+void FShaderPluginContext::Release()
+{
+	check(IsInGameThread());
+
+	// Whoever called BeginRendering is going away with the world, they won't get to call EndRendering.
+	if (NumRenderingClients > 0)
+	{
+		NumRenderingClients = 1;
+		EndRendering();
+	}
+
+	auto* ThisPtr = this;
+	ENQUEUE_RENDER_COMMAND(ReleaseShaderPluginContextCommand)(
+		[ThisPtr](FRHICommandListImmediate& RHICmdList)
+	{
+		if (ThisPtr->ComputeShaderOutput.IsValid())
+		{
+			const FIntPoint Extent = ThisPtr->ComputeShaderOutput->GetDesc().Extent;
+			FShaderPluginMemory::TrackFree(EShaderPluginResource::ComputeShaderOutput, ThisPtr->MemoryTrackingName, CalculateImageBytes(Extent.X, Extent.Y, 0, PF_R8G8B8A8));
+			ThisPtr->ComputeShaderOutput.SafeRelease();
+		}
+		if (ThisPtr->AtlasPageComputeOutput.IsValid())
+		{
+			const FIntPoint Extent = ThisPtr->AtlasPageComputeOutput->GetDesc().Extent;
+			FShaderPluginMemory::TrackFree(EShaderPluginResource::AtlasPageComputeOutput, ThisPtr->MemoryTrackingName, CalculateImageBytes(Extent.X, Extent.Y, 0, PF_R8G8B8A8));
+			ThisPtr->AtlasPageComputeOutput.SafeRelease();
+		}
+		ThisPtr->ParticleSimulation.Reset();
+		ThisPtr->VertexRing.Reset();
+		ThisPtr->SourceImages.Reset();
+		ThisPtr->TargetUniformBuffers->Reset();
+		ThisPtr->SubmittedDraws.Reset();
+	}
+	);
+}
+
+void FShaderPluginContext::BeginRendering()
+{
+	check(IsInGameThread());
+
+	if (NumRenderingClients++ > 0)
+	{
+		return;
+	}
+
+	// From here on draws are queued and drawn by the extension, inside the engine's own frame.
+	ViewExtension = FSceneViewExtensions::NewExtension<FShaderPluginViewExtension>(this);
+}
+
+void FShaderPluginContext::EndRendering()
+{
+	check(IsInGameThread());
+
+	if (NumRenderingClients == 0 || --NumRenderingClients > 0)
+	{
+		return;
+	}
+
+	// The engine only holds on to extensions weakly, so this is all it takes to unregister.
+	ViewExtension.Reset();
+
+	// Anything still queued would never be drawn otherwise.
+	SubmitPendingDraws();
+	auto* ThisPtr = this;
+	ENQUEUE_RENDER_COMMAND(DrawRemainingTargetsCommand)(
+		[ThisPtr](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->DrawPendingTargets_RenderThread(RHICmdList);
+	}
+	);
+}
+
+void FShaderPluginContext::UpdateParameters(FShaderUsageExampleParameters& DrawParameters)
+{
+	SHADERPLUGIN_TRACE_SCOPE(UpdateParameters);
+
+	CachedShaderUsageExampleParameters = DrawParameters;
+	bCachedParametersValid = true;
+
+	if (Module->ParameterStreamWriter.IsValid())
+	{
+		Module->RecordParameters(*this, DrawParameters, true);
+	}
+}
+
+void FShaderPluginContext::DrawTarget(EShaderTestSampleType TestType /*= EShaderTestSampleType::ComputeAndPixel*/)
+{
+	SHADERPLUGIN_TRACE_SCOPE(DrawTarget);
+
+	if (!bCachedParametersValid)
+		return;
+
+	if (Module->ParameterStreamWriter.IsValid())
+	{
+		// Another context may have recorded its parameters since ours.
+		Module->RecordParameters(*this, CachedShaderUsageExampleParameters, false);
+		Module->ParameterStreamWriter->AppendDraw(TestType);
+	}
+
+	if (ViewExtension.IsValid())
+	{
+		QueueDraw(CachedShaderUsageExampleParameters, TestType, FIntRect());
+		return;
+	}
+
+	FShaderUsageExampleParameters Copy = CachedShaderUsageExampleParameters;
+	auto* ThisPtr = this;
+
+	ENQUEUE_RENDER_COMMAND(DrawTargetCommand)(
+		[ThisPtr, Copy, TestType](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->Draw_RenderThread(RHICmdList, Copy, TestType);
+	}
+	);
+}
+
+void FShaderPluginContext::DrawTargets(FShaderUsageExampleParameterBatch&& Batch)
+{
+	SHADERPLUGIN_TRACE_SCOPE(DrawTargets);
+
+	if (Batch.Num() == 0)
+	{
+		return;
+	}
+
+	Batch.CaptureRenderTargetNames();
+
+	if (Module->ParameterStreamWriter.IsValid())
+	{
+		for (int32 Index = 0; Index < Batch.Num(); Index++)
+		{
+			Module->ParameterStreamWriter->AppendUpdate(Batch.GetParameters(Index));
+			Module->ParameterStreamWriter->AppendDraw(Batch.SampleTypes[Index]);
+		}
+
+		// The batch replaced our parameters in the recording, the next DrawTarget has to record them again.
+		Module->LastRecordedContext = nullptr;
+	}
+
+	if (ViewExtension.IsValid())
+	{
+		for (int32 Index = 0; Index < Batch.Num(); Index++)
+		{
+			FShaderUsageExampleParameters DrawParameters = Batch.GetParameters(Index);
+			DrawParameters.RenderTarget = Batch.RenderTargets[Index];
+			QueueDraw(DrawParameters, Batch.SampleTypes[Index], Batch.AtlasRects[Index]);
+		}
+		return;
+	}
+
+	auto* ThisPtr = this;
+
+	ENQUEUE_RENDER_COMMAND(DrawTargetsCommand)(
+		[ThisPtr, Batch = MoveTemp(Batch)](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->DrawBatch_RenderThread(RHICmdList, Batch);
+	}
+	);
+}
+
+void FShaderPluginContext::QueueDraw(const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType TestType, const FIntRect& AtlasRect)
+{
+	check(IsInGameThread());
+
+	// Later requests for the same target replace earlier ones, so each target is drawn at most once per frame.
+	const TPair<UTextureRenderTarget2D*, FIntPoint> Key(DrawParameters.RenderTarget, AtlasRect.Min);
+	int32 Index = INDEX_NONE;
+	bool bReplacesQueuedDraw = false;
+	TArray<FIntRect> QueuedDirtyRects;
+	if (const int32* ExistingIndex = PendingDrawIndices.Find(Key))
+	{
+		Index = *ExistingIndex;
+		bReplacesQueuedDraw = true;
+		QueuedDirtyRects = MoveTemp(PendingDraws.DirtyRects[Index]);
+	}
+	else
+	{
+		Index = PendingDraws.Num();
+		PendingDraws.SetNumUninitialized(Index + 1);
+		PendingDrawIndices.Add(Key, Index);
+	}
+
+	PendingDraws.SetParameters(Index, DrawParameters, TestType, AtlasRect);
+
+	// The draw we replace never happens, so whatever it would have updated has to be updated by this one as well.
+	if (bReplacesQueuedDraw)
+	{
+		if (QueuedDirtyRects.Num() > 0 && DrawParameters.DirtyRects.Num() > 0)
+		{
+			PendingDraws.DirtyRects[Index].Append(QueuedDirtyRects);
+		}
+		else
+		{
+			PendingDraws.DirtyRects[Index].Reset();
+		}
+	}
+}
+
+void FShaderPluginContext::SubmitPendingDraws()
+{
+	check(IsInGameThread());
+	if (PendingDraws.Num() == 0)
+	{
+		return;
+	}
+
+	auto* ThisPtr = this;
+
+	ENQUEUE_RENDER_COMMAND(SubmitPendingDrawsCommand)(
+		[ThisPtr, Batch = MoveTemp(PendingDraws)](FRHICommandListImmediate& RHICmdList) mutable
+	{
+		ThisPtr->SubmittedDraws.Add(MoveTemp(Batch));
+	}
+	);
+
+	PendingDraws = FShaderUsageExampleParameterBatch();
+	PendingDrawIndices.Reset();
+}
+
+void FShaderPluginContext::DrawPendingTargets_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	for (const FShaderUsageExampleParameterBatch& Batch : SubmittedDraws)
+	{
+		DrawBatch_RenderThread(RHICmdList, Batch);
+	}
+	SubmittedDraws.Reset();
+}
+
+void FShaderPluginContext::DrawBatch_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameterBatch& Batch)
+{
+	check(IsInRenderingThread());
+
+	TMap<UTextureRenderTarget2D*, TArray<int32>> AtlasPages;
+	for (int32 Index = 0; Index < Batch.Num(); Index++)
+	{
+		if (Batch.IsAtlasSlot(Index))
+		{
+			AtlasPages.FindOrAdd(Batch.RenderTargets[Index]).Add(Index);
+		}
+		else
+		{
+			Draw_RenderThread(RHICmdList, Batch.GetParameters(Index), Batch.SampleTypes[Index]);
+		}
+	}
+
+	for (const TPair<UTextureRenderTarget2D*, TArray<int32>>& AtlasPage : AtlasPages)
+	{
+		FAtlasPageExample::DrawPage_RenderThread(RHICmdList, Batch, AtlasPage.Value, AtlasPageComputeOutput, MemoryTrackingName);
+	}
+}
+
+void FShaderPluginContext::SubmitSourceImage(const FIntPoint& Size, TArray<FColor>&& Pixels)
+{
+	check(IsInGameThread());
+
+	if (Size.X <= 0 || Size.Y <= 0 || Pixels.Num() != Size.X * Size.Y)
+	{
+		UE_LOG(LogShaderPlugin, Warning, TEXT("Ignoring source image with %d pixels, a %dx%d image needs %d."), Pixels.Num(), Size.X, Size.Y, FMath::Max(Size.X * Size.Y, 0));
+		return;
+	}
+
+	// The pixels are moved along with the command, the game thread is free to build the next image right away.
+	auto* ThisPtr = this;
+	ENQUEUE_RENDER_COMMAND(SubmitSourceImageCommand)(
+		[ThisPtr, Size, Pixels = MoveTemp(Pixels)](FRHICommandListImmediate& RHICmdList) mutable
+	{
+		if (!ThisPtr->SourceImages.IsValid())
+		{
+			ThisPtr->SourceImages = MakeShared<FTextureUploadRing>();
+		}
+		ThisPtr->SourceImages->Upload_RenderThread(RHICmdList, Size, MoveTemp(Pixels));
+	}
+	);
+}
+
+void FShaderPluginContext::ClearSourceImages()
+{
+	check(IsInGameThread());
+
+	auto* ThisPtr = this;
+	ENQUEUE_RENDER_COMMAND(ClearSourceImagesCommand)(
+		[ThisPtr](FRHICommandListImmediate& RHICmdList)
+	{
+		ThisPtr->SourceImages.Reset();
+	}
+	);
+}
+
+FRHITexture* FShaderPluginContext::GetSourceTexture_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	FRHITexture* SourceTexture = SourceImages.IsValid() ? SourceImages->GetLatest_RenderThread(RHICmdList) : nullptr;
+	return SourceTexture ? SourceTexture : GBlackTexture->TextureRHI.GetReference();
+}
+
+void FShaderPluginContext::Draw_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType Type /*= EShaderTestSampleType::ComputeAndPixel*/)
+{
+	check(IsInRenderingThread());
+	SHADERPLUGIN_TRACE_SCOPE(Draw_RenderThread);
+
+	switch (Type)
+	{
+	case EShaderTestSampleType::ComputeAndPixel:
+		RunComputeAndPixelSample_RenderThread(RHICmdList, DrawParameters, GetSourceTexture_RenderThread(RHICmdList));
+		break;
+
+	case EShaderTestSampleType::ComputeToVertexBuffer:
+	{
+		if (!VertexRing.IsValid())
+		{
+			VertexRing = MakeShared<FVertexFromCSRing>();
+		}
+
+		// Getting the texture can move on to a newer upload, so the sequence has to be read after it.
+		FRHITexture* SourceTexture = GetSourceTexture_RenderThread(RHICmdList);
+		const uint64 SourceSequence = SourceImages.IsValid() ? SourceImages->GetLatestSequence() : 0;
+		FVertexFromCSExample::RunVertexFromCS_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffers->Get(DrawParameters), *VertexRing, SourceTexture, SourceSequence);
+		break;
+	}
+
+	case EShaderTestSampleType::Particles:
+		RunParticleSample_RenderThread(RHICmdList, DrawParameters);
+		break;
+	}
+
+	if (!DrawParameters.RenderTarget)
+	{
+		return;
+	}
+
+	FTextureRenderTargetResource* RenderTargetResource = DrawParameters.RenderTarget->GetRenderTargetResource();
+	FRHITexture2D* Texture = RenderTargetResource && RenderTargetResource->TextureRHI.IsValid() ? RenderTargetResource->TextureRHI->GetTexture2D() : nullptr;
+
+	// Otherwise materials sampling the target from a distance only ever see mip 0, or stale mips if it has any.
+	if (CVarGenerateMips.GetValueOnRenderThread() != 0 && FGenerateMipsExample::CanGenerateMips(Texture))
+	{
+		SCOPED_GPU_STAT(RHICmdList, ShaderPlugin_GenerateMips);
+		FGenerateMipsExample::GenerateMips_RenderThread(RHICmdList, Texture);
+	}
+
+	// Only mip 0 is compressed, so it doesn't matter that this comes after the mips.
+	if (TSharedPtr<FCompressedTarget>* CompressedTarget = Module->CompressedTargetResources.Find(DrawParameters.RenderTarget))
+	{
+		SCOPED_GPU_STAT(RHICmdList, ShaderPlugin_BlockCompression);
+		FBlockCompressionExample::UpdateCompressedTarget_RenderThread(RHICmdList, Texture, **CompressedTarget);
+	}
+}
+
+void FShaderPluginContext::RunComputeAndPixelSample_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FRHITexture* SourceTexture)
+{
+	if (!DrawParameters.RenderTarget)
+	{
+		return;
+	}
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_Render); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Render); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+
+	TArray<FIntRect> DirtyRects;
+	if (!GetDirtyRects_RenderThread(DrawParameters, DirtyRects))
+	{
+		return;
+	}
+
+	// With a baked flipbook there is no need to run the compute shader at all.
+	if (DrawParameters.bUseFlipbook && Module->FlipbookTexture.IsValid())
+	{
+		FPixelShaderExample::DrawFlipbookToRenderTarget_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffers->Get(DrawParameters), Module->FlipbookTexture, Module->FlipbookSettings, DirtyRects);
+		return;
+	}
+
+	// The output is allocated at full resolution even when we compute at a lower one. That way changing the scale
+	// doesn't reallocate anything, we just write and sample a smaller part of it.
+	if (!ComputeShaderOutput.IsValid() || ComputeShaderOutput->GetDesc().Extent != DrawParameters.GetRenderTargetSize())
+	{
+		SHADERPLUGIN_TRACE_SCOPE(AllocateComputeShaderOutput);
+
+		if (ComputeShaderOutput.IsValid())
+		{
+			const FIntPoint OldExtent = ComputeShaderOutput->GetDesc().Extent;
+			FShaderPluginMemory::TrackFree(EShaderPluginResource::ComputeShaderOutput, MemoryTrackingName, CalculateImageBytes(OldExtent.X, OldExtent.Y, 0, PF_R8G8B8A8));
+		}
+
+		FPooledRenderTargetDesc ComputeShaderOutputDesc(FPooledRenderTargetDesc::Create2DDesc(DrawParameters.GetRenderTargetSize(), PF_R8G8B8A8, FClearValueBinding::None, TexCreate_None, TexCreate_RenderTargetable | TexCreate_UAV, false));
+		ComputeShaderOutputDesc.DebugName = TEXT("ShaderPlugin_ComputeShaderOutput");
+		GRenderTargetPool.FindFreeElement(RHICmdList, ComputeShaderOutputDesc, ComputeShaderOutput, TEXT("ShaderPlugin_ComputeShaderOutput"));
+		FShaderPluginMemory::TrackAllocation(EShaderPluginResource::ComputeShaderOutput, MemoryTrackingName, CalculateImageBytes(DrawParameters.GetRenderTargetSize().X, DrawParameters.GetRenderTargetSize().Y, 0, PF_R8G8B8A8));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	}
+
+	const EComputeBufferLayout BufferLayout = FComputeShaderExample::GetBufferLayout_RenderThread();
+
+	const uint32 NumBufferElements = FComputeShaderExample::GetBufferNumElements(DrawParameters.GetRenderTargetSize(), BufferLayout);
+	FRWBuffer TestRWBuffer;
+	{
+		SHADERPLUGIN_TRACE_SCOPE(BufferSetup);
+		TestRWBuffer.Initialize(sizeof(float) * 4, NumBufferElements, PF_A32B32G32R32F);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	}
+	FShaderPluginScopedMemory TestRWBufferMemory(EShaderPluginResource::ComputeShaderOutputBuffer, DrawParameters.GetRenderTargetName(), sizeof(float) * 4 * (int64)NumBufferElements);
+
+	const FIntPoint ComputeSize = GetComputeSize_RenderThread(DrawParameters);
+
+	// Everything both passes need to know about this target, uploaded only when it changes and bound by both.
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = TargetUniformBuffers->Get(DrawParameters, ComputeSize);
+
+	// The pixel shader only reads the compute output inside the rectangles it redraws, so that is all we have to compute.
+	// Outside them TestRWBuffer is never written, and ComputeShaderOutput keeps what earlier draws left there.
+	TArray<FIntRect> ComputeRects;
+	for (const FIntRect& DirtyRect : DirtyRects)
+	{
+		ComputeRects.Add(GetComputeRect(DirtyRect, DrawParameters.GetRenderTargetSize(), ComputeSize));
+	}
+
+	FComputeShaderExample::RunComputeShader_RenderThread(RHICmdList, TargetUniformBuffer, ComputeSize, BufferLayout, ComputeShaderOutput->GetRenderTargetItem().UAV, TestRWBuffer.UAV, FComputeShaderExample::UseHalfPrecision_RenderThread(), ComputeRects, SourceTexture);
+
+	FPixelShaderExample::DrawToRenderTarget_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer, ComputeSize, BufferLayout, ComputeShaderOutput->GetRenderTargetItem().TargetableTexture, TestRWBuffer.SRV, DirtyRects);
+}
+
+void FShaderPluginContext::RunParticleSample_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters)
+{
+	if (!DrawParameters.RenderTarget || GMaxRHIFeatureLevel < ERHIFeatureLevel::SM5)
+	{
+		return;
+	}
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_Particles); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Particles); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SCOPED_GPU_STAT(RHICmdList, ShaderPlugin_Particles);
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+
+	if (!ParticleSimulation.IsValid())
+	{
+		ParticleSimulation = MakeShared<FParticleSimulation>();
+	}
+
+	FShaderPluginTargetUniformBufferRef TargetUniformBuffer = TargetUniformBuffers->Get(DrawParameters);
+	const float DeltaTime = ParticleSimulation->Clock.Advance(DrawParameters.SimulationState);
+
+	ParticleSimulation->Simulate_RenderThread(RHICmdList, FParticleSimulationSettings::FromConsoleVariables(), DeltaTime, TargetUniformBuffer);
+	ParticleSimulation->Draw_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer);
+}
+
+FIntPoint FShaderPluginContext::GetComputeSize_RenderThread(const FShaderUsageExampleParameters& DrawParameters)
+{
+	check(IsInRenderingThread());
+
+	if (CVarDynamicComputeScale.GetValueOnRenderThread() == 0)
+	{
+		DynamicComputeScale = 1.0f;
+	}
+	else if (DynamicComputeScaleFrameNumber != GFrameNumberRenderThread)
+	{
+		// Only adjust once per frame, no matter how many targets we draw. The dead band keeps us from oscillating.
+		DynamicComputeScaleFrameNumber = GFrameNumberRenderThread;
+
+		const float GPUFrameTimeMs = FPlatformTime::ToMilliseconds(GGPUFrameTime);
+		const float TargetTimeMs = CVarDynamicComputeScaleTargetTime.GetValueOnRenderThread();
+		if (GPUFrameTimeMs > TargetTimeMs)
+		{
+			DynamicComputeScale *= 0.95f;
+		}
+		else if (GPUFrameTimeMs < TargetTimeMs * 0.85f)
+		{
+			DynamicComputeScale *= 1.02f;
+		}
+
+		DynamicComputeScale = FMath::Clamp(DynamicComputeScale, FMath::Clamp(CVarDynamicComputeScaleMin.GetValueOnRenderThread(), 0.05f, 1.0f), 1.0f);
+	}
+
+	return CalculateComputeSize(DrawParameters.GetRenderTargetSize(), DrawParameters.ComputeResolutionScale, CVarComputeScale.GetValueOnRenderThread(), DynamicComputeScale);
+}
+
+FIntPoint FShaderPluginContext::CalculateComputeSize(const FIntPoint& TargetSize, float ComputeResolutionScale, float ComputeScale, float DynamicScale)
+{
+	const float Scale = FMath::Clamp(ComputeResolutionScale * ComputeScale * DynamicScale, 0.05f, 1.0f);
+
+	return FIntPoint(
+		FMath::Clamp(FMath::CeilToInt(TargetSize.X * Scale), 1, TargetSize.X),
+		FMath::Clamp(FMath::CeilToInt(TargetSize.Y * Scale), 1, TargetSize.Y));
+}
+
+float FShaderPluginContext::GetComputeScale()
+{
+	return CVarComputeScale.GetValueOnAnyThread();
+}
@@ -0,0 +1,363 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginImageArray.h"
+#include "ShaderDeclarationDemoModule.h"
+
+#include "Async/MappedFileHandle.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "PixelFormat.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsHWrapper.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Bump the version whenever the layout changes, old files are rejected rather than misread.
+static const uint32 ImageArrayMagic = 0x41495053; // "SPIA"
+static const uint32 ImageArrayVersion = 1;
+
+// A page on every platform we run on, so each image can be mapped or read with unbuffered I/O on its own.
+static const uint32 ImageArrayAlignment = 4096;
+
+static int64 GetEntryOffset(int32 Index)
+{
+	return sizeof(FImageArrayHeader) + (int64)Index * sizeof(FImageArrayEntry);
+}
+
+/*
+ * A write handle that other processes can have open at the same time. The engine's OpenWrite won't do: it denies other
+ * writers on Windows, and takes an exclusive lock and opens in append mode on the other platforms. Every write goes to
+ * the position the handle was seeked to, with WriteFile at an explicit offset or pwrite, so writers never share a file
+ * position either. Only what FImageArrayWriter needs is implemented.
+ */
+class FSharedWriteFileHandle : public IFileHandle
+{
+public:
+#if PLATFORM_WINDOWS
+	typedef HANDLE FNativeHandle;
+#else
+	typedef int FNativeHandle;
+#endif
+
+	static FSharedWriteFileHandle* Open(const FString& Filename)
+	{
+		const FString FullFilename = FPaths::ConvertRelativePathToFull(Filename);
+#if PLATFORM_WINDOWS
+		const FNativeHandle Handle = CreateFileW(*FullFilename, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		return Handle != INVALID_HANDLE_VALUE ? new FSharedWriteFileHandle(Handle) : nullptr;
+#else
+		const FNativeHandle Handle = open(TCHAR_TO_UTF8(*FullFilename), O_WRONLY | O_CLOEXEC);
+		return Handle != -1 ? new FSharedWriteFileHandle(Handle) : nullptr;
+#endif
+	}
+
+	virtual ~FSharedWriteFileHandle()
+	{
+#if PLATFORM_WINDOWS
+		CloseHandle(Handle);
+#else
+		close(Handle);
+#endif
+	}
+
+	virtual int64 Tell() override { return Position; }
+	virtual bool Seek(int64 NewPosition) override { Position = NewPosition; return NewPosition >= 0; }
+	virtual bool SeekFromEnd(int64 NewPositionRelativeToEnd = 0) override { return false; }
+	virtual bool Read(uint8* Destination, int64 BytesToRead) override { return false; }
+	virtual bool Truncate(int64 NewSize) override { return false; }
+
+	virtual bool Write(const uint8* Source, int64 BytesToWrite) override
+	{
+		while (BytesToWrite > 0)
+		{
+#if PLATFORM_WINDOWS
+			OVERLAPPED Overlapped = {};
+			Overlapped.Offset = (DWORD)(Position & 0xffffffff);
+			Overlapped.OffsetHigh = (DWORD)(Position >> 32);
+			DWORD BytesWritten = 0;
+			if (!WriteFile(Handle, Source, (DWORD)FMath::Min<int64>(BytesToWrite, MAX_int32), &BytesWritten, &Overlapped) || BytesWritten == 0)
+			{
+				return false;
+			}
+#else
+			const ssize_t BytesWritten = pwrite(Handle, Source, FMath::Min<int64>(BytesToWrite, MAX_int32), Position);
+			if (BytesWritten < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (BytesWritten <= 0)
+			{
+				return false;
+			}
+#endif
+			Source += BytesWritten;
+			BytesToWrite -= BytesWritten;
+			Position += BytesWritten;
+		}
+		return true;
+	}
+
+	virtual bool Flush(const bool bFullFlush = false) override
+	{
+		// Nothing is buffered on our side. A full flush waits for the disk, which only matters if the machine goes down.
+		if (!bFullFlush)
+		{
+			return true;
+		}
+#if PLATFORM_WINDOWS
+		return FlushFileBuffers(Handle) != 0;
+#else
+		return fsync(Handle) == 0;
+#endif
+	}
+
+private:
+	explicit FSharedWriteFileHandle(FNativeHandle InHandle)
+		: Handle(InHandle)
+		, Position(0)
+	{
+	}
+
+	FNativeHandle Handle;
+	int64 Position;
+};
+
+static bool ReadHeaderAndEntries(IFileHandle& FileHandle, const FString& Filename, TArray<FImageArrayEntry>& OutEntries)
+{
+	FImageArrayHeader Header;
+	if (!FileHandle.Read(reinterpret_cast<uint8*>(&Header), sizeof(Header)) || Header.Magic != ImageArrayMagic || Header.Version != ImageArrayVersion)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("%s is not a version %u image array."), *Filename, ImageArrayVersion);
+		return false;
+	}
+
+	OutEntries.SetNumUninitialized(Header.NumImages);
+	if (!FileHandle.Read(reinterpret_cast<uint8*>(OutEntries.GetData()), OutEntries.Num() * sizeof(FImageArrayEntry)))
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Image array %s is truncated."), *Filename);
+		return false;
+	}
+
+	return true;
+}
+
+FImageArrayWriter::~FImageArrayWriter()
+{
+	Close();
+}
+
+bool FImageArrayWriter::Create(const FString& Filename, const TArray<FIntPoint>& Sizes)
+{
+	FImageArrayHeader Header;
+	Header.Magic = ImageArrayMagic;
+	Header.Version = ImageArrayVersion;
+	Header.NumImages = Sizes.Num();
+	Header.Alignment = ImageArrayAlignment;
+
+	TArray<FImageArrayEntry> Entries;
+	Entries.SetNumZeroed(Sizes.Num());
+	uint64 Offset = Align(GetEntryOffset(Sizes.Num()), ImageArrayAlignment);
+	for (int32 Index = 0; Index < Sizes.Num(); Index++)
+	{
+		check(Sizes[Index].X > 0 && Sizes[Index].Y > 0);
+
+		FImageArrayEntry& Entry = Entries[Index];
+		Entry.Width = Sizes[Index].X;
+		Entry.Height = Sizes[Index].Y;
+		Entry.PixelFormat = PF_B8G8R8A8;
+		Entry.Offset = Offset;
+		Entry.NumBytes = (uint64)Entry.Width * Entry.Height * sizeof(FColor);
+		Offset = Align(Offset + Entry.NumBytes, ImageArrayAlignment);
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+	TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenWrite(*Filename));
+	if (!FileHandle.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to create image array %s."), *Filename);
+		return false;
+	}
+
+	bool bSuccess = FileHandle->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	bSuccess = bSuccess && FileHandle->Write(reinterpret_cast<const uint8*>(Entries.GetData()), Entries.Num() * sizeof(FImageArrayEntry));
+
+	// Sizing the file now means the writers only ever write inside it. Most file systems keep the gaps sparse until then.
+	const uint8 LastByte = 0;
+	bSuccess = bSuccess && FileHandle->Seek(Offset - 1) && FileHandle->Write(&LastByte, 1);
+	if (!bSuccess)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to write the layout of image array %s."), *Filename);
+	}
+	return bSuccess;
+}
+
+bool FImageArrayWriter::Open(const FString& InFilename)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	{
+		TUniquePtr<IFileHandle> ReadHandle(PlatformFile.OpenRead(*InFilename, true));
+		if (!ReadHandle.IsValid() || !ReadHeaderAndEntries(*ReadHandle, InFilename, Entries))
+		{
+			Entries.Reset();
+			return false;
+		}
+	}
+
+	// The other shards write into the same file at the same time.
+	FileHandle.Reset(FSharedWriteFileHandle::Open(InFilename));
+	if (!FileHandle.IsValid())
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to open image array %s for writing."), *InFilename);
+		Entries.Reset();
+		return false;
+	}
+
+	Filename = InFilename;
+	return true;
+}
+
+void FImageArrayWriter::Close()
+{
+	if (FileHandle.IsValid())
+	{
+		FileHandle->Flush();
+		FileHandle.Reset();
+	}
+	Entries.Reset();
+}
+
+bool FImageArrayWriter::Write(int32 Index, const TArray<FColor>& Pixels)
+{
+	check(FileHandle.IsValid());
+	check(Entries.IsValidIndex(Index));
+
+	FImageArrayEntry& Entry = Entries[Index];
+	if ((uint64)Pixels.Num() * sizeof(FColor) != Entry.NumBytes)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Image %d of %s is %ux%u, got %d pixels."), Index, *Filename, Entry.Width, Entry.Height, Pixels.Num());
+		return false;
+	}
+
+	// The pixels go first, so an image is never marked written before all of it is.
+	const uint32 bWritten = 1;
+	if (!FileHandle->Seek(Entry.Offset) || !FileHandle->Write(reinterpret_cast<const uint8*>(Pixels.GetData()), Entry.NumBytes)
+		|| !FileHandle->Seek(GetEntryOffset(Index) + STRUCT_OFFSET(FImageArrayEntry, bWritten))
+		|| !FileHandle->Write(reinterpret_cast<const uint8*>(&bWritten), sizeof(bWritten)))
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to write image %d of %s."), Index, *Filename);
+		return false;
+	}
+
+	Entry.bWritten = bWritten;
+	return true;
+}
+
+FImageArrayReader::FImageArrayReader()
+	: Data(nullptr)
+	, DataSize(0)
+{
+}
+
+FImageArrayReader::~FImageArrayReader()
+{
+	Close();
+}
+
+bool FImageArrayReader::Open(const FString& Filename)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile.IsValid())
+	{
+		MappedRegion.Reset(MappedFile->MapRegion());
+	}
+
+	if (MappedRegion.IsValid())
+	{
+		Data = MappedRegion->GetMappedPtr();
+		DataSize = MappedRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(LoadedFile, *Filename))
+	{
+		Data = LoadedFile.GetData();
+		DataSize = LoadedFile.Num();
+	}
+	else
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Failed to open image array %s."), *Filename);
+		Close();
+		return false;
+	}
+
+	const FImageArrayHeader* Header = DataSize >= (int64)sizeof(FImageArrayHeader) ? reinterpret_cast<const FImageArrayHeader*>(Data) : nullptr;
+	if (!Header || Header->Magic != ImageArrayMagic || Header->Version != ImageArrayVersion || GetEntryOffset(Header->NumImages) > DataSize)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("%s is not a version %u image array."), *Filename, ImageArrayVersion);
+		Close();
+		return false;
+	}
+
+	for (int32 Index = 0; Index < Num(); Index++)
+	{
+		const FImageArrayEntry& Entry = GetEntry(Index);
+		if (Entry.Offset + Entry.NumBytes > (uint64)DataSize || Entry.PixelFormat != PF_B8G8R8A8)
+		{
+			UE_LOG(LogShaderPlugin, Error, TEXT("Image %d of %s is outside the file or in an unknown format."), Index, *Filename);
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FImageArrayReader::Close()
+{
+	// The region has to go before the file it maps.
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	LoadedFile.Empty();
+	Data = nullptr;
+	DataSize = 0;
+}
+
+int32 FImageArrayReader::Num() const
+{
+	return Data ? reinterpret_cast<const FImageArrayHeader*>(Data)->NumImages : 0;
+}
+
+const FImageArrayEntry& FImageArrayReader::GetEntry(int32 Index) const
+{
+	check(Index >= 0 && Index < Num());
+	return *reinterpret_cast<const FImageArrayEntry*>(Data + GetEntryOffset(Index));
+}
+
+FIntPoint FImageArrayReader::GetSize(int32 Index) const
+{
+	const FImageArrayEntry& Entry = GetEntry(Index);
+	return FIntPoint(Entry.Width, Entry.Height);
+}
+
+bool FImageArrayReader::IsWritten(int32 Index) const
+{
+	return GetEntry(Index).bWritten != 0;
+}
+
+const FColor* FImageArrayReader::GetPixels(int32 Index) const
+{
+	const FImageArrayEntry& Entry = GetEntry(Index);
+	return Entry.bWritten ? reinterpret_cast<const FColor*>(Data + Entry.Offset) : nullptr;
+}
@@ -0,0 +1,265 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginMemory.h"
+
+#include "ShaderDeclarationDemoModule.h"
+#include "RenderingThread.h"
+#include "HAL/IConsoleManager.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("ShaderPlugin Memory"), STATGROUP_ShaderPluginMemory, STATCAT_Advanced);
+
+// Shows up with "stat ShaderPluginMemory". The GPU ones are also counted towards the GPU memory pool.
+DECLARE_MEMORY_STAT_POOL(TEXT("Compute Shader Output"), STAT_ShaderPlugin_ComputeShaderOutputMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Compute Shader Output Buffer"), STAT_ShaderPlugin_ComputeShaderOutputBufferMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Vertex Position Buffer"), STAT_ShaderPlugin_VertexPositionBufferMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Vertex Color Buffer"), STAT_ShaderPlugin_VertexColorBufferMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Vertex Index Buffer"), STAT_ShaderPlugin_VertexIndexBufferMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT(TEXT("Vertex Index Staging"), STAT_ShaderPlugin_VertexIndexStagingMemory, STATGROUP_ShaderPluginMemory);
+DECLARE_MEMORY_STAT_POOL(TEXT("Vertex Ring Index Buffer"), STAT_ShaderPlugin_VertexRingIndexBufferMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Flipbook Atlas"), STAT_ShaderPlugin_FlipbookAtlasMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Atlas Page Compute Output"), STAT_ShaderPlugin_AtlasPageComputeOutputMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Atlas Slot Parameters"), STAT_ShaderPlugin_AtlasSlotParametersMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Scene Mesh Buffers"), STAT_ShaderPlugin_SceneMeshBuffersMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Particle Buffers"), STAT_ShaderPlugin_ParticleBuffersMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Compressed Targets"), STAT_ShaderPlugin_CompressedTargetsMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Source Images"), STAT_ShaderPlugin_SourceImagesMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT_POOL(TEXT("Total GPU"), STAT_ShaderPlugin_TotalGPUMemory, STATGROUP_ShaderPluginMemory, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT(TEXT("Total CPU"), STAT_ShaderPlugin_TotalCPUMemory, STATGROUP_ShaderPluginMemory);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT(TEXT("ShaderPlugin"), STAT_ShaderPluginLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("ShaderPlugin"), STAT_ShaderPluginSummaryLLM, STATGROUP_LLM);
+#endif
+
+static FAutoConsoleCommand CMemReportCommand(
+	TEXT("ShaderPlugin.MemReport"),
+	TEXT("Lists the live plugin resources, their peak usage and the transient allocations made during the last frame."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		ENQUEUE_RENDER_COMMAND(ShaderPluginMemReportCommand)(
+			[](FRHICommandListImmediate& RHICmdList)
+		{
+			FShaderPluginMemory::LogReport_RenderThread();
+		}
+		);
+	}));
+
+// All of the bookkeeping below is render thread only, so there is nothing to lock.
+namespace ShaderPluginMemory
+{
+	struct FLiveEntry
+	{
+		EShaderPluginResource Resource;
+		FName Target;
+		int64 Bytes;
+		int32 NumAllocations;
+	};
+
+	struct FFrameChurn
+	{
+		int64 Bytes[2] = { 0, 0 }; // CPU, GPU
+		int32 NumAllocations[2] = { 0, 0 };
+	};
+
+	static TArray<FLiveEntry> LiveEntries;
+	static int64 LiveBytes[(int32)EShaderPluginResource::Num] = {};
+	static int64 PeakBytes[(int32)EShaderPluginResource::Num] = {};
+	static int64 TotalLiveBytes[2] = { 0, 0 };
+	static int64 TotalPeakBytes[2] = { 0, 0 };
+
+	static uint32 ChurnFrameNumber = 0;
+	static FFrameChurn CurrentFrameChurn;
+	static FFrameChurn LastFrameChurn;
+
+	static void UpdateStat(EShaderPluginResource Resource, int64 Delta)
+	{
+#if STATS
+		FName StatName;
+		switch (Resource)
+		{
+		case EShaderPluginResource::ComputeShaderOutput:		StatName = GET_STATFNAME(STAT_ShaderPlugin_ComputeShaderOutputMemory); break;
+		case EShaderPluginResource::ComputeShaderOutputBuffer:	StatName = GET_STATFNAME(STAT_ShaderPlugin_ComputeShaderOutputBufferMemory); break;
+		case EShaderPluginResource::VertexPositionBuffer:		StatName = GET_STATFNAME(STAT_ShaderPlugin_VertexPositionBufferMemory); break;
+		case EShaderPluginResource::VertexColorBuffer:			StatName = GET_STATFNAME(STAT_ShaderPlugin_VertexColorBufferMemory); break;
+		case EShaderPluginResource::VertexIndexBuffer:			StatName = GET_STATFNAME(STAT_ShaderPlugin_VertexIndexBufferMemory); break;
+		case EShaderPluginResource::VertexIndexStaging:			StatName = GET_STATFNAME(STAT_ShaderPlugin_VertexIndexStagingMemory); break;
+		case EShaderPluginResource::VertexRingIndexBuffer:		StatName = GET_STATFNAME(STAT_ShaderPlugin_VertexRingIndexBufferMemory); break;
+		case EShaderPluginResource::FlipbookAtlas:				StatName = GET_STATFNAME(STAT_ShaderPlugin_FlipbookAtlasMemory); break;
+		case EShaderPluginResource::AtlasPageComputeOutput:		StatName = GET_STATFNAME(STAT_ShaderPlugin_AtlasPageComputeOutputMemory); break;
+		case EShaderPluginResource::AtlasSlotParameters:		StatName = GET_STATFNAME(STAT_ShaderPlugin_AtlasSlotParametersMemory); break;
+		case EShaderPluginResource::SceneMeshBuffers:			StatName = GET_STATFNAME(STAT_ShaderPlugin_SceneMeshBuffersMemory); break;
+		case EShaderPluginResource::ParticleBuffers:			StatName = GET_STATFNAME(STAT_ShaderPlugin_ParticleBuffersMemory); break;
+		case EShaderPluginResource::CompressedTargets:			StatName = GET_STATFNAME(STAT_ShaderPlugin_CompressedTargetsMemory); break;
+		case EShaderPluginResource::SourceImages:				StatName = GET_STATFNAME(STAT_ShaderPlugin_SourceImagesMemory); break;
+		default: check(0); return;
+		}
+
+		const FName TotalStatName = FShaderPluginMemory::IsGPUResource(Resource) ? GET_STATFNAME(STAT_ShaderPlugin_TotalGPUMemory) : GET_STATFNAME(STAT_ShaderPlugin_TotalCPUMemory);
+		if (Delta >= 0)
+		{
+			INC_MEMORY_STAT_BY_FName(StatName, Delta);
+			INC_MEMORY_STAT_BY_FName(TotalStatName, Delta);
+		}
+		else
+		{
+			DEC_MEMORY_STAT_BY_FName(StatName, -Delta);
+			DEC_MEMORY_STAT_BY_FName(TotalStatName, -Delta);
+		}
+#endif
+	}
+
+	static FLiveEntry& FindOrAddEntry(EShaderPluginResource Resource, FName Target)
+	{
+		for (FLiveEntry& Entry : LiveEntries)
+		{
+			if (Entry.Resource == Resource && Entry.Target == Target)
+			{
+				return Entry;
+			}
+		}
+
+		FLiveEntry& Entry = LiveEntries.AddDefaulted_GetRef();
+		Entry.Resource = Resource;
+		Entry.Target = Target;
+		Entry.Bytes = 0;
+		Entry.NumAllocations = 0;
+		return Entry;
+	}
+
+	static FString FormatBytes(int64 Bytes)
+	{
+		return FString::Printf(TEXT("%8.2f MB"), Bytes / (1024.0 * 1024.0));
+	}
+}
+
+void FShaderPluginMemory::RegisterLLMTags()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	FLowLevelMemTracker::Get().RegisterProjectTag((int32)EShaderPluginLLMTag::ShaderPlugin, TEXT("ShaderPlugin"), GET_STATFNAME(STAT_ShaderPluginLLM), GET_STATFNAME(STAT_ShaderPluginSummaryLLM));
+#endif
+}
+
+void FShaderPluginMemory::TrackAllocation(EShaderPluginResource Resource, FName Target, int64 Bytes)
+{
+	using namespace ShaderPluginMemory;
+	check(IsInRenderingThread());
+
+	const int32 ResourceIndex = (int32)Resource;
+	const int32 Pool = IsGPUResource(Resource) ? 1 : 0;
+
+	FLiveEntry& Entry = FindOrAddEntry(Resource, Target);
+	Entry.Bytes += Bytes;
+	Entry.NumAllocations++;
+
+	LiveBytes[ResourceIndex] += Bytes;
+	PeakBytes[ResourceIndex] = FMath::Max(PeakBytes[ResourceIndex], LiveBytes[ResourceIndex]);
+	TotalLiveBytes[Pool] += Bytes;
+	TotalPeakBytes[Pool] = FMath::Max(TotalPeakBytes[Pool], TotalLiveBytes[Pool]);
+
+	if (IsTransientResource(Resource))
+	{
+		if (ChurnFrameNumber != GFrameNumberRenderThread)
+		{
+			LastFrameChurn = CurrentFrameChurn;
+			CurrentFrameChurn = FFrameChurn();
+			ChurnFrameNumber = GFrameNumberRenderThread;
+		}
+
+		CurrentFrameChurn.Bytes[Pool] += Bytes;
+		CurrentFrameChurn.NumAllocations[Pool]++;
+	}
+
+	UpdateStat(Resource, Bytes);
+}
+
+void FShaderPluginMemory::TrackFree(EShaderPluginResource Resource, FName Target, int64 Bytes)
+{
+	using namespace ShaderPluginMemory;
+	check(IsInRenderingThread());
+
+	const int32 Pool = IsGPUResource(Resource) ? 1 : 0;
+
+	FLiveEntry& Entry = FindOrAddEntry(Resource, Target);
+	check(Entry.Bytes >= Bytes && Entry.NumAllocations > 0);
+	Entry.Bytes -= Bytes;
+	Entry.NumAllocations--;
+
+	LiveBytes[(int32)Resource] -= Bytes;
+	TotalLiveBytes[Pool] -= Bytes;
+
+	UpdateStat(Resource, -Bytes);
+}
+
+void FShaderPluginMemory::LogReport_RenderThread()
+{
+	using namespace ShaderPluginMemory;
+	check(IsInRenderingThread());
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("ShaderPlugin memory report:"));
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Live resources:"));
+	for (const FLiveEntry& Entry : LiveEntries)
+	{
+		if (Entry.NumAllocations > 0)
+		{
+			UE_LOG(LogShaderPlugin, Display, TEXT("    %-28s %s  %-32s %s (%d)"), GetResourceName(Entry.Resource), IsGPUResource(Entry.Resource) ? TEXT("GPU") : TEXT("CPU"),
+				Entry.Target.IsNone() ? TEXT("<shared>") : *Entry.Target.ToString(), *FormatBytes(Entry.Bytes), Entry.NumAllocations);
+		}
+	}
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Peak per resource:"));
+	for (int32 ResourceIndex = 0; ResourceIndex < (int32)EShaderPluginResource::Num; ResourceIndex++)
+	{
+		const EShaderPluginResource Resource = (EShaderPluginResource)ResourceIndex;
+		UE_LOG(LogShaderPlugin, Display, TEXT("    %-28s %s  live %s, peak %s"), GetResourceName(Resource), IsGPUResource(Resource) ? TEXT("GPU") : TEXT("CPU"),
+			*FormatBytes(LiveBytes[ResourceIndex]), *FormatBytes(PeakBytes[ResourceIndex]));
+	}
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Total CPU: live %s, peak %s"), *FormatBytes(TotalLiveBytes[0]), *FormatBytes(TotalPeakBytes[0]));
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Total GPU: live %s, peak %s"), *FormatBytes(TotalLiveBytes[1]), *FormatBytes(TotalPeakBytes[1]));
+
+	// If nothing was drawn since the last frame we counted, the current frame is the most recent one we have.
+	const FFrameChurn& Churn = ChurnFrameNumber == GFrameNumberRenderThread ? LastFrameChurn : CurrentFrameChurn;
+	UE_LOG(LogShaderPlugin, Display, TEXT("  Transient churn last frame: CPU %s in %d allocations, GPU %s in %d allocations"),
+		*FormatBytes(Churn.Bytes[0]), Churn.NumAllocations[0], *FormatBytes(Churn.Bytes[1]), Churn.NumAllocations[1]);
+}
+
+bool FShaderPluginMemory::IsGPUResource(EShaderPluginResource Resource)
+{
+	return Resource != EShaderPluginResource::VertexIndexStaging;
+}
+
+bool FShaderPluginMemory::IsTransientResource(EShaderPluginResource Resource)
+{
+	return Resource != EShaderPluginResource::ComputeShaderOutput && Resource != EShaderPluginResource::FlipbookAtlas
+		&& Resource != EShaderPluginResource::VertexPositionBuffer && Resource != EShaderPluginResource::VertexColorBuffer
+		&& Resource != EShaderPluginResource::VertexIndexBuffer && Resource != EShaderPluginResource::VertexRingIndexBuffer
+		&& Resource != EShaderPluginResource::SceneMeshBuffers && Resource != EShaderPluginResource::ParticleBuffers
+		&& Resource != EShaderPluginResource::CompressedTargets && Resource != EShaderPluginResource::SourceImages
+		&& Resource != EShaderPluginResource::AtlasPageComputeOutput;
+}
+
+const TCHAR* FShaderPluginMemory::GetResourceName(EShaderPluginResource Resource)
+{
+	switch (Resource)
+	{
+	case EShaderPluginResource::ComputeShaderOutput:		return TEXT("ComputeShaderOutput");
+	case EShaderPluginResource::ComputeShaderOutputBuffer:	return TEXT("ComputeShaderOutputBuffer");
+	case EShaderPluginResource::VertexPositionBuffer:		return TEXT("VertexPositionBuffer");
+	case EShaderPluginResource::VertexColorBuffer:			return TEXT("VertexColorBuffer");
+	case EShaderPluginResource::VertexIndexBuffer:			return TEXT("VertexIndexBuffer");
+	case EShaderPluginResource::VertexIndexStaging:			return TEXT("VertexIndexStaging");
+	case EShaderPluginResource::VertexRingIndexBuffer:		return TEXT("VertexRingIndexBuffer");
+	case EShaderPluginResource::FlipbookAtlas:				return TEXT("FlipbookAtlas");
+	case EShaderPluginResource::AtlasPageComputeOutput:		return TEXT("AtlasPageComputeOutput");
+	case EShaderPluginResource::AtlasSlotParameters:		return TEXT("AtlasSlotParameters");
+	case EShaderPluginResource::SceneMeshBuffers:			return TEXT("SceneMeshBuffers");
+	case EShaderPluginResource::ParticleBuffers:			return TEXT("ParticleBuffers");
+	case EShaderPluginResource::CompressedTargets:			return TEXT("CompressedTargets");
+	case EShaderPluginResource::SourceImages:				return TEXT("SourceImages");
+	default:												return TEXT("Unknown");
+	}
+}
@@ -0,0 +1,84 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// Everything the plugin allocates. Resources marked transient are created and released within a single draw.
+enum class EShaderPluginResource : int32
+{
+	ComputeShaderOutput,		// GPU, persistent
+	ComputeShaderOutputBuffer,	// GPU, transient
+	VertexPositionBuffer,		// GPU, persistent. The ring of FVertexFromCSRing.
+	VertexColorBuffer,			// GPU, persistent
+	VertexIndexBuffer,			// GPU, persistent. Culled indices and draw arguments of FVertexFromCSRing.
+	VertexIndexStaging,			// CPU, transient
+	VertexRingIndexBuffer,		// GPU, persistent. Static indices of the ring, built once.
+	FlipbookAtlas,				// GPU, persistent. Only counted when we created it, assigned assets belong to the asset.
+	AtlasPageComputeOutput,		// GPU, persistent. Shared by all atlas pages of a context, only ever grows.
+	AtlasSlotParameters,		// GPU, transient
+	SceneMeshBuffers,			// GPU, persistent. The vertex streams of every FComputeMeshSceneProxy.
+	ParticleBuffers,			// GPU, persistent. State, free list and vertices of FParticleSimulation.
+	CompressedTargets,			// GPU, persistent. Block textures and BC1/BC3 copies of render targets, see FBlockCompressionExample.
+	SourceImages,				// GPU, persistent. The slots of FTextureUploadRing.
+	Num
+};
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+// LLM project tags are shared with the game, so we start a bit into the range to leave the first ones to the project.
+enum class EShaderPluginLLMTag : int32
+{
+	ShaderPlugin = (int32)ELLMTag::ProjectTagStart + 16,
+};
+
+#define LLM_SCOPE_SHADERPLUGIN() LLM_SCOPE((ELLMTag)EShaderPluginLLMTag::ShaderPlugin)
+#else
+#define LLM_SCOPE_SHADERPLUGIN()
+#endif
+
+/**************************************************************************************/
+/* Keeps track of how much memory the plugin resources use, per resource and target.  */
+/* Everything except RegisterLLMTags must be called on the render thread.             */
+/**************************************************************************************/
+class FShaderPluginMemory
+{
+public:
+	// Call once on startup so LLM reports the ShaderPlugin tag by name.
+	static void RegisterLLMTags();
+
+	static void TrackAllocation(EShaderPluginResource Resource, FName Target, int64 Bytes);
+	static void TrackFree(EShaderPluginResource Resource, FName Target, int64 Bytes);
+
+	// Lists the live resources, the peaks and the transient allocations made during the last complete frame.
+	static void LogReport_RenderThread();
+
+	static bool IsGPUResource(EShaderPluginResource Resource);
+	static bool IsTransientResource(EShaderPluginResource Resource);
+	static const TCHAR* GetResourceName(EShaderPluginResource Resource);
+};
+
+// Tracks a transient resource for as long as it is in scope.
+class FShaderPluginScopedMemory
+{
+public:
+	FShaderPluginScopedMemory(EShaderPluginResource InResource, FName InTarget, int64 InBytes)
+		: Resource(InResource)
+		, Target(InTarget)
+		, Bytes(InBytes)
+	{
+		FShaderPluginMemory::TrackAllocation(Resource, Target, Bytes);
+	}
+
+	~FShaderPluginScopedMemory()
+	{
+		FShaderPluginMemory::TrackFree(Resource, Target, Bytes);
+	}
+
+private:
+	EShaderPluginResource Resource;
+	FName Target;
+	int64 Bytes;
+};
@@ -0,0 +1,107 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginTargetParameters.h"
+
+#include "ComputeShaderExample.h"
+#include "ShaderPluginTrace.h"
+
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FShaderPluginTargetParameters, "ShaderPluginTarget");
+
+// How many frames a cached buffer survives without its target being drawn.
+static const uint32 TargetUniformBufferMaxUnusedFrames = 30;
+
+// The padding is zeroed too, so two sets of parameters can be compared with Memcmp.
+static void FillShaderPluginTargetParameters(FShaderPluginTargetParameters& Parameters, const FShaderUsageExampleParameters& DrawParameters, const FIntPoint& ComputeSize)
+{
+	const FIntPoint TargetSize = DrawParameters.GetRenderTargetSize();
+	const FFractalFrameConstants FrameConstants(DrawParameters.SimulationState);
+
+	FMemory::Memzero(&Parameters, sizeof(Parameters));
+	Parameters.StartColor = FVector4(DrawParameters.StartColor.R, DrawParameters.StartColor.G, DrawParameters.StartColor.B, DrawParameters.StartColor.A) / 255.0f;
+	Parameters.EndColor = FVector4(DrawParameters.EndColor.R, DrawParameters.EndColor.G, DrawParameters.EndColor.B, DrawParameters.EndColor.A) / 255.0f;
+	Parameters.TargetSize = FVector2D(TargetSize.X, TargetSize.Y);
+	Parameters.ComputeSize = FVector2D(ComputeSize.X, ComputeSize.Y);
+	Parameters.SimulationState = DrawParameters.SimulationState;
+	Parameters.BlendFactor = DrawParameters.ComputeShaderBlend;
+	Parameters.Radius = DrawParameters.ComputeRadius;
+	Parameters.TimePhase = FrameConstants.TimePhase;
+	Parameters.TimeWarp = FrameConstants.TimeWarp;
+	Parameters.ZOffset = FrameConstants.ZOffset;
+	Parameters.V1Phase = FrameConstants.V1Phase;
+	Parameters.V2Phase = FrameConstants.V2Phase;
+	Parameters.RedScale = FrameConstants.RedScale;
+}
+
+FShaderPluginTargetUniformBufferRef CreateShaderPluginTargetUniformBuffer(const FShaderUsageExampleParameters& DrawParameters, const FIntPoint& ComputeSize)
+{
+	check(IsInRenderingThread());
+	SHADERPLUGIN_TRACE_SCOPE(CreateTargetUniformBuffer);
+
+	FShaderPluginTargetParameters Parameters;
+	FillShaderPluginTargetParameters(Parameters, DrawParameters, ComputeSize);
+
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, sizeof(FShaderPluginTargetParameters));
+
+	return FShaderPluginTargetUniformBufferRef::CreateUniformBufferImmediate(Parameters, UniformBuffer_SingleFrame);
+}
+
+FShaderPluginTargetUniformBufferRef CreateShaderPluginTargetUniformBuffer(const FShaderUsageExampleParameters& DrawParameters)
+{
+	return CreateShaderPluginTargetUniformBuffer(DrawParameters, DrawParameters.GetRenderTargetSize());
+}
+
+FShaderPluginTargetUniformBufferRef FShaderPluginTargetUniformBufferCache::Get(const FShaderUsageExampleParameters& DrawParameters, const FIntPoint& ComputeSize)
+{
+	check(IsInRenderingThread());
+	SHADERPLUGIN_TRACE_SCOPE(GetTargetUniformBuffer);
+
+	if (LastTrimFrameNumber != GFrameNumberRenderThread)
+	{
+		LastTrimFrameNumber = GFrameNumberRenderThread;
+		for (auto It = Entries.CreateIterator(); It; ++It)
+		{
+			if (GFrameNumberRenderThread - It.Value().LastUsedFrameNumber > TargetUniformBufferMaxUnusedFrames)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	FShaderPluginTargetParameters Parameters;
+	FillShaderPluginTargetParameters(Parameters, DrawParameters, ComputeSize);
+
+	FEntry& Entry = Entries.FindOrAdd(DrawParameters.RenderTarget);
+	Entry.LastUsedFrameNumber = GFrameNumberRenderThread;
+	if (!Entry.UniformBuffer.IsValid())
+	{
+		Entry.UniformBuffer = FShaderPluginTargetUniformBufferRef::CreateUniformBufferImmediate(Parameters, UniformBuffer_MultiFrame);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+	}
+	else if (FMemory::Memcmp(&Entry.Contents, &Parameters, sizeof(Parameters)) != 0)
+	{
+		// Draws that already bound the buffer this frame keep the contents they were recorded with.
+		Entry.UniformBuffer.UpdateUniformBufferImmediate(Parameters);
+	}
+	else
+	{
+		return Entry.UniformBuffer;
+	}
+
+	FMemory::Memcpy(&Entry.Contents, &Parameters, sizeof(Parameters));
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, sizeof(FShaderPluginTargetParameters));
+	return Entry.UniformBuffer;
+}
+
+FShaderPluginTargetUniformBufferRef FShaderPluginTargetUniformBufferCache::Get(const FShaderUsageExampleParameters& DrawParameters)
+{
+	return Get(DrawParameters, DrawParameters.GetRenderTargetSize());
+}
+
+void FShaderPluginTargetUniformBufferCache::Reset()
+{
+	check(IsInRenderingThread());
+	Entries.Reset();
+}
@@ -0,0 +1,66 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "ShaderParameterMacros.h"
+#include "UniformBuffer.h"
+
+/*
+ * Everything the passes need to know about the target they are drawing to. Rather than every pass packing and uploading
+ * its own copy of these as loose parameters, we keep one uniform buffer per target and bind it to all of them.
+ * In HLSL these are read through ShaderPluginTarget, for example ShaderPluginTarget.StartColor.
+ */
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FShaderPluginTargetParameters, )
+	SHADER_PARAMETER(FVector4, StartColor)
+	SHADER_PARAMETER(FVector4, EndColor)
+	SHADER_PARAMETER(FVector2D, TargetSize) // Metal doesn't support GetDimensions(), so we send in this data via our parameters.
+	SHADER_PARAMETER(FVector2D, ComputeSize) // Resolution the fractal runs at, can be smaller than TargetSize.
+	SHADER_PARAMETER(float, SimulationState)
+	SHADER_PARAMETER(float, BlendFactor)
+	SHADER_PARAMETER(float, Radius)
+	SHADER_PARAMETER(float, TimePhase) // The rest are the fractal's per frame constants, see FFractalFrameConstants.
+	SHADER_PARAMETER(float, TimeWarp)
+	SHADER_PARAMETER(float, ZOffset)
+	SHADER_PARAMETER(float, V1Phase)
+	SHADER_PARAMETER(float, V2Phase)
+	SHADER_PARAMETER(float, RedScale)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+
+typedef TUniformBufferRef<FShaderPluginTargetParameters> FShaderPluginTargetUniformBufferRef;
+
+// Creates a single frame uniform buffer for one target. ComputeSize defaults to the full render target size. This is for
+// one-off draws like bakes and benchmarks, anything that draws every frame should go through a cache below.
+FShaderPluginTargetUniformBufferRef CreateShaderPluginTargetUniformBuffer(const FShaderUsageExampleParameters& DrawParameters, const FIntPoint& ComputeSize);
+FShaderPluginTargetUniformBufferRef CreateShaderPluginTargetUniformBuffer(const FShaderUsageExampleParameters& DrawParameters);
+
+/*
+ * Keeps a uniform buffer per render target across frames, rather than creating a new one every time a target is drawn.
+ * The buffer is only uploaded again when what would go into it changes, so a target that holds still costs nothing and
+ * one that animates costs an update instead of an allocation. Buffers of targets that stop drawing are dropped after a
+ * few frames. Render thread only.
+ */
+class FShaderPluginTargetUniformBufferCache
+{
+public:
+	FShaderPluginTargetUniformBufferCache() : LastTrimFrameNumber(0) { }
+
+	FShaderPluginTargetUniformBufferRef Get(const FShaderUsageExampleParameters& DrawParameters, const FIntPoint& ComputeSize);
+	FShaderPluginTargetUniformBufferRef Get(const FShaderUsageExampleParameters& DrawParameters);
+
+	void Reset();
+
+private:
+	struct FEntry
+	{
+		FShaderPluginTargetUniformBufferRef UniformBuffer;
+		FShaderPluginTargetParameters Contents;
+		uint32 LastUsedFrameNumber;
+	};
+
+	TMap<const UTextureRenderTarget2D*, FEntry> Entries;
+	uint32 LastTrimFrameNumber;
+};
@@ -0,0 +1,93 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginTrace.h"
+
+#include "Misc/CoreDelegates.h"
+#include "RenderingThread.h"
+#include "Stats/Stats.h"
+
+#if SHADERPLUGIN_TRACE_COUNTERS
+#include "ProfilingDebugging/CountersTrace.h"
+#endif
+
+#if SHADERPLUGIN_TRACE_CHANNELS
+UE_TRACE_CHANNEL_DEFINE(ShaderPluginChannel)
+#endif
+
+DECLARE_STATS_GROUP(TEXT("ShaderPlugin"), STATGROUP_ShaderPlugin, STATCAT_Advanced);
+
+// Counter stats are reset every frame, so these are per frame totals.
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dispatches"), STAT_ShaderPlugin_Dispatches, STATGROUP_ShaderPlugin);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Draws"), STAT_ShaderPlugin_Draws, STATGROUP_ShaderPlugin);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Vertices Generated"), STAT_ShaderPlugin_VerticesGenerated, STATGROUP_ShaderPlugin);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Bytes Uploaded"), STAT_ShaderPlugin_BytesUploaded, STATGROUP_ShaderPlugin);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resources Created"), STAT_ShaderPlugin_ResourcesCreated, STATGROUP_ShaderPlugin);
+
+#if SHADERPLUGIN_TRACE_COUNTERS
+TRACE_DECLARE_INT_COUNTER(ShaderPlugin_Dispatches, TEXT("ShaderPlugin/Dispatches"));
+TRACE_DECLARE_INT_COUNTER(ShaderPlugin_Draws, TEXT("ShaderPlugin/Draws"));
+TRACE_DECLARE_INT_COUNTER(ShaderPlugin_VerticesGenerated, TEXT("ShaderPlugin/VerticesGenerated"));
+TRACE_DECLARE_INT_COUNTER(ShaderPlugin_BytesUploaded, TEXT("ShaderPlugin/BytesUploaded"));
+TRACE_DECLARE_INT_COUNTER(ShaderPlugin_ResourcesCreated, TEXT("ShaderPlugin/ResourcesCreated"));
+
+// Render thread only.
+static int64 FrameCounters[(int32)EShaderPluginTraceCounter::Num] = {};
+static FDelegateHandle EndFrameHandle;
+
+static void PublishFrameCounters()
+{
+	check(IsInRenderingThread());
+
+	TRACE_COUNTER_SET(ShaderPlugin_Dispatches, FrameCounters[(int32)EShaderPluginTraceCounter::Dispatches]);
+	TRACE_COUNTER_SET(ShaderPlugin_Draws, FrameCounters[(int32)EShaderPluginTraceCounter::Draws]);
+	TRACE_COUNTER_SET(ShaderPlugin_VerticesGenerated, FrameCounters[(int32)EShaderPluginTraceCounter::VerticesGenerated]);
+	TRACE_COUNTER_SET(ShaderPlugin_BytesUploaded, FrameCounters[(int32)EShaderPluginTraceCounter::BytesUploaded]);
+	TRACE_COUNTER_SET(ShaderPlugin_ResourcesCreated, FrameCounters[(int32)EShaderPluginTraceCounter::ResourcesCreated]);
+	FMemory::Memzero(FrameCounters);
+}
+#endif
+
+void FShaderPluginTrace::Startup()
+{
+	// The stats are counter stats, which the stats system already resets every frame. Only the trace counters need this.
+#if SHADERPLUGIN_TRACE_COUNTERS
+	EndFrameHandle = FCoreDelegates::OnEndFrameRT.AddStatic(&PublishFrameCounters);
+#endif
+}
+
+void FShaderPluginTrace::Shutdown()
+{
+#if SHADERPLUGIN_TRACE_COUNTERS
+	// The delegate is broadcast on the render thread, so that is where it has to be removed from as well.
+	ENQUEUE_RENDER_COMMAND(ShaderPluginTraceShutdownCommand)(
+		[](FRHICommandListImmediate& RHICmdList)
+	{
+		FCoreDelegates::OnEndFrameRT.Remove(EndFrameHandle);
+		EndFrameHandle.Reset();
+	}
+	);
+	FlushRenderingCommands();
+#endif
+}
+
+void FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter Counter, int64 Amount /*= 1*/)
+{
+	check(IsInRenderingThread());
+
+	switch (Counter)
+	{
+	case EShaderPluginTraceCounter::Dispatches:			INC_DWORD_STAT_BY(STAT_ShaderPlugin_Dispatches, Amount); break;
+	case EShaderPluginTraceCounter::Draws:				INC_DWORD_STAT_BY(STAT_ShaderPlugin_Draws, Amount); break;
+	case EShaderPluginTraceCounter::VerticesGenerated:	INC_DWORD_STAT_BY(STAT_ShaderPlugin_VerticesGenerated, Amount); break;
+	case EShaderPluginTraceCounter::BytesUploaded:		INC_DWORD_STAT_BY(STAT_ShaderPlugin_BytesUploaded, Amount); break;
+	case EShaderPluginTraceCounter::ResourcesCreated:	INC_DWORD_STAT_BY(STAT_ShaderPlugin_ResourcesCreated, Amount); break;
+	default: check(0); break;
+	}
+
+#if SHADERPLUGIN_TRACE_COUNTERS
+	// Only the totals are published, which keeps it to one counter event per frame instead of one per call.
+	FrameCounters[(int32)Counter] += Amount;
+#endif
+}
@@ -0,0 +1,51 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+#define SHADERPLUGIN_TRACE_CHANNELS (ENGINE_MAJOR_VERSION > 4 || ENGINE_MINOR_VERSION >= 26)
+#define SHADERPLUGIN_TRACE_COUNTERS (ENGINE_MAJOR_VERSION > 4 || ENGINE_MINOR_VERSION >= 25)
+
+/*
+ * Scopes show up as ShaderPlugin_<Name> in the CPU track of Unreal Insights, right next to the engine's own events.
+ * On engines with trace channels they go on their own ShaderPlugin channel, so run with -trace=cpu,ShaderPlugin to
+ * capture them. Older engines only have the CPU channel, so there they are captured together with everything else.
+ */
+#if SHADERPLUGIN_TRACE_CHANNELS
+#include "Trace/Trace.h"
+UE_TRACE_CHANNEL_EXTERN(ShaderPluginChannel)
+#define SHADERPLUGIN_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(ShaderPlugin_##Name, ShaderPluginChannel)
+#else
+#define SHADERPLUGIN_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE(ShaderPlugin_##Name)
+#endif
+
+enum class EShaderPluginTraceCounter : int32
+{
+	Dispatches,
+	Draws,
+	VerticesGenerated,
+	BytesUploaded,
+	ResourcesCreated,
+	Num
+};
+
+/**************************************************************************************/
+/* Per frame counters for the plugin. They are published as trace counters where the  */
+/* engine supports them, and always as stats, see "stat ShaderPlugin".                */
+/**************************************************************************************/
+class FShaderPluginTrace
+{
+public:
+	// Call on startup and shutdown. Every frame the render thread finishes publishes the totals, frames without any
+	// plugin work publish zeros, so the counters never show the last busy frame while nothing is happening.
+	static void Startup();
+	static void Shutdown();
+
+	// Render thread only. The totals are published when the render thread finishes the frame.
+	static void AddToCounter(EShaderPluginTraceCounter Counter, int64 Amount = 1);
+};
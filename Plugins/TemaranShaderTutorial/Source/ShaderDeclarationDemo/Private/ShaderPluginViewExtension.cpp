@@ -0,0 +1,82 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginViewExtension.h"
+
+#include "ShaderPluginContext.h"
+#include "ShaderPluginTrace.h"
+
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+#include "SceneInterface.h"
+
+static TAutoConsoleVariable<int32> CVarRenderPoint(
+	TEXT("r.ShaderPlugin.RenderPoint"),
+	0,
+	TEXT("Where in the frame the plugin draws, while BeginRendering is active.\n")
+	TEXT(" 0: Before the base pass, materials see the result in the same frame (default)\n")
+	TEXT(" 1: After post processing, materials see the result one frame later"),
+	ECVF_RenderThreadSafe);
+
+FShaderPluginViewExtension::FShaderPluginViewExtension(const FAutoRegister& AutoRegister, FShaderPluginContext* InContext)
+	: FSceneViewExtensionBase(AutoRegister)
+	, Context(InContext)
+	, LastRenderedFrameNumber(0)
+{
+}
+
+bool FShaderPluginViewExtension::IsContextViewFamily(const FSceneViewFamily& InViewFamily) const
+{
+	// Both threads. The scene's world is only compared, never used.
+	if (!Context->World)
+	{
+		return true;
+	}
+	return InViewFamily.Scene && InViewFamily.Scene->GetWorld() == Context->World;
+}
+
+void FShaderPluginViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+	// Game thread. Whatever was queued since the last view family of our world goes to the render thread now.
+	if (IsContextViewFamily(InViewFamily))
+	{
+		Context->SubmitPendingDraws();
+	}
+}
+
+void FShaderPluginViewExtension::PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily)
+{
+	if (GetRenderPoint_RenderThread() == EShaderPluginRenderPoint::PreBasePass && IsContextViewFamily(InViewFamily))
+	{
+		Render_RenderThread(RHICmdList);
+	}
+}
+
+void FShaderPluginViewExtension::PostRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily)
+{
+	if (GetRenderPoint_RenderThread() == EShaderPluginRenderPoint::PostProcess && IsContextViewFamily(InViewFamily))
+	{
+		Render_RenderThread(RHICmdList);
+	}
+}
+
+EShaderPluginRenderPoint FShaderPluginViewExtension::GetRenderPoint_RenderThread()
+{
+	return CVarRenderPoint.GetValueOnRenderThread() == 1 ? EShaderPluginRenderPoint::PostProcess : EShaderPluginRenderPoint::PreBasePass;
+}
+
+void FShaderPluginViewExtension::Render_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	// Editor viewports, split screen and scene captures each render their own view family. We only draw for the first one.
+	if (LastRenderedFrameNumber == GFrameNumberRenderThread)
+	{
+		return;
+	}
+	LastRenderedFrameNumber = GFrameNumberRenderThread;
+
+	SHADERPLUGIN_TRACE_SCOPE(ViewExtension);
+	Context->DrawPendingTargets_RenderThread(RHICmdList);
+}
@@ -0,0 +1,50 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+class FShaderPluginContext;
+
+// Where in the engine frame the queued draws run, see r.ShaderPlugin.RenderPoint.
+enum class EShaderPluginRenderPoint : int32
+{
+	PreBasePass,	// Before the first view family renders, so materials sample this frame's result
+	PostProcess,	// After the first view family has been post processed, so materials sample last frame's result
+};
+
+/*
+ * Hooks a context into the engine's frame while BeginRendering is active. Draws requested with DrawTarget and
+ * DrawTargets are queued up on the game thread, handed over once per view family and drawn on the frame's own
+ * command list at the chosen render point. Only the first view family of a frame draws anything, so the work happens
+ * exactly once per frame no matter how many viewports or scene captures there are or how many objects asked for it.
+ * Every context has its own extension, and it only draws for view families of the context's world, so each world's queue
+ * is drawn once per frame with that world's views, and a world that isn't rendered doesn't draw at all.
+ */
+class FShaderPluginViewExtension : public FSceneViewExtensionBase
+{
+public:
+	FShaderPluginViewExtension(const FAutoRegister& AutoRegister, FShaderPluginContext* InContext);
+
+	// ISceneViewExtension
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
+	virtual void PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override;
+	virtual void PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView) override {}
+	virtual void PostRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override;
+
+	static EShaderPluginRenderPoint GetRenderPoint_RenderThread();
+
+private:
+	// Whether InViewFamily renders the context's world. Contexts without a world draw with any view family.
+	bool IsContextViewFamily(const FSceneViewFamily& InViewFamily) const;
+
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	FShaderPluginContext* Context;
+	uint32 LastRenderedFrameNumber; // Render thread only
+};
@@ -0,0 +1,199 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "TextureUploadRing.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTrace.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "RenderUtils.h"
+#include "HAL/PlatformTime.h"
+
+FTextureUploadRing::FTextureUploadRing(int32 NumSlots /*= 3*/)
+	: LatestSlot(INDEX_NONE)
+	, NextSequence(0)
+{
+	// Fewer than two would mean every upload has to wait for the passes to stop reading the latest image.
+	Slots.SetNum(FMath::Max(NumSlots, 2));
+}
+
+FTextureUploadRing::~FTextureUploadRing()
+{
+	Release_RenderThread();
+}
+
+void FTextureUploadRing::Release_RenderThread()
+{
+	for (FSlot& Slot : Slots)
+	{
+		if (Slot.State == ESlotState::Filling)
+		{
+			// The task is writing into the locked staging texture, it has to be done before the texture can go.
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(Slot.FillTask, ENamedThreads::GetRenderThread_Local());
+			RHIUnlockTexture2D(Slot.StagingTexture, 0, false);
+		}
+		if (Slot.Texture.IsValid())
+		{
+			// The staging texture always has the same size as the slot's texture.
+			const FIntPoint Size(Slot.Texture->GetSizeX(), Slot.Texture->GetSizeY());
+			FShaderPluginMemory::TrackFree(EShaderPluginResource::SourceImages, NAME_None, 2 * CalculateImageBytes(Size.X, Size.Y, 0, PF_B8G8R8A8));
+		}
+		Slot = FSlot();
+	}
+	LatestSlot = INDEX_NONE;
+}
+
+bool FTextureUploadRing::HasPendingUploads() const
+{
+	for (const FSlot& Slot : Slots)
+	{
+		if (Slot.State == ESlotState::Filling || Slot.State == ESlotState::Uploading)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FTextureUploadRing::WriteFence_RenderThread(FRHICommandListImmediate& RHICmdList, FSlot& Slot)
+{
+	if (!Slot.Fence.IsValid())
+	{
+		Slot.Fence = RHICreateGPUFence(TEXT("ShaderPlugin_SourceImage"));
+	}
+	Slot.Fence->Clear();
+	RHICmdList.WriteGPUFence(Slot.Fence);
+}
+
+void FTextureUploadRing::CopyFilledSlot_RenderThread(FRHICommandListImmediate& RHICmdList, FSlot& Slot)
+{
+	RHIUnlockTexture2D(Slot.StagingTexture, 0, false);
+	Slot.FillTask = nullptr;
+
+	FRHICopyTextureInfo CopyInfo;
+	CopyInfo.Size = FIntVector(Slot.Texture->GetSizeX(), Slot.Texture->GetSizeY(), 1);
+	RHICmdList.CopyTexture(Slot.StagingTexture, Slot.Texture, CopyInfo);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, Slot.Texture);
+	WriteFence_RenderThread(RHICmdList, Slot);
+
+	Slot.State = ESlotState::Uploading;
+}
+
+void FTextureUploadRing::UpdateSlots_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	TArray<int32, TInlineAllocator<4>> FinishedSlots;
+	for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); SlotIndex++)
+	{
+		FSlot& Slot = Slots[SlotIndex];
+		if (Slot.State == ESlotState::Filling && Slot.FillTask->IsComplete())
+		{
+			CopyFilledSlot_RenderThread(RHICmdList, Slot);
+		}
+		else if (Slot.State == ESlotState::Retiring && Slot.Fence->Poll())
+		{
+			Slot.State = ESlotState::Free;
+		}
+		else if (Slot.State == ESlotState::Uploading && Slot.Fence->Poll())
+		{
+			FinishedSlots.Add(SlotIndex);
+			Stats.NumCompleted++;
+			Stats.BytesCompleted += Slot.Bytes;
+		}
+	}
+
+	if (FinishedSlots.Num() == 0)
+	{
+		return;
+	}
+
+	// Only the newest finished upload is handed out. The older ones never were, so nothing can be reading them.
+	int32 NewestSlot = FinishedSlots[0];
+	for (int32 SlotIndex : FinishedSlots)
+	{
+		if (Slots[SlotIndex].Sequence > Slots[NewestSlot].Sequence)
+		{
+			NewestSlot = SlotIndex;
+		}
+	}
+
+	for (int32 SlotIndex : FinishedSlots)
+	{
+		Slots[SlotIndex].State = ESlotState::Free;
+	}
+
+	if (LatestSlot != INDEX_NONE)
+	{
+		// Everything that read the old image was queued before this fence.
+		Slots[LatestSlot].State = ESlotState::Retiring;
+		WriteFence_RenderThread(RHICmdList, Slots[LatestSlot]);
+	}
+
+	LatestSlot = NewestSlot;
+	Slots[LatestSlot].State = ESlotState::Latest;
+}
+
+bool FTextureUploadRing::Upload_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, TArray<FColor>&& Pixels)
+{
+	check(IsInRenderingThread());
+	check(Pixels.Num() == Size.X * Size.Y);
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+	SHADERPLUGIN_TRACE_SCOPE(UploadSourceImage);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	UpdateSlots_RenderThread(RHICmdList);
+
+	FSlot* Slot = Slots.FindByPredicate([](const FSlot& Candidate) { return Candidate.State == ESlotState::Free; });
+	if (!Slot)
+	{
+		Stats.NumDropped++;
+		return false;
+	}
+
+	if (!Slot->Texture.IsValid() || Slot->Texture->GetSizeX() != Size.X || Slot->Texture->GetSizeY() != Size.Y)
+	{
+		if (Slot->Texture.IsValid())
+		{
+			FShaderPluginMemory::TrackFree(EShaderPluginResource::SourceImages, NAME_None, 2 * CalculateImageBytes(Slot->Texture->GetSizeX(), Slot->Texture->GetSizeY(), 0, PF_B8G8R8A8));
+		}
+
+		// FColor is stored as BGRA in memory.
+		FRHIResourceCreateInfo CreateInfo;
+		Slot->Texture = RHICreateTexture2D(Size.X, Size.Y, PF_B8G8R8A8, 1, 1, TexCreate_ShaderResource, CreateInfo);
+		Slot->StagingTexture = RHICreateTexture2D(Size.X, Size.Y, PF_B8G8R8A8, 1, 1, TexCreate_CPUWritable, CreateInfo);
+		FShaderPluginMemory::TrackAllocation(EShaderPluginResource::SourceImages, NAME_None, 2 * CalculateImageBytes(Size.X, Size.Y, 0, PF_B8G8R8A8));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated, 2);
+	}
+
+	// The slot's fence has passed, so the GPU is done with both textures and the lock doesn't have to wait for it. The
+	// rows of the locked texture may be padded, so the task copies them one by one.
+	const int64 Bytes = Pixels.Num() * sizeof(FColor);
+	uint32 DestStride = 0;
+	uint8* Dest = static_cast<uint8*>(RHILockTexture2D(Slot->StagingTexture, 0, RLM_WriteOnly, DestStride, false));
+	Slot->FillTask = FFunctionGraphTask::CreateAndDispatchWhenReady([Dest, DestStride, Size, Pixels = MoveTemp(Pixels)]()
+	{
+		for (int32 Row = 0; Row < Size.Y; Row++)
+		{
+			FMemory::Memcpy(Dest + Row * DestStride, &Pixels[Row * Size.X], Size.X * sizeof(FColor));
+		}
+	}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+
+	Slot->State = ESlotState::Filling;
+	Slot->Sequence = ++NextSequence;
+	Slot->Bytes = Bytes;
+
+	Stats.NumUploaded++;
+	Stats.BytesUploaded += Bytes;
+	Stats.UploadSeconds += FPlatformTime::Seconds() - StartTime;
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, Bytes);
+	return true;
+}
+
+FRHITexture* FTextureUploadRing::GetLatest_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	UpdateSlots_RenderThread(RHICmdList);
+	return LatestSlot != INDEX_NONE ? Slots[LatestSlot].Texture.GetReference() : nullptr;
+}
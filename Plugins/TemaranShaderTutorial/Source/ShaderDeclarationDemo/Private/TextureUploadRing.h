@@ -0,0 +1,88 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIResources.h"
+#include "Async/TaskGraphInterfaces.h"
+
+class FRHICommandListImmediate;
+
+// Running totals of a FTextureUploadRing, for the benchmark and the log.
+struct FTextureUploadRingStats
+{
+	int64 NumUploaded = 0;
+	int64 NumDropped = 0; // Every slot was busy, so the image was never uploaded
+	int64 NumCompleted = 0; // Uploads the GPU has been seen to finish
+	int64 BytesUploaded = 0;
+	int64 BytesCompleted = 0;
+	double UploadSeconds = 0.0; // Render thread time spent handing images to the RHI, the pixel copy itself runs on a task
+};
+
+/*
+ * Streams CPU images into a small ring of textures without ever waiting for the GPU. Each slot has a fence that is
+ * written after the last GPU work that touches it: first its upload, then, once a newer upload has replaced it, whatever
+ * read it while it was the latest. A slot is only written again after its fence has passed, so an upload never has to
+ * wait for the GPU to let go of the texture, and readers never see a half written one. When every slot is still busy
+ * the image is dropped rather than waited for, since the next one will be newer anyway. Render thread only.
+ *
+ * Each slot also has a CPU writable staging texture. The render thread only locks it, the pixels are copied in by a task,
+ * and once that is done the staging texture is unlocked and copied into the slot's texture on the GPU. The same fence
+ * guards both textures, so the render thread never copies pixels or waits for the RHI to take them.
+ */
+class FTextureUploadRing
+{
+public:
+	explicit FTextureUploadRing(int32 NumSlots = 3);
+	~FTextureUploadRing();
+
+	// Starts copying Pixels into the first free slot. Returns false if the image was dropped because every slot was busy.
+	bool Upload_RenderThread(FRHICommandListImmediate& RHICmdList, const FIntPoint& Size, TArray<FColor>&& Pixels);
+
+	// The newest image the GPU has finished uploading, or nullptr if there is none yet. Never waits for the GPU.
+	FRHITexture* GetLatest_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// Counts up with every upload, so it tells images apart even when a slot's texture is reused. 0 when there is none.
+	uint64 GetLatestSequence() const { return LatestSlot != INDEX_NONE ? Slots[LatestSlot].Sequence : 0; }
+
+	void Release_RenderThread();
+
+	const FTextureUploadRingStats& GetStats() const { return Stats; }
+
+	// Whether any upload is still on its way to the GPU.
+	bool HasPendingUploads() const;
+
+private:
+	enum class ESlotState : uint8
+	{
+		Free,
+		Filling,	// The staging texture is locked and a task is copying the pixels into it
+		Uploading,	// The upload is queued, its fence passes when the copy is done
+		Latest,		// Handed to the passes
+		Retiring,	// Replaced by a newer upload, its fence passes when the passes that read it are done
+	};
+
+	struct FSlot
+	{
+		FTexture2DRHIRef Texture;
+		FTexture2DRHIRef StagingTexture; // CPU writable, copied into Texture once it is filled
+		FGraphEventRef FillTask;
+		FGPUFenceRHIRef Fence;
+		ESlotState State = ESlotState::Free;
+		uint64 Sequence = 0;
+		int64 Bytes = 0; // Of the last upload
+	};
+
+	// Frees retired slots the GPU is done with, queues the copies of filled staging textures, and makes the newest finished
+	// upload the latest one.
+	void UpdateSlots_RenderThread(FRHICommandListImmediate& RHICmdList);
+	void CopyFilledSlot_RenderThread(FRHICommandListImmediate& RHICmdList, FSlot& Slot);
+	void WriteFence_RenderThread(FRHICommandListImmediate& RHICmdList, FSlot& Slot);
+
+	TArray<FSlot> Slots;
+	int32 LatestSlot;
+	uint64 NextSequence;
+	FTextureUploadRingStats Stats;
+};
@@ -9,29 +9,79 @@
 #include "UniformBuffer.h"
 #include "RHICommandList.h"
 #include "PipelineStateCache.h"
+#include "ShaderPluginMemory.h"
+#include "ShaderPluginTrace.h"
+#include "HAL/IConsoleManager.h"
 
 #define NUM_VERTS 524288
 
+// The max area ring halves the number of rim vertices with every level.
+static_assert((NUM_VERTS & (NUM_VERTS - 1)) == 0, "NUM_VERTS must be a power of two.");
+
+static TAutoConsoleVariable<int32> CVarVertexCulling(
+	TEXT("r.ShaderPlugin.VertexCulling"),
+	1,
+	TEXT("When enabled, the vertex sample culls its triangles on the GPU and only draws the ones that can end up on the render target.\n")
+	TEXT("The draw arguments are written by the GPU as well. Needs SM5, the whole ring is drawn otherwise."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarVertexCullingMinArea(
+	TEXT("r.ShaderPlugin.VertexCulling.MinArea"),
+	0.0f,
+	TEXT("Triangles covering this many pixels or less are culled. Triangles that miss every pixel center are always culled."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarVertexRingTopology(
+	TEXT("r.ShaderPlugin.VertexRing.Topology"),
+	1,
+	TEXT("How the vertex sample triangulates its ring.\n")
+	TEXT(" 0: A fan around the center. Every triangle is a sliver, which wastes most of the pixel shading on partial 2x2 quads.\n")
+	TEXT(" 1: Max area, the ears of every other rim vertex, then every fourth and so on (default). Skips the center vertex."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarVertexRingMinTriangleSize(
+	TEXT("r.ShaderPlugin.VertexRing.MinTriangleSize"),
+	1.0f,
+	TEXT("With the max area topology, the levels whose triangles would be less than this many pixels tall at the current radius\n")
+	TEXT("and resolution are left out. The ring then differs from a circle by less than about this much. 0 draws every level."),
+	ECVF_RenderThreadSafe);
+
 class FVertexFromCSExampleCS : public FGlobalShader
 {
 public:
 	DECLARE_GLOBAL_SHADER(FVertexFromCSExampleCS);
 	SHADER_USE_PARAMETER_STRUCT(FVertexFromCSExampleCS, FGlobalShader);
 
+	// Writes the layout FLocalVertexFactory reads instead of the one our own vertex declaration reads.
+	class FSceneMeshDim : SHADER_PERMUTATION_BOOL("SCENE_MESH");
+	using FPermutationDomain = TShaderPermutationDomain<FSceneMeshDim>;
+
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER_TEXTURE(Texture2D, SrcTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, SrcSampler)
 		SHADER_PARAMETER_UAV(RWBuffer<float>, VertexPosition)
 		SHADER_PARAMETER_UAV(RWBuffer<float>, VertexColor)
-		SHADER_PARAMETER(float, Radius)
+		SHADER_PARAMETER_UAV(RWBuffer<float4>, VertexTangents) // Scene mesh only
+		SHADER_PARAMETER_UAV(RWBuffer<float2>, VertexTexCoords) // Scene mesh only
 		SHADER_PARAMETER(uint32, TotalSize)
+		SHADER_PARAMETER(float, MeshScale) // Scene mesh only
+		SHADER_PARAMETER(float, MeshHeight) // Scene mesh only
+		SHADER_PARAMETER_STRUCT_REF(FShaderPluginTargetParameters, ShaderPluginTarget) // Scene mesh only, Radius and SimulationState
 	END_SHADER_PARAMETER_STRUCT()
 
 public:
 
 	enum { ThreadGroupSize = 64 };
+	static_assert(NUM_VERTS / ThreadGroupSize <= 65535, "The ring is generated with one 1D dispatch, which can't have more than 65535 thread groups.");
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
+		// The scene mesh needs typed UAV stores to packed formats and a vertex factory that can read them back as buffers.
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		if (PermutationVector.Get<FSceneMeshDim>())
+		{
+			return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+		}
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::ES3_1);
 	}
 
@@ -45,7 +95,315 @@ public:
 
 IMPLEMENT_GLOBAL_SHADER(FVertexFromCSExampleCS, "/TutorialShaders/Private/VertexFromCs_ComputeShader.usf", "MainComputeShader", SF_Compute);
 
-void FVertexFromCSExample::RunVertexFromCS_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters)
+BEGIN_SHADER_PARAMETER_STRUCT(FVertexFromCSCullParameters, )
+	SHADER_PARAMETER_SRV(Buffer<float>, VertexPosition)
+	SHADER_PARAMETER_UAV(RWBuffer<uint>, CulledIndices)
+	SHADER_PARAMETER_UAV(RWBuffer<uint>, DrawArgs)
+	SHADER_PARAMETER(uint32, NumTriangles)
+	SHADER_PARAMETER(uint32, NumRimVertices)
+	SHADER_PARAMETER(float, MinScreenArea)
+	SHADER_PARAMETER(float, PositionScale)
+	SHADER_PARAMETER(FVector2D, PositionOffset)
+	SHADER_PARAMETER_STRUCT_REF(FShaderPluginTargetParameters, ShaderPluginTarget) // TargetSize
+END_SHADER_PARAMETER_STRUCT()
+
+class FVertexFromCSCullShader : public FGlobalShader
+{
+public:
+	enum { ThreadGroupSize = 64 };
+	static_assert(NUM_VERTS / ThreadGroupSize <= 65535, "The ring is culled with one 1D dispatch, which can't have more than 65535 thread groups.");
+
+	FVertexFromCSCullShader() { }
+	FVertexFromCSCullShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) { }
+
+	// Writing indices from a compute shader needs UAVs on index buffers, which we only rely on having with SM5.
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	static inline void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		OutEnvironment.SetDefine(TEXT("THREADGROUPSIZE_X"), ThreadGroupSize);
+	}
+};
+
+class FVertexFromCSResetArgsCS : public FVertexFromCSCullShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FVertexFromCSResetArgsCS);
+	using FParameters = FVertexFromCSCullParameters;
+	SHADER_USE_PARAMETER_STRUCT(FVertexFromCSResetArgsCS, FVertexFromCSCullShader);
+};
+
+class FVertexFromCSCullCS : public FVertexFromCSCullShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FVertexFromCSCullCS);
+	using FParameters = FVertexFromCSCullParameters;
+	SHADER_USE_PARAMETER_STRUCT(FVertexFromCSCullCS, FVertexFromCSCullShader);
+
+	class FRingTopologyDim : SHADER_PERMUTATION_INT("RING_TOPOLOGY", (int32)EVertexRingTopology::Num);
+	using FPermutationDomain = TShaderPermutationDomain<FRingTopologyDim>;
+};
+
+IMPLEMENT_GLOBAL_SHADER(FVertexFromCSResetArgsCS, "/TutorialShaders/Private/VertexFromCs_CullShader.usf", "MainResetArgsCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FVertexFromCSCullCS, "/TutorialShaders/Private/VertexFromCs_CullShader.usf", "MainCullCS", SF_Compute);
+
+FVertexFromCSRing::FVertexFromCSRing()
+	: bCullOutputValid(false)
+	, Topology(EVertexRingTopology::Fan)
+	, GeneratedSrcVersion(0)
+	, bGenerated(false)
+{
+}
+
+FVertexFromCSRing::~FVertexFromCSRing()
+{
+	Release_RenderThread();
+}
+
+// Triangle TriangleIndex of the max area ring. Keep in sync with GetTriangle in VertexFromCs_CullShader.usf.
+static FIntVector GetMaxAreaTriangle(uint32 TriangleIndex)
+{
+	// The level with NumLevelVertices rim vertices has NumLevelVertices / 2 ears, after the NumLevelVertices / 2 - 2
+	// triangles of the coarser levels. The vertices are reversed so the ears wind the same way as the fan.
+	const uint32 NumLevelVertices = 2u << FMath::FloorLog2(TriangleIndex + 2);
+	const uint32 Stride = NUM_VERTS / NumLevelVertices;
+	const uint32 First = (TriangleIndex + 2 - NumLevelVertices / 2) * 2 * Stride;
+	return FIntVector((First + 2 * Stride) % NUM_VERTS, First + Stride, First);
+}
+
+static uint32 GetMaxNumTriangles(EVertexRingTopology Topology)
+{
+	return Topology == EVertexRingTopology::MaxArea ? NUM_VERTS - 2 : NUM_VERTS;
+}
+
+int64 FVertexFromCSRing::GetIndexBufferBytes() const
+{
+	return sizeof(uint32) * 3 * GetMaxNumTriangles(Topology);
+}
+
+int64 FVertexFromCSRing::GetCullOutputBytes() const
+{
+	// Room for every triangle, since we can't know how many survive without asking the GPU.
+	return GetIndexBufferBytes() + sizeof(uint32) * 5;
+}
+
+uint32 FVertexFromCSRing::GetNumTriangles(float RadiusInPixels, float MinTriangleSize) const
+{
+	if (Topology != EVertexRingTopology::MaxArea)
+	{
+		return NUM_VERTS;
+	}
+
+	// An ear spanning two steps of Stride rim vertices is as tall as the sagitta of that arc, R * (1 - cos(Stride * 2PI / N)).
+	// Find the finest level that is still tall enough, the levels from there up have NUM_VERTS / Stride - 2 triangles.
+	uint32 Stride = 1;
+	while (Stride < NUM_VERTS / 4 && RadiusInPixels * 2.0f * FMath::Square(FMath::Sin(PI * Stride / NUM_VERTS)) < MinTriangleSize)
+	{
+		Stride *= 2;
+	}
+	return NUM_VERTS / Stride - 2;
+}
+
+void FVertexFromCSRing::SetTopology_RenderThread(EVertexRingTopology InTopology)
+{
+	check(IsInRenderingThread());
+
+	if (InTopology != Topology)
+	{
+		ReleaseIndexBuffer_RenderThread();
+		ReleaseCullOutput_RenderThread();
+		Topology = InTopology;
+	}
+}
+
+void FVertexFromCSRing::Allocate_RenderThread()
+{
+	check(IsInRenderingThread());
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+	SHADERPLUGIN_TRACE_SCOPE(VertexBufferSetup);
+
+	PositionBuffer.Initialize(sizeof(float), (NUM_VERTS + 1) * 4, PF_R32_FLOAT);
+	ColorBuffer.Initialize(sizeof(float), (NUM_VERTS + 1) * 4, PF_R32_FLOAT);
+	VertexOutput.PositionVB = PositionBuffer.Buffer;
+	VertexOutput.ColorVB = ColorBuffer.Buffer;
+
+	FShaderPluginMemory::TrackAllocation(EShaderPluginResource::VertexPositionBuffer, NAME_None, PositionBuffer.NumBytes);
+	FShaderPluginMemory::TrackAllocation(EShaderPluginResource::VertexColorBuffer, NAME_None, ColorBuffer.NumBytes);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated, 2);
+}
+
+void FVertexFromCSRing::BuildIndexBuffer_RenderThread()
+{
+	check(IsInRenderingThread());
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+	SHADERPLUGIN_TRACE_SCOPE(IndexBufferSetup);
+
+	// This only happens again when the topology changes.
+	FRHIResourceCreateInfo CreateInfo;
+	IndexBuffer = RHICreateIndexBuffer(sizeof(uint32), GetIndexBufferBytes(), BUF_Static, CreateInfo);
+	{
+		SHADERPLUGIN_TRACE_SCOPE(IndexBufferLockUnlock);
+		FShaderPluginScopedMemory IndexStagingMemory(EShaderPluginResource::VertexIndexStaging, NAME_None, GetIndexBufferBytes());
+		uint32* Indices = static_cast<uint32*>(RHILockIndexBuffer(IndexBuffer, 0, GetIndexBufferBytes(), RLM_WriteOnly));
+		const uint32 NumTriangles = GetMaxNumTriangles(Topology);
+		for (uint32 i = 0; i < NumTriangles; ++i)
+		{
+			const FIntVector Triangle = Topology == EVertexRingTopology::MaxArea ? GetMaxAreaTriangle(i) : FIntVector(NUM_VERTS, (i + 1) % NUM_VERTS, i);
+			Indices[i * 3 + 0] = Triangle.X;
+			Indices[i * 3 + 1] = Triangle.Y;
+			Indices[i * 3 + 2] = Triangle.Z;
+		}
+		RHIUnlockIndexBuffer(IndexBuffer);
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, GetIndexBufferBytes());
+	}
+
+	FShaderPluginMemory::TrackAllocation(EShaderPluginResource::VertexRingIndexBuffer, NAME_None, GetIndexBufferBytes());
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated);
+}
+
+void FVertexFromCSRing::ReleaseIndexBuffer_RenderThread()
+{
+	if (IndexBuffer.IsValid())
+	{
+		FShaderPluginMemory::TrackFree(EShaderPluginResource::VertexRingIndexBuffer, NAME_None, GetIndexBufferBytes());
+		IndexBuffer.SafeRelease();
+	}
+}
+
+void FVertexFromCSRing::AllocateCullOutput_RenderThread()
+{
+	check(IsInRenderingThread());
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
+	SHADERPLUGIN_TRACE_SCOPE(CullBufferSetup);
+
+	// Like the index buffer, this only happens again when the topology changes.
+	FRHIResourceCreateInfo CreateInfo;
+	CullOutput.CulledIndexBuffer = RHICreateIndexBuffer(sizeof(uint32), GetIndexBufferBytes(), BUF_UnorderedAccess, CreateInfo);
+	CullOutput.CulledIndexUAV = RHICreateUnorderedAccessView(CullOutput.CulledIndexBuffer, PF_R32_UINT);
+	DrawArgsBuffer.Initialize(sizeof(uint32), 5, PF_R32_UINT, BUF_DrawIndirect);
+	CullOutput.DrawArgsBuffer = DrawArgsBuffer.Buffer;
+	CullOutput.DrawArgsUAV = DrawArgsBuffer.UAV;
+	bCullOutputValid = false;
+
+	FShaderPluginMemory::TrackAllocation(EShaderPluginResource::VertexIndexBuffer, NAME_None, GetCullOutputBytes());
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::ResourcesCreated, 2);
+}
+
+void FVertexFromCSRing::ReleaseCullOutput_RenderThread()
+{
+	if (CullOutput.CulledIndexBuffer.IsValid())
+	{
+		FShaderPluginMemory::TrackFree(EShaderPluginResource::VertexIndexBuffer, NAME_None, GetCullOutputBytes());
+		CullOutput = FComputeShaderCullOutput();
+		DrawArgsBuffer.Release();
+	}
+	bCullOutputValid = false;
+}
+
+void FVertexFromCSRing::Release_RenderThread()
+{
+	ReleaseIndexBuffer_RenderThread();
+	ReleaseCullOutput_RenderThread();
+
+	if (!PositionBuffer.Buffer.IsValid())
+	{
+		return;
+	}
+
+	FShaderPluginMemory::TrackFree(EShaderPluginResource::VertexPositionBuffer, NAME_None, PositionBuffer.NumBytes);
+	FShaderPluginMemory::TrackFree(EShaderPluginResource::VertexColorBuffer, NAME_None, ColorBuffer.NumBytes);
+
+	PositionBuffer.Release();
+	ColorBuffer.Release();
+	VertexOutput = FComputeShaderVertexOutputStruct();
+	GeneratedSrcTexture.SafeRelease();
+	GeneratedSrcVersion = 0;
+	bGenerated = false;
+}
+
+bool FVertexFromCSRing::Update_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* SrcTexture, uint64 SrcVersion /*= 0*/)
+{
+	check(IsInRenderingThread());
+
+	if (!PositionBuffer.Buffer.IsValid())
+	{
+		Allocate_RenderThread();
+	}
+
+	if (!IndexBuffer.IsValid())
+	{
+		BuildIndexBuffer_RenderThread();
+	}
+
+	if (bGenerated && GeneratedSrcTexture == SrcTexture && GeneratedSrcVersion == SrcVersion)
+	{
+		return false;
+	}
+
+	{
+		SHADERPLUGIN_TRACE_SCOPE(VertexBufferLockUnlock);
+
+		// The center isn't written by the compute shader.
+		FVector4* PositionBufferData = static_cast<FVector4*>(RHILockVertexBuffer(PositionBuffer.Buffer, sizeof(FVector4) * NUM_VERTS, sizeof(FVector4), EResourceLockMode::RLM_WriteOnly));
+		*PositionBufferData = FVector4(0.0, 0.0, 0.0, 1.0);
+		RHIUnlockVertexBuffer(PositionBuffer.Buffer);
+
+		FVector4* ColorBufferData = static_cast<FVector4*>(RHILockVertexBuffer(ColorBuffer.Buffer, sizeof(FVector4) * NUM_VERTS, sizeof(FVector4), EResourceLockMode::RLM_WriteOnly));
+		*ColorBufferData = FVector4(1.0, 1.0, 0.0, 1.0);
+		RHIUnlockVertexBuffer(ColorBuffer.Buffer);
+
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::BytesUploaded, sizeof(FVector4) * 2);
+	}
+
+	FComputeShaderOutputUAVs OutputUAVs;
+	OutputUAVs.VertexPositionUAV = PositionBuffer.UAV;
+	OutputUAVs.VertexColorUAV = ColorBuffer.UAV;
+	FVertexFromCSExample::RunComputeShader_RenderThread(RHICmdList, SrcTexture, OutputUAVs);
+
+	GeneratedSrcTexture = SrcTexture;
+	GeneratedSrcVersion = SrcVersion;
+	bGenerated = true;
+	bCullOutputValid = false;
+	return true;
+}
+
+bool FVertexFromCSRing::Cull_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FIntPoint& TargetSize, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform)
+{
+	check(IsInRenderingThread());
+	check(IndexBuffer.IsValid());
+
+	if (!CullOutput.CulledIndexBuffer.IsValid())
+	{
+		AllocateCullOutput_RenderThread();
+	}
+
+	FCullInputs Inputs;
+	Inputs.TargetSize = TargetSize;
+	Inputs.NumTriangles = NumTriangles;
+	Inputs.Scale = Transform.Scale;
+	Inputs.Offset = Transform.Offset;
+	Inputs.MinScreenArea = FMath::Max(CVarVertexCullingMinArea.GetValueOnRenderThread(), 0.0f);
+
+	// A ring that holds still, or several targets of the same size drawing it the same way, cull the same triangles.
+	// Reusing what the last pass left behind skips both dispatches and all of their reads and writes.
+	if (bCullOutputValid && CulledInputs == Inputs)
+	{
+		return false;
+	}
+
+	FVertexFromCSExample::RunCullShader_RenderThread(RHICmdList, TargetUniformBuffer, PositionBuffer.SRV, Topology, NumTriangles, Transform, CullOutput);
+
+	CulledInputs = Inputs;
+	bCullOutputValid = true;
+	return true;
+}
+
+void FVertexFromCSExample::RunVertexFromCS_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FVertexFromCSRing& Ring, FRHITexture* SrcTexture, uint64 SrcVersion /*= 0*/)
 {
 	if (!DrawParameters.RenderTarget)
 	{
@@ -54,59 +412,182 @@ void FVertexFromCSExample::RunVertexFromCS_RenderThread(FRHICommandListImmediate
 
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_Render); // Used to gather CPU profiling data for the UE4 session frontend
 	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_Render); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	LLM_SCOPE_SHADERPLUGIN(); // Used to attribute our allocations to the ShaderPlugin tag in the low level memory tracker
 
-	FRWBuffer VertexPositionRWBuffer;
-	VertexPositionRWBuffer.Initialize(sizeof(float), (NUM_VERTS + 1) * 4, PF_R32_FLOAT);
-	FRWBuffer VertexColorRWBuffer;
-	VertexColorRWBuffer.Initialize(sizeof(float), (NUM_VERTS + 1) * 4, PF_R32_FLOAT);
+	// Only regenerates when a new source image has arrived.
+	Ring.SetTopology_RenderThread(GetRingTopology_RenderThread());
+	Ring.Update_RenderThread(RHICmdList, SrcTexture, SrcVersion);
 
-	FComputeShaderOutputUAVs OutputUAVs;
-	OutputUAVs.VertexPositionUAV = VertexPositionRWBuffer.UAV;
-	OutputUAVs.VertexColorUAV = VertexColorRWBuffer.UAV;
+	FVertexFromCSDrawTransform Transform;
+	Transform.Scale = DrawParameters.ComputeRadius;
+	Transform.Offset = DrawParameters.VertexOffset;
+	Transform.Tint = DrawParameters.VertexTint;
 
-	FComputeShaderVertexOutputStruct OutputVertex;
-	OutputVertex.PositionVB = VertexPositionRWBuffer.Buffer;
-	OutputVertex.ColorVB = VertexColorRWBuffer.Buffer;
+	// Smaller rings draw fewer of the fine levels, see EVertexRingTopology.
+	const uint32 NumTriangles = Ring.GetNumTriangles(GetRingRadiusInPixels(DrawParameters.GetRenderTargetSize(), Transform), GetMinTriangleSize_RenderThread());
 
-	FVector4* PositionBufferData = static_cast<FVector4*>(RHILockVertexBuffer(VertexPositionRWBuffer.Buffer, 0, sizeof(float) * (NUM_VERTS + 1) * 4, EResourceLockMode::RLM_WriteOnly));
-	PositionBufferData[NUM_VERTS] = FVector4(0.0, 0.0, 0.0, 1.0);
-	RHIUnlockVertexBuffer(VertexPositionRWBuffer.Buffer);
-
-	FVector4* BufferData = static_cast<FVector4*>(RHILockVertexBuffer(VertexColorRWBuffer.Buffer, 0, sizeof(float) * (NUM_VERTS + 1) * 4, EResourceLockMode::RLM_WriteOnly));
-	BufferData[NUM_VERTS] = FVector4(1.0, 1.0, 0.0, 1.0);
-	RHIUnlockVertexBuffer(VertexColorRWBuffer.Buffer);
+	if (UseCulling_RenderThread())
+	{
+		// What survives depends on the radius, offset and target size, so this runs again whenever one of them changes.
+		Ring.Cull_RenderThread(RHICmdList, TargetUniformBuffer, DrawParameters.GetRenderTargetSize(), NumTriangles, Transform);
 
-	RunComputeShader_RenderThread(RHICmdList, DrawParameters, OutputUAVs);
+		DrawCulledToRenderTarget_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer, Ring.GetVertexOutput(), Ring.GetCullOutput(), Transform);
+		return;
+	}
 
-	DrawToRenderTarget_RenderThread(RHICmdList, DrawParameters, OutputVertex);
+	DrawToRenderTarget_RenderThread(RHICmdList, DrawParameters, TargetUniformBuffer, Ring.GetVertexOutput(), Ring.GetIndexBuffer(), NumTriangles, Transform);
 }
 
-void FVertexFromCSExample::RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FComputeShaderOutputUAVs& ComputeShaderOutputUAVs)
+void FVertexFromCSExample::RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* SrcTexture, FComputeShaderOutputUAVs& ComputeShaderOutputUAVs)
 {
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_VertexCompute); // Used to gather CPU profiling data for the UE4 session frontend
 	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_VertexCompute); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(VertexDispatch); // Used to show our work next to the engine's in Unreal Insights
 
 	UnbindRenderTargets(RHICmdList);
 	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, ComputeShaderOutputUAVs.VertexPositionUAV);
 	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, ComputeShaderOutputUAVs.VertexColorUAV);
 
 	FVertexFromCSExampleCS::FParameters PassParameters;
-	PassParameters.SrcTexture = GBlackTexture->TextureRHI;
+	PassParameters.SrcTexture = SrcTexture;
+	PassParameters.SrcSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
 	PassParameters.VertexPosition = ComputeShaderOutputUAVs.VertexPositionUAV;
 	PassParameters.VertexColor = ComputeShaderOutputUAVs.VertexColorUAV;
-	PassParameters.Radius = DrawParameters.ComputeRadius;
 	PassParameters.TotalSize = NUM_VERTS;
 
-	TShaderMapRef<FVertexFromCSExampleCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FVertexFromCSExampleCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FVertexFromCSExampleCS::FSceneMeshDim>(false);
+
+	TShaderMapRef<FVertexFromCSExampleCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 
 	FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters,
 		FIntVector(NUM_VERTS / (int)FVertexFromCSExampleCS::ThreadGroupSize,
 			1, 1));
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::VerticesGenerated, NUM_VERTS);
 
 	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, ComputeShaderOutputUAVs.VertexPositionUAV);
 	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, ComputeShaderOutputUAVs.VertexColorUAV);
 }
 
+void FVertexFromCSExample::RunSceneMeshComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderSceneMeshUAVs& SceneMeshUAVs, uint32 NumTriangles, float MeshScale, float MeshHeight)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_SceneMeshCompute); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_SceneMeshCompute); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(SceneMeshDispatch); // Used to show our work next to the engine's in Unreal Insights
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, SceneMeshUAVs.VertexPositionUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, SceneMeshUAVs.VertexTangentsUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, SceneMeshUAVs.VertexTexCoordsUAV);
+
+	check(NumTriangles <= MaxSceneMeshTriangles);
+	static_assert(MaxSceneMeshTriangles / FVertexFromCSExampleCS::ThreadGroupSize <= 65535, "MaxSceneMeshTriangles doesn't fit in one dispatch.");
+
+	FVertexFromCSExampleCS::FParameters PassParameters;
+	PassParameters.SrcTexture = GBlackTexture->TextureRHI;
+	PassParameters.SrcSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
+	PassParameters.VertexPosition = SceneMeshUAVs.VertexPositionUAV;
+	PassParameters.VertexTangents = SceneMeshUAVs.VertexTangentsUAV;
+	PassParameters.VertexTexCoords = SceneMeshUAVs.VertexTexCoordsUAV;
+	PassParameters.TotalSize = NumTriangles;
+	PassParameters.MeshScale = MeshScale;
+	PassParameters.MeshHeight = MeshHeight;
+	PassParameters.ShaderPluginTarget = TargetUniformBuffer;
+
+	FVertexFromCSExampleCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FVertexFromCSExampleCS::FSceneMeshDim>(true);
+
+	TShaderMapRef<FVertexFromCSExampleCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+	FComputeShaderUtils::Dispatch(RHICmdList, *ComputeShader, PassParameters,
+		FIntVector(FMath::DivideAndRoundUp(NumTriangles, (uint32)FVertexFromCSExampleCS::ThreadGroupSize), 1, 1));
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::VerticesGenerated, NumTriangles * 3);
+
+	// The buffers are read as vertex streams and SRVs by every pass that draws the mesh this frame.
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, SceneMeshUAVs.VertexPositionUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, SceneMeshUAVs.VertexTangentsUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, SceneMeshUAVs.VertexTexCoordsUAV);
+}
+
+bool FVertexFromCSExample::SupportsSceneMesh(ERHIFeatureLevel::Type FeatureLevel)
+{
+	return FeatureLevel >= ERHIFeatureLevel::SM5;
+}
+
+void FVertexFromCSExample::RunCullShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FRHIShaderResourceView* VertexPositionSRV, EVertexRingTopology Topology, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform, const FComputeShaderCullOutput& CullOutput)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_VertexCull); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_VertexCull); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(VertexCull); // Used to show our work next to the engine's in Unreal Insights
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, CullOutput.CulledIndexUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EGfxToCompute, CullOutput.DrawArgsUAV);
+
+	FVertexFromCSCullParameters PassParameters;
+	PassParameters.VertexPosition = VertexPositionSRV;
+	PassParameters.CulledIndices = CullOutput.CulledIndexUAV;
+	PassParameters.DrawArgs = CullOutput.DrawArgsUAV;
+	PassParameters.NumTriangles = NumTriangles;
+	PassParameters.NumRimVertices = NUM_VERTS;
+	PassParameters.MinScreenArea = FMath::Max(CVarVertexCullingMinArea.GetValueOnRenderThread(), 0.0f);
+	PassParameters.PositionScale = Transform.Scale;
+	PassParameters.PositionOffset = Transform.Offset;
+	PassParameters.ShaderPluginTarget = TargetUniformBuffer;
+
+	auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+	{
+		TShaderMapRef<FVertexFromCSResetArgsCS> ResetArgsShader(ShaderMap);
+		FComputeShaderUtils::Dispatch(RHICmdList, *ResetArgsShader, PassParameters, FIntVector(1, 1, 1));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	}
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, CullOutput.DrawArgsUAV);
+
+	{
+		FVertexFromCSCullCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FVertexFromCSCullCS::FRingTopologyDim>((int32)Topology);
+
+		TShaderMapRef<FVertexFromCSCullCS> CullShader(ShaderMap, PermutationVector);
+		FComputeShaderUtils::Dispatch(RHICmdList, *CullShader, PassParameters, FIntVector(FMath::DivideAndRoundUp(NumTriangles, (uint32)FVertexFromCSCullShader::ThreadGroupSize), 1, 1));
+		FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Dispatches);
+	}
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, CullOutput.CulledIndexUAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, CullOutput.DrawArgsUAV);
+}
+
+bool FVertexFromCSExample::UseCulling_RenderThread()
+{
+	return CVarVertexCulling.GetValueOnRenderThread() != 0 && GMaxRHIFeatureLevel >= ERHIFeatureLevel::SM5;
+}
+
+EVertexRingTopology FVertexFromCSExample::GetRingTopology_RenderThread()
+{
+	return (EVertexRingTopology)FMath::Clamp(CVarVertexRingTopology.GetValueOnRenderThread(), 0, (int32)EVertexRingTopology::Num - 1);
+}
+
+float FVertexFromCSExample::GetMinTriangleSize_RenderThread()
+{
+	return FMath::Max(CVarVertexRingMinTriangleSize.GetValueOnRenderThread(), 0.0f);
+}
+
+const TCHAR* FVertexFromCSExample::GetRingTopologyName(EVertexRingTopology Topology)
+{
+	switch (Topology)
+	{
+	case EVertexRingTopology::Fan:		return TEXT("Fan");
+	case EVertexRingTopology::MaxArea:	return TEXT("MaxArea");
+	default:							return TEXT("Unknown");
+	}
+}
+
+float FVertexFromCSExample::GetRingRadiusInPixels(const FIntPoint& TargetSize, const FVertexFromCSDrawTransform& Transform)
+{
+	// On a target that isn't square the ring is an ellipse. Its short axis is where the triangles are the thinnest.
+	return Transform.Scale * 0.5f * FMath::Min(TargetSize.X, TargetSize.Y);
+}
+
 class FVertexFromCSVertexDeclaration : public FRenderResource
 {
 public:
@@ -136,15 +617,20 @@ class FVertexFromCSExampleVS : public FGlobalShader
 {
 public:
 	DECLARE_GLOBAL_SHADER(FVertexFromCSExampleVS);
+	SHADER_USE_PARAMETER_STRUCT(FVertexFromCSExampleVS, FGlobalShader);
+
+	// See FVertexFromCSDrawTransform.
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(float, PositionScale)
+		SHADER_PARAMETER(FVector2D, PositionOffset)
+		SHADER_PARAMETER(FLinearColor, Tint)
+	END_SHADER_PARAMETER_STRUCT()
 
 public:
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
 		return true;
 	}
-
-	FVertexFromCSExampleVS() { }
-	FVertexFromCSExampleVS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) { }
 };
 
 class FVertexFromCSExamplePS : public FGlobalShader
@@ -154,7 +640,7 @@ public:
 	SHADER_USE_PARAMETER_STRUCT(FVertexFromCSExamplePS, FGlobalShader);
 
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
-		SHADER_PARAMETER(FVector2D, TextureSize) // Metal doesn't support GetDimensions(), so we send in this data via our parameters.
+		SHADER_PARAMETER_STRUCT_REF(FShaderPluginTargetParameters, ShaderPluginTarget) // TargetSize
 	END_SHADER_PARAMETER_STRUCT()
 
 public:
@@ -169,16 +655,9 @@ public:
 IMPLEMENT_GLOBAL_SHADER(FVertexFromCSExampleVS, "/TutorialShaders/Private/VertexFromCS_UseShader.usf", "MainVertexShader", SF_Vertex);
 IMPLEMENT_GLOBAL_SHADER(FVertexFromCSExamplePS, "/TutorialShaders/Private/VertexFromCS_UseShader.usf", "MainPixelShader", SF_Pixel);
 
-void FVertexFromCSExample::DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FComputeShaderVertexOutputStruct& ComputeShaderOutput)
+// Both draws use the same shaders and vertex layout, they only differ in how the vertices are assembled.
+static void SetVertexFromCSPipelineState(FRHICommandListImmediate& RHICmdList, EPrimitiveType PrimitiveType, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FVertexFromCSDrawTransform& Transform)
 {
-	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_VertexFromCSVertexPixel); // Used to gather CPU profiling data for the UE4 session frontend
-	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_VertexFromCSVertexPixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
-
-	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture());
-
-	FRHIRenderPassInfo RenderPassInfo(DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture(), ERenderTargetActions::Clear_Store);
-	RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_OutputToRenderTarget"));
-
 	auto ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
 	TShaderMapRef<FVertexFromCSExampleVS> VertexShader(ShaderMap);
 	TShaderMapRef<FVertexFromCSExamplePS> PixelShader(ShaderMap);
@@ -192,39 +671,101 @@ void FVertexFromCSExample::DrawToRenderTarget_RenderThread(FRHICommandListImmedi
 	GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = GVertexFromCSVertexDeclaration.VertexDeclarationRHI;
 	GraphicsPSOInit.BoundShaderState.VertexShaderRHI = GETSAFERHISHADER_VERTEX(*VertexShader);
 	GraphicsPSOInit.BoundShaderState.PixelShaderRHI = GETSAFERHISHADER_PIXEL(*PixelShader);
-	GraphicsPSOInit.PrimitiveType = PT_TriangleList;
+	GraphicsPSOInit.PrimitiveType = PrimitiveType;
 	SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit);
 
+	FVertexFromCSExampleVS::FParameters VertexParameters;
+	VertexParameters.PositionScale = Transform.Scale;
+	VertexParameters.PositionOffset = Transform.Offset;
+	VertexParameters.Tint = Transform.Tint;
+	SetShaderParameters(RHICmdList, *VertexShader, VertexShader->GetVertexShader(), VertexParameters);
+
 	// Setup the pixel shader
 	FVertexFromCSExamplePS::FParameters PassParameters;
-	PassParameters.TextureSize = FVector2D(DrawParameters.GetRenderTargetSize().X, DrawParameters.GetRenderTargetSize().Y);
+	PassParameters.ShaderPluginTarget = TargetUniformBuffer;
 	SetShaderParameters(RHICmdList, *PixelShader, PixelShader->GetPixelShader(), PassParameters);
+}
 
-	TArray<uint32> Indices;
-	Indices.SetNum(NUM_VERTS * 3);
-	for (int i = 0; i < NUM_VERTS; ++i)
-	{
-		Indices[i * 3 + 0] = NUM_VERTS;
-		Indices[i * 3 + 1] = (i + 1) % NUM_VERTS;
-		Indices[i * 3 + 2] = i;
-	}
+void FVertexFromCSExample::DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, FRHIIndexBuffer* IndexBuffer, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform)
+{
+	DrawToTexture_RenderThread(RHICmdList, TargetUniformBuffer, DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture(), ComputeShaderOutput, IndexBuffer, NumTriangles, Transform);
+}
 
-	FRHIResourceCreateInfo CreateInfo;
-	FIndexBufferRHIRef IndexBufferRHI = RHICreateIndexBuffer(sizeof(uint32), sizeof(uint32) * 3 * NUM_VERTS, BUF_Volatile, CreateInfo);
-	void* VoidPtr2 = RHILockIndexBuffer(IndexBufferRHI, 0, sizeof(uint32) * 3 * NUM_VERTS, RLM_WriteOnly);
-	FPlatformMemory::Memcpy(VoidPtr2, Indices.GetData(), sizeof(uint32) * 3 * NUM_VERTS);
-	RHIUnlockIndexBuffer(IndexBufferRHI);
+void FVertexFromCSExample::DrawToTexture_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FRHITexture* RenderTargetTexture, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, FRHIIndexBuffer* IndexBuffer, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_VertexFromCSVertexPixel); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_VertexFromCSVertexPixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(VertexDraw); // Used to show our work next to the engine's in Unreal Insights
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, RenderTargetTexture);
+
+	FRHIRenderPassInfo RenderPassInfo(RenderTargetTexture, ERenderTargetActions::Clear_Store);
+	RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_OutputToRenderTarget"));
+
+	SetVertexFromCSPipelineState(RHICmdList, PT_TriangleList, TargetUniformBuffer, Transform);
 
 	// Draw
 	RHICmdList.SetStreamSource(0, ComputeShaderOutput.PositionVB, 0);
 	RHICmdList.SetStreamSource(1, ComputeShaderOutput.ColorVB, 0);
-	//RHICmdList.DrawPrimitive(0, NUM_VERTS / 2, 1);
-	RHICmdList.DrawIndexedPrimitive(IndexBufferRHI, 0, 0, NUM_VERTS + 1, 0, NUM_VERTS, 1);
+	RHICmdList.DrawIndexedPrimitive(IndexBuffer, 0, 0, NUM_VERTS + 1, 0, NumTriangles, 1);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Draws);
 
-	IndexBufferRHI.SafeRelease();
+	RHICmdList.EndRenderPass();
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, RenderTargetTexture);
+}
+
+void FVertexFromCSExample::DrawCulledToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, const FComputeShaderCullOutput& CullOutput, const FVertexFromCSDrawTransform& Transform)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_VertexFromCSVertexPixel); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_VertexFromCSVertexPixel); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(VertexDrawCulled); // Used to show our work next to the engine's in Unreal Insights
+
+	FRHITexture* RenderTargetTexture = DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture();
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, RenderTargetTexture);
+
+	FRHIRenderPassInfo RenderPassInfo(RenderTargetTexture, ERenderTargetActions::Clear_Store);
+	RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_CulledToRenderTarget"));
+
+	SetVertexFromCSPipelineState(RHICmdList, PT_TriangleList, TargetUniformBuffer, Transform);
+
+	// The index count was written by the cull pass, so there is nothing to build or upload here.
+	RHICmdList.SetStreamSource(0, ComputeShaderOutput.PositionVB, 0);
+	RHICmdList.SetStreamSource(1, ComputeShaderOutput.ColorVB, 0);
+	RHICmdList.DrawIndexedPrimitiveIndirect(CullOutput.CulledIndexBuffer, CullOutput.DrawArgsBuffer, 0);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Draws);
 
 	RHICmdList.EndRenderPass();
 
-	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture());
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, RenderTargetTexture);
 }
 
+void FVertexFromCSExample::DrawPointsToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, uint32 NumPoints, const FVertexFromCSDrawTransform& Transform)
+{
+	if (!DrawParameters.RenderTarget || NumPoints == 0)
+	{
+		return;
+	}
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderPlugin_VertexFromCSPoints); // Used to gather CPU profiling data for the UE4 session frontend
+	SCOPED_DRAW_EVENT(RHICmdList, ShaderPlugin_VertexFromCSPoints); // Used to profile GPU activity and add metadata to be consumed by for example RenderDoc
+	SHADERPLUGIN_TRACE_SCOPE(VertexDrawPoints); // Used to show our work next to the engine's in Unreal Insights
+
+	FRHITexture* RenderTargetTexture = DrawParameters.RenderTarget->GetRenderTargetResource()->GetRenderTargetTexture();
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable, RenderTargetTexture);
+
+	FRHIRenderPassInfo RenderPassInfo(RenderTargetTexture, ERenderTargetActions::Clear_Store);
+	RHICmdList.BeginRenderPass(RenderPassInfo, TEXT("ShaderPlugin_PointsToRenderTarget"));
+
+	SetVertexFromCSPipelineState(RHICmdList, PT_PointList, TargetUniformBuffer, Transform);
+
+	// No index buffer needed, every vertex is its own point.
+	RHICmdList.SetStreamSource(0, ComputeShaderOutput.PositionVB, 0);
+	RHICmdList.SetStreamSource(1, ComputeShaderOutput.ColorVB, 0);
+	RHICmdList.DrawPrimitive(0, NumPoints, 1);
+	FShaderPluginTrace::AddToCounter(EShaderPluginTraceCounter::Draws);
+
+	RHICmdList.EndRenderPass();
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, RenderTargetTexture);
+}
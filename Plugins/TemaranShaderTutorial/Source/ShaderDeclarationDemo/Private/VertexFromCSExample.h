@@ -3,6 +3,8 @@
 #include "CoreMinimal.h"
 #include "ShaderDeclarationDemoModule.h"
 #include "RHIResources.h"
+#include "RenderResource.h"
+#include "ShaderPluginTargetParameters.h"
 
 struct FComputeShaderVertexOutputStruct
 {
@@ -16,14 +18,170 @@ struct FComputeShaderOutputUAVs
 	FUnorderedAccessViewRHIRef VertexColorUAV;
 };
 
+// The streams FComputeMeshSceneProxy hands to its vertex factory, see VertexFromCs_ComputeShader.usf for the layout.
+struct FComputeShaderSceneMeshUAVs
+{
+	FUnorderedAccessViewRHIRef VertexPositionUAV;
+	FUnorderedAccessViewRHIRef VertexTangentsUAV;
+	FUnorderedAccessViewRHIRef VertexTexCoordsUAV;
+};
+
+// The compacted index buffer and the arguments for the indirect draw, both written by the cull pass.
+struct FComputeShaderCullOutput
+{
+	FIndexBufferRHIRef CulledIndexBuffer;
+	FUnorderedAccessViewRHIRef CulledIndexUAV;
+	FVertexBufferRHIRef DrawArgsBuffer;
+	FUnorderedAccessViewRHIRef DrawArgsUAV;
+};
+
+// Changes to the ring that are cheap to make per vertex while drawing, so they never need the compute shader to run again.
+struct FVertexFromCSDrawTransform
+{
+	float Scale;
+	FVector2D Offset; // In clip space
+	FLinearColor Tint;
+
+	FVertexFromCSDrawTransform()
+		: Scale(1.0f)
+		, Offset(FVector2D::ZeroVector)
+		, Tint(FLinearColor::White)
+	{
+	}
+};
+
+// How the triangles of the ring are laid out in its index buffer. Must match RING_TOPOLOGY in VertexFromCs_CullShader.usf.
+enum class EVertexRingTopology : uint8
+{
+	// Triangle i is (center, i + 1, i). Every triangle is a sliver a tiny fraction of a pixel wide that still reaches all
+	// the way to the center, so the rasterizer shades many 2x2 quads for every pixel that is actually covered.
+	Fan,
+
+	// The ears of every other rim vertex, then of every fourth one and so on, which is the triangulation of a regular
+	// polygon with the largest smallest triangle. The coarsest level comes first in the index buffer, so drawing only the
+	// first triangles gives a coarser polygon, and the fine levels that would just be slivers at the current resolution
+	// can be left out. The center vertex isn't used.
+	MaxArea,
+
+	Num
+};
+
+/*
+ * The ring of the vertex sample, kept between draws. The compute shader generates it with a radius of 1 and only runs
+ * again when the vertex buffers are new or its inputs change, the radius of each draw is applied by the vertex shader.
+ * The index buffer only depends on the topology, so it is built once and only rebuilt when that changes. The same goes for
+ * the buffers the cull pass writes, which also keep what the last cull left in them so draws that would cull the same
+ * triangles again can skip the pass. Render thread only.
+ */
+class FVertexFromCSRing
+{
+public:
+	FVertexFromCSRing();
+	~FVertexFromCSRing();
+
+	// Allocates the buffers on the first call and regenerates the ring when needed. Returns whether the compute shader ran.
+	// SrcVersion has to change whenever new pixels are written to the same SrcTexture.
+	bool Update_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* SrcTexture, uint64 SrcVersion = 0);
+
+	void Release_RenderThread();
+
+	// Rebuilds the index buffer on the next Update_RenderThread if the topology changed. The vertices stay as they are.
+	void SetTopology_RenderThread(EVertexRingTopology InTopology);
+	EVertexRingTopology GetTopology() const { return Topology; }
+
+	// How many triangles from the start of the index buffer to draw when the ring is RadiusInPixels large. Only the max area
+	// topology can leave any out, it skips the levels whose triangles are less than MinTriangleSize pixels tall.
+	uint32 GetNumTriangles(float RadiusInPixels, float MinTriangleSize) const;
+
+	// Culls the first NumTriangles triangles for a draw with Transform to a target of TargetSize, unless the last call already
+	// did that for the same ring. Draw with GetCullOutput afterwards. Returns whether the cull pass ran.
+	bool Cull_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FIntPoint& TargetSize, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform);
+
+	const FComputeShaderVertexOutputStruct& GetVertexOutput() const { return VertexOutput; }
+	FRHIShaderResourceView* GetPositionSRV() const { return PositionBuffer.SRV; }
+	FRHIIndexBuffer* GetIndexBuffer() const { return IndexBuffer; }
+	const FComputeShaderCullOutput& GetCullOutput() const { return CullOutput; }
+
+private:
+	// Everything that decides which triangles survive the cull pass. The tint doesn't, so it isn't here.
+	struct FCullInputs
+	{
+		FIntPoint TargetSize;
+		uint32 NumTriangles;
+		float Scale;
+		FVector2D Offset;
+		float MinScreenArea;
+
+		bool operator==(const FCullInputs& Other) const
+		{
+			return TargetSize == Other.TargetSize && NumTriangles == Other.NumTriangles && Scale == Other.Scale && Offset == Other.Offset && MinScreenArea == Other.MinScreenArea;
+		}
+	};
+
+	void Allocate_RenderThread();
+	void BuildIndexBuffer_RenderThread();
+	void ReleaseIndexBuffer_RenderThread();
+	void AllocateCullOutput_RenderThread();
+	void ReleaseCullOutput_RenderThread();
+	int64 GetIndexBufferBytes() const;
+	int64 GetCullOutputBytes() const;
+
+	FRWBuffer PositionBuffer;
+	FRWBuffer ColorBuffer;
+	FIndexBufferRHIRef IndexBuffer;
+	FComputeShaderVertexOutputStruct VertexOutput;
+	FComputeShaderCullOutput CullOutput; // Only allocated once a draw culls, sized for every triangle of Topology
+	FRWBuffer DrawArgsBuffer; // Owns CullOutput.DrawArgsBuffer
+	FCullInputs CulledInputs;
+	bool bCullOutputValid; // CullOutput holds the survivors for CulledInputs and the current ring
+	EVertexRingTopology Topology; // Of IndexBuffer and CullOutput, or of the next ones built when they are released
+	FTextureRHIRef GeneratedSrcTexture; // What the ring was last generated from, kept alive so the comparison stays valid
+	uint64 GeneratedSrcVersion;
+	bool bGenerated;
+};
+
 /**************************************************************************************/
 /* This is just an interface we use to keep all the pixel shading code in one file.   */
 /**************************************************************************************/
 class FVertexFromCSExample
 {
 public:
-	static void RunVertexFromCS_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters);
+	// A dispatch can have at most 65535 thread groups along each dimension, and the scene mesh uses 64 threads per group.
+	enum { MaxSceneMeshTriangles = 65535 * 64 };
+
+	// SrcTexture tints the ring, pass GBlackTexture when there is no source image. See FVertexFromCSRing for SrcVersion.
+	// TargetUniformBuffer has to be made from DrawParameters, both the cull and the draw pass read it.
+	static void RunVertexFromCS_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FVertexFromCSRing& Ring, FRHITexture* SrcTexture, uint64 SrcVersion = 0);
+
+	// Writes a ring with a radius of 1, see FVertexFromCSRing.
+	static void RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* SrcTexture, FComputeShaderOutputUAVs& ComputeShaderOutputUAVs);
+	// Writes NumTriangles unindexed triangles straight into the scene mesh buffers. The geometry never leaves the GPU.
+	// NumTriangles can be at most MaxSceneMeshTriangles, which is what one 1D dispatch can cover.
+	static void RunSceneMeshComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderSceneMeshUAVs& SceneMeshUAVs, uint32 NumTriangles, float MeshScale, float MeshHeight);
+	static bool SupportsSceneMesh(ERHIFeatureLevel::Type FeatureLevel);
+
+	// Culls the first NumTriangles triangles of the ring against the render target, and compacts the survivors into
+	// CullOutput along with the arguments to draw them. See VertexFromCs_CullShader.usf.
+	static void RunCullShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FRHIShaderResourceView* VertexPositionSRV, EVertexRingTopology Topology, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform, const FComputeShaderCullOutput& CullOutput);
+	static bool UseCulling_RenderThread();
+
+	// The topology selected with r.ShaderPlugin.VertexRing.Topology, and the smallest triangles it should draw in pixels.
+	static EVertexRingTopology GetRingTopology_RenderThread();
+	static float GetMinTriangleSize_RenderThread();
+	static const TCHAR* GetRingTopologyName(EVertexRingTopology Topology);
+
+	// The ring has a radius of 1 in clip space before Transform, so this is how many pixels it covers on a target of TargetSize.
+	static float GetRingRadiusInPixels(const FIntPoint& TargetSize, const FVertexFromCSDrawTransform& Transform);
+
+	// Draws the first NumTriangles triangles of IndexBuffer.
+	static void DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, FRHIIndexBuffer* IndexBuffer, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform);
+
+	// Same as DrawToRenderTarget_RenderThread, but draws to any render targetable texture instead of DrawParameters.RenderTarget.
+	static void DrawToTexture_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, FRHITexture* RenderTargetTexture, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, FRHIIndexBuffer* IndexBuffer, uint32 NumTriangles, const FVertexFromCSDrawTransform& Transform);
+
+	// Same as DrawToRenderTarget_RenderThread, but only draws the triangles RunCullShader_RenderThread let through.
+	static void DrawCulledToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, const FComputeShaderCullOutput& CullOutput, const FVertexFromCSDrawTransform& Transform);
 
-	static void RunComputeShader_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FComputeShaderOutputUAVs& ComputeShaderOutputUAVs);
-	static void DrawToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FComputeShaderVertexOutputStruct& ComputeShaderOutput);
+	// Draws the first NumPoints vertices of ComputeShaderOutput as a point list, with the same shaders as DrawToRenderTarget_RenderThread.
+	static void DrawPointsToRenderTarget_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, const FShaderPluginTargetUniformBufferRef& TargetUniformBuffer, const FComputeShaderVertexOutputStruct& ComputeShaderOutput, uint32 NumPoints, const FVertexFromCSDrawTransform& Transform = FVertexFromCSDrawTransform());
 };
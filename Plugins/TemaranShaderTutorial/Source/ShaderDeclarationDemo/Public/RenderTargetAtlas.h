@@ -0,0 +1,74 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTextureRenderTarget2D;
+
+// A square part of an atlas page. Slots are handed out by FRenderTargetAtlas and stay where they are until freed.
+struct FRenderTargetAtlasSlot
+{
+	int32 PageIndex;
+	int32 SlotIndex;
+
+	FRenderTargetAtlasSlot()
+		: PageIndex(INDEX_NONE)
+		, SlotIndex(INDEX_NONE)
+	{
+	}
+
+	bool IsValid() const
+	{
+		return PageIndex != INDEX_NONE;
+	}
+};
+
+/*
+ * Packs many small effect targets into a few large render targets, so they can all be drawn with one dispatch and one
+ * draw per page instead of one each. Every page is split into a grid of equally sized slots, and requested sizes are
+ * rounded up to the next power of two. That wastes some space for odd sizes, but allocating and freeing is just a bit
+ * flip and pages never fragment.
+ *
+ * Sample a slot by setting the page as the texture and transforming the UVs with GetSlotScaleBias: uv * xy + zw.
+ * Everything here is game thread only, the pages are drawn through FShaderUsageExampleParameterBatch::AtlasRects.
+ */
+class SHADERDECLARATIONDEMO_API FRenderTargetAtlas
+{
+public:
+	static const int32 PageSize = 2048;
+	static const int32 MinSlotSize = 32; // Must be a multiple of the compute shader thread group size
+
+	~FRenderTargetAtlas();
+
+	// Returns an invalid slot if Size is larger than a page. The slot starts out cleared to transparent black.
+	FRenderTargetAtlasSlot Allocate(int32 Size);
+	void Free(FRenderTargetAtlasSlot& Slot);
+
+	// Frees every slot and releases all pages.
+	void Reset();
+
+	UTextureRenderTarget2D* GetPageTexture(const FRenderTargetAtlasSlot& Slot) const;
+	FIntRect GetSlotRect(const FRenderTargetAtlasSlot& Slot) const;
+	FVector4 GetSlotScaleBias(const FRenderTargetAtlasSlot& Slot) const;
+
+	int32 GetNumPages() const;
+	int32 GetNumSlots() const;
+
+private:
+	struct FPage
+	{
+		UTextureRenderTarget2D* Texture; // Null when the page has been released and the entry is free for reuse
+		int32 SlotSize;
+		int32 SlotsPerRow;
+		TBitArray<> UsedSlots;
+		int32 NumUsedSlots;
+	};
+
+	const FPage& GetPage(const FRenderTargetAtlasSlot& Slot) const;
+
+	// Released pages keep their entry, so page indices in slots that are still allocated stay valid.
+	TArray<FPage> Pages;
+};
@@ -10,7 +10,23 @@
 #include "Modules/ModuleManager.h"
 
 #include "RenderGraphResources.h"
+#include "RenderTargetAtlas.h"
 #include "Runtime/Engine/Classes/Engine/TextureRenderTarget2D.h"
+#include "UObject/ObjectKey.h"
+#include "UObject/StrongObjectPtr.h"
+
+class UTexture;
+class UTexture2D;
+class UMeshComponent;
+class FPrimitiveSceneProxy;
+class UWorld;
+class FShaderPluginContext;
+struct FCompressedTarget;
+class FParameterStreamWriter;
+struct FParameterStreamEvent;
+struct FParameterStreamReplay;
+
+SHADERDECLARATIONDEMO_API DECLARE_LOG_CATEGORY_EXTERN(LogShaderPlugin, Log, All);
 
 // This struct contains all the data we need to pass from the game thread to draw our effect.
 struct FShaderUsageExampleParameters
@@ -22,25 +38,204 @@ struct FShaderUsageExampleParameters
 	float ComputeShaderBlend;
 
 	float ComputeRadius;
+
+	// Moves and tints the ring of the vertex sample, the offset is in clip space. Both are applied while drawing, so
+	// animating them never makes the compute shader generate the ring again. The other samples ignore them.
+	FVector2D VertexOffset;
+	FLinearColor VertexTint;
+
+	// When set and a flipbook has been baked or assigned, the fractal is sampled from the flipbook instead of being computed.
+	bool bUseFlipbook;
+
+	// Fraction of the render target resolution to run the compute shader at. The pixel shader upscales the result.
+	// This is multiplied with r.ShaderPlugin.ComputeScale and the dynamic scale, if enabled.
+	float ComputeResolutionScale;
+
+	// Parts of the render target that changed since it was last drawn, for example where a projectile hit. When any are set,
+	// the compute and pixel sample only redraws these and keeps the rest of the target, so the cost follows the changed area.
+	// Leave it empty to redraw everything, which the first draw to a target should always do. The other samples ignore it.
+	TArray<FIntRect> DirtyRects;
 	
 	FIntPoint GetRenderTargetSize() const
 	{
 		return CachedRenderTargetSize;
 	}
 
+	// For memory tracking and logging. The name is captured on the game thread, so the render thread never has to ask the UObject.
+	FName GetRenderTargetName() const
+	{
+		return CachedRenderTargetName;
+	}
+
 	FShaderUsageExampleParameters()	{ }
 	FShaderUsageExampleParameters(UTextureRenderTarget2D* InRenderTarget)
+		: FShaderUsageExampleParameters(InRenderTarget, InRenderTarget ? InRenderTarget->GetFName() : NAME_None)
+	{
+	}
+
+	// Same as above for when the name was already captured, so this one is safe to use on the render thread.
+	FShaderUsageExampleParameters(UTextureRenderTarget2D* InRenderTarget, FName InRenderTargetName)
 		: RenderTarget(InRenderTarget)
 		, StartColor(FColor::White)
 		, EndColor(FColor::White)
 		, SimulationState(1.0f)
 		, ComputeRadius(1.0f)
+		, VertexOffset(FVector2D::ZeroVector)
+		, VertexTint(FLinearColor::White)
+		, bUseFlipbook(false)
+		, ComputeResolutionScale(1.0f)
+		, CachedRenderTargetName(InRenderTargetName)
 	{
 		CachedRenderTargetSize = RenderTarget ? FIntPoint(RenderTarget->SizeX, RenderTarget->SizeY) : FIntPoint::ZeroValue;
 	}
 
+	// Used when we want to run the shaders without a render target, for example when baking.
+	FShaderUsageExampleParameters(const FIntPoint& InRenderTargetSize)
+		: RenderTarget(nullptr)
+		, StartColor(FColor::White)
+		, EndColor(FColor::White)
+		, SimulationState(1.0f)
+		, ComputeRadius(1.0f)
+		, VertexOffset(FVector2D::ZeroVector)
+		, VertexTint(FLinearColor::White)
+		, bUseFlipbook(false)
+		, ComputeResolutionScale(1.0f)
+		, CachedRenderTargetSize(InRenderTargetSize)
+	{
+	}
+
 private:
 	FIntPoint CachedRenderTargetSize;
+	FName CachedRenderTargetName;
+};
+
+/*
+ * Describes one loop of the compute shader fractal baked into a flipbook atlas. Frames are laid out row-major,
+ * FramesPerRow frames to a row, and frame N is the fractal at LoopStart + N * LoopDuration / NumFrames.
+ * Every time term in the fractal is a multiple of 0.01 rad/s, so it only repeats exactly every 200 * PI seconds. That is
+ * over 600 seconds, which 64 frames can't show as motion, so the default loop is much shorter and does not repeat: the
+ * fractal at LoopStart + LoopDuration is not the one at LoopStart. Playback crossfades the last frame into the first just
+ * like any other pair of frames, which softens the jump but doesn't remove it, so there is a visible seam once per loop.
+ * Set LoopDuration to 200 * PI for an exact loop. The atlas has to fit in a single texture.
+ */
+struct FFractalFlipbookSettings
+{
+	FIntPoint FrameSize;
+	int32 NumFrames;
+	int32 FramesPerRow;
+	float LoopStart;
+	float LoopDuration;
+
+	FFractalFlipbookSettings()
+		: FrameSize(256, 256)
+		, NumFrames(64)
+		, FramesPerRow(8)
+		, LoopStart(0.0f)
+		, LoopDuration(8.0f)
+	{
+	}
+
+	bool IsValid() const
+	{
+		if (FrameSize.X <= 0 || FrameSize.Y <= 0 || NumFrames <= 0 || FramesPerRow <= 0 || LoopDuration <= 0.0f)
+		{
+			return false;
+		}
+
+		const FIntPoint AtlasSize = GetAtlasSize();
+		return AtlasSize.X <= (int32)GetMax2DTextureDimension() && AtlasSize.Y <= (int32)GetMax2DTextureDimension();
+	}
+
+	int32 GetNumRows() const
+	{
+		return FMath::DivideAndRoundUp(NumFrames, FramesPerRow);
+	}
+
+	FIntPoint GetAtlasSize() const
+	{
+		return FIntPoint(FrameSize.X * FMath::Min(NumFrames, FramesPerRow), FrameSize.Y * GetNumRows());
+	}
+
+	FIntPoint GetFrameOrigin(int32 FrameIndex) const
+	{
+		return FIntPoint((FrameIndex % FramesPerRow) * FrameSize.X, (FrameIndex / FramesPerRow) * FrameSize.Y);
+	}
+
+	float GetFrameTime(int32 FrameIndex) const
+	{
+		return LoopStart + LoopDuration * FrameIndex / NumFrames;
+	}
+};
+
+// The shapes FComputeMeshGenerator can build, see ComputeVertices.usf. Must match the MESH_SHAPE defines in there.
+enum class EComputeMeshShape : uint8
+{
+	Grid,			// Flat, Extent large, facing up
+	Torus,			// Around the Z axis, with a ring of Radius and a cross section of MinorRadius
+	Sphere,			// Of Radius, with the poles on the Z axis
+	Tube,			// Open ended, of Radius and Height along the Z axis
+	Heightfield,	// A grid displaced up by the red channel of HeightTexture times Height
+	Num
+};
+
+/*
+ * Describes a mesh for FComputeMeshGenerator. Every shape is a grid of Segments.X by Segments.Y quads bent into shape,
+ * U going around closed shapes and V along them. Only the fields the shape uses matter.
+ */
+struct FComputeMeshShapeSettings
+{
+	EComputeMeshShape Shape;
+	FIntPoint Segments;
+	float Radius;
+	float MinorRadius;
+	FVector2D Extent;
+	float Height;
+	UTexture* HeightTexture; // Heightfield only. Flat when not set.
+
+	FComputeMeshShapeSettings()
+		: Shape(EComputeMeshShape::Grid)
+		, Segments(64, 64)
+		, Radius(100.0f)
+		, MinorRadius(25.0f)
+		, Extent(200.0f, 200.0f)
+		, Height(100.0f)
+		, HeightTexture(nullptr)
+	{
+	}
+
+	// The generator covers the vertices and the quads with one 1D dispatch each, of at most 65535 groups of 64 threads.
+	// A square shape can have up to 2046 segments each way.
+	enum { MaxElementsPerDispatch = 65535 * 64 };
+
+	bool IsValid() const
+	{
+		return Segments.X > 0 && Segments.Y > 0
+			&& (int64)(Segments.X + 1) * (Segments.Y + 1) <= MaxElementsPerDispatch
+			&& (int64)Segments.X * Segments.Y <= MaxElementsPerDispatch;
+	}
+
+	int32 GetNumVertices() const
+	{
+		return (Segments.X + 1) * (Segments.Y + 1);
+	}
+
+	int32 GetNumIndices() const
+	{
+		return Segments.X * Segments.Y * 6;
+	}
+
+	// Local bounds, before any radius scale is applied.
+	FBox GetBounds() const
+	{
+		switch (Shape)
+		{
+		case EComputeMeshShape::Torus:			return FBox(FVector(-Radius - MinorRadius, -Radius - MinorRadius, -MinorRadius), FVector(Radius + MinorRadius, Radius + MinorRadius, MinorRadius));
+		case EComputeMeshShape::Sphere:			return FBox(FVector(-Radius), FVector(Radius));
+		case EComputeMeshShape::Tube:			return FBox(FVector(-Radius, -Radius, -Height * 0.5f), FVector(Radius, Radius, Height * 0.5f));
+		case EComputeMeshShape::Heightfield:	return FBox(FVector(-Extent * 0.5f, FMath::Min(Height, 0.0f)), FVector(Extent * 0.5f, FMath::Max(Height, 0.0f)));
+		default:								return FBox(FVector(-Extent * 0.5f, 0.0f), FVector(Extent * 0.5f, 0.0f));
+		}
+	}
 };
 
 /*
@@ -73,6 +268,118 @@ enum class EShaderTestSampleType
 {
 	ComputeAndPixel,
 	ComputeToVertexBuffer,
+
+	// A GPU particle simulation drawn as points, see FParticleSimulation. Every target a context draws this to shares one
+	// simulation, which is stepped by the SimulationState of each draw. Needs SM5, nothing is drawn otherwise.
+	Particles,
+};
+
+// Block compressed formats a render target can be copied to, see CreateCompressedTarget.
+enum class EShaderPluginCompression : uint8
+{
+	BC1, // RGB at 4 bits per pixel, alpha is dropped
+	BC3, // RGBA at 8 bits per pixel
+};
+
+/*
+ * Parameters for many targets at once, stored as one array per field. Whoever gathers them can fill each array in
+ * parallel, and the whole batch is handed to the render thread in a single command instead of one per target.
+ */
+struct FShaderUsageExampleParameterBatch
+{
+	TArray<UTextureRenderTarget2D*> RenderTargets;
+	TArray<FColor> StartColors;
+	TArray<FColor> EndColors;
+	TArray<float> SimulationStates;
+	TArray<float> ComputeShaderBlends;
+	TArray<float> ComputeRadii;
+	TArray<FVector2D> VertexOffsets;
+	TArray<FLinearColor> VertexTints;
+	TArray<float> ComputeResolutionScales;
+	TArray<bool> UseFlipbook;
+	TArray<EShaderTestSampleType> SampleTypes;
+	TArray<TArray<FIntRect>> DirtyRects; // Ignored for atlas slots
+
+	// The part of RenderTargets[Index] to draw to, for targets that are FRenderTargetAtlas slots. Leave it empty to
+	// draw to the whole render target. Slots on the same page are all drawn together, see FAtlasPageExample.
+	TArray<FIntRect> AtlasRects;
+
+	// Filled in by SetParameters or CaptureRenderTargetNames on the game thread, see FShaderUsageExampleParameters::GetRenderTargetName.
+	TArray<FName> RenderTargetNames;
+
+	int32 Num() const
+	{
+		return RenderTargets.Num();
+	}
+
+	void SetNumUninitialized(int32 NewNum)
+	{
+		RenderTargets.SetNumUninitialized(NewNum, false);
+		StartColors.SetNumUninitialized(NewNum, false);
+		EndColors.SetNumUninitialized(NewNum, false);
+		SimulationStates.SetNumUninitialized(NewNum, false);
+		ComputeShaderBlends.SetNumUninitialized(NewNum, false);
+		ComputeRadii.SetNumUninitialized(NewNum, false);
+		VertexOffsets.SetNumUninitialized(NewNum, false);
+		VertexTints.SetNumUninitialized(NewNum, false);
+		ComputeResolutionScales.SetNumUninitialized(NewNum, false);
+		UseFlipbook.SetNumUninitialized(NewNum, false);
+		SampleTypes.SetNumUninitialized(NewNum, false);
+		DirtyRects.SetNum(NewNum, false); // Owns memory, so it can't be left uninitialized
+		AtlasRects.SetNumUninitialized(NewNum, false);
+		RenderTargetNames.SetNumUninitialized(NewNum, false);
+	}
+
+	// Game thread only. Batches filled in directly rather than through SetParameters need this before they are drawn.
+	void CaptureRenderTargetNames()
+	{
+		check(IsInGameThread());
+		RenderTargetNames.SetNumUninitialized(RenderTargets.Num(), false);
+		for (int32 Index = 0; Index < RenderTargets.Num(); Index++)
+		{
+			RenderTargetNames[Index] = RenderTargets[Index] ? RenderTargets[Index]->GetFName() : NAME_None;
+		}
+	}
+
+	bool IsAtlasSlot(int32 Index) const
+	{
+		return AtlasRects[Index].Area() > 0;
+	}
+
+	void SetParameters(int32 Index, const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType SampleType, const FIntRect& AtlasRect)
+	{
+		RenderTargets[Index] = DrawParameters.RenderTarget;
+		StartColors[Index] = DrawParameters.StartColor;
+		EndColors[Index] = DrawParameters.EndColor;
+		SimulationStates[Index] = DrawParameters.SimulationState;
+		ComputeShaderBlends[Index] = DrawParameters.ComputeShaderBlend;
+		ComputeRadii[Index] = DrawParameters.ComputeRadius;
+		VertexOffsets[Index] = DrawParameters.VertexOffset;
+		VertexTints[Index] = DrawParameters.VertexTint;
+		ComputeResolutionScales[Index] = DrawParameters.ComputeResolutionScale;
+		UseFlipbook[Index] = DrawParameters.bUseFlipbook;
+		SampleTypes[Index] = SampleType;
+		DirtyRects[Index] = DrawParameters.DirtyRects;
+		AtlasRects[Index] = AtlasRect;
+		RenderTargetNames[Index] = DrawParameters.RenderTarget ? DrawParameters.RenderTarget->GetFName() : NAME_None;
+	}
+
+	// Atlas slots come back without a render target, sized like the slot.
+	FShaderUsageExampleParameters GetParameters(int32 Index) const
+	{
+		FShaderUsageExampleParameters DrawParameters = IsAtlasSlot(Index) ? FShaderUsageExampleParameters(AtlasRects[Index].Size()) : FShaderUsageExampleParameters(RenderTargets[Index], RenderTargetNames[Index]);
+		DrawParameters.StartColor = StartColors[Index];
+		DrawParameters.EndColor = EndColors[Index];
+		DrawParameters.SimulationState = SimulationStates[Index];
+		DrawParameters.ComputeShaderBlend = ComputeShaderBlends[Index];
+		DrawParameters.ComputeRadius = ComputeRadii[Index];
+		DrawParameters.VertexOffset = VertexOffsets[Index];
+		DrawParameters.VertexTint = VertexTints[Index];
+		DrawParameters.ComputeResolutionScale = ComputeResolutionScales[Index];
+		DrawParameters.bUseFlipbook = UseFlipbook[Index];
+		DrawParameters.DirtyRects = DirtyRects[Index];
+		return DrawParameters;
+	}
 };
 
 class SHADERDECLARATIONDEMO_API FShaderDeclarationDemoModule : public IModuleInterface
@@ -93,31 +400,102 @@ public:
 	virtual void ShutdownModule() override;
 
 public:
-	// Call this when you want to hook onto the renderer and start drawing. The shader will be executed once per frame.
-	void BeginRendering();
+	// The context a world draws with, made the first time it is asked for. Parameters, queued draws and the resources
+	// the samples keep between draws all live in the context, so every world draws on its own. Anything that should be
+	// drawn independently can have its own context, a world is just the usual owner. Pass nullptr for the context of
+	// tools and console commands that have no world. Game thread only.
+	FShaderPluginContext& GetContext(const UObject* Owner);
 
-	// When you are done, call this to stop drawing.
-	void EndRendering();
-	
-	// Call this whenever you have new parameters to share. You could set this up to update different sets of properties at
-	// different intervals to save on locking and GPU transfer time.
-	void UpdateParameters(FShaderUsageExampleParameters& DrawParameters);
+	// Same as above, but returns nullptr instead of making a new context.
+	FShaderPluginContext* FindContext(const UObject* Owner) const;
+
+	// Stops drawing for Owner and frees its resources. Contexts of worlds are released for you when the world is cleaned up.
+	void ReleaseContext(const UObject* Owner);
 
-	void DrawTarget(EShaderTestSampleType TestType = EShaderTestSampleType::ComputeAndPixel);
+	// Creates the proxy for a mesh the vertex compute shader generates on the GPU, see FComputeMeshSceneProxy. Returns
+	// nullptr when the scene's feature level can't run it. Call this from the component's CreateSceneProxy.
+	FPrimitiveSceneProxy* CreateComputeMeshSceneProxy(UMeshComponent* Component, int32 NumTriangles, float MeshScale, float MeshHeight);
+
+	// Same as above, but the mesh is one of FComputeMeshGenerator's shapes instead of the fan. ComputeRadius scales the
+	// radii of the shape on every update.
+	FPrimitiveSceneProxy* CreateComputeMeshSceneProxy(UMeshComponent* Component, const FComputeMeshShapeSettings& Shape);
+
+	// Changes the shape or resolution of a proxy made with the overload above, without recreating it. The buffers are
+	// only reallocated when the new resolution doesn't fit in them.
+	void SetComputeMeshShape(FPrimitiveSceneProxy* SceneProxy, const FComputeMeshShapeSettings& Shape);
+
+	// Regenerates the mesh of a proxy made with CreateComputeMeshSceneProxy. Only ComputeRadius and SimulationState are
+	// used. Shapes are only generated again when ComputeRadius, the shape or its height texture changed since the last
+	// time. Like other render dynamic data this should be sent from SendRenderDynamicData_Concurrent.
+	void UpdateComputeMesh(FPrimitiveSceneProxy* SceneProxy, const FShaderUsageExampleParameters& DrawParameters);
+
+	// Renders one loop of the fractal into a flipbook atlas once. Draws with bUseFlipbook set will then sample the atlas
+	// instead of running the compute shader. The CPU path is used automatically when the RHI can't run compute shaders.
+	void BakeFlipbook(const FFractalFlipbookSettings& Settings, bool bForceCPU = false);
+
+	// Plays back a flipbook that was baked earlier and saved as a texture asset, so the compute shader never has to run.
+	void SetFlipbook(UTexture2D* FlipbookAsset, const FFractalFlipbookSettings& Settings);
+
+	// Drops the current flipbook, draws go back to running the compute shader.
+	void ClearFlipbook();
+
+	// Makes a block compressed copy of a render target, which is encoded on the GPU after every draw to the target. Sample
+	// the returned texture instead of the render target to read an eighth (BC1) or a quarter (BC3) of the bytes. Returns
+	// nullptr without SM5, or when the render target size isn't a multiple of 4. Render targets with auto generate mips get
+	// their mips compressed too, down to the first one that isn't a multiple of 4, which is where the texture's chain ends.
+	UTexture2D* CreateCompressedTarget(UTextureRenderTarget2D* RenderTarget, EShaderPluginCompression Compression);
+
+	// Stops compressing the render target. The texture CreateCompressedTarget returned is no longer kept alive by us.
+	void ReleaseCompressedTarget(UTextureRenderTarget2D* RenderTarget);
+
+#if WITH_EDITOR
+	// Bakes a flipbook and saves it as an uncompressed texture asset, for example "/Game/Flipbooks/T_Fractal".
+	UTexture2D* BakeFlipbookToAsset(const FFractalFlipbookSettings& Settings, const FString& PackageName, bool bForceCPU = false);
+#endif
+
+	// Captures every UpdateParameters and DrawTarget call of every context to a binary file until StopRecording, so the
+	// exact same workload can be replayed later. See ParameterStream.h for the format.
+	bool StartRecording(const FString& Filename);
+	void StopRecording();
+	bool IsRecording() const;
+
+	// Plays a recording back as fast as it can, up to r.ShaderPlugin.ReplayTickBudget of draws per engine tick, or at the
+	// recorded pace when bRealTime is set.
+	// With bForceCPU, or when running with -nullrhi, the draws go through the CPU reference instead of the GPU.
+	// The replay logs its timings when it is done, and requests an exit afterwards if bExitWhenDone is set. It draws with
+	// a context of its own, so it doesn't disturb the worlds that are running.
+	bool StartReplay(const FString& Filename, bool bRealTime = false, bool bForceCPU = false, bool bExitWhenDone = false);
+	void StopReplay();
+	bool IsReplaying() const;
 
 private:
-	TRefCountPtr<IPooledRenderTarget> ComputeShaderOutput;
-	FShaderUsageExampleParameters CachedShaderUsageExampleParameters;
-	FDelegateHandle OnPostResolvedSceneColorHandle;
-	FCriticalSection RenderEveryFrameLock;
-	volatile bool bCachedParametersValid;
+	friend class FShaderPluginContext;
+
+	TStrongObjectPtr<UTexture2D> FlipbookTextureAsset; // Game thread only, keeps the texture passed to SetFlipbook and its resource alive
+	FTextureRHIRef FlipbookTexture; // Render thread only
+	FFractalFlipbookSettings FlipbookSettings; // Render thread only
+	int64 FlipbookTextureBytes; // Render thread only, 0 unless we created FlipbookTexture ourselves
+	TMap<UTextureRenderTarget2D*, UTexture2D*> CompressedTargets; // Game thread only, the textures are rooted until released
+	TMap<UTextureRenderTarget2D*, TSharedPtr<FCompressedTarget>> CompressedTargetResources; // Render thread only
+
+	TMap<FObjectKey, TSharedPtr<FShaderPluginContext>> Contexts; // Game thread only
+	FDelegateHandle WorldCleanupHandle;
+
+	TSharedPtr<FParameterStreamWriter> ParameterStreamWriter;
+	const FShaderPluginContext* LastRecordedContext; // Game thread only, whose parameters the last recorded update was
+	TSharedPtr<FParameterStreamReplay> ParameterStreamReplay;
+	FDelegateHandle ReplayTickHandle;
 
-	FDelegateHandle HandlePreRenderHandle;
+	// Records Context's parameters unless they were the last ones recorded, so a replay draws them and not another context's.
+	void RecordParameters(const FShaderPluginContext& Context, const FShaderUsageExampleParameters& DrawParameters, bool bForce);
 
-	void PostResolveSceneColor_RenderThread(FRHICommandListImmediate& RHICmdList, class FSceneRenderTargets& SceneContext);
-	void Draw_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType Type = EShaderTestSampleType::ComputeAndPixel);
+	// Releases the contexts and waits for the render thread to let go of them before they are deleted.
+	void DestroyContexts(TArray<TSharedPtr<FShaderPluginContext>>&& ContextsToDestroy);
+	void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
 
-	void RunComputeAndPixelSample_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters);
+	// Swaps the flipbook and keeps the memory stats up to date. Textures that belong to an asset aren't counted as ours.
+	void SetFlipbookTexture_RenderThread(FTextureRHIRef Texture, const FFractalFlipbookSettings& Settings, bool bOwnedByPlugin);
 
-	void HandlePreRender();
+	bool ReplayTick(float DeltaTime);
+	void ReplayEvent(const FParameterStreamEvent& Event);
 };
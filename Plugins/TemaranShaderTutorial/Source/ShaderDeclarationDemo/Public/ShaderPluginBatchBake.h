@@ -0,0 +1,60 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "ShaderDeclarationDemoModule.h"
+
+// One image to bake. The parameters are made with the size constructor, there is no render target to draw to.
+struct FShaderPluginBakeJob
+{
+	FShaderUsageExampleParameters Parameters;
+	EShaderTestSampleType SampleType;
+
+	FShaderPluginBakeJob()
+		: Parameters(FIntPoint::ZeroValue)
+		, SampleType(EShaderTestSampleType::ComputeAndPixel)
+	{
+	}
+};
+
+// Running totals of a baked shard, for the log.
+struct FShaderPluginBakeStats
+{
+	int32 NumBaked = 0;
+	int32 NumSkipped = 0; // The back-end can't draw the sample type, or the job has no size
+	int32 NumFailed = 0; // Couldn't be written to the output
+	int64 BytesWritten = 0;
+	double Seconds = 0.0;
+};
+
+/*
+ * Renders a list of jobs into an FImageArrayWriter file without a world or a viewport, see UShaderPluginBakeCommandlet.
+ * The jobs are kept in the parameter stream format, where every DrawTarget event is a job that uses the parameters of
+ * the UpdateParameters event before it. A session recorded with ShaderPlugin.Record can be baked as is.
+ *
+ * The work is split into shards that take every NumShards-th job, so a job list that gets more expensive towards its
+ * end still spreads evenly. Every shard writes its own images into the same output, which CreateOutput has laid out
+ * beforehand. That way shards can run in as many processes as there are cores without sharing anything but the file.
+ */
+class SHADERDECLARATIONDEMO_API FShaderPluginBatchBake
+{
+public:
+	static bool LoadJobs(const FString& Filename, TArray<FShaderPluginBakeJob>& OutJobs);
+	static bool SaveJobs(const FString& Filename, const TArray<FShaderPluginBakeJob>& Jobs);
+
+	// Makes an image array with one image per job, all of them unwritten.
+	static bool CreateOutput(const FString& Filename, const TArray<FShaderPluginBakeJob>& Jobs);
+
+	// Renders the jobs of one shard into an output made by CreateOutput. The GPU is used unless bForceCPU is set, and the
+	// bake fails when there is no RHI to use it with. The CPU back-end only draws ComputeAndPixel jobs, and always runs the
+	// fractal at full resolution. Particle jobs continue the simulation of the shard's previous particle job, so they only
+	// make sense with a single shard.
+	static bool BakeShard(const TArray<FShaderPluginBakeJob>& Jobs, const FString& OutputFilename, int32 ShardIndex, int32 NumShards, bool bForceCPU, FShaderPluginBakeStats& OutStats);
+
+	// A CPU port of the compute and pixel sample without flipbook or source image, for when there is no GPU to run on.
+	static void RenderCPU(const FShaderUsageExampleParameters& Parameters, TArray<FColor>& OutPixels);
+};
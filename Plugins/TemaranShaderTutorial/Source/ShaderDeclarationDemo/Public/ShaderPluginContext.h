@@ -0,0 +1,125 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "ShaderDeclarationDemoModule.h"
+
+class UWorld;
+class FRHITexture;
+class FRHICommandListImmediate;
+class FParticleSimulation;
+class FVertexFromCSRing;
+class FTextureUploadRing;
+class FShaderPluginTargetUniformBufferCache;
+
+/*
+ * Everything one world draws with: the parameters set with UpdateParameters, the draw queue, the view extension and the
+ * render thread resources the samples keep between draws. Every world gets its own context from
+ * FShaderDeclarationDemoModule::GetContext, so PIE clients, listen servers and preview worlds running in the same process
+ * never see each other's parameters or share an output texture, and don't have to wait for each other.
+ *
+ * The module owns the contexts and releases a world's context when the world is cleaned up. What is left in the module
+ * is shared on purpose: the flipbook, compressed targets (they belong to a render target, not to a world) and recording.
+ */
+class SHADERDECLARATIONDEMO_API FShaderPluginContext
+{
+public:
+	// InWorld is the world whose views draw the context's queue, or nullptr to draw it with the first view of any world.
+	FShaderPluginContext(FShaderDeclarationDemoModule* InModule, const FString& InName, const UWorld* InWorld = nullptr);
+	~FShaderPluginContext();
+
+	// Call this when you want to hook onto the renderer and start drawing. Until EndRendering, DrawTarget and DrawTargets
+	// only queue their work, and it is drawn once per frame from inside the engine's frame, see FShaderPluginViewExtension.
+	// Calls are counted, so split screen players sharing a world can each call it, and the last EndRendering stops drawing.
+	void BeginRendering();
+
+	// When you are done, call this to stop drawing. Anything still queued is drawn right away.
+	void EndRendering();
+
+	// Call this whenever you have new parameters to share. You could set this up to update different sets of properties at
+	// different intervals to save on GPU transfer time. Other contexts keep their own parameters.
+	void UpdateParameters(FShaderUsageExampleParameters& DrawParameters);
+
+	void DrawTarget(EShaderTestSampleType TestType = EShaderTestSampleType::ComputeAndPixel);
+
+	// Draws every target in the batch with one render command. This doesn't touch the parameters set with
+	// UpdateParameters. Every entry needs a render target. Atlas slots are drawn after the other targets, one page at a time.
+	void DrawTargets(FShaderUsageExampleParameterBatch&& Batch);
+
+	// Hands out slots for small targets that are better drawn together, see FRenderTargetAtlas. Game thread only.
+	FRenderTargetAtlas& GetRenderTargetAtlas() { return RenderTargetAtlas; }
+	const FRenderTargetAtlas& GetRenderTargetAtlas() const { return RenderTargetAtlas; }
+
+	// Streams a CPU image into the compute passes, where it is stretched over the target and added to the fractal. The
+	// pixels are uploaded asynchronously and the passes pick up the newest image that has finished uploading, so this
+	// never waits for the GPU. Images that arrive faster than the GPU can take them are dropped. Draws with DirtyRects only
+	// see a new image inside their rectangles. Pixels is row major and must hold Size.X * Size.Y colors.
+	void SubmitSourceImage(const FIntPoint& Size, TArray<FColor>&& Pixels);
+
+	// Goes back to a black source image and frees the upload textures.
+	void ClearSourceImages();
+
+	// The world or object the context was made for, for logging.
+	const FString& GetName() const { return Name; }
+
+	// The resolution the compute shader runs at for a target of TargetSize. The three scales are multiplied and clamped to
+	// [0.05, 1], and the size is rounded up. Draws pass r.ShaderPlugin.ComputeScale as ComputeScale, see GetComputeScale.
+	static FIntPoint CalculateComputeSize(const FIntPoint& TargetSize, float ComputeResolutionScale, float ComputeScale, float DynamicScale);
+
+	// The value of r.ShaderPlugin.ComputeScale. Any thread.
+	static float GetComputeScale();
+
+private:
+	friend class FShaderDeclarationDemoModule;
+	friend class FShaderPluginViewExtension;
+
+	FShaderDeclarationDemoModule* Module;
+	FString Name;
+	FName MemoryTrackingName; // Name, made on the game thread. The compute output is shared by all targets, so it is tracked under the context.
+	const UWorld* World; // Only compared against, never dereferenced, so it is safe to read on the render thread
+
+	TRefCountPtr<IPooledRenderTarget> ComputeShaderOutput; // Render thread only
+	TRefCountPtr<IPooledRenderTarget> AtlasPageComputeOutput; // Render thread only, see FAtlasPageExample::DrawPage_RenderThread
+	float DynamicComputeScale; // Render thread only
+	uint32 DynamicComputeScaleFrameNumber; // Render thread only
+	TSharedPtr<FParticleSimulation> ParticleSimulation; // Render thread only, created by the first particle draw
+	TSharedPtr<FVertexFromCSRing> VertexRing; // Render thread only, created by the first vertex draw
+	TSharedPtr<FTextureUploadRing> SourceImages; // Render thread only, created by the first SubmitSourceImage
+	TSharedPtr<FShaderPluginTargetUniformBufferCache> TargetUniformBuffers; // Render thread only
+	FShaderUsageExampleParameters CachedShaderUsageExampleParameters; // Game thread only
+	bool bCachedParametersValid; // Game thread only
+
+	TSharedPtr<class FShaderPluginViewExtension, ESPMode::ThreadSafe> ViewExtension;
+	int32 NumRenderingClients; // Game thread only, BeginRendering calls without a matching EndRendering
+	FShaderUsageExampleParameterBatch PendingDraws; // Game thread only
+	TMap<TPair<UTextureRenderTarget2D*, FIntPoint>, int32> PendingDrawIndices; // Game thread only, render target and atlas rect origin to index in PendingDraws
+	TArray<FShaderUsageExampleParameterBatch> SubmittedDraws; // Render thread only
+
+	FRenderTargetAtlas RenderTargetAtlas;
+
+	// Stops rendering no matter how many BeginRendering calls are outstanding, and frees the render thread resources
+	// once the commands already enqueued have run. The module flushes the render commands before deleting the context.
+	void Release();
+
+	void QueueDraw(const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType TestType, const FIntRect& AtlasRect);
+
+	// Hands the queued draws over to the render thread, where DrawPendingTargets_RenderThread picks them up.
+	void SubmitPendingDraws();
+	void DrawPendingTargets_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	void DrawBatch_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameterBatch& Batch);
+	void Draw_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, EShaderTestSampleType Type = EShaderTestSampleType::ComputeAndPixel);
+
+	void RunComputeAndPixelSample_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters, FRHITexture* SourceTexture);
+	void RunParticleSample_RenderThread(FRHICommandListImmediate& RHICmdList, const FShaderUsageExampleParameters& DrawParameters);
+
+	// The newest source image that has finished uploading, or GBlackTexture if there is none.
+	FRHITexture* GetSourceTexture_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// Works out the resolution to run the compute shader at, and updates the dynamic scale once per frame.
+	FIntPoint GetComputeSize_RenderThread(const FShaderUsageExampleParameters& DrawParameters);
+};
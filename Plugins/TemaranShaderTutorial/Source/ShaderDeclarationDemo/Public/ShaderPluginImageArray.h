@@ -0,0 +1,93 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/*
+ * A file of many images that can be memory mapped and used as is. It starts with a FImageArrayHeader, followed by one
+ * FImageArrayEntry per image, followed by the pixels. Every image starts on a multiple of Header.Alignment, so each one
+ * can also be mapped or read on its own with page aligned I/O. Pixels are B8G8R8A8 rows without padding, so a mapped
+ * image can be used as a const FColor* directly. Everything is little endian.
+ *
+ * The whole layout is written up front by FImageArrayWriter::Create, so any number of processes can then fill in
+ * different images of the same file at the same time without coordinating. An image's entry is only marked written
+ * once its pixels are, so a reader can tell which images a crashed writer never got to.
+ */
+struct FImageArrayHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 NumImages;
+	uint32 Alignment; // Of the image data, in bytes
+};
+
+struct FImageArrayEntry
+{
+	uint32 Width;
+	uint32 Height;
+	uint32 PixelFormat; // An EPixelFormat, always PF_B8G8R8A8 for now
+	uint32 bWritten;
+	uint64 Offset; // From the start of the file
+	uint64 NumBytes;
+};
+
+static_assert(sizeof(FImageArrayHeader) == 16, "FImageArrayHeader is part of the file format.");
+static_assert(sizeof(FImageArrayEntry) == 32, "FImageArrayEntry is part of the file format.");
+
+class SHADERDECLARATIONDEMO_API FImageArrayWriter
+{
+public:
+	~FImageArrayWriter();
+
+	// Lays out a file for images of the given sizes and writes everything but the pixels. Replaces any existing file.
+	static bool Create(const FString& Filename, const TArray<FIntPoint>& Sizes);
+
+	// Opens a file made by Create for writing images into it. Other writers may have it open at the same time.
+	bool Open(const FString& Filename);
+	void Close();
+
+	int32 Num() const { return Entries.Num(); }
+	FIntPoint GetSize(int32 Index) const { return FIntPoint(Entries[Index].Width, Entries[Index].Height); }
+
+	// Writes the pixels of one image and marks it as written. Pixels must hold exactly GetSize(Index) pixels.
+	bool Write(int32 Index, const TArray<FColor>& Pixels);
+
+private:
+	TUniquePtr<IFileHandle> FileHandle;
+	TArray<FImageArrayEntry> Entries;
+	FString Filename;
+};
+
+class SHADERDECLARATIONDEMO_API FImageArrayReader
+{
+public:
+	FImageArrayReader();
+	~FImageArrayReader();
+
+	// Maps the whole file into memory, or reads it in when the platform can't map files.
+	bool Open(const FString& Filename);
+	void Close();
+
+	int32 Num() const;
+	FIntPoint GetSize(int32 Index) const;
+	bool IsWritten(int32 Index) const;
+
+	// The pixels of an image, row by row, or nullptr if it hasn't been written.
+	const FColor* GetPixels(int32 Index) const;
+
+private:
+	const FImageArrayEntry& GetEntry(int32 Index) const;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray<uint8> LoadedFile; // Only used when the file couldn't be mapped
+	const uint8* Data;
+	int64 DataSize;
+};
@@ -0,0 +1,142 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderComputeMeshComponent.h"
+
+#include "ShaderDeclarationDemoModule.h"
+
+UShaderComputeMeshComponent::UShaderComputeMeshComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	bTickInEditor = true;
+
+	Shape = EShaderComputeMeshShape::Fan;
+	NumTriangles = 65536;
+	Segments = FIntPoint(64, 64);
+	MeshScale = 100.0f;
+	MeshHeight = 25.0f;
+	MinorRadius = 25.0f;
+	HeightTexture = nullptr;
+	ComputeRadius = 1.0f;
+	SimulationSpeed = 1.0f;
+	ShaderModule = nullptr;
+	SimulationState = 0.0f;
+}
+
+void UShaderComputeMeshComponent::SetComputeRadius(float NewComputeRadius)
+{
+	if (ComputeRadius == NewComputeRadius)
+	{
+		return;
+	}
+
+	// The geometry follows on the next update, but the bounds have to be right before the scene culls us with them.
+	ComputeRadius = NewComputeRadius;
+	UpdateBounds();
+	MarkRenderTransformDirty();
+}
+
+void UShaderComputeMeshComponent::SetSegments(FIntPoint NewSegments)
+{
+	NewSegments = FIntPoint(FMath::Clamp(NewSegments.X, 1, 2046), FMath::Clamp(NewSegments.Y, 1, 2046));
+	if (Segments == NewSegments || Shape == EShaderComputeMeshShape::Fan)
+	{
+		return;
+	}
+
+	Segments = NewSegments;
+	if (SceneProxy && ShaderModule)
+	{
+		ShaderModule->SetComputeMeshShape(SceneProxy, GetShapeSettings());
+	}
+}
+
+FComputeMeshShapeSettings UShaderComputeMeshComponent::GetShapeSettings() const
+{
+	FComputeMeshShapeSettings Settings;
+	switch (Shape)
+	{
+	case EShaderComputeMeshShape::Torus:		Settings.Shape = EComputeMeshShape::Torus; break;
+	case EShaderComputeMeshShape::Sphere:		Settings.Shape = EComputeMeshShape::Sphere; break;
+	case EShaderComputeMeshShape::Tube:			Settings.Shape = EComputeMeshShape::Tube; break;
+	case EShaderComputeMeshShape::Heightfield:	Settings.Shape = EComputeMeshShape::Heightfield; break;
+	default:									Settings.Shape = EComputeMeshShape::Grid; break;
+	}
+
+	Settings.Segments = Segments;
+	Settings.Radius = MeshScale;
+	Settings.MinorRadius = MinorRadius;
+	Settings.Extent = FVector2D(MeshScale, MeshScale) * 2.0f;
+	Settings.Height = MeshHeight;
+	Settings.HeightTexture = HeightTexture;
+	return Settings;
+}
+
+void UShaderComputeMeshComponent::OnRegister()
+{
+	// Cached so SendRenderDynamicData_Concurrent doesn't have to go through the module manager from a worker thread.
+	ShaderModule = &FShaderDeclarationDemoModule::Get();
+
+	Super::OnRegister();
+}
+
+void UShaderComputeMeshComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SimulationState += DeltaTime * SimulationSpeed;
+	MarkRenderDynamicDataDirty();
+}
+
+void UShaderComputeMeshComponent::SendRenderDynamicData_Concurrent()
+{
+	Super::SendRenderDynamicData_Concurrent();
+
+	if (!SceneProxy || !ShaderModule)
+	{
+		return;
+	}
+
+	FShaderUsageExampleParameters DrawParameters(FIntPoint(1, 1));
+	DrawParameters.ComputeRadius = ComputeRadius;
+	DrawParameters.SimulationState = SimulationState;
+	ShaderModule->UpdateComputeMesh(SceneProxy, DrawParameters);
+}
+
+FPrimitiveSceneProxy* UShaderComputeMeshComponent::CreateSceneProxy()
+{
+	if (!ShaderModule)
+	{
+		return nullptr;
+	}
+
+	if (Shape == EShaderComputeMeshShape::Fan)
+	{
+		return ShaderModule->CreateComputeMeshSceneProxy(this, NumTriangles, MeshScale, MeshHeight);
+	}
+
+	return ShaderModule->CreateComputeMeshSceneProxy(this, GetShapeSettings());
+}
+
+int32 UShaderComputeMeshComponent::GetNumMaterials() const
+{
+	return 1;
+}
+
+FBoxSphereBounds UShaderComputeMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (Shape != EShaderComputeMeshShape::Fan)
+	{
+		// The radii follow ComputeRadius, flat shapes and heights don't.
+		FComputeMeshShapeSettings Settings = GetShapeSettings();
+		Settings.Radius *= FMath::Abs(ComputeRadius);
+		Settings.MinorRadius *= FMath::Abs(ComputeRadius);
+		return FBoxSphereBounds(Settings.GetBounds()).TransformBy(LocalToWorld);
+	}
+
+	const float Radius = FMath::Abs(ComputeRadius * MeshScale);
+	const float Ripple = FMath::Abs(MeshHeight) * 0.25f;
+	const FBox LocalBox(FVector(-Radius, -Radius, FMath::Min(-Ripple, MeshHeight)), FVector(Radius, Radius, FMath::Max(Ripple, MeshHeight)));
+	return FBoxSphereBounds(LocalBox).TransformBy(LocalToWorld);
+}
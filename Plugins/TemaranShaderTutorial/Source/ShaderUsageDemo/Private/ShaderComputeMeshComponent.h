@@ -0,0 +1,101 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Components/MeshComponent.h"
+#include "ShaderComputeMeshComponent.generated.h"
+
+class FShaderDeclarationDemoModule;
+class UTexture;
+struct FComputeMeshShapeSettings;
+
+// What UShaderComputeMeshComponent draws. Everything but the fan is built by FComputeMeshGenerator.
+UENUM()
+enum class EShaderComputeMeshShape : uint8
+{
+	Fan,
+	Grid,
+	Torus,
+	Sphere,
+	Tube,
+	Heightfield,
+};
+
+/*
+ * A mesh generated by the vertex compute shader every frame and drawn in the scene like any other mesh, with depth,
+ * lighting, shadows and the material in slot 0. The vertices are only ever written and read on the GPU, so this scales
+ * to meshes far too big to update from the CPU. Needs SM5, nothing is drawn on lower feature levels.
+ */
+UCLASS(ClassGroup = Rendering, meta = (BlueprintSpawnableComponent))
+class UShaderComputeMeshComponent : public UMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo)
+	EShaderComputeMeshShape Shape;
+
+	// Number of triangles in the fan. Changes take effect when the render state is recreated. The maximum is 65535 * 64,
+	// the most one dispatch of the mesh's compute shader can generate.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo, meta = (ClampMin = "3", ClampMax = "4194240", EditCondition = "Shape == EShaderComputeMeshShape::Fan"))
+	int32 NumTriangles;
+
+	// Quads around and along the other shapes. Use SetSegments to change them at runtime. The maximum keeps the mesh
+	// within what one dispatch of the generator can cover, see FComputeMeshShapeSettings::IsValid.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo, meta = (ClampMin = "1", ClampMax = "2046", EditCondition = "Shape != EShaderComputeMeshShape::Fan"))
+	FIntPoint Segments;
+
+	// Size in world units of a shape with a ComputeRadius of 1. The radius of round shapes, half the width of flat ones.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo)
+	float MeshScale;
+
+	// Height of the tip of the fan, the rim ripples by a quarter of this. The length of the tube and the height of the heightfield.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo)
+	float MeshHeight;
+
+	// Radius of the cross section of the torus, with a ComputeRadius of 1.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo, meta = (EditCondition = "Shape == EShaderComputeMeshShape::Torus"))
+	float MinorRadius;
+
+	// The red channel displaces the heightfield by up to MeshHeight.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo, meta = (EditCondition = "Shape == EShaderComputeMeshShape::Heightfield"))
+	UTexture* HeightTexture;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = ShaderDemo)
+	float ComputeRadius;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	float SimulationSpeed;
+
+public:
+	UShaderComputeMeshComponent();
+
+	UFUNCTION(BlueprintCallable, Category = ShaderDemo)
+	void SetComputeRadius(float NewComputeRadius);
+
+	// Changes the resolution of the shape without recreating the render state. Does nothing for the fan.
+	UFUNCTION(BlueprintCallable, Category = ShaderDemo)
+	void SetSegments(FIntPoint NewSegments);
+
+	// UActorComponent
+	virtual void OnRegister() override;
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void SendRenderDynamicData_Concurrent() override;
+
+	// UPrimitiveComponent
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	virtual int32 GetNumMaterials() const override;
+
+	// USceneComponent
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+	FComputeMeshShapeSettings GetShapeSettings() const;
+
+	FShaderDeclarationDemoModule* ShaderModule;
+	float SimulationState;
+};
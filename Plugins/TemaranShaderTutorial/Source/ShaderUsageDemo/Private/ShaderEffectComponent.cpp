@@ -0,0 +1,84 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderEffectComponent.h"
+
+#include "ShaderEffectSubsystem.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginContext.h"
+
+#include "Engine/World.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+UShaderEffectComponent::UShaderEffectComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	// The subsystem only draws active components, Deactivate() is how an effect is paused.
+	bAutoActivate = true;
+
+	RenderTarget = nullptr;
+	StartColor = FColor::Green;
+	EndColor = FColor::Red;
+	SimulationSpeed = 1.0f;
+	SimulationTimeOffset = 0.0f;
+	ComputeShaderBlend = 0.5f;
+	ComputeRadius = 1.0f;
+	VertexOffset = FVector2D::ZeroVector;
+	VertexTint = FLinearColor::White;
+	ComputeResolutionScale = 1.0f;
+	bUseFlipbook = false;
+	bComputeToVertexBuffer = false;
+	bUseAtlas = false;
+	AtlasSlotSize = 256;
+	SubsystemIndex = INDEX_NONE;
+}
+
+void UShaderEffectComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	UWorld* World = GetWorld();
+	UShaderEffectSubsystem* Subsystem = World ? World->GetSubsystem<UShaderEffectSubsystem>() : nullptr;
+	if (Subsystem)
+	{
+		Subsystem->RegisterEffectComponent(this);
+	}
+}
+
+void UShaderEffectComponent::OnUnregister()
+{
+	UWorld* World = GetWorld();
+	UShaderEffectSubsystem* Subsystem = World ? World->GetSubsystem<UShaderEffectSubsystem>() : nullptr;
+	if (Subsystem)
+	{
+		Subsystem->UnregisterEffectComponent(this);
+	}
+
+	Super::OnUnregister();
+}
+
+UTextureRenderTarget2D* UShaderEffectComponent::GetEffectTexture() const
+{
+	const FShaderPluginContext* ShaderContext = AtlasSlot.IsValid() ? FShaderDeclarationDemoModule::Get().FindContext(GetWorld()) : nullptr;
+	return ShaderContext ? ShaderContext->GetRenderTargetAtlas().GetPageTexture(AtlasSlot) : RenderTarget;
+}
+
+FVector4 UShaderEffectComponent::GetEffectScaleBias() const
+{
+	const FShaderPluginContext* ShaderContext = AtlasSlot.IsValid() ? FShaderDeclarationDemoModule::Get().FindContext(GetWorld()) : nullptr;
+	return ShaderContext ? ShaderContext->GetRenderTargetAtlas().GetSlotScaleBias(AtlasSlot) : FVector4(1.0f, 1.0f, 0.0f, 0.0f);
+}
+
+void UShaderEffectComponent::ApplyToMaterial(UMaterialInstanceDynamic* MaterialInstance, FName TextureParameterName /*= TEXT("InputTexture")*/, FName ScaleBiasParameterName /*= TEXT("InputTextureScaleBias")*/) const
+{
+	if (!MaterialInstance)
+	{
+		return;
+	}
+
+	const FVector4 ScaleBias = GetEffectScaleBias();
+	MaterialInstance->SetTextureParameterValue(TextureParameterName, GetEffectTexture());
+	MaterialInstance->SetVectorParameterValue(ScaleBiasParameterName, FLinearColor(ScaleBias.X, ScaleBias.Y, ScaleBias.Z, ScaleBias.W));
+}
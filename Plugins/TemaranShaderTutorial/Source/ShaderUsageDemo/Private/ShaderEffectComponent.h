@@ -0,0 +1,103 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Components/ActorComponent.h"
+#include "RenderTargetAtlas.h"
+#include "ShaderEffectComponent.generated.h"
+
+class UMaterialInstanceDynamic;
+
+/*
+ * Draws the shader effect into a render target every frame. Unlike AShaderUsageDemoCharacter this doesn't tick:
+ * the component only holds settings, and UShaderEffectSubsystem gathers every active one in its world in a single pass.
+ */
+UCLASS(ClassGroup = Rendering, meta = (BlueprintSpawnableComponent))
+class UShaderEffectComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	class UTextureRenderTarget2D* RenderTarget;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	FColor StartColor;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	FColor EndColor;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	float SimulationSpeed;
+
+	// Added to the world time, so components sharing a render target size don't all show the same frame.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	float SimulationTimeOffset;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo, meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float ComputeShaderBlend;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	float ComputeRadius;
+
+	// Moves the ring of the vertex buffer sample, in clip space. Cheap to animate, the ring is not generated again.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo, meta = (EditCondition = "bComputeToVertexBuffer"))
+	FVector2D VertexOffset;
+
+	// Multiplied with the colors of the vertex buffer sample. Cheap to animate, the ring is not generated again.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo, meta = (EditCondition = "bComputeToVertexBuffer"))
+	FLinearColor VertexTint;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo, meta = (ClampMin = "0.1", ClampMax = "1.0"))
+	float ComputeResolutionScale;
+
+	// Play back a baked flipbook instead of running the compute shader, if one has been baked (see ShaderPlugin.BakeFlipbook).
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	bool bUseFlipbook;
+
+	// Draw the vertex buffer sample instead of the compute and pixel shader sample.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	bool bComputeToVertexBuffer;
+
+	// Draw into a slot of a shared atlas page instead of RenderTarget. All the slots on a page are drawn with one dispatch
+	// and one draw, which is much cheaper for small effects. Only the compute and pixel shader sample supports this, and
+	// changes only take effect when the component is registered again.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	bool bUseAtlas;
+
+	// Size of the atlas slot in texels, rounded up to a power of two.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo, meta = (EditCondition = "bUseAtlas", ClampMin = "32", ClampMax = "2048"))
+	int32 AtlasSlotSize;
+
+public:
+	UShaderEffectComponent();
+
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+
+	// The texture the effect ends up in, either RenderTarget or the atlas page our slot is on.
+	UFUNCTION(BlueprintCallable, Category = ShaderDemo)
+	UTextureRenderTarget2D* GetEffectTexture() const;
+
+	// Transforms UVs into the effect's part of GetEffectTexture: uv * xy + zw. Identity when we don't use the atlas.
+	UFUNCTION(BlueprintCallable, Category = ShaderDemo)
+	FVector4 GetEffectScaleBias() const;
+
+	// Points a material instance at the effect. The material should sample TextureParameterName with its UVs
+	// transformed by the ScaleBiasParameterName vector, so it works both with and without the atlas.
+	UFUNCTION(BlueprintCallable, Category = ShaderDemo)
+	void ApplyToMaterial(UMaterialInstanceDynamic* MaterialInstance, FName TextureParameterName = TEXT("InputTexture"), FName ScaleBiasParameterName = TEXT("InputTextureScaleBias")) const;
+
+private:
+	friend class UShaderEffectSubsystem;
+
+	// Our slot in UShaderEffectSubsystem::Components, so unregistering doesn't have to search for us.
+	int32 SubsystemIndex;
+
+	// Set by UShaderEffectSubsystem while we are registered with bUseAtlas.
+	FRenderTargetAtlasSlot AtlasSlot;
+};
@@ -0,0 +1,174 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderEffectSubsystem.h"
+
+#include "ShaderEffectComponent.h"
+#include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginContext.h"
+
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarParallelGatherThreshold(
+	TEXT("r.ShaderPlugin.ParallelGatherThreshold"),
+	256,
+	TEXT("Number of active shader effect components above which the per frame gather is spread over the task graph."),
+	ECVF_Default);
+
+void UShaderEffectSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	ShaderModule = &FShaderDeclarationDemoModule::Get();
+}
+
+FShaderPluginContext* UShaderEffectSubsystem::GetShaderContext() const
+{
+	// The module lets go of the context when the world is cleaned up, which can be before we are deinitialized.
+	return ShaderModule ? ShaderModule->FindContext(GetWorld()) : nullptr;
+}
+
+void UShaderEffectSubsystem::Deinitialize()
+{
+	FShaderPluginContext* ShaderContext = GetShaderContext();
+	for (UShaderEffectComponent* Component : Components)
+	{
+		if (Component)
+		{
+			Component->SubsystemIndex = INDEX_NONE;
+			if (ShaderContext)
+			{
+				ShaderContext->GetRenderTargetAtlas().Free(Component->AtlasSlot);
+			}
+			else
+			{
+				// The atlas was released along with the context.
+				Component->AtlasSlot = FRenderTargetAtlasSlot();
+			}
+		}
+	}
+	Components.Reset();
+	ShaderModule = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UShaderEffectSubsystem::RegisterEffectComponent(UShaderEffectComponent* Component)
+{
+	check(Component);
+	if (Component->SubsystemIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	Component->SubsystemIndex = Components.Add(Component);
+
+	if (Component->bUseAtlas && !Component->bComputeToVertexBuffer && ShaderModule)
+	{
+		Component->AtlasSlot = ShaderModule->GetContext(GetWorld()).GetRenderTargetAtlas().Allocate(Component->AtlasSlotSize);
+	}
+}
+
+void UShaderEffectSubsystem::UnregisterEffectComponent(UShaderEffectComponent* Component)
+{
+	check(Component);
+	const int32 Index = Component->SubsystemIndex;
+	if (!Components.IsValidIndex(Index) || Components[Index] != Component)
+	{
+		return;
+	}
+
+	// Move the last component into the hole, so removing is O(1) no matter how many components there are.
+	Components.RemoveAtSwap(Index, 1, false);
+	if (Components.IsValidIndex(Index))
+	{
+		Components[Index]->SubsystemIndex = Index;
+	}
+	Component->SubsystemIndex = INDEX_NONE;
+
+	if (FShaderPluginContext* ShaderContext = GetShaderContext())
+	{
+		ShaderContext->GetRenderTargetAtlas().Free(Component->AtlasSlot);
+	}
+	else
+	{
+		Component->AtlasSlot = FRenderTargetAtlasSlot();
+	}
+}
+
+void UShaderEffectSubsystem::Tick(float DeltaTime)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderEffectSubsystem_Tick); // Used to gather CPU profiling data for the UE4 session frontend
+
+	if (!ShaderModule)
+	{
+		return;
+	}
+
+	// This pass only looks at two fields per component, the copying below is what we spread over the workers.
+	ActiveComponents.Reset();
+	for (UShaderEffectComponent* Component : Components)
+	{
+		if (Component && Component->IsActive() && (Component->RenderTarget || Component->AtlasSlot.IsValid()))
+		{
+			ActiveComponents.Add(Component);
+		}
+	}
+
+	if (ActiveComponents.Num() == 0)
+	{
+		return;
+	}
+
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+	FShaderPluginContext& ShaderContext = ShaderModule->GetContext(GetWorld());
+	const FRenderTargetAtlas& Atlas = ShaderContext.GetRenderTargetAtlas();
+
+	FShaderUsageExampleParameterBatch Batch;
+	Batch.SetNumUninitialized(ActiveComponents.Num());
+
+	// Every iteration only reads its own component and writes its own slot, so there is nothing to synchronize.
+	const bool bSingleThreaded = ActiveComponents.Num() < CVarParallelGatherThreshold.GetValueOnGameThread();
+	ParallelFor(ActiveComponents.Num(), [this, &Batch, &Atlas, WorldTime](int32 Index)
+	{
+		const UShaderEffectComponent* Component = ActiveComponents[Index];
+		const bool bUseAtlas = Component->AtlasSlot.IsValid();
+		Batch.RenderTargets[Index] = bUseAtlas ? Atlas.GetPageTexture(Component->AtlasSlot) : Component->RenderTarget;
+		Batch.AtlasRects[Index] = Atlas.GetSlotRect(Component->AtlasSlot);
+		Batch.StartColors[Index] = Component->StartColor;
+		Batch.EndColors[Index] = Component->EndColor;
+		Batch.SimulationStates[Index] = (WorldTime + Component->SimulationTimeOffset) * Component->SimulationSpeed;
+		Batch.ComputeShaderBlends[Index] = Component->ComputeShaderBlend;
+		Batch.ComputeRadii[Index] = Component->ComputeRadius;
+		Batch.VertexOffsets[Index] = Component->VertexOffset;
+		Batch.VertexTints[Index] = Component->VertexTint;
+		Batch.ComputeResolutionScales[Index] = Component->ComputeResolutionScale;
+		Batch.UseFlipbook[Index] = Component->bUseFlipbook;
+		Batch.SampleTypes[Index] = Component->bComputeToVertexBuffer && !bUseAtlas ? EShaderTestSampleType::ComputeToVertexBuffer : EShaderTestSampleType::ComputeAndPixel;
+	}, bSingleThreaded);
+
+	ShaderContext.DrawTargets(MoveTemp(Batch));
+}
+
+ETickableTickType UShaderEffectSubsystem::GetTickableTickType() const
+{
+	// The class default object is created like any other subsystem, but it should never draw anything.
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UShaderEffectSubsystem::IsTickable() const
+{
+	return Components.Num() > 0;
+}
+
+UWorld* UShaderEffectSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+TStatId UShaderEffectSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShaderEffectSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,55 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "ShaderEffectSubsystem.generated.h"
+
+class UShaderEffectComponent;
+class FShaderDeclarationDemoModule;
+class FShaderPluginContext;
+
+/*
+ * Drives every UShaderEffectComponent in a world. Once per frame it gathers the active components into one
+ * FShaderUsageExampleParameterBatch and hands that to the world's context, so the per actor cost is filling in one
+ * entry rather than a whole actor tick and a module lookup.
+ */
+UCLASS()
+class UShaderEffectSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	void RegisterEffectComponent(UShaderEffectComponent* Component);
+	void UnregisterEffectComponent(UShaderEffectComponent* Component);
+
+	int32 GetNumEffectComponents() const { return Components.Num(); }
+
+	// The context this world draws with, or nullptr if it has none yet or it has already been released.
+	FShaderPluginContext* GetShaderContext() const;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	UPROPERTY(Transient)
+	TArray<UShaderEffectComponent*> Components;
+
+	// Reused every frame so the gather doesn't have to grow a new array.
+	TArray<UShaderEffectComponent*> ActiveComponents;
+
+	// Looked up once instead of through the module manager every frame.
+	FShaderDeclarationDemoModule* ShaderModule;
+};
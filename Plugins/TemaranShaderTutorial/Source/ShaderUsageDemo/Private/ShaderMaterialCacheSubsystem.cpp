@@ -0,0 +1,225 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderMaterialCacheSubsystem.h"
+
+#include "ShaderDeclarationDemoModule.h"
+
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "UObject/UObjectArray.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace ShaderMaterialCacheStress
+{
+	// How the stress test hands out materials.
+	enum class EMode
+	{
+		PerComponent,	// What AShaderUsageDemoCharacter::OnFire used to do, a new instance for every component on every hit
+		Cached,			// One shared instance from UShaderMaterialCacheSubsystem
+	};
+
+	static void Run(UWorld* World, EMode Mode, const TArray<UPrimitiveComponent*>& Components, int32 NumHits, UMaterialInterface* BaseMaterial, UTexture* Texture)
+	{
+		UShaderMaterialCacheSubsystem* Cache = World->GetSubsystem<UShaderMaterialCacheSubsystem>();
+		const int32 NumObjectsBefore = GUObjectArray.GetObjectArrayNumMinusAvailable();
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Hit = 0; Hit < NumHits; Hit++)
+		{
+			if (Mode == EMode::Cached)
+			{
+				Cache->AssignMaterialInstance(Components, 0, BaseMaterial, TEXT("InputTexture"), Texture);
+			}
+			else
+			{
+				for (UPrimitiveComponent* Component : Components)
+				{
+					Component->SetMaterial(0, BaseMaterial);
+					UMaterialInstanceDynamic* MID = Component->CreateAndSetMaterialInstanceDynamic(0);
+					MID->SetTextureParameterValue(TEXT("InputTexture"), Texture);
+				}
+			}
+		}
+		const double AssignMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		const int32 NumObjectsAfterAssign = GUObjectArray.GetObjectArrayNumMinusAvailable();
+
+		const double GCStartTime = FPlatformTime::Seconds();
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		const double GCMilliseconds = (FPlatformTime::Seconds() - GCStartTime) * 1000.0;
+		const int32 NumObjectsAfterGC = GUObjectArray.GetObjectArrayNumMinusAvailable();
+
+		UE_LOG(LogShaderPlugin, Display, TEXT("%-12s %6d components x %3d hits: assign %8.2f ms (%.2f us per component per hit), GC %8.2f ms, UObjects +%d after assigning, +%d after GC"),
+			Mode == EMode::Cached ? TEXT("Cached") : TEXT("PerComponent"),
+			Components.Num(),
+			NumHits,
+			AssignMilliseconds,
+			AssignMilliseconds * 1000.0 / FMath::Max(Components.Num() * NumHits, 1),
+			GCMilliseconds,
+			NumObjectsAfterAssign - NumObjectsBefore,
+			NumObjectsAfterGC - NumObjectsBefore);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CMaterialCacheStressCommand(
+	TEXT("ShaderPlugin.MaterialCacheStress"),
+	TEXT("Spawns a grid of static meshes and paints a render target onto all of them, first with a new material instance per mesh and then with the shared cache.\n")
+	TEXT("Game thread time and the change in live UObjects are printed to the log.\n")
+	TEXT("Usage: ShaderPlugin.MaterialCacheStress [NumMeshes=4096] [NumHits=10]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		const int32 NumMeshes = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 4096;
+		const int32 NumHits = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 10;
+
+		UStaticMesh* Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+		UMaterialInterface* BaseMaterial = UMaterial::GetDefaultMaterial(MD_Surface);
+		UTextureRenderTarget2D* Texture = NewObject<UTextureRenderTarget2D>(GetTransientPackage());
+		Texture->AddToRoot();
+		Texture->InitAutoFormat(64, 64);
+
+		// Everything lives on one actor so spawning doesn't dominate the run, the material work per component is the same.
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.ObjectFlags |= RF_Transient;
+		AStaticMeshActor* Actor = World->SpawnActor<AStaticMeshActor>(SpawnParameters);
+
+		TArray<UPrimitiveComponent*> Components;
+		Components.Reserve(NumMeshes);
+		const int32 GridSize = FMath::CeilToInt(FMath::Sqrt((float)NumMeshes));
+		for (int32 i = 0; i < NumMeshes; i++)
+		{
+			UStaticMeshComponent* Component = NewObject<UStaticMeshComponent>(Actor);
+			Component->SetStaticMesh(Mesh);
+			Component->SetupAttachment(Actor->GetRootComponent());
+			Component->SetRelativeLocation(FVector((i % GridSize) * 150.0f, (i / GridSize) * 150.0f, 0.0f));
+			Component->RegisterComponent();
+			Actor->AddInstanceComponent(Component);
+			Components.Add(Component);
+		}
+
+		UE_LOG(LogShaderPlugin, Display, TEXT("Material cache stress test, %d meshes hit %d times:"), NumMeshes, NumHits);
+		ShaderMaterialCacheStress::Run(World, ShaderMaterialCacheStress::EMode::PerComponent, Components, NumHits, BaseMaterial, Texture);
+		ShaderMaterialCacheStress::Run(World, ShaderMaterialCacheStress::EMode::Cached, Components, NumHits, BaseMaterial, Texture);
+
+		Actor->Destroy();
+		Texture->RemoveFromRoot();
+	}));
+
+void UShaderMaterialCacheSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &UShaderMaterialCacheSubsystem::OnPreGarbageCollect);
+}
+
+void UShaderMaterialCacheSubsystem::Deinitialize()
+{
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	MaterialInstances.Reset();
+	Assignments.Reset();
+
+	Super::Deinitialize();
+}
+
+void UShaderMaterialCacheSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	UShaderMaterialCacheSubsystem* This = CastChecked<UShaderMaterialCacheSubsystem>(InThis);
+	for (TPair<FMaterialInstanceKey, FCachedMaterialInstance>& Pair : This->MaterialInstances)
+	{
+		Collector.AddReferencedObject(Pair.Value.MaterialInstance, This);
+	}
+
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
+UMaterialInstanceDynamic* UShaderMaterialCacheSubsystem::FindOrCreateMaterialInstance(UMaterialInterface* BaseMaterial, FName TextureParameterName, UTexture* Texture)
+{
+	check(BaseMaterial);
+
+	const FMaterialInstanceKey Key = { BaseMaterial, TextureParameterName, Texture };
+	if (FCachedMaterialInstance* Cached = MaterialInstances.Find(Key))
+	{
+		return Cached->MaterialInstance;
+	}
+
+	UMaterialInstanceDynamic* MaterialInstance = UMaterialInstanceDynamic::Create(BaseMaterial, this);
+	MaterialInstance->SetTextureParameterValue(TextureParameterName, Texture);
+	MaterialInstances.Add(Key, { MaterialInstance, 0 });
+	return MaterialInstance;
+}
+
+void UShaderMaterialCacheSubsystem::AssignMaterialInstance(TArrayView<UPrimitiveComponent* const> Components, int32 ElementIndex, UMaterialInterface* BaseMaterial, FName TextureParameterName, UTexture* Texture)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderMaterialCache_Assign); // Used to gather CPU profiling data for the UE4 session frontend
+
+	UMaterialInstanceDynamic* MaterialInstance = FindOrCreateMaterialInstance(BaseMaterial, TextureParameterName, Texture);
+	const FMaterialInstanceKey Key = { BaseMaterial, TextureParameterName, Texture };
+	FCachedMaterialInstance& Cached = MaterialInstances.FindChecked(Key);
+
+	for (UPrimitiveComponent* Component : Components)
+	{
+		// Setting the material we already have would still mark the render state dirty, which is most of the cost.
+		if (!Component || Component->GetMaterial(ElementIndex) == MaterialInstance)
+		{
+			continue;
+		}
+
+		Component->SetMaterial(ElementIndex, MaterialInstance);
+
+		FMaterialInstanceKey& AssignedKey = Assignments.FindOrAdd(FMaterialSlot(Component, ElementIndex));
+		if (AssignedKey.BaseMaterial)
+		{
+			RemoveUser(AssignedKey);
+		}
+		AssignedKey = Key;
+		Cached.NumUsers++;
+	}
+}
+
+void UShaderMaterialCacheSubsystem::ReleaseUnusedMaterialInstances()
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_ShaderMaterialCache_ReleaseUnused); // Used to gather CPU profiling data for the UE4 session frontend
+
+	for (auto It = Assignments.CreateIterator(); It; ++It)
+	{
+		const UPrimitiveComponent* Component = It.Key().Key.Get();
+		const FCachedMaterialInstance* Cached = MaterialInstances.Find(It.Value());
+		if (!Component || !Cached || Component->GetMaterial(It.Key().Value) != Cached->MaterialInstance)
+		{
+			RemoveUser(It.Value());
+			It.RemoveCurrent();
+		}
+	}
+
+	for (auto It = MaterialInstances.CreateIterator(); It; ++It)
+	{
+		if (It.Value().NumUsers <= 0)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UShaderMaterialCacheSubsystem::OnPreGarbageCollect()
+{
+	// Anything we drop here is no longer referenced by the time the collection that is about to run marks objects.
+	ReleaseUnusedMaterialInstances();
+}
+
+void UShaderMaterialCacheSubsystem::RemoveUser(const FMaterialInstanceKey& Key)
+{
+	if (FCachedMaterialInstance* Cached = MaterialInstances.Find(Key))
+	{
+		Cached->NumUsers--;
+	}
+}
@@ -0,0 +1,82 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/WeakObjectPtr.h"
+#include "ShaderMaterialCacheSubsystem.generated.h"
+
+class UMaterialInterface;
+class UMaterialInstanceDynamic;
+class UPrimitiveComponent;
+class UTexture;
+
+/*
+ * Hands out one UMaterialInstanceDynamic per (base material, texture parameter, texture) instead of one per component.
+ * Painting a render target onto thousands of meshes then costs a SetMaterial per mesh, and no new UObjects for the GC
+ * to chew through. Instances that no component uses any more are dropped right before each garbage collection.
+ */
+UCLASS()
+class UShaderMaterialCacheSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
+	// Returns the shared instance of BaseMaterial with TextureParameterName set to Texture, creating it the first time.
+	UMaterialInstanceDynamic* FindOrCreateMaterialInstance(UMaterialInterface* BaseMaterial, FName TextureParameterName, UTexture* Texture);
+
+	// Resolves the instance once, then puts it in ElementIndex of every component that doesn't already have it.
+	void AssignMaterialInstance(TArrayView<UPrimitiveComponent* const> Components, int32 ElementIndex, UMaterialInterface* BaseMaterial, FName TextureParameterName, UTexture* Texture);
+
+	// Forgets components that are gone or have been given a different material, and drops instances nobody uses.
+	// This runs before every garbage collection, so there is normally no need to call it yourself.
+	void ReleaseUnusedMaterialInstances();
+
+	int32 GetNumMaterialInstances() const { return MaterialInstances.Num(); }
+	int32 GetNumAssignments() const { return Assignments.Num(); }
+
+private:
+	struct FMaterialInstanceKey
+	{
+		UMaterialInterface* BaseMaterial;
+		FName TextureParameterName;
+		UTexture* Texture;
+
+		bool operator==(const FMaterialInstanceKey& Other) const
+		{
+			return BaseMaterial == Other.BaseMaterial && TextureParameterName == Other.TextureParameterName && Texture == Other.Texture;
+		}
+
+		friend uint32 GetTypeHash(const FMaterialInstanceKey& Key)
+		{
+			return HashCombine(HashCombine(GetTypeHash(Key.BaseMaterial), GetTypeHash(Key.TextureParameterName)), GetTypeHash(Key.Texture));
+		}
+	};
+
+	struct FCachedMaterialInstance
+	{
+		UMaterialInstanceDynamic* MaterialInstance;
+		int32 NumUsers;
+	};
+
+	// A material slot we have put one of our instances in.
+	typedef TPair<TWeakObjectPtr<UPrimitiveComponent>, int32> FMaterialSlot;
+
+	void OnPreGarbageCollect();
+	void RemoveUser(const FMaterialInstanceKey& Key);
+
+	// The key's material and texture are kept alive by the instance itself, so only the instances need to be reported to the GC.
+	TMap<FMaterialInstanceKey, FCachedMaterialInstance> MaterialInstances;
+	TMap<FMaterialSlot, FMaterialInstanceKey> Assignments;
+
+	FDelegateHandle PreGarbageCollectHandle;
+};
@@ -0,0 +1,194 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPluginBakeCommandlet.h"
+
+#include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginBatchBake.h"
+#include "ShaderPluginImageArray.h"
+
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "RHI.h"
+
+UShaderPluginBakeCommandlet::UShaderPluginBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Renders every draw in a parameter stream into one memory mappable image array, split over worker processes.");
+	HelpUsage = TEXT("<Project> -run=ShaderPluginBake -Jobs=<file.params> -Output=<file.spia> [-Workers=N] [-cpu] [-WorkerArgs=\"...\"]");
+	HelpParamNames.Add(TEXT("Jobs"));
+	HelpParamDescriptions.Add(TEXT("A parameter stream, for example one recorded with ShaderPlugin.Record. Every DrawTarget is one image."));
+	HelpParamNames.Add(TEXT("Output"));
+	HelpParamDescriptions.Add(TEXT("The image array to write. It is replaced if it exists."));
+	HelpParamNames.Add(TEXT("Workers"));
+	HelpParamDescriptions.Add(TEXT("Processes to bake with. 0, the default, is one per core with -cpu and one otherwise."));
+	HelpParamNames.Add(TEXT("cpu"));
+	HelpParamDescriptions.Add(TEXT("Bake on the CPU. Only the compute and pixel sample is drawn, other jobs are skipped. Without it the bake needs -AllowCommandletRendering."));
+	HelpParamNames.Add(TEXT("WorkerArgs"));
+	HelpParamDescriptions.Add(TEXT("Added to the command line of every worker."));
+}
+
+int32 UShaderPluginBakeCommandlet::Main(const FString& Params)
+{
+	FString JobsFilename;
+	FString OutputFilename;
+	if (!FParse::Value(*Params, TEXT("Jobs="), JobsFilename) || !FParse::Value(*Params, TEXT("Output="), OutputFilename))
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Usage: %s"), *HelpUsage);
+		return 1;
+	}
+
+	// The workers may not start in our working directory.
+	JobsFilename = FPaths::ConvertRelativePathToFull(JobsFilename);
+	OutputFilename = FPaths::ConvertRelativePathToFull(OutputFilename);
+	const bool bForceCPU = FParse::Param(*Params, TEXT("cpu"));
+
+	int32 ShardIndex = 0;
+	int32 NumShards = 0;
+	if (FParse::Value(*Params, TEXT("Shard="), ShardIndex) && FParse::Value(*Params, TEXT("NumShards="), NumShards))
+	{
+		return RunShard(JobsFilename, OutputFilename, ShardIndex, NumShards, bForceCPU);
+	}
+
+	TArray<FShaderPluginBakeJob> Jobs;
+	if (!FShaderPluginBatchBake::LoadJobs(JobsFilename, Jobs))
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("%s has no jobs to bake."), *JobsFilename);
+		return 1;
+	}
+
+	if (!FShaderPluginBatchBake::CreateOutput(OutputFilename, Jobs))
+	{
+		return 1;
+	}
+
+	int32 NumWorkers = 0;
+	FParse::Value(*Params, TEXT("Workers="), NumWorkers);
+	if (NumWorkers <= 0)
+	{
+		NumWorkers = bForceCPU ? FPlatformMisc::NumberOfCores() : 1;
+	}
+	NumWorkers = FMath::Clamp(NumWorkers, 1, Jobs.Num());
+
+	FString WorkerArgs;
+	FParse::Value(*Params, TEXT("WorkerArgs="), WorkerArgs, false);
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Baking %d jobs from %s into %s with %d worker(s) on the %s."),
+		Jobs.Num(), *JobsFilename, *OutputFilename, NumWorkers, bForceCPU ? TEXT("CPU") : TEXT("GPU"));
+
+	const double StartTime = FPlatformTime::Seconds();
+	bool bSuccess;
+	if (NumWorkers == 1)
+	{
+		// Not worth a process of its own, and this one already has the jobs loaded.
+		FShaderPluginBakeStats Stats;
+		bSuccess = FShaderPluginBatchBake::BakeShard(Jobs, OutputFilename, 0, 1, bForceCPU, Stats);
+	}
+	else
+	{
+		bSuccess = RunWorkers(JobsFilename, OutputFilename, NumWorkers, bForceCPU, WorkerArgs);
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	// The workers only report through their exit codes, so check what actually made it into the file.
+	FImageArrayReader Reader;
+	if (!Reader.Open(OutputFilename))
+	{
+		return 1;
+	}
+
+	int32 NumWritten = 0;
+	int64 BytesWritten = 0;
+	for (int32 Index = 0; Index < Reader.Num(); Index++)
+	{
+		if (Reader.IsWritten(Index))
+		{
+			const FIntPoint Size = Reader.GetSize(Index);
+			NumWritten++;
+			BytesWritten += (int64)Size.X * Size.Y * sizeof(FColor);
+		}
+	}
+
+	UE_LOG(LogShaderPlugin, Display, TEXT("Baked %d of %d images in %.2f s (%.1f images/s, %.1f MB/s)."),
+		NumWritten, Reader.Num(), Seconds,
+		Seconds > 0.0 ? NumWritten / Seconds : 0.0,
+		Seconds > 0.0 ? BytesWritten / (1024.0 * 1024.0) / Seconds : 0.0);
+
+	return bSuccess ? 0 : 1;
+}
+
+int32 UShaderPluginBakeCommandlet::RunShard(const FString& JobsFilename, const FString& OutputFilename, int32 ShardIndex, int32 NumShards, bool bForceCPU)
+{
+	if (NumShards <= 0 || ShardIndex < 0 || ShardIndex >= NumShards)
+	{
+		UE_LOG(LogShaderPlugin, Error, TEXT("Shard %d of %d doesn't exist."), ShardIndex, NumShards);
+		return 1;
+	}
+
+	TArray<FShaderPluginBakeJob> Jobs;
+	if (!FShaderPluginBatchBake::LoadJobs(JobsFilename, Jobs))
+	{
+		return 1;
+	}
+
+	FShaderPluginBakeStats Stats;
+	return FShaderPluginBatchBake::BakeShard(Jobs, OutputFilename, ShardIndex, NumShards, bForceCPU, Stats) ? 0 : 1;
+}
+
+bool UShaderPluginBakeCommandlet::RunWorkers(const FString& JobsFilename, const FString& OutputFilename, int32 NumWorkers, bool bForceCPU, const FString& WorkerArgs)
+{
+	const FString ExecutablePath = FPlatformProcess::ExecutablePath();
+	const FString ProjectPath = FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath());
+
+	// CPU workers don't need a GPU, and each of them is one core of the pool, so their ParallelFor runs inline. Commandlets
+	// get the null RHI unless they ask for rendering, so GPU workers have to.
+	const FString BackendArgs = bForceCPU ? TEXT("-cpu -nullrhi -nothreading") : TEXT("-AllowCommandletRendering");
+
+	TArray<FProcHandle> Workers;
+	bool bSuccess = true;
+	for (int32 ShardIndex = 0; ShardIndex < NumWorkers; ShardIndex++)
+	{
+		const FString Args = FString::Printf(TEXT("\"%s\" -run=ShaderPluginBake -Jobs=\"%s\" -Output=\"%s\" -Shard=%d -NumShards=%d %s %s -unattended -nopause"),
+			*ProjectPath, *JobsFilename, *OutputFilename, ShardIndex, NumWorkers, *BackendArgs, *WorkerArgs);
+
+		FProcHandle Worker = FPlatformProcess::CreateProc(*ExecutablePath, *Args, false, true, true, nullptr, 0, nullptr, nullptr);
+		if (!Worker.IsValid())
+		{
+			UE_LOG(LogShaderPlugin, Error, TEXT("Failed to start worker %d: %s %s"), ShardIndex, *ExecutablePath, *Args);
+			bSuccess = false;
+		}
+		Workers.Add(Worker);
+	}
+
+	for (int32 ShardIndex = 0; ShardIndex < Workers.Num(); ShardIndex++)
+	{
+		FProcHandle& Worker = Workers[ShardIndex];
+		if (!Worker.IsValid())
+		{
+			continue;
+		}
+
+		while (FPlatformProcess::IsProcRunning(Worker))
+		{
+			FPlatformProcess::Sleep(0.1f);
+		}
+
+		int32 ReturnCode = 0;
+		if (!FPlatformProcess::GetProcReturnCode(Worker, &ReturnCode) || ReturnCode != 0)
+		{
+			UE_LOG(LogShaderPlugin, Error, TEXT("Worker %d failed with exit code %d."), ShardIndex, ReturnCode);
+			bSuccess = false;
+		}
+		FPlatformProcess::CloseProc(Worker);
+	}
+
+	return bSuccess;
+}
@@ -0,0 +1,37 @@
+// Copyright 2016-2020 Cadic AB. All Rights Reserved.
+// @Author	Fredrik Lindh [Temaran] (temaran@gmail.com) {https://github.com/Temaran}
+///////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Commandlets/Commandlet.h"
+#include "ShaderPluginBakeCommandlet.generated.h"
+
+/*
+ * Bakes a job list into an image array without opening a world, see FShaderPluginBatchBake. Run it with
+ *
+ *   UE4Editor-Cmd <Project> -run=ShaderPluginBake -Jobs=<file.params> -Output=<file.spia> [-Workers=N] [-cpu] [-WorkerArgs="..."]
+ *
+ * The first process lays out the output and then starts N copies of itself, each baking every N-th job straight into
+ * the shared file. Nothing but the job list and the output file is shared, so on the CPU back-end the throughput grows
+ * with the number of cores. GPU workers all use the same GPU, so more than a couple of them rarely pays off there.
+ */
+UCLASS()
+class UShaderPluginBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UShaderPluginBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	// Bakes one shard in this process. This is what the workers run.
+	int32 RunShard(const FString& JobsFilename, const FString& OutputFilename, int32 ShardIndex, int32 NumShards, bool bForceCPU);
+
+	// Starts the workers and waits for all of them. Returns false if any of them failed or couldn't be started.
+	bool RunWorkers(const FString& JobsFilename, const FString& OutputFilename, int32 NumWorkers, bool bForceCPU, const FString& WorkerArgs);
+};
@@ -5,14 +5,17 @@
 #include "ShaderUsageDemoCharacter.h"
 
 #include "ShaderDeclarationDemoModule.h"
+#include "ShaderPluginContext.h"
+#include "ShaderMaterialCacheSubsystem.h"
 
 #include "Animation/AnimInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Texture2D.h"
 #include "GameFramework/InputSettings.h"
 #include "Kismet/GameplayStatics.h"
-#include "Runtime/Engine/Classes/Materials/MaterialInstanceDynamic.h"
 
 AShaderUsageDemoCharacter::AShaderUsageDemoCharacter()
 {
@@ -52,18 +55,50 @@ AShaderUsageDemoCharacter::AShaderUsageDemoCharacter()
 	ComputeShaderSimulationSpeed = 1.0;
 	ComputeShaderBlend = 0.5f;
 	TotalTimeSecs = 0.0f;
+	VertexOffset = FVector2D::ZeroVector;
+	VertexTint = FLinearColor::White;
+	bUseFlipbook = false;
+	bCompressRenderTarget = false;
+	bCompressAlpha = false;
+	CompressedRenderTarget = nullptr;
+	ShaderContext = nullptr;
 }
 
 void AShaderUsageDemoCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 	FP_Gun->AttachToComponent(Mesh1P, FAttachmentTransformRules::SnapToTargetIncludingScale, TEXT("GripPoint"));
-	FShaderDeclarationDemoModule::Get().BeginRendering();
+	FShaderDeclarationDemoModule& ShaderModule = FShaderDeclarationDemoModule::Get();
+
+	// Split screen players share the world's context, it keeps rendering until the last of them has ended play.
+	ShaderContext = &ShaderModule.GetContext(GetWorld());
+	ShaderContext->BeginRendering();
+
+	if (bCompressRenderTarget && RenderTarget)
+	{
+		CompressedRenderTarget = ShaderModule.CreateCompressedTarget(RenderTarget, bCompressAlpha ? EShaderPluginCompression::BC3 : EShaderPluginCompression::BC1);
+	}
+}
+
+void AShaderUsageDemoCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ShaderContext)
+	{
+		ShaderContext->EndRendering();
+		ShaderContext = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AShaderUsageDemoCharacter::BeginDestroy()
 {
-	FShaderDeclarationDemoModule::Get().EndRendering();
+	if (CompressedRenderTarget)
+	{
+		FShaderDeclarationDemoModule::Get().ReleaseCompressedTarget(RenderTarget);
+		CompressedRenderTarget = nullptr;
+	}
+
 	Super::BeginDestroy();
 }
 
@@ -94,14 +129,20 @@ void AShaderUsageDemoCharacter::Tick(float DeltaSeconds)
 		DrawParameters.SimulationState = ComputeShaderSimulationSpeed * TotalTimeSecs;
 		DrawParameters.ComputeShaderBlend = ComputeShaderBlend;
 		DrawParameters.ComputeRadius = FMath::Abs(FMath::Sin(TotalTimeSecs));
+		DrawParameters.VertexOffset = VertexOffset;
+		DrawParameters.VertexTint = VertexTint;
 		DrawParameters.StartColor = StartColor;
 		DrawParameters.EndColor = FColor(EndColorBuildup * 255, 0, 0, 255);
+		DrawParameters.bUseFlipbook = bUseFlipbook;
 	}
 
 	// If doing this for realsies, you should avoid doing this every frame unless you have to of course.
 	// We set it every frame here since we're updating the end color and simulation state. Boop.
-	FShaderDeclarationDemoModule::Get().UpdateParameters(DrawParameters);
-	FShaderDeclarationDemoModule::Get().DrawTarget(EShaderTestSampleType::ComputeToVertexBuffer);
+	if (ShaderContext)
+	{
+		ShaderContext->UpdateParameters(DrawParameters);
+		ShaderContext->DrawTarget(EShaderTestSampleType::ComputeToVertexBuffer);
+	}
 }
 
 void AShaderUsageDemoCharacter::OnFire()
@@ -118,18 +159,20 @@ void AShaderUsageDemoCharacter::OnFire()
 	{
 		AActor* HitActor = HitResult.GetActor();
 
-		if (HitActor)
+		if (HitActor && MaterialToApplyToClickedObject)
 		{
-			TArray<UStaticMeshComponent*> StaticMeshComponents = TArray<UStaticMeshComponent*>();
-			HitActor->GetComponents<UStaticMeshComponent>(StaticMeshComponents);
-
-			for (int32 i = 0; i < StaticMeshComponents.Num(); i++) 
+			TArray<UPrimitiveComponent*> StaticMeshComponents;
+			for (UActorComponent* Component : HitActor->GetComponents())
 			{
-				UStaticMeshComponent* CurrentStaticMeshPtr = StaticMeshComponents[i];
-				CurrentStaticMeshPtr->SetMaterial(0, MaterialToApplyToClickedObject);
-				UMaterialInstanceDynamic* MID =	CurrentStaticMeshPtr->CreateAndSetMaterialInstanceDynamic(0);
-				MID->SetTextureParameterValue("InputTexture", (UTexture*)RenderTarget);
+				if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+				{
+					StaticMeshComponents.Add(StaticMeshComponent);
+				}
 			}
+
+			// Every mesh we hit shares one material instance, instead of getting a new one on every hit.
+			UShaderMaterialCacheSubsystem* MaterialCache = GetWorld()->GetSubsystem<UShaderMaterialCacheSubsystem>();
+			MaterialCache->AssignMaterialInstance(StaticMeshComponents, 0, MaterialToApplyToClickedObject, TEXT("InputTexture"), CompressedRenderTarget ? (UTexture*)CompressedRenderTarget : (UTexture*)RenderTarget);
 		}
 	}
 
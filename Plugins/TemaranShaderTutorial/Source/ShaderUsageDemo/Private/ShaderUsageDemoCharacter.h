@@ -10,6 +10,7 @@
 #include "ShaderUsageDemoCharacter.generated.h"
 
 class UInputComponent;
+class FShaderPluginContext;
 
 UCLASS()
 class AShaderUsageDemoCharacter : public ACharacter
@@ -57,12 +58,36 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
 	UMaterialInterface* MaterialToApplyToClickedObject;
 
+	// Moves and tints the ring we draw to RenderTarget. The offset is in clip space. Changing either only changes how the
+	// ring is drawn, the compute shader doesn't run again.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	FVector2D VertexOffset;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	FLinearColor VertexTint;
+
+	// Tick "Auto Generate Mips" on the target to have the plugin rebuild its mips after every draw, so the meshes OnFire
+	// assigns it to don't alias when they are far away. See r.ShaderPlugin.GenerateMips.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
 	class UTextureRenderTarget2D* RenderTarget;
 
+	// Play back a baked flipbook instead of running the compute shader, if one has been baked (see ShaderPlugin.BakeFlipbook).
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = ShaderDemo)
+	bool bUseFlipbook;
+
+	// Give the meshes OnFire hits a block compressed copy of the render target, which is re-encoded after every draw.
+	// Needs SM5 and a render target size that is a multiple of 4, the render target itself is used otherwise.
+	UPROPERTY(EditAnywhere, Category = ShaderDemo)
+	bool bCompressRenderTarget;
+
+	// Compress to BC3 and keep the alpha channel, instead of BC1 at half the size.
+	UPROPERTY(EditAnywhere, Category = ShaderDemo, meta = (EditCondition = "bCompressRenderTarget"))
+	bool bCompressAlpha;
+
 public:
 	AShaderUsageDemoCharacter();
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void BeginDestroy() override;
 	virtual void Tick(float DeltaSeconds) override;
 
@@ -146,4 +171,11 @@ protected:
 	float EndColorBuildupDirection;
 	float ComputeShaderBlend;
 	float TotalTimeSecs;
+
+	// Made by the plugin in BeginPlay when bCompressRenderTarget is set.
+	UPROPERTY(Transient)
+	class UTexture2D* CompressedRenderTarget;
+
+	// The context of our world. Looked up once in BeginPlay instead of through the module manager on every tick.
+	FShaderPluginContext* ShaderContext;
 };